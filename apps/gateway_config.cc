@@ -0,0 +1,234 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "gateway_config.h"
+
+namespace gr {
+  namespace ule {
+
+    gateway_config::gateway_config()
+      : input(INPUT_PCAP), interface("dvb0_0"), output(OUTPUT_STDOUT),
+        udp_port(0), ts_rate(0), call_sign("ULE"),
+        ping_reply(PING_REPLY_OFF), ipaddr_spoof(IPADDR_SPOOF_OFF),
+        src_address("0.0.0.0"), dst_address("0.0.0.0"),
+        dbit(DBIT_OFF), packing(PACKING_ON), aqm(AQM_FQ_CODEL),
+        ack_filter(ACK_FILTER_OFF), codel_target(5.0), codel_interval(100.0),
+        security(SECURITY_OFF), spi(1), compress(COMPRESS_OFF),
+        compress_classes("*="), fec_k(32), fec_r(0)
+    {
+    }
+
+    static std::string
+    trim(const std::string &s)
+    {
+      size_t first = s.find_first_not_of(" \t\r");
+      size_t last = s.find_last_not_of(" \t\r");
+
+      return first == std::string::npos ? std::string() : s.substr(first, last - first + 1);
+    }
+
+    static int
+    parse_int(const std::string &value, bool *ok)
+    {
+      char *end;
+      long n = strtol(value.c_str(), &end, 0);
+
+      *ok = !value.empty() && *end == '\0';
+      return (int)n;
+    }
+
+    static double
+    parse_double(const std::string &value, bool *ok)
+    {
+      char *end;
+      double n = strtod(value.c_str(), &end);
+
+      *ok = !value.empty() && *end == '\0';
+      return n;
+    }
+
+    /* index of value in names, or -1 */
+    static int
+    parse_choice(const std::string &value, const char *const *names, int count)
+    {
+      for (int i = 0; i < count; i++) {
+        if (value == names[i]) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    gateway_config
+    read_gateway_config(const char *filename)
+    {
+      static const char *const inputs[] = {"pcap", "tun", "packet"};
+      static const char *const outputs[] = {"file", "stdout", "fifo", "udp"};
+      static const char *const off_on[] = {"off", "on"};
+      static const char *const on_off[] = {"on", "off"};
+      static const char *const aqms[] = {"off", "fq_codel", "fq_codel_ecn"};
+      static const char *const securities[] = {"off", "aes128_gcm", "aes256_gcm"};
+      static const char *const compressions[] = {"off", "zstd"};
+      std::ifstream file(filename);
+      gateway_config cfg;
+      std::string line, key, value;
+      size_t equals;
+      int number = 0, choice = 0;
+      bool ok;
+
+      if (!file) {
+        throw std::runtime_error(std::string("Cannot open ") + filename + "\n");
+      }
+      while (std::getline(file, line)) {
+        number++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+          continue;
+        }
+        equals = line.find('=');
+        if (equals == std::string::npos) {
+          std::ostringstream s;
+          s << filename << ":" << number << ": expected key = value\n";
+          throw std::runtime_error(s.str());
+        }
+        key = trim(line.substr(0, equals));
+        value = trim(line.substr(equals + 1));
+        ok = true;
+        if (key == "input") {
+          ok = (choice = parse_choice(value, inputs, 3)) >= 0;
+          cfg.input = (gateway_input_t)choice;
+        }
+        else if (key == "interface") {
+          cfg.interface = value;
+        }
+        else if (key == "mac_address") {
+          cfg.mac_address = value;
+        }
+        else if (key == "output") {
+          ok = (choice = parse_choice(value, outputs, 4)) >= 0;
+          cfg.output = (gateway_output_t)choice;
+        }
+        else if (key == "path") {
+          cfg.path = value;
+        }
+        else if (key == "udp_address") {
+          cfg.udp_address = value;
+        }
+        else if (key == "udp_port") {
+          cfg.udp_port = parse_int(value, &ok);
+        }
+        else if (key == "ts_rate") {
+          cfg.ts_rate = parse_int(value, &ok);
+        }
+        else if (key == "call_sign") {
+          cfg.call_sign = value;
+        }
+        else if (key == "ping_reply") {
+          ok = (choice = parse_choice(value, off_on, 2)) >= 0;
+          cfg.ping_reply = (ule_ping_reply_t)choice;
+        }
+        else if (key == "ipaddr_spoof") {
+          ok = (choice = parse_choice(value, off_on, 2)) >= 0;
+          cfg.ipaddr_spoof = (ule_ipaddr_spoof_t)choice;
+        }
+        else if (key == "src_address") {
+          cfg.src_address = value;
+        }
+        else if (key == "dst_address") {
+          cfg.dst_address = value;
+        }
+        else if (key == "npa_address") {
+          ok = (choice = parse_choice(value, on_off, 2)) >= 0;
+          cfg.dbit = (ule_dbit_t)choice;
+        }
+        else if (key == "packing") {
+          ok = (choice = parse_choice(value, on_off, 2)) >= 0;
+          cfg.packing = (ule_packing_t)choice;
+        }
+        else if (key == "aqm") {
+          ok = (choice = parse_choice(value, aqms, 3)) >= 0;
+          cfg.aqm = (ule_aqm_t)choice;
+        }
+        else if (key == "ack_filter") {
+          ok = (choice = parse_choice(value, off_on, 2)) >= 0;
+          cfg.ack_filter = (ule_ack_filter_t)choice;
+        }
+        else if (key == "codel_target") {
+          cfg.codel_target = parse_double(value, &ok);
+        }
+        else if (key == "codel_interval") {
+          cfg.codel_interval = parse_double(value, &ok);
+        }
+        else if (key == "security") {
+          ok = (choice = parse_choice(value, securities, 3)) >= 0;
+          cfg.security = (ule_security_t)choice;
+        }
+        else if (key == "security_key") {
+          cfg.security_key = value;
+        }
+        else if (key == "spi") {
+          cfg.spi = parse_int(value, &ok);
+        }
+        else if (key == "compress") {
+          ok = (choice = parse_choice(value, compressions, 2)) >= 0;
+          cfg.compress = (ule_compress_t)choice;
+        }
+        else if (key == "compress_classes") {
+          cfg.compress_classes = value;
+        }
+        else if (key == "fec_k") {
+          cfg.fec_k = parse_int(value, &ok);
+        }
+        else if (key == "fec_r") {
+          cfg.fec_r = parse_int(value, &ok);
+        }
+        else {
+          std::ostringstream s;
+          s << filename << ":" << number << ": unknown key " << key << "\n";
+          throw std::runtime_error(s.str());
+        }
+        if (!ok) {
+          std::ostringstream s;
+          s << filename << ":" << number << ": bad value for " << key << "\n";
+          throw std::runtime_error(s.str());
+        }
+      }
+
+      if (cfg.ts_rate <= 0) {
+        throw std::runtime_error("ts_rate must be set to the Transport Stream rate in bits per second\n");
+      }
+      if ((cfg.output == OUTPUT_FILE || cfg.output == OUTPUT_FIFO) && cfg.path.empty()) {
+        throw std::runtime_error("File and FIFO output need a path\n");
+      }
+      if (cfg.output == OUTPUT_UDP && (cfg.udp_address.empty() || cfg.udp_port <= 0 || cfg.udp_port > 65535)) {
+        throw std::runtime_error("UDP output needs udp_address and udp_port\n");
+      }
+      if (cfg.input == INPUT_PCAP && cfg.mac_address.empty()) {
+        throw std::runtime_error("pcap input needs mac_address for the capture filter\n");
+      }
+      return cfg;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
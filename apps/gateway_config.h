@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_GATEWAY_CONFIG_H
+#define INCLUDED_ULE_GATEWAY_CONFIG_H
+
+#include <ule/ule_config.h>
+#include <string>
+
+namespace gr {
+  namespace ule {
+
+    enum gateway_input_t {
+      INPUT_PCAP = 0,
+      INPUT_TUN,
+      INPUT_PACKET,
+    };
+
+    enum gateway_output_t {
+      OUTPUT_FILE = 0,
+      OUTPUT_STDOUT,
+      OUTPUT_FIFO,
+      OUTPUT_UDP,
+    };
+
+    /*
+     * Everything ule-gateway is told by its configuration file. The
+     * defaults match the ULE Source block.
+     */
+    struct gateway_config {
+      gateway_input_t input;
+      std::string interface;
+      std::string mac_address;
+      gateway_output_t output;
+      std::string path;
+      std::string udp_address;
+      int udp_port;
+      int ts_rate;
+      std::string call_sign;
+      ule_ping_reply_t ping_reply;
+      ule_ipaddr_spoof_t ipaddr_spoof;
+      std::string src_address;
+      std::string dst_address;
+      ule_dbit_t dbit;
+      ule_packing_t packing;
+      ule_aqm_t aqm;
+      ule_ack_filter_t ack_filter;
+      double codel_target;
+      double codel_interval;
+      ule_security_t security;
+      std::string security_key;
+      int spi;
+      ule_compress_t compress;
+      std::string compress_classes;
+      int fec_k;
+      int fec_r;
+
+      gateway_config();
+    };
+
+    /*
+     * Read "key = value" lines from filename. Blank lines and lines
+     * starting with # are skipped. Throws std::runtime_error naming
+     * the line on an unknown key or bad value.
+     */
+    gateway_config read_gateway_config(const char *filename);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_GATEWAY_CONFIG_H */
@@ -0,0 +1,402 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/if_packet.h>
+#include <linux/if_tun.h>
+#include "gateway_io.h"
+#include "pcap_capture.h"
+
+namespace gr {
+  namespace ule {
+
+    static void
+    fail(const std::string &what)
+    {
+      std::stringstream s;
+      s << what << ": " << strerror(errno) << std::endl;
+      throw std::runtime_error(s.str());
+    }
+
+    /* colon separated MAC address, or broadcast if it does not parse */
+    static void
+    parse_mac(const std::string &mac_address, unsigned char *addr)
+    {
+      if (sscanf(mac_address.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &addr[0], &addr[1],
+                 &addr[2], &addr[3], &addr[4], &addr[5]) != ETHER_ADDR_LEN) {
+        memset(addr, 0xff, ETHER_ADDR_LEN);
+      }
+    }
+
+    /*
+     * libpcap capture with the same "ether src" filter as the ULE
+     * Source block, in non-blocking mode.
+     */
+    class pcap_input : public gateway_input
+    {
+     private:
+      pcap_t *descr;
+
+      static void handler(unsigned char *user, const struct pcap_pkthdr *hdr, const unsigned char *packet)
+      {
+        ((fq_codel_queue *)user)->enqueue(hdr, packet);
+      }
+
+     public:
+      pcap_input(const gateway_config &cfg)
+      {
+        char errbuf[PCAP_ERRBUF_SIZE];
+
+        descr = open_capture(cfg.interface.c_str(), cfg.mac_address.c_str(), 1);
+        if (pcap_setnonblock(descr, 1, errbuf) != 0 || pcap_get_selectable_fd(descr) < 0) {
+          pcap_close(descr);
+          throw std::runtime_error("Error making the capture handle non-blocking\n");
+        }
+      }
+
+      ~pcap_input() { pcap_close(descr); }
+
+      int fd(void) { return pcap_get_selectable_fd(descr); }
+
+      void drain(fq_codel_queue *queue)
+      {
+        int rc;
+
+        while ((rc = pcap_dispatch(descr, -1, handler, (unsigned char *)queue)) > 0) {
+        }
+        if (rc < 0) {
+          std::stringstream s;
+          s << "Error calling pcap_dispatch(): " << pcap_geterr(descr) << std::endl;
+          throw std::runtime_error(s.str());
+        }
+      }
+    };
+
+    /*
+     * Layer 3 TUN device. Datagrams get an Ethernet header addressed
+     * to mac_address, as raw IP PDUs do in the ULE Source block.
+     */
+    class tun_input : public gateway_input
+    {
+     private:
+      int tun;
+      unsigned char npa_address[ETHER_ADDR_LEN];
+
+     public:
+      tun_input(const gateway_config &cfg)
+      {
+        struct ifreq ifr;
+
+        parse_mac(cfg.mac_address, npa_address);
+        tun = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+        if (tun < 0) {
+          fail("Error opening /dev/net/tun");
+        }
+        memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+        strncpy(ifr.ifr_name, cfg.interface.c_str(), IFNAMSIZ - 1);
+        if (ioctl(tun, TUNSETIFF, &ifr) < 0) {
+          close(tun);
+          fail("Error attaching to TUN device " + cfg.interface);
+        }
+      }
+
+      ~tun_input() { close(tun); }
+
+      int fd(void) { return tun; }
+
+      void drain(fq_codel_queue *queue)
+      {
+        unsigned char frame[ULE_MAX_FRAME_SIZE];
+        struct ether_header *eptr = (struct ether_header *)frame;
+        struct pcap_pkthdr hdr;
+        ssize_t n;
+
+        memcpy(eptr->ether_dhost, npa_address, ETHER_ADDR_LEN);
+        memset(eptr->ether_shost, 0, ETHER_ADDR_LEN);
+        while ((n = read(tun, frame + sizeof(struct ether_header), sizeof(frame) - sizeof(struct ether_header))) > 0) {
+          switch (frame[sizeof(struct ether_header)] >> 4) {
+            case 4:
+              eptr->ether_type = htons(ETHERTYPE_IP);
+              break;
+            case 6:
+              eptr->ether_type = htons(ETHERTYPE_IPV6);
+              break;
+            default:
+              continue;
+          }
+          hdr.caplen = hdr.len = n + sizeof(struct ether_header);
+          queue->enqueue(&hdr, frame);
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+          fail("Error reading the TUN device");
+        }
+      }
+    };
+
+    /*
+     * AF_PACKET socket on one interface. With mac_address set only the
+     * frames sent by that address are taken, like the pcap filter.
+     */
+    class packet_input : public gateway_input
+    {
+     private:
+      int sock;
+      bool filter;
+      unsigned char src_address[ETHER_ADDR_LEN];
+
+     public:
+      packet_input(const gateway_config &cfg)
+      {
+        struct sockaddr_ll sll;
+        int size = 1024 * 1024 * 16;
+
+        filter = !cfg.mac_address.empty();
+        parse_mac(cfg.mac_address, src_address);
+        sock = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK, htons(ETH_P_ALL));
+        if (sock < 0) {
+          fail("Error opening AF_PACKET socket");
+        }
+        memset(&sll, 0, sizeof(sll));
+        sll.sll_family = AF_PACKET;
+        sll.sll_protocol = htons(ETH_P_ALL);
+        sll.sll_ifindex = if_nametoindex(cfg.interface.c_str());
+        if (sll.sll_ifindex == 0 || bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+          close(sock);
+          fail("Error binding to interface " + cfg.interface);
+        }
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+      }
+
+      ~packet_input() { close(sock); }
+
+      int fd(void) { return sock; }
+
+      void drain(fq_codel_queue *queue)
+      {
+        unsigned char frame[ULE_MAX_FRAME_SIZE];
+        struct pcap_pkthdr hdr;
+        ssize_t n;
+
+        while ((n = recv(sock, frame, sizeof(frame), MSG_TRUNC)) >= 0) {
+          if ((size_t)n > sizeof(frame) || (size_t)n < sizeof(struct ether_header)) {
+            continue;
+          }
+          if (filter && memcmp(frame + ETHER_ADDR_LEN, src_address, ETHER_ADDR_LEN) != 0) {
+            continue;
+          }
+          hdr.caplen = hdr.len = n;
+          queue->enqueue(&hdr, frame);
+        }
+        if (errno != EAGAIN && errno != EINTR) {
+          fail("Error reading the AF_PACKET socket");
+        }
+      }
+    };
+
+    /*
+     * File, named pipe or stdout. A pipe, socket or terminal is
+     * switched to non-blocking writes and whatever its reader has not
+     * taken yet is kept in backlog. A regular file is written through.
+     */
+    class fd_output : public gateway_output
+    {
+     private:
+      int out;
+      bool owned;
+      int flags;
+      bool pollable;
+      std::vector<unsigned char> backlog;
+      size_t backlog_offset;
+
+      /* as much as the descriptor takes now */
+      int put(const unsigned char *ts, int size)
+      {
+        ssize_t n;
+        int written = 0;
+
+        while (written < size) {
+          n = ::write(out, ts + written, size - written);
+          if (n < 0) {
+            if (errno == EINTR) {
+              continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+              break;
+            }
+            fail("Error writing the Transport Stream");
+          }
+          written += n;
+        }
+        return written;
+      }
+
+     public:
+      fd_output(const gateway_config &cfg) : out(STDOUT_FILENO), owned(false), flags(-1), pollable(false), backlog_offset(0)
+      {
+        struct stat st;
+
+        if (cfg.output == OUTPUT_FIFO) {
+          if (mkfifo(cfg.path.c_str(), 0644) < 0 && errno != EEXIST) {
+            fail("Error creating FIFO " + cfg.path);
+          }
+          /* waits here for the reader, usually the modulator */
+          out = open(cfg.path.c_str(), O_WRONLY);
+        }
+        else if (cfg.output == OUTPUT_FILE) {
+          out = open(cfg.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (out < 0) {
+          fail("Error opening " + cfg.path);
+        }
+        owned = out != STDOUT_FILENO;
+        if (fstat(out, &st) < 0) {
+          fail("Error opening " + cfg.path);
+        }
+        pollable = S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || isatty(out);
+        if (pollable) {
+          flags = fcntl(out, F_GETFL);
+          if (flags < 0 || fcntl(out, F_SETFL, flags | O_NONBLOCK) < 0) {
+            fail("Error setting non-blocking output");
+          }
+        }
+      }
+
+      ~fd_output()
+      {
+        if (flags >= 0) {
+          /* stdout may be shared with the shell */
+          fcntl(out, F_SETFL, flags);
+        }
+        if (owned) {
+          close(out);
+        }
+      }
+
+      int fd(void) { return pollable ? out : -1; }
+      bool pending(void) { return !backlog.empty(); }
+
+      void write(const unsigned char *ts, int size)
+      {
+        int n = 0;
+
+        if (backlog.empty()) {
+          n = put(ts, size);
+        }
+        backlog.insert(backlog.end(), ts + n, ts + size);
+      }
+
+      void flush(void)
+      {
+        if (backlog.empty()) {
+          return;
+        }
+        backlog_offset += put(&backlog[backlog_offset], backlog.size() - backlog_offset);
+        if (backlog_offset == backlog.size()) {
+          backlog.clear();
+          backlog_offset = 0;
+        }
+      }
+    };
+
+    /* Raw TS over UDP, GATEWAY_UDP_CELLS cells per datagram */
+    class udp_output : public gateway_output
+    {
+     private:
+      int sock;
+
+     public:
+      udp_output(const gateway_config &cfg)
+      {
+        struct addrinfo hints, *res;
+        char port[8];
+        int rc;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        snprintf(port, sizeof(port), "%d", cfg.udp_port);
+        rc = getaddrinfo(cfg.udp_address.c_str(), port, &hints, &res);
+        if (rc != 0) {
+          std::stringstream s;
+          s << "Cannot resolve " << cfg.udp_address << ": " << gai_strerror(rc) << std::endl;
+          throw std::runtime_error(s.str());
+        }
+        sock = socket(res->ai_family, SOCK_DGRAM, 0);
+        if (sock < 0 || connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+          freeaddrinfo(res);
+          fail("Error connecting UDP socket to " + cfg.udp_address);
+        }
+        freeaddrinfo(res);
+      }
+
+      ~udp_output() { close(sock); }
+
+      void write(const unsigned char *ts, int size)
+      {
+        int count;
+
+        for (int i = 0; i < size; i += count) {
+          count = size - i;
+          if (count > GATEWAY_UDP_CELLS * MPEG2_PACKET_SIZE) {
+            count = GATEWAY_UDP_CELLS * MPEG2_PACKET_SIZE;
+          }
+          /* a datagram refused, nobody listening or the buffer full, is simply lost */
+          send(sock, ts + i, count, MSG_DONTWAIT);
+        }
+      }
+    };
+
+    gateway_input *
+    open_gateway_input(const gateway_config &cfg)
+    {
+      switch (cfg.input) {
+        case INPUT_TUN:
+          return new tun_input(cfg);
+        case INPUT_PACKET:
+          return new packet_input(cfg);
+        default:
+          return new pcap_input(cfg);
+      }
+    }
+
+    gateway_output *
+    open_gateway_output(const gateway_config &cfg)
+    {
+      if (cfg.output == OUTPUT_UDP) {
+        return new udp_output(cfg);
+      }
+      return new fd_output(cfg);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,67 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_GATEWAY_IO_H
+#define INCLUDED_ULE_GATEWAY_IO_H
+
+#include "gateway_config.h"
+#include "fq_codel.h"
+
+#define GATEWAY_UDP_CELLS 7
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * A non-blocking frame source. drain() queues every frame that is
+     * ready when epoll reports fd() readable.
+     */
+    class gateway_input
+    {
+     public:
+      virtual ~gateway_input() {}
+      virtual int fd(void) = 0;
+      virtual void drain(fq_codel_queue *queue) = 0;
+    };
+
+    /*
+     * Where the Transport Stream goes. write() takes whole cells and
+     * never blocks. What a pipe, socket or terminal cannot take yet
+     * stays pending, and flush() moves more of it when epoll reports
+     * fd() writable. fd() is -1 where writes always complete.
+     */
+    class gateway_output
+    {
+     public:
+      virtual ~gateway_output() {}
+      virtual int fd(void) { return -1; }
+      virtual bool pending(void) { return false; }
+      virtual void write(const unsigned char *ts, int size) = 0;
+      virtual void flush(void) {}
+    };
+
+    /* Throw std::runtime_error if the device or socket cannot be opened. */
+    gateway_input *open_gateway_input(const gateway_config &cfg);
+    gateway_output *open_gateway_output(const gateway_config &cfg);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_GATEWAY_IO_H */
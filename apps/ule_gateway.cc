@@ -0,0 +1,235 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Standalone ULE encapsulator. Takes frames from pcap, a TUN device
+ * or an AF_PACKET socket and writes a constant rate Transport Stream
+ * to a file, stdout, a named pipe or UDP, from a single epoll loop on
+ * the same encapsulation code as the ULE Source block, without the
+ * GNU Radio runtime.
+ *
+ * usage: ule-gateway config_file
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <boost/scoped_ptr.hpp>
+#include "gateway_config.h"
+#include "gateway_io.h"
+#include "sndu_fec.h"
+#include "sndu_security.h"
+#include "sndu_compress.h"
+#include "stage_profile.h"
+
+#define GATEWAY_TICK_MS 10
+#define GATEWAY_MAX_BURST_MS 100
+#define GATEWAY_POOL_SIZE (FQ_CODEL_LIMIT + 2)
+
+using namespace gr::ule;
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+watch(int epfd, int op, int fd, unsigned int events)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epfd, op, fd, &ev) < 0) {
+    throw std::runtime_error("Error calling epoll_ctl()\n");
+  }
+}
+
+/*
+ * Frames are queued as soon as the input is readable. Every tick the
+ * cells due since the start at ts_rate are packed and written, so a
+ * frame waits at most one tick plus its queueing delay. When the
+ * output falls more than GATEWAY_MAX_BURST_MS behind, the debt is
+ * written off instead of bursting to catch up. Output is never
+ * waited for: while the reader of a pipe has not taken the last
+ * cells, ticks pack nothing, frames wait in the queue under CoDel and
+ * the rest goes out as epoll reports the pipe writable, so signals
+ * are still handled. SIGUSR1 prints the stage profile.
+ */
+static void
+run(const gateway_config &cfg, gateway_input *input, gateway_output *output,
+    fq_codel_queue *queue, ts_packetizer *packetizer, sndu_source *source)
+{
+  double cell_rate = cfg.ts_rate / (MPEG2_PACKET_SIZE * 8.0);
+  uint64_t max_cells = (uint64_t)(cell_rate * GATEWAY_MAX_BURST_MS / 1000) + 1;
+  std::vector<unsigned char> out(max_cells * MPEG2_PACKET_SIZE);
+  struct epoll_event events[4];
+  struct itimerspec period;
+  struct signalfd_siginfo info;
+  sigset_t signals;
+  uint64_t expirations, due, cells, sent = 0;
+  double start;
+  int epfd, timer, sig, n, size;
+  bool running = true, waiting = false;
+
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  sig = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (epfd < 0 || timer < 0 || sig < 0) {
+    throw std::runtime_error("Error setting up the event loop\n");
+  }
+  period.it_interval.tv_sec = 0;
+  period.it_interval.tv_nsec = GATEWAY_TICK_MS * 1000000L;
+  period.it_value = period.it_interval;
+  timerfd_settime(timer, 0, &period, NULL);
+  watch(epfd, EPOLL_CTL_ADD, input->fd(), EPOLLIN);
+  watch(epfd, EPOLL_CTL_ADD, timer, EPOLLIN);
+  watch(epfd, EPOLL_CTL_ADD, sig, EPOLLIN);
+  if (output->fd() >= 0) {
+    watch(epfd, EPOLL_CTL_ADD, output->fd(), 0);
+  }
+
+  start = now();
+  while (running) {
+    n = epoll_wait(epfd, events, 4, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Error calling epoll_wait()\n");
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.fd == input->fd()) {
+        input->drain(queue);
+      }
+      else if (events[i].data.fd == output->fd()) {
+        if (events[i].events & EPOLLERR) {
+          throw std::runtime_error("Transport Stream reader has gone away\n");
+        }
+        output->flush();
+      }
+      else if (events[i].data.fd == timer) {
+        if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+          continue;
+        }
+        if (output->pending()) {
+          continue;
+        }
+        due = (uint64_t)((now() - start) * cell_rate);
+        cells = due - sent;
+        if (cells > max_cells) {
+          cells = max_cells;
+          sent = due - cells;
+        }
+        size = packetizer->packetize_sndus(&out[0], cells * MPEG2_PACKET_SIZE, source);
+        output->write(&out[0], size);
+        sent += cells;
+      }
+      else if (events[i].data.fd == sig) {
+        if (read(sig, &info, sizeof(info)) != sizeof(info)) {
+          continue;
+        }
+        if (info.ssi_signo == SIGUSR1) {
+          fprintf(stderr, "%s", profile_summary().c_str());
+        }
+        else {
+          running = false;
+        }
+      }
+    }
+    if (output->fd() >= 0 && output->pending() != waiting) {
+      waiting = output->pending();
+      watch(epfd, EPOLL_CTL_MOD, output->fd(), waiting ? (unsigned int)EPOLLOUT : 0);
+    }
+  }
+
+  close(sig);
+  close(timer);
+  close(epfd);
+}
+
+int
+main(int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s config_file\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    gateway_config cfg = read_gateway_config(argv[1]);
+    packet_pool pool(GATEWAY_POOL_SIZE);
+    fq_codel_queue queue(&pool, cfg.aqm != AQM_OFF ? cfg.codel_target : 0.0, cfg.codel_interval, cfg.aqm == AQM_FQ_CODEL_ECN);
+    serial_sndu_source sndus(&queue);
+    ts_packetizer packetizer(ULE_PID, cfg.call_sign.c_str(), cfg.ping_reply, cfg.ipaddr_spoof, cfg.src_address.c_str(), cfg.dst_address.c_str(), NPD_ON, cfg.dbit, cfg.packing);
+    boost::scoped_ptr<sndu_security> security;
+    boost::scoped_ptr<sndu_compress> compress;
+    boost::scoped_ptr<fec_sndu_source> fec;
+    boost::scoped_ptr<gateway_input> input;
+    boost::scoped_ptr<gateway_output> output;
+    sndu_source *source = &sndus;
+
+    signal(SIGPIPE, SIG_IGN);
+    queue.set_ack_filter(cfg.ack_filter == ACK_FILTER_ON);
+    if (cfg.security != SECURITY_OFF) {
+      security.reset(new sndu_security(cfg.security, cfg.security_key, cfg.spi));
+      packetizer.set_security(security.get());
+    }
+    if (cfg.compress != COMPRESS_OFF) {
+      compress.reset(new sndu_compress(cfg.compress, cfg.compress_classes));
+      packetizer.set_compress(compress.get());
+    }
+    if (cfg.fec_r > 0) {
+      fec.reset(new fec_sndu_source(&sndus, &pool, cfg.fec_k, cfg.fec_r));
+      source = fec.get();
+    }
+    input.reset(open_gateway_input(cfg));
+    output.reset(open_gateway_output(cfg));
+
+    run(cfg, input.get(), output.get(), &queue, &packetizer, source);
+    fprintf(stderr, "%llu data cells, %llu null cells, %llu AQM drops, %llu overlimit drops, %llu ACK drops\n",
+            (unsigned long long)packetizer.get_data_cells(), (unsigned long long)packetizer.get_null_cells(),
+            (unsigned long long)queue.get_drops(), (unsigned long long)queue.get_overlimit_drops(),
+            (unsigned long long)queue.get_ack_drops());
+  }
+  catch (std::exception &e) {
+    fprintf(stderr, "%s", e.what());
+    return 1;
+  }
+  return 0;
+}
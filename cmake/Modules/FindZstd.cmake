@@ -0,0 +1,28 @@
+INCLUDE(FindPkgConfig)
+PKG_CHECK_MODULES(PC_ZSTD libzstd)
+
+FIND_PATH(
+    ZSTD_INCLUDE_DIRS
+    NAMES zstd.h
+    HINTS ${PC_ZSTD_INCLUDEDIR}
+    PATHS ${CMAKE_INSTALL_PREFIX}/include
+          /usr/local/include
+          /usr/include
+)
+
+FIND_LIBRARY(
+    ZSTD_LIBRARIES
+    NAMES zstd
+    HINTS ${PC_ZSTD_LIBDIR}
+    PATHS ${CMAKE_INSTALL_PREFIX}/lib
+          ${CMAKE_INSTALL_PREFIX}/lib64
+          /usr/local/lib
+          /usr/local/lib64
+          /usr/lib
+          /usr/lib64
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD DEFAULT_MSG ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS)
+MARK_AS_ADVANCED(ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS)
+
@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_ULE_TS_ANALYZER_H
+#define INCLUDED_ULE_TS_ANALYZER_H
+
+#include <ule/api.h>
+#include <ule/ule_config.h>
+#include <gnuradio/sync_block.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace ule {
+
+    /*!
+     * \brief Check a Transport Stream against ETSI TR 101 290.
+     * \ingroup ule
+     *
+     * A tap for the output of the ULE source: sync, continuity
+     * counters per PID, PAT and PMT repetition, PSI section CRCs, PCR
+     * repetition and the bitrate of each PID, all in real time.
+     * work() only copies the stream into a ring that a background
+     * thread analyzes. If the analyzer ever falls a whole ring behind,
+     * input is dropped and counted rather than holding up the
+     * transmit chain. Once per second of stream a dictionary of the
+     * counters and PID bitrates is published on the report port.
+     */
+    class ULE_API ts_analyzer : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<ts_analyzer> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of ule::ts_analyzer.
+       *
+       * \param ts_rate Transport Stream rate in bits per second, the
+       *        clock for all interval checks.
+       * \param item_size Input items, bytes or 188 or 204 byte TS
+       *        packets. Reed-Solomon parity is ignored.
+       */
+      static sptr make(int ts_rate, ule_item_t item_size);
+
+      //! Errors found by one check since start.
+      virtual uint64_t errors(ule_ts_check_t check) = 0;
+
+      //! Cells analyzed since start.
+      virtual uint64_t cells_analyzed() = 0;
+
+      //! Cells dropped because the analyzer fell behind.
+      virtual uint64_t cells_dropped() = 0;
+
+      //! Bitrate of a PID over the last second of stream.
+      virtual uint64_t pid_bitrate(int pid) = 0;
+
+      //! Continuity counter errors on a PID since start.
+      virtual uint64_t pid_cc_errors(int pid) = 0;
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_ANALYZER_H */
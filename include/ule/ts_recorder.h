@@ -0,0 +1,110 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_RECORDER_H
+#define INCLUDED_ULE_TS_RECORDER_H
+
+#include <ule/api.h>
+#include <ule/ule_config.h>
+#include <gnuradio/sync_block.h>
+#include <stdint.h>
+
+#define TS_INDEX_MAGIC "ULETSIDX"
+#define TS_INDEX_VERSION 1
+#define TS_INDEX_HEADER_SIZE 4096
+
+namespace gr {
+  namespace ule {
+
+    /*!
+     * \brief Header at the start of a recorder index file.
+     *
+     * The TS ring file holds the last data_size bytes of the stream,
+     * cell n at byte (n * 188) % data_size. Entry n of the index is at
+     * TS_INDEX_HEADER_SIZE + (n % entry_capacity) * entry_size. There
+     * are 7 entries per cell of the ring, enough for cells packed with
+     * SNDUs of 28 bytes, so the index reaches back as far as the ring.
+     * A stream of even shorter SNDUs wraps the index sooner. The
+     * counters are written after the data they cover.
+     */
+    struct ts_index_header {
+      char magic[8];
+      uint32_t version;
+      uint32_t entry_size;
+      uint64_t data_size;
+      uint64_t entry_capacity;
+      uint64_t cells;
+      uint64_t entries;
+      int64_t start_time;
+    };
+
+    /*!
+     * \brief One SNDU start in the recorded stream.
+     *
+     * Entries are in increasing sequence and cell order, so a reader
+     * can binary search the ring by either, or by time.
+     */
+    struct ts_index_entry {
+      uint64_t sequence;    //!< SNDU number since the recorder started
+      uint64_t cell;        //!< absolute cell number of the SNDU start
+      int64_t time;         //!< CLOCK_REALTIME in ns when recorded
+      uint16_t offset;      //!< byte offset of the SNDU in the cell
+      uint16_t pid;
+      uint32_t length;      //!< SNDU length including header and CRC
+    };
+
+    /*!
+     * \brief Record a Transport Stream to a rolling memory mapped ring.
+     * \ingroup ule
+     *
+     * Keeps the last window seconds of the stream in filename and an
+     * index of every SNDU start on the given PID in filename.idx, for
+     * replaying what a receiver saw when it reported errors. work()
+     * only copies into the mapping; a background thread starts
+     * writeback of each finished 2 MB segment and prefetches the
+     * segments ahead.
+     */
+    class ULE_API ts_recorder : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<ts_recorder> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of ule::ts_recorder.
+       *
+       * \param filename TS ring file, created or reused.
+       * \param window Seconds of stream to keep.
+       * \param ts_rate Transport Stream rate in bits per second, used
+       *        to size the ring.
+       * \param pid PID whose SNDUs are indexed.
+       */
+      static sptr make(const std::string &filename, float window, int ts_rate, int pid);
+
+      //! Cells recorded since start.
+      virtual uint64_t cells_recorded() = 0;
+
+      //! SNDU starts indexed since start.
+      virtual uint64_t sndus_indexed() = 0;
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_RECORDER_H */
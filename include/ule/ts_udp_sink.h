@@ -0,0 +1,70 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_UDP_SINK_H
+#define INCLUDED_ULE_TS_UDP_SINK_H
+
+#include <ule/api.h>
+#include <ule/ule_config.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace ule {
+
+    /*!
+     * \brief Send a Transport Stream over UDP or RTP.
+     * \ingroup ule
+     *
+     * Groups cells_per_datagram 188 byte cells into each datagram,
+     * with an RTP header (payload type 33, RFC 2250) in RTP mode, and
+     * sends them to a unicast or multicast address in batches with
+     * UDP_SEGMENT offload, or sendmmsg() where the kernel lacks it.
+     * With a ts_rate the datagrams are paced to that bitrate, so the
+     * sink can clock a flowgraph that has no SDR hardware.
+     */
+    class ULE_API ts_udp_sink : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<ts_udp_sink> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of ule::ts_udp_sink.
+       *
+       * \param address Destination IPv4 or IPv6 address or host name.
+       * \param port Destination UDP port.
+       * \param encapsulation Plain UDP or RTP.
+       * \param cells_per_datagram TS cells per datagram, 1 to 7.
+       * \param ts_rate Pacing rate in bits per second, 0 to send as
+       *        fast as the input arrives.
+       * \param ttl Unicast or multicast time to live.
+       */
+      static sptr make(const std::string &address, int port, ule_udp_encap_t encapsulation, int cells_per_datagram, int ts_rate, int ttl);
+
+      //! Datagrams sent since start.
+      virtual uint64_t datagrams_sent() = 0;
+
+      //! Datagrams the kernel refused, for example with ENOBUFS.
+      virtual uint64_t send_errors() = 0;
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_UDP_SINK_H */
@@ -33,11 +33,122 @@ namespace gr {
       IPADDR_SPOOF_ON,
     };
 
+    enum ule_npd_t {
+      NPD_OFF = 0,
+      NPD_ON,
+    };
+
+    enum ule_dbit_t {
+      DBIT_OFF = 0,
+      DBIT_ON,
+    };
+
+    enum ule_packing_t {
+      PACKING_ON = 0,
+      PACKING_OFF,
+    };
+
+    enum ule_mcast_t {
+      MCAST_OFF = 0,
+      MCAST_SNOOP,
+    };
+
+    enum ule_arp_t {
+      ARP_PROXY_OFF = 0,
+      ARP_PROXY_ON,
+    };
+
+    enum ule_aqm_t {
+      AQM_OFF = 0,
+      AQM_FQ_CODEL,
+      AQM_FQ_CODEL_ECN,
+    };
+
+    enum ule_ack_filter_t {
+      ACK_FILTER_OFF = 0,
+      ACK_FILTER_ON,
+    };
+
+    enum ule_output_t {
+      OUTPUT_THROUGHPUT = 0,
+      OUTPUT_LATENCY,
+      OUTPUT_BBFRAME,
+    };
+
+    enum ule_item_t {
+      ITEM_BYTE = 0,
+      ITEM_TS188,
+      ITEM_TS204,
+    };
+
+    enum ule_security_t {
+      SECURITY_OFF = 0,
+      SECURITY_AES128_GCM,
+      SECURITY_AES256_GCM,
+    };
+
+    enum ule_compress_t {
+      COMPRESS_OFF = 0,
+      COMPRESS_ZSTD,
+    };
+
+    enum ule_udp_encap_t {
+      UDP_RAW = 0,
+      UDP_RTP,
+    };
+
+    enum ule_fanout_t {
+      FANOUT_HASH = 0,
+      FANOUT_CPU,
+    };
+
+    enum ule_ingress_t {
+      INGRESS_PCAP = 0,
+      INGRESS_PDU,
+      INGRESS_PCAP_PDU,
+      INGRESS_GENERATOR,
+    };
+
+    enum ule_traffic_t {
+      TRAFFIC_FIXED = 0,
+      TRAFFIC_IMIX,
+      TRAFFIC_PARETO,
+      TRAFFIC_CBR,
+      TRAFFIC_ACK,
+    };
+
+    enum ule_ts_check_t {
+      CHECK_SYNC_LOSS = 0,
+      CHECK_SYNC_BYTE,
+      CHECK_PAT,
+      CHECK_CC,
+      CHECK_PMT,
+      CHECK_TRANSPORT,
+      CHECK_CRC,
+      CHECK_PCR,
+    };
+
   } // namespace ule
 } // namespace gr
 
 typedef gr::ule::ule_ping_reply_t ule_ping_reply_t;
 typedef gr::ule::ule_ipaddr_spoof_t ule_ipaddr_spoof_t;
+typedef gr::ule::ule_npd_t ule_npd_t;
+typedef gr::ule::ule_dbit_t ule_dbit_t;
+typedef gr::ule::ule_packing_t ule_packing_t;
+typedef gr::ule::ule_mcast_t ule_mcast_t;
+typedef gr::ule::ule_arp_t ule_arp_t;
+typedef gr::ule::ule_aqm_t ule_aqm_t;
+typedef gr::ule::ule_ack_filter_t ule_ack_filter_t;
+typedef gr::ule::ule_output_t ule_output_t;
+typedef gr::ule::ule_ingress_t ule_ingress_t;
+typedef gr::ule::ule_fanout_t ule_fanout_t;
+typedef gr::ule::ule_udp_encap_t ule_udp_encap_t;
+typedef gr::ule::ule_item_t ule_item_t;
+typedef gr::ule::ule_security_t ule_security_t;
+typedef gr::ule::ule_compress_t ule_compress_t;
+typedef gr::ule::ule_traffic_t ule_traffic_t;
+typedef gr::ule::ule_ts_check_t ule_ts_check_t;
 
 #endif /* INCLUDED_ULE_ULE_CONFIG_H */
 
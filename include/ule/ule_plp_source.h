@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_ULE_PLP_SOURCE_H
+#define INCLUDED_ULE_ULE_PLP_SOURCE_H
+
+#include <ule/api.h>
+#include <ule/ule_config.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace ule {
+
+    /*!
+     * \brief IP over TS source for one PLP of a multi-PLP stream.
+     * \ingroup ule
+     *
+     * Captured frames are classified by IP precedence (the top three
+     * bits of the IPv4 TOS or IPv6 Traffic Class field, 0 for non-IP
+     * frames) and class_map[class] selects the PLP. One block per PLP
+     * shares the capture and queues of its interface, and each has
+     * its own PSI, continuity counters and stuffing, so every PLP
+     * runs at the rate its own output drains.
+     */
+    class ULE_API ule_plp_source : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<ule_plp_source> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of ule::ule_plp_source.
+       *
+       * \param interface Capture interface, shared by the PLP sources on it.
+       * \param plp PLP this block outputs, 0 to num_plps - 1. The PLP 0
+       *        block tunes the DVB frontend.
+       * \param num_plps Number of PLPs, the same in every block.
+       * \param class_map PLP for each of the 8 traffic classes, the same
+       *        in every block.
+       */
+      static sptr make(char *mac_address, char *interface, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, int plp, int num_plps, const std::vector<int> &class_map);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_ULE_PLP_SOURCE_H */
+
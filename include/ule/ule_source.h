@@ -45,8 +45,144 @@ namespace gr {
        * constructor is in a private implementation
        * class. ule::ule_source::make is the public interface for
        * creating new instances.
+       *
+       * \param aqm Capture into a userspace FQ-CoDel queue (optionally
+       *        ECN marking instead of dropping) instead of reading
+       *        straight from the kernel buffer.
+       * \param codel_target CoDel target sojourn time in milliseconds.
+       * \param codel_interval CoDel interval in milliseconds.
+       * \param output_mode Throughput mode always produces 200 TS
+       *        packets per call. Latency mode sizes every call from
+       *        the queued data and the TS rate. BBFRAME mode produces
+       *        the TS packets of one DVB-T2 BBFRAME per call.
+       * \param ts_rate Transport Stream rate in bits per second.
+       * \param max_latency Latency mode upper bound on the data
+       *        produced per call, in milliseconds of TS.
+       * \param ingress_mode Take frames from the pcap capture, from
+       *        PMT PDUs (raw IP or Ethernet) on the "pdus" message
+       *        port, from both, or from the built in traffic
+       *        generator set up with set_traffic(). Without pcap,
+       *        mac_address is only used as the destination address
+       *        of raw IP PDUs and generated frames.
+       * \param interfaces Comma separated list of interfaces to
+       *        capture from.
+       * \param capture_threads Capture threads per interface. With
+       *        more than one, PACKET_FANOUT spreads each interface
+       *        over its threads.
+       * \param fanout Spread by flow hash or by receiving CPU.
+       * \param encap_threads Worker threads that build SNDUs in
+       *        parallel ahead of the packetizer, or 0 to encapsulate
+       *        on the block thread. Capture and cell packing stay on
+       *        the block thread either way.
+       * \param item_size Output item: bytes, 188 byte TS packets or
+       *        204 byte TS packets with RS(204,188) parity.
+       * \param security Encrypt and authenticate every SNDU with
+       *        AES-GCM in a ULE security extension header.
+       * \param security_key AES key followed by a 4 byte salt, in
+       *        hexadecimal.
+       * \param spi Key identifier carried in each secured SNDU.
+       * \param fec_k SNDUs per FEC block.
+       * \param fec_r Repair SNDUs sent after each FEC block, or 0 to
+       *        disable the packet level FEC.
+       * \param dbit Set the D bit and leave out the NPA destination
+       *        address, saving 6 bytes per SNDU. Secured SNDUs
+       *        always carry the address.
+       * \param packing Start the next SNDU in the rest of the cell
+       *        that ends the last one, or pad every SNDU out to the
+       *        end of its last cell.
+       * \param mcast_filter Encapsulate IPv4 and IPv6 multicast only
+       *        for groups with a receiver, learnt by snooping IGMP
+       *        and MLD reports on snoop_interface.
+       * \param static_groups Comma separated list of groups that are
+       *        always encapsulated. A link-local group written as
+       *        !group is snooped instead of always encapsulated.
+       * \param snoop_interface Interface the membership reports and
+       *        the ARP and ND traffic of the receivers arrive on, or
+       *        empty for the first capture interface.
+       * \param arp Answer ARP requests and neighbour solicitations
+       *        for the receivers locally, drop those for local hosts
+       *        and rate limit the rest.
+       * \param arp_table Comma separated list of ip=mac mappings of
+       *        the receivers, added to the ones learnt on
+       *        snoop_interface.
+       * \param ack_filter Drop queued pure TCP ACKs made redundant
+       *        by a newer ACK of the same connection. Captured frames
+       *        then always go through the ingress queue.
+       * \param compress Compress the PDU of every SNDU that shrinks
+       *        with zstd in a compression extension header.
+       * \param compress_classes Comma separated list of port=dictionary
+       *        flow classes, matched on the UDP or TCP destination
+       *        port, with * for any other port and an empty dictionary
+       *        for none.
+       * \param bbframe_size BBFRAME mode data field length in bits,
+       *        Kbch minus the 80 bit BBHEADER.
+       * \param bbframe_rate BBFRAME mode frames per second.
+       */
+      static sptr make(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, ule_aqm_t aqm, float codel_target, float codel_interval, ule_output_t output_mode, int ts_rate, float max_latency, ule_ingress_t ingress_mode, char *interfaces, int capture_threads, ule_fanout_t fanout, int encap_threads, ule_item_t item_size, ule_security_t security, char *security_key, int spi, int fec_k, int fec_r, ule_dbit_t dbit, ule_packing_t packing, ule_mcast_t mcast_filter, char *static_groups, char *snoop_interface, ule_arp_t arp, char *arp_table, ule_ack_filter_t ack_filter, ule_compress_t compress, char *compress_classes, int bbframe_size, float bbframe_rate);
+
+      //! Packets dropped by CoDel on the ingress queue.
+      virtual uint64_t aqm_drops() = 0;
+
+      //! Packets ECN marked by CoDel instead of dropped.
+      virtual uint64_t aqm_marks() = 0;
+
+      //! Packets dropped because the ingress queue was full.
+      virtual uint64_t aqm_overlimit_drops() = 0;
+
+      //! Redundant TCP ACKs dropped by the ACK filter.
+      virtual uint64_t ack_filter_drops() = 0;
+
+      /*!
+       * \brief Traffic made by the generator ingress mode.
+       *
+       * Call before the flowgraph starts. Until then the generator
+       * sends 1514 byte frames of 16 flows at 10 Mbps with seed 1. It
+       * is ignored in the other ingress modes, but the values are
+       * still checked.
+       *
+       * \param traffic Traffic model.
+       * \param traffic_rate Mean rate in bits per second.
+       * \param traffic_flows Number of flows, 1 to 65536.
+       * \param traffic_size Frame size of the fixed and Pareto models,
+       *        60 to 1514 bytes.
+       * \param traffic_seed Random seed, the same seed repeats the
+       *        same traffic.
        */
-      static sptr make(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address);
+      virtual void set_traffic(ule_traffic_t traffic, int traffic_rate, int traffic_flows, int traffic_size, int traffic_seed) = 0;
+
+      /*
+       * Runtime settings. Each may be called from any thread while
+       * the flowgraph runs, or sent as a dictionary on the "control"
+       * message port. Packetizer settings take effect at the next
+       * SNDU boundary, so the TS output never carries a partial
+       * SNDU. Invalid values throw std::runtime_error.
+       */
+
+      //! Capture only frames sent by mac_address, unless set_filter() replaced the filter.
+      virtual void set_mac_address(const std::string &mac_address) = 0;
+
+      //! Replace the capture filter with any BPF expression, or "" for the MAC filter.
+      virtual void set_filter(const std::string &filter) = 0;
+
+      //! Move the ULE stream to another PID and update the PMT.
+      virtual void set_pid(int pid) = 0;
+
+      //! Change the TVCT short name.
+      virtual void set_call_sign(const std::string &call_sign) = 0;
+
+      virtual void set_ping_reply(ule_ping_reply_t ping_reply) = 0;
+      virtual void set_ipaddr_spoof(ule_ipaddr_spoof_t ipaddr_spoof) = 0;
+      virtual void set_src_address(const std::string &src_address) = 0;
+      virtual void set_dst_address(const std::string &dst_address) = 0;
+
+      //! CoDel target and interval in milliseconds.
+      virtual void set_codel(float codel_target, float codel_interval) = 0;
+
+      //! Latency mode TS rate in bits per second.
+      virtual void set_ts_rate(int ts_rate) = 0;
+
+      //! Latency mode upper bound per call in milliseconds.
+      virtual void set_max_latency(float max_latency) = 0;
     };
 
   } // namespace ule
@@ -0,0 +1,455 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/if_ether.h>
+#include "arp_proxy.h"
+
+#define ARP_HEADER 14
+#define ARP_SIZE 28
+#define IPV6_HEADER 14
+#define ICMPV6_HEADER (IPV6_HEADER + 40)
+#define ND_SIZE 24
+#define ND_SOLICIT 135
+#define ND_ADVERT 136
+#define ND_SOURCE_LLADDR 1
+#define ND_TARGET_LLADDR 2
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char v4_mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    static const unsigned char unspecified[16] = {0};
+
+    static std::string
+    key(const unsigned char *addr)
+    {
+      return std::string((const char *)addr, 16);
+    }
+
+    static void
+    map_v4(const unsigned char *ip, unsigned char *addr)
+    {
+      memcpy(addr, v4_mapped, sizeof(v4_mapped));
+      memcpy(addr + sizeof(v4_mapped), ip, 4);
+    }
+
+    /* an ARP packet for IPv4 over Ethernet */
+    static bool
+    is_arp(const unsigned char *frame, unsigned int len)
+    {
+      const unsigned char *arp = frame + ARP_HEADER;
+
+      return len >= ARP_HEADER + ARP_SIZE && frame[12] == 0x08 && frame[13] == 0x06 &&
+             arp[0] == 0 && arp[1] == 1 && arp[2] == 0x08 && arp[3] == 0x00 && arp[4] == 6 && arp[5] == 4;
+    }
+
+    /* a neighbour solicitation or advertisement, returns its type */
+    static int
+    nd_type(const unsigned char *frame, unsigned int len)
+    {
+      const unsigned char *icmp = frame + ICMPV6_HEADER;
+
+      if (len < ICMPV6_HEADER + ND_SIZE || frame[12] != 0x86 || frame[13] != 0xdd ||
+          (frame[14] >> 4) != 6 || frame[IPV6_HEADER + 6] != IPPROTO_ICMPV6) {
+        return 0;
+      }
+      return (icmp[0] == ND_SOLICIT || icmp[0] == ND_ADVERT) && icmp[1] == 0 ? icmp[0] : 0;
+    }
+
+    /* the link layer address option of the given type, or NULL */
+    static const unsigned char *
+    nd_option(const unsigned char *frame, unsigned int len, int type)
+    {
+      unsigned int payload = ICMPV6_HEADER + ((frame[IPV6_HEADER + 4] << 8) | frame[IPV6_HEADER + 5]);
+      unsigned int offset = ICMPV6_HEADER + ND_SIZE;
+
+      if (payload < len) {
+        len = payload;
+      }
+      while (offset + 8 <= len && frame[offset + 1] != 0) {
+        if (frame[offset] == type && frame[offset + 1] == 1) {
+          return frame + offset + 2;
+        }
+        offset += frame[offset + 1] * 8;
+      }
+      return NULL;
+    }
+
+    static bool
+    parse_mac(const char *text, unsigned char *mac)
+    {
+      unsigned int octets[6];
+      char extra;
+
+      if (sscanf(text, "%x:%x:%x:%x:%x:%x%c", &octets[0], &octets[1], &octets[2],
+                 &octets[3], &octets[4], &octets[5], &extra) != 6) {
+        return false;
+      }
+      for (int i = 0; i < 6; i++) {
+        if (octets[i] > 0xff) {
+          return false;
+        }
+        mac[i] = octets[i];
+      }
+      return true;
+    }
+
+    arp_proxy::arp_proxy(const char *static_entries)
+      : tokens(ARP_PASS_BURST), last_refill(0), answered(0), dropped(0), limited(0)
+    {
+      std::string list(static_entries ? static_entries : "");
+      unsigned char addr[16], mac[6];
+      size_t start = 0, end, equals;
+      entry e;
+
+      while (start <= list.size()) {
+        end = list.find(',', start);
+        if (end == std::string::npos) {
+          end = list.size();
+        }
+        std::string pair = list.substr(start, end - start);
+        pair.erase(0, pair.find_first_not_of(" \t"));
+        pair.erase(pair.find_last_not_of(" \t") + 1);
+        start = end + 1;
+        if (pair.empty()) {
+          continue;
+        }
+        equals = pair.find('=');
+        if (equals == std::string::npos || !parse_mac(pair.substr(equals + 1).c_str(), mac)) {
+          throw std::runtime_error("Invalid ARP table entry " + pair + "\n");
+        }
+        std::string ip = pair.substr(0, equals);
+        if (inet_pton(AF_INET, ip.c_str(), addr + sizeof(v4_mapped)) == 1) {
+          memcpy(addr, v4_mapped, sizeof(v4_mapped));
+        }
+        else if (inet_pton(AF_INET6, ip.c_str(), addr) != 1) {
+          throw std::runtime_error("Invalid ARP table entry " + pair + "\n");
+        }
+        if (table.size() == ARP_MAX_ENTRIES) {
+          throw std::runtime_error("Too many ARP table entries\n");
+        }
+        memcpy(e.mac, mac, sizeof(e.mac));
+        e.expires = 0;
+        e.is_static = true;
+        e.remote = true;
+        table[key(addr)] = e;
+      }
+    }
+
+    uint64_t
+    arp_proxy::clock(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    /* learnt mappings replace each other, never a static one */
+    void
+    arp_proxy::add(const unsigned char *addr, const unsigned char *mac, bool remote, uint64_t now)
+    {
+      std::map<std::string, entry>::iterator it;
+      std::string k = key(addr);
+      entry *e;
+
+      /* no multicast senders, nor the unspecified address of a probe */
+      if ((mac[0] & 0x01) || memcmp(addr, unspecified, 16) == 0 ||
+          (memcmp(addr, v4_mapped, sizeof(v4_mapped)) == 0 && memcmp(addr + 12, unspecified, 4) == 0)) {
+        return;
+      }
+      it = table.find(k);
+      if (it == table.end()) {
+        if (table.size() >= ARP_MAX_ENTRIES) {
+          for (it = table.begin(); it != table.end(); ) {
+            if (!it->second.is_static && it->second.expires <= now) {
+              table.erase(it++);
+            }
+            else {
+              ++it;
+            }
+          }
+          if (table.size() >= ARP_MAX_ENTRIES) {
+            return;
+          }
+        }
+        e = &table[k];
+        e->is_static = false;
+      }
+      else {
+        e = &it->second;
+        if (e->is_static) {
+          return;
+        }
+      }
+      memcpy(e->mac, mac, sizeof(e->mac));
+      e->expires = now + (uint64_t)ARP_ENTRY_TIMEOUT * 1000000;
+      e->remote = remote;
+    }
+
+    const arp_proxy::entry *
+    arp_proxy::lookup(const unsigned char *addr, uint64_t now)
+    {
+      std::map<std::string, entry>::const_iterator it = table.find(key(addr));
+
+      if (it == table.end() || (!it->second.is_static && it->second.expires <= now)) {
+        return NULL;
+      }
+      return &it->second;
+    }
+
+    /* token bucket shared by all the resolution traffic that crosses the link */
+    arp_verdict
+    arp_proxy::rate_limit(uint64_t now)
+    {
+      if (now > last_refill) {
+        tokens += (now - last_refill) * (ARP_PASS_RATE / 1e6);
+        if (tokens > ARP_PASS_BURST) {
+          tokens = ARP_PASS_BURST;
+        }
+        last_refill = now;
+      }
+      if (tokens >= 1.0) {
+        tokens -= 1.0;
+        return ARP_PASS;
+      }
+      limited++;
+      return ARP_DROP;
+    }
+
+    unsigned int
+    arp_proxy::arp_reply(const unsigned char *frame, const unsigned char *mac, unsigned char *reply)
+    {
+      const unsigned char *request = frame + ARP_HEADER;
+      unsigned char *arp = reply + ARP_HEADER;
+
+      memset(reply, 0, ETH_ZLEN);
+      memcpy(reply, request + 8, ETHER_ADDR_LEN);
+      memcpy(reply + ETHER_ADDR_LEN, mac, ETHER_ADDR_LEN);
+      reply[12] = 0x08;
+      reply[13] = 0x06;
+      memcpy(arp, request, 6);
+      arp[7] = ARPOP_REPLY;
+      memcpy(arp + 8, mac, ETHER_ADDR_LEN);
+      memcpy(arp + 14, request + 24, 4);
+      memcpy(arp + 18, request + 8, 10);
+      return ETH_ZLEN;
+    }
+
+    /* solicited, override, with the target link layer address option */
+    unsigned int
+    arp_proxy::neighbour_advert(const unsigned char *frame, const unsigned char *mac, unsigned char *reply)
+    {
+      unsigned char *ip6 = reply + IPV6_HEADER;
+      unsigned char *icmp = reply + ICMPV6_HEADER;
+      unsigned int length = ND_SIZE + 8;
+      uint32_t sum = 0;
+
+      memset(reply, 0, ARP_REPLY_SIZE);
+      memcpy(reply, frame + ETHER_ADDR_LEN, ETHER_ADDR_LEN);
+      memcpy(reply + ETHER_ADDR_LEN, mac, ETHER_ADDR_LEN);
+      reply[12] = 0x86;
+      reply[13] = 0xdd;
+      ip6[0] = 0x60;
+      ip6[5] = length;
+      ip6[6] = IPPROTO_ICMPV6;
+      ip6[7] = 255;
+      memcpy(ip6 + 8, frame + ICMPV6_HEADER + 8, 16);
+      memcpy(ip6 + 24, frame + IPV6_HEADER + 8, 16);
+      icmp[0] = ND_ADVERT;
+      icmp[4] = 0x60;
+      memcpy(icmp + 8, frame + ICMPV6_HEADER + 8, 16);
+      icmp[ND_SIZE] = ND_TARGET_LLADDR;
+      icmp[ND_SIZE + 1] = 1;
+      memcpy(icmp + ND_SIZE + 2, mac, ETHER_ADDR_LEN);
+
+      /* pseudo header of source, destination, length and next header */
+      for (int i = 8; i < 40; i += 2) {
+        sum += (ip6[i] << 8) | ip6[i + 1];
+      }
+      sum += length + IPPROTO_ICMPV6;
+      for (unsigned int i = 0; i < length; i += 2) {
+        sum += (icmp[i] << 8) | icmp[i + 1];
+      }
+      while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+      }
+      sum = ~sum & 0xffff;
+      icmp[2] = sum >> 8;
+      icmp[3] = sum & 0xff;
+      return ICMPV6_HEADER + length;
+    }
+
+    arp_verdict
+    arp_proxy::handle(const unsigned char *frame, unsigned int len, unsigned char *reply, unsigned int *reply_len, uint64_t now)
+    {
+      const unsigned char *arp = frame + ARP_HEADER;
+      const unsigned char *icmp = frame + ICMPV6_HEADER;
+      const unsigned char *lladdr;
+      unsigned char addr[16];
+      const entry *e;
+      int type;
+
+      if (is_arp(frame, len)) {
+        boost::mutex::scoped_lock lock(mutex);
+        map_v4(arp + 14, addr);
+        add(addr, arp + 8, false, now);
+        map_v4(arp + 24, addr);
+        /* gratuitous ARP and replies may be news to the receivers */
+        if (arp[7] != ARPOP_REQUEST || memcmp(arp + 14, arp + 24, 4) == 0) {
+          return rate_limit(now);
+        }
+        e = lookup(addr, now);
+        if (e && !e->remote) {
+          dropped++;
+          return ARP_DROP;
+        }
+        if (e && reply) {
+          *reply_len = arp_reply(frame, e->mac, reply);
+          answered++;
+          return ARP_REPLY;
+        }
+        return rate_limit(now);
+      }
+
+      type = nd_type(frame, len);
+      if (type == 0) {
+        return ARP_PASS;
+      }
+      boost::mutex::scoped_lock lock(mutex);
+      if (type == ND_ADVERT) {
+        lladdr = nd_option(frame, len, ND_TARGET_LLADDR);
+        add(icmp + 8, lladdr ? lladdr : frame + ETHER_ADDR_LEN, false, now);
+        return rate_limit(now);
+      }
+      /* duplicate address detection has to reach every host */
+      if (memcmp(frame + IPV6_HEADER + 8, unspecified, 16) == 0) {
+        return rate_limit(now);
+      }
+      lladdr = nd_option(frame, len, ND_SOURCE_LLADDR);
+      if (lladdr) {
+        add(frame + IPV6_HEADER + 8, lladdr, false, now);
+      }
+      e = lookup(icmp + 8, now);
+      if (e && !e->remote) {
+        dropped++;
+        return ARP_DROP;
+      }
+      if (e && reply) {
+        *reply_len = neighbour_advert(frame, e->mac, reply);
+        answered++;
+        return ARP_REPLY;
+      }
+      return rate_limit(now);
+    }
+
+    bool
+    arp_proxy::learn(const unsigned char *frame, unsigned int len, uint64_t now)
+    {
+      const unsigned char *arp = frame + ARP_HEADER;
+      const unsigned char *icmp = frame + ICMPV6_HEADER;
+      const unsigned char *lladdr;
+      unsigned char addr[16];
+      int type;
+
+      if (is_arp(frame, len)) {
+        boost::mutex::scoped_lock lock(mutex);
+        map_v4(arp + 14, addr);
+        add(addr, arp + 8, true, now);
+        return true;
+      }
+      type = nd_type(frame, len);
+      if (type == ND_ADVERT) {
+        boost::mutex::scoped_lock lock(mutex);
+        lladdr = nd_option(frame, len, ND_TARGET_LLADDR);
+        add(icmp + 8, lladdr ? lladdr : frame + ETHER_ADDR_LEN, true, now);
+        return true;
+      }
+      if (type == ND_SOLICIT) {
+        boost::mutex::scoped_lock lock(mutex);
+        lladdr = nd_option(frame, len, ND_SOURCE_LLADDR);
+        if (lladdr) {
+          add(frame + IPV6_HEADER + 8, lladdr, true, now);
+        }
+        return true;
+      }
+      return false;
+    }
+
+    std::vector<arp_neighbour>
+    arp_proxy::get_neighbours(uint64_t now)
+    {
+      std::vector<arp_neighbour> result;
+      arp_neighbour neighbour;
+      char text[INET6_ADDRSTRLEN];
+      char mac[18];
+
+      boost::mutex::scoped_lock lock(mutex);
+      for (std::map<std::string, entry>::const_iterator it = table.begin(); it != table.end(); ++it) {
+        const unsigned char *addr = (const unsigned char *)it->first.data();
+        const entry &e = it->second;
+        if (!e.is_static && e.expires <= now) {
+          continue;
+        }
+        if (memcmp(addr, v4_mapped, sizeof(v4_mapped)) == 0) {
+          inet_ntop(AF_INET, addr + sizeof(v4_mapped), text, sizeof(text));
+        }
+        else {
+          inet_ntop(AF_INET6, addr, text, sizeof(text));
+        }
+        snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 e.mac[0], e.mac[1], e.mac[2], e.mac[3], e.mac[4], e.mac[5]);
+        neighbour.address = text;
+        neighbour.mac_address = mac;
+        neighbour.is_static = e.is_static;
+        neighbour.remote = e.remote;
+        result.push_back(neighbour);
+      }
+      return result;
+    }
+
+    uint64_t
+    arp_proxy::get_answered(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return answered;
+    }
+
+    uint64_t
+    arp_proxy::get_dropped(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return dropped;
+    }
+
+    uint64_t
+    arp_proxy::get_limited(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return limited;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
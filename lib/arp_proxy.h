@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_ARP_PROXY_H
+#define INCLUDED_ULE_ARP_PROXY_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#define ARP_MAX_ENTRIES 4096
+#define ARP_ENTRY_TIMEOUT 300    /* learnt mappings, s */
+#define ARP_PASS_RATE 10         /* resolution frames sent over the link per second */
+#define ARP_PASS_BURST 20
+#define ARP_REPLY_SIZE 86        /* the larger of the ARP reply and neighbour advertisement */
+#define ARP_LEARN_FILTER "arp or icmp6"
+#define ARP_INJECT_FILTER "less 1"     /* a capture handle that only sends */
+
+namespace gr {
+  namespace ule {
+
+    enum arp_verdict {
+      ARP_PASS = 0,    /* encapsulate the frame */
+      ARP_REPLY,       /* answered locally, send the reply back to the sender */
+      ARP_DROP,
+    };
+
+    struct arp_neighbour {
+      std::string address;
+      std::string mac_address;
+      bool is_static;
+      bool remote;
+    };
+
+    /*
+     * Answers ARP requests and IPv6 neighbour solicitations for hosts
+     * across the link from a table of static mappings and mappings
+     * learnt from the ARP and ND traffic of the receivers, so address
+     * resolution never has to make the round trip over the air.
+     * Requests for hosts on the local side, which learn() never
+     * reports as remote, are dropped, and the remaining resolution
+     * traffic is limited to ARP_PASS_RATE frames per second. Learnt
+     * mappings expire after ARP_ENTRY_TIMEOUT seconds. Times are
+     * CLOCK_MONOTONIC microseconds. Safe to call from several
+     * threads.
+     */
+    class arp_proxy
+    {
+     private:
+      struct entry {
+        unsigned char mac[6];
+        uint64_t expires;
+        bool is_static;
+        bool remote;
+      };
+      std::map<std::string, entry> table;
+      double tokens;
+      uint64_t last_refill;
+      uint64_t answered;
+      uint64_t dropped;
+      uint64_t limited;
+      boost::mutex mutex;
+      void add(const unsigned char *addr, const unsigned char *mac, bool remote, uint64_t now);
+      const entry *lookup(const unsigned char *addr, uint64_t now);
+      arp_verdict resolve(const unsigned char *addr, uint64_t now);
+      arp_verdict rate_limit(uint64_t now);
+      unsigned int arp_reply(const unsigned char *frame, const unsigned char *mac, unsigned char *reply);
+      unsigned int neighbour_advert(const unsigned char *frame, const unsigned char *mac, unsigned char *reply);
+      static uint64_t clock(void);
+
+     public:
+      /*
+       * static_entries is a comma separated list of ip=mac pairs for
+       * remote hosts, IPv4 or IPv6. Throws std::runtime_error on
+       * anything else.
+       */
+      arp_proxy(const char *static_entries);
+
+      /*
+       * Decide what to do with a frame about to be encapsulated and
+       * learn the local hosts from its sender fields. On ARP_REPLY
+       * the answer is in reply, which holds ARP_REPLY_SIZE bytes, and
+       * its length in *reply_len. Without a reply buffer known hosts
+       * are not answered but still rate limited.
+       */
+      arp_verdict handle(const unsigned char *frame, unsigned int len, unsigned char *reply, unsigned int *reply_len) { return handle(frame, len, reply, reply_len, clock()); }
+      arp_verdict handle(const unsigned char *frame, unsigned int len, unsigned char *reply, unsigned int *reply_len, uint64_t now);
+
+      /* Learn the remote hosts from a frame sent by a receiver. Returns true if it was ARP or ND. */
+      bool learn(const unsigned char *frame, unsigned int len) { return learn(frame, len, clock()); }
+      bool learn(const unsigned char *frame, unsigned int len, uint64_t now);
+
+      std::vector<arp_neighbour> get_neighbours(void) { return get_neighbours(clock()); }
+      std::vector<arp_neighbour> get_neighbours(uint64_t now);
+      uint64_t get_answered(void);
+      uint64_t get_dropped(void);
+      uint64_t get_limited(void);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_ARP_PROXY_H */
@@ -0,0 +1,283 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Encapsulation throughput benchmark. Feeds synthetic Ethernet frames
+ * through the generic SNDU builder, the specialised serial builders
+ * and the parallel SNDU pipeline with 1 to max_threads workers, checks
+ * that every SNDU comes back intact and in order, and prints the rates
+ * relative to the generic builder. Checking is not included in the
+ * timings. Frames come from a packet pool, as captured frames do.
+ *
+ * usage: bench-ule-encap [frames] [frame_size] [max_threads]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include "ts_packetizer.h"
+#include "sndu_builder.h"
+#include "sndu_encap.h"
+#include "sndu_pipeline.h"
+
+#define BENCH_CHUNK (MPEG2_PACKET_SIZE * 2000)
+
+using namespace gr::ule;
+
+class synthetic_source : public packet_source
+{
+ private:
+  packet_pool pool;
+  std::vector<unsigned char> frame;
+  unsigned int frame_size;
+  uint32_t count;
+  uint32_t total;
+
+ public:
+  synthetic_source(uint32_t total, unsigned int frame_size, unsigned int buffers)
+    : pool(buffers), frame(frame_size), frame_size(frame_size), count(0), total(total)
+  {
+    struct ether_header *eptr = (struct ether_header *)&frame[0];
+
+    memset(eptr->ether_dhost, 0x02, ETHER_ADDR_LEN);
+    memset(eptr->ether_shost, 0x04, ETHER_ADDR_LEN);
+    eptr->ether_type = htons(ETHERTYPE_IP);
+    for (unsigned int i = sizeof(struct ether_header); i < frame_size; i++) {
+      frame[i] = i & 0xff;
+    }
+  }
+
+  packet_desc *next_packet(void)
+  {
+    packet_desc *desc;
+
+    if (count == total || (desc = pool.alloc()) == NULL) {
+      return NULL;
+    }
+    /* sequence number in the first payload bytes */
+    memcpy(desc->data, &frame[0], frame_size);
+    memcpy(&desc->data[sizeof(struct ether_header)], &count, sizeof(count));
+    desc->length = frame_size;
+    count++;
+    return desc;
+  }
+};
+
+/*
+ * The generic builder, testing every option per frame. It shares the
+ * CRC with the specialised builders, so the difference is only what
+ * specialising on the options saves.
+ */
+class generic_sndu_source : public sndu_source
+{
+ private:
+  packet_source *source;
+
+ public:
+  generic_sndu_source(packet_source *source) : source(source) {}
+
+  packet_desc *next_sndu(const sndu_rewrite &rewrite)
+  {
+    packet_desc *desc;
+
+    while ((desc = source->next_packet()) != NULL) {
+      desc = build_sndu(desc, rewrite);
+      if (desc) {
+        return desc;
+      }
+    }
+    return NULL;
+  }
+};
+
+/*
+ * Minimal RFC 4326 receiver for the ULE PID. Counts SNDUs with a good
+ * CRC whose sequence numbers arrive in order.
+ */
+class checker
+{
+ private:
+  std::vector<unsigned char> sndu;
+  unsigned int needed;
+  bool active;
+
+  void complete(void)
+  {
+    unsigned int crc = sndu_crc32(&sndu[0], sndu.size() - SNDU_CRC_SIZE);
+    const unsigned char *tail = &sndu[sndu.size() - SNDU_CRC_SIZE];
+    uint32_t seq;
+
+    if (tail[0] != (crc >> 24) || tail[1] != ((crc >> 16) & 0xff) ||
+        tail[2] != ((crc >> 8) & 0xff) || tail[3] != (crc & 0xff)) {
+      errors++;
+      return;
+    }
+    memcpy(&seq, &sndu[SNDU_BASE_HEADER_SIZE + ((sndu[0] & 0x80) ? 0 : ETHER_ADDR_LEN)], sizeof(seq));
+    if (seq != good) {
+      errors++;
+    }
+    good = seq + 1;
+  }
+
+  /* consume payload bytes, stopping at padding */
+  void feed(const unsigned char *p, unsigned int n, bool may_start)
+  {
+    unsigned int count;
+
+    while (n) {
+      if (!active) {
+        if (!may_start || n < 2 || (p[0] == 0xff && p[1] == 0xff)) {
+          return;
+        }
+        needed = (((p[0] & 0x7f) << 8) | p[1]) + SNDU_BASE_HEADER_SIZE;
+        sndu.clear();
+        active = true;
+      }
+      count = needed - sndu.size();
+      if (count > n) {
+        count = n;
+      }
+      sndu.insert(sndu.end(), p, p + count);
+      p += count;
+      n -= count;
+      if (sndu.size() == needed) {
+        complete();
+        active = false;
+      }
+    }
+  }
+
+ public:
+  uint32_t good;
+  uint32_t errors;
+
+  checker() : needed(0), active(false), good(0), errors(0) {}
+
+  void cells(const unsigned char *ts, int size)
+  {
+    for (int i = 0; i < size; i += MPEG2_PACKET_SIZE) {
+      const unsigned char *cell = &ts[i];
+      int pid = ((cell[1] & 0x1f) << 8) | cell[2];
+
+      if (pid != ULE_PID) {
+        continue;
+      }
+      if (cell[1] & 0x40) {
+        unsigned int pointer = cell[TS_HEADER_SIZE];
+        if (active) {
+          feed(&cell[SNDU_PAYLOAD_PP_OFFSET], pointer, false);
+          if (active) {
+            errors++;
+            active = false;
+          }
+        }
+        feed(&cell[SNDU_PAYLOAD_PP_OFFSET + pointer], SNDU_PAYLOAD_PP_SIZE - pointer, true);
+      }
+      else {
+        feed(&cell[TS_HEADER_SIZE], SNDU_PAYLOAD_SIZE, false);
+      }
+    }
+  }
+};
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double seconds, uint32_t frames, unsigned int frame_size, double base, const checker &check, bool checked)
+{
+  double rate = frames * (double)frame_size * 8 / seconds / 1e6;
+
+  printf("%-20s %10.1f Mb/s %10.0f frames/s %6.2fx", name, rate, frames / seconds, base > 0 ? rate / base : 1.0);
+  if (checked) {
+    printf("  %u in order, %u errors", check.good, check.errors);
+  }
+  printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  uint32_t frames = argc > 1 ? atoi(argv[1]) : 200000;
+  unsigned int frame_size = argc > 2 ? atoi(argv[2]) : 1500;
+  int max_threads = argc > 3 ? atoi(argv[3]) : 8;
+  std::vector<unsigned char> out(BENCH_CHUNK);
+  const char *paths[] = {"generic sndu", "serial sndu", "serial sndu d-bit"};
+  double start, seconds, base;
+  char name[32];
+  int failed = 0;
+
+  if (frame_size < sizeof(struct ether_header) + sizeof(uint32_t) || frame_size > ULE_MAX_FRAME_SIZE) {
+    fprintf(stderr, "frame_size must be %u to %u\n", (unsigned int)(sizeof(struct ether_header) + sizeof(uint32_t)), ULE_MAX_FRAME_SIZE);
+    return 1;
+  }
+
+  for (int path = 0; path < 3; path++) {
+    synthetic_source source(frames, frame_size, 2);
+    generic_sndu_source generic(&source);
+    serial_sndu_source serial(&source);
+    sndu_source *sndus = path == 0 ? (sndu_source *)&generic : (sndu_source *)&serial;
+    ts_packetizer packetizer(ULE_PID, "BENCH", PING_REPLY_OFF, IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0", NPD_ON, path == 2 ? DBIT_ON : DBIT_OFF, PACKING_ON);
+    checker check;
+
+    seconds = 0;
+    do {
+      start = now();
+      packetizer.packetize_sndus(&out[0], BENCH_CHUNK, sndus);
+      seconds += now() - start;
+      check.cells(&out[0], BENCH_CHUNK);
+    } while (packetizer.get_pending_cells() || packetizer.get_null_runs().empty());
+    if (path == 0) {
+      base = frames * (double)frame_size * 8 / seconds / 1e6;
+    }
+    report(paths[path], seconds, frames, frame_size, base, check, true);
+    failed |= check.good != frames || check.errors;
+  }
+
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    synthetic_source source(frames, frame_size, threads * PIPELINE_AHEAD + 1);
+    sndu_pipeline pipeline(&source, threads);
+    ts_packetizer packetizer(ULE_PID, "BENCH", PING_REPLY_OFF, IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0", NPD_ON, DBIT_OFF, PACKING_ON);
+    checker check;
+
+    pipeline.start();
+    seconds = 0;
+    do {
+      start = now();
+      packetizer.packetize_sndus(&out[0], BENCH_CHUNK, &pipeline);
+      seconds += now() - start;
+      check.cells(&out[0], BENCH_CHUNK);
+    } while (packetizer.get_pending_cells() || pipeline.in_flight() || packetizer.get_null_runs().empty());
+    pipeline.stop();
+    snprintf(name, sizeof(name), "pipeline %d", threads);
+    report(name, seconds, frames, frame_size, base, check, true);
+    failed |= check.good != frames || check.errors;
+  }
+
+  return failed;
+}
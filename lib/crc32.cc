@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "crc32.h"
+
+namespace gr {
+  namespace ule {
+
+    static unsigned int crc32_table[8][256];
+
+    /*
+     * crc32_table[k][i] is the CRC of byte i followed by k zero
+     * bytes.
+     */
+    static bool
+    crc32_init(void)
+    {
+      unsigned int i, j, k;
+
+      for (i = 0; i < 256; i++) {
+        k = 0;
+        for (j = (i << 24) | 0x800000; j != 0x80000000; j <<= 1) {
+          k = (k << 1) ^ (((k ^ j) & 0x80000000) ? 0x04c11db7 : 0);
+        }
+        crc32_table[0][i] = k;
+      }
+      for (i = 0; i < 256; i++) {
+        for (j = 1; j < 8; j++) {
+          k = crc32_table[j - 1][i];
+          crc32_table[j][i] = (k << 8) ^ crc32_table[0][k >> 24];
+        }
+      }
+      return true;
+    }
+
+    static bool crc32_ready = crc32_init();
+
+    unsigned int
+    crc32_mpeg2(const unsigned char *buf, int size)
+    {
+      unsigned int crc = 0xffffffff;
+      unsigned int hi, lo;
+
+      while (size >= 8) {
+        hi = crc ^ ((buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3]);
+        lo = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+        crc = crc32_table[7][hi >> 24] ^ crc32_table[6][(hi >> 16) & 0xff] ^
+              crc32_table[5][(hi >> 8) & 0xff] ^ crc32_table[4][hi & 0xff] ^
+              crc32_table[3][lo >> 24] ^ crc32_table[2][(lo >> 16) & 0xff] ^
+              crc32_table[1][(lo >> 8) & 0xff] ^ crc32_table[0][lo & 0xff];
+        buf += 8;
+        size -= 8;
+      }
+      while (size-- > 0) {
+        crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buf++) & 0xff];
+      }
+      return crc;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
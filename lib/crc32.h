@@ -0,0 +1,40 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_ULE_CRC32_H
+#define INCLUDED_ULE_CRC32_H
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * MPEG-2 CRC32 (polynomial 0x04c11db7, all ones preset, no final
+     * inversion) as carried by PSI sections and at the end of an
+     * SNDU. Slicing by 8, so eight bytes fold into the CRC with
+     * eight table lookups. Running it over the data and its CRC
+     * gives 0.
+     */
+    unsigned int crc32_mpeg2(const unsigned char *buf, int size);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_CRC32_H */
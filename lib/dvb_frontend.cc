@@ -0,0 +1,248 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <sys/stat.h>
+#include "dvb_frontend.h"
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Parsed channel files, shared by every frontend in the process
+     * and reloaded when the file changes on disk. Each entry maps a
+     * frequency to the properties needed to tune it.
+     */
+    struct channel_file {
+      time_t mtime;
+      std::map<unsigned int, std::vector<struct dtv_property> > channels;
+    };
+
+    static boost::mutex channel_cache_mutex;
+    static std::map<std::string, channel_file> channel_cache;
+
+    static bool
+    lookup_channel(const std::string &filename, unsigned int freq, std::vector<struct dtv_property> &props)
+    {
+      boost::mutex::scoped_lock lock(channel_cache_mutex);
+      struct stat st;
+      std::map<std::string, channel_file>::iterator it;
+      std::map<unsigned int, std::vector<struct dtv_property> >::iterator ch;
+      struct dvb_file *dvb_file;
+      struct dvb_entry *entry;
+      unsigned int f;
+
+      if (stat(filename.c_str(), &st) < 0) {
+        return false;
+      }
+      it = channel_cache.find(filename);
+      if (it == channel_cache.end() || it->second.mtime != st.st_mtime) {
+        dvb_file = dvb_read_file_format(filename.c_str(), SYS_UNDEFINED, FILE_DVBV5);
+        if (!dvb_file) {
+          return false;
+        }
+        channel_file &file = channel_cache[filename];
+        file.mtime = st.st_mtime;
+        file.channels.clear();
+        for (entry = dvb_file->first_entry; entry != NULL; entry = entry->next) {
+          if (dvb_retrieve_entry_prop(entry, DTV_FREQUENCY, &f) == 0 && file.channels.find(f) == file.channels.end()) {
+            file.channels[f].assign(entry->props, entry->props + entry->n_props);
+          }
+        }
+        dvb_file_free(dvb_file);
+        it = channel_cache.find(filename);
+      }
+      ch = it->second.channels.find(freq);
+      if (ch == it->second.channels.end()) {
+        return false;
+      }
+      props = ch->second;
+      return true;
+    }
+
+    dvb_frontend::dvb_frontend(const char *filename, const char *frequency, status_callback callback, int poll_interval)
+      : filename(filename), callback(callback), poll_interval(poll_interval)
+    {
+      running = false;
+      requested_frequency = atoi(frequency);
+      parms = NULL;
+    }
+
+    dvb_frontend::~dvb_frontend()
+    {
+      stop();
+    }
+
+    void
+    dvb_frontend::start(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+
+      if (!running) {
+        running = true;
+        worker = boost::thread(boost::bind(&dvb_frontend::run, this));
+      }
+    }
+
+    void
+    dvb_frontend::stop(void)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!running) {
+          return;
+        }
+        running = false;
+        wakeup.notify_all();
+      }
+      worker.join();
+    }
+
+    void
+    dvb_frontend::retune(unsigned int frequency)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+
+      requested_frequency = frequency;
+      wakeup.notify_all();
+    }
+
+    void
+    dvb_frontend::report(frontend_state_t state, unsigned int frequency, const std::string &error)
+    {
+      frontend_status status;
+
+      status.state = state;
+      status.frequency = frequency;
+      status.locked = false;
+      status.snr = 0.0;
+      status.ber = 0.0;
+      status.error = error;
+      if (callback) {
+        callback(status);
+      }
+    }
+
+    bool
+    dvb_frontend::tune(unsigned int frequency, std::string &error)
+    {
+      std::vector<struct dtv_property> props;
+      unsigned int sys = SYS_UNDEFINED;
+
+      if (!frequency || !lookup_channel(filename, frequency, props)) {
+        error = "Can't find channel";
+        return false;
+      }
+      for (unsigned int i = 0; i < props.size(); i++) {
+        if (props[i].cmd == DTV_DELIVERY_SYSTEM) {
+          sys = props[i].u.data;
+        }
+      }
+      dvb_set_compat_delivery_system(parms, sys);
+      for (unsigned int i = 0; i < props.size(); i++) {
+        if (props[i].cmd == DTV_DELIVERY_SYSTEM) {
+          continue;
+        }
+        dvb_fe_store_parm(parms, props[i].cmd, props[i].u.data);
+      }
+      if (dvb_fe_set_parms(parms) < 0) {
+        error = "Error calling dvb_fe_set_parms()";
+        return false;
+      }
+      return true;
+    }
+
+    void
+    dvb_frontend::poll(unsigned int frequency)
+    {
+      frontend_status status;
+      enum fecap_scale_params scale;
+      struct dtv_stats *cnr;
+      uint32_t fe_status = 0;
+
+      status.state = FRONTEND_TUNED;
+      status.frequency = frequency;
+      status.snr = 0.0;
+      status.ber = 0.0;
+      if (dvb_fe_get_stats(parms) == 0) {
+        dvb_fe_retrieve_stats(parms, DTV_STATUS, &fe_status);
+        cnr = dvb_fe_retrieve_stats_layer(parms, DTV_STAT_CNR, 0);
+        if (cnr && cnr->scale == FE_SCALE_DECIBEL) {
+          status.snr = cnr->svalue / 1000.0;
+        }
+        status.ber = dvb_fe_retrieve_ber(parms, 0, &scale);
+        if (scale == FE_SCALE_NOT_AVAILABLE) {
+          status.ber = 0.0;
+        }
+      }
+      status.locked = (fe_status & FE_HAS_LOCK) != 0;
+      if (callback) {
+        callback(status);
+      }
+    }
+
+    void
+    dvb_frontend::run(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      unsigned int tuned_frequency = 0;
+      unsigned int frequency;
+      bool tuned = false;
+      std::string error;
+
+      while (running) {
+        frequency = requested_frequency;
+        lock.unlock();
+        if (!parms) {
+          report(FRONTEND_OPENING, frequency, "");
+          parms = dvb_fe_open(0, 0, 0, 0);
+          if (!parms) {
+            report(FRONTEND_ERROR, frequency, "Error calling dvb_fe_open()");
+          }
+        }
+        if (parms) {
+          if (!tuned || frequency != tuned_frequency) {
+            report(FRONTEND_TUNING, frequency, "");
+            tuned = tune(frequency, error);
+            tuned_frequency = frequency;
+            if (!tuned) {
+              report(FRONTEND_ERROR, frequency, error);
+            }
+          }
+          if (tuned) {
+            poll(frequency);
+          }
+        }
+        lock.lock();
+        if (running && requested_frequency == frequency) {
+          wakeup.timed_wait(lock, boost::posix_time::milliseconds(poll_interval));
+        }
+      }
+      lock.unlock();
+      if (parms) {
+        dvb_fe_close(parms);
+        parms = NULL;
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
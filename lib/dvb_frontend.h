@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_ULE_DVB_FRONTEND_H
+#define INCLUDED_ULE_DVB_FRONTEND_H
+
+#include <string>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include "libdvbv5/dvb-file.h"
+
+#define FRONTEND_POLL_INTERVAL 1000
+
+namespace gr {
+  namespace ule {
+
+    enum frontend_state_t {
+      FRONTEND_OPENING = 0,
+      FRONTEND_TUNING,
+      FRONTEND_TUNED,
+      FRONTEND_ERROR,
+    };
+
+    struct frontend_status {
+      frontend_state_t state;
+      unsigned int frequency;
+      bool locked;
+      double snr;
+      double ber;
+      std::string error;
+    };
+
+    /*
+     * Return channel receiver. The frontend is opened and tuned to
+     * the channel in the DVBv5 file that matches the frequency on a
+     * worker thread, which then polls lock, SNR and BER every
+     * poll_interval milliseconds and reports them to the callback.
+     * Failures are reported and retried instead of thrown, so the
+     * transmit path never waits on the tuner.
+     */
+    class dvb_frontend
+    {
+     public:
+      typedef boost::function<void (const frontend_status &)> status_callback;
+
+      dvb_frontend(const char *filename, const char *frequency, status_callback callback, int poll_interval = FRONTEND_POLL_INTERVAL);
+      ~dvb_frontend();
+
+      void start(void);
+      void stop(void);
+      void retune(unsigned int frequency);
+
+     private:
+      std::string filename;
+      status_callback callback;
+      int poll_interval;
+      boost::thread worker;
+      boost::mutex mutex;
+      boost::condition_variable wakeup;
+      bool running;
+      unsigned int requested_frequency;
+      struct dvb_v5_fe_parms *parms;
+      void run(void);
+      void report(frontend_state_t state, unsigned int frequency, const std::string &error);
+      bool tune(unsigned int frequency, std::string &error);
+      void poll(unsigned int frequency);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_DVB_FRONTEND_H */
@@ -0,0 +1,693 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include "fq_codel.h"
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+    fq_codel_queue::fq_codel_queue(packet_pool *pool, double target_ms, double interval_ms, bool ecn, unsigned int limit, unsigned int num_flows)
+      : pool(pool),
+        flows(num_flows),
+        current(NULL),
+        total_packets(0),
+        total_bytes(0),
+        limit(limit),
+        quantum(FQ_CODEL_QUANTUM),
+        target((uint64_t)(target_ms * 1000.0)),
+        interval((uint64_t)(interval_ms * 1000.0)),
+        ecn(ecn),
+        drops(0),
+        overlimit_drops(0),
+        marks(0),
+        ack_filter(false),
+        ack_drops(0)
+    {
+      for (unsigned int i = 0; i < flows.size(); i++) {
+        flows[i].head = NULL;
+        flows[i].tail = NULL;
+        flows[i].next = -1;
+        flows[i].backlog = 0;
+        flows[i].deficit = 0;
+        flows[i].list = FLOW_INACTIVE;
+        flows[i].first_above_time = 0;
+        flows[i].drop_next = 0;
+        flows[i].count = 0;
+        flows[i].lastcount = 0;
+        flows[i].dropping = false;
+      }
+      new_flows.head = new_flows.tail = -1;
+      old_flows.head = old_flows.tail = -1;
+      perturbation = (uint32_t)now() ^ (uint32_t)rand();
+    }
+
+    fq_codel_queue::~fq_codel_queue()
+    {
+      packet_desc *desc;
+
+      for (unsigned int i = 0; i < flows.size(); i++) {
+        while (flows[i].head) {
+          desc = flows[i].head;
+          flows[i].head = desc->next;
+          desc->release();
+        }
+      }
+    }
+
+    uint64_t
+    fq_codel_queue::now(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+    }
+
+    unsigned int
+    fq_codel_queue::classify(const unsigned char *packet, unsigned int len)
+    {
+      const unsigned char *ip = packet + sizeof(struct ether_header);
+      unsigned int ether_type, header_length, protocol = 0;
+      uint32_t hash = perturbation;
+      const unsigned char *key = packet;
+      unsigned int key_length = ETHER_ADDR_LEN * 2;
+      const unsigned char *ports = NULL;
+
+      if (len < sizeof(struct ether_header)) {
+        return 0;
+      }
+      ether_type = (packet[12] << 8) | packet[13];
+      if (ether_type == ETHERTYPE_IP && len >= sizeof(struct ether_header) + 20) {
+        header_length = (ip[0] & 0xf) * 4;
+        protocol = ip[9];
+        key = &ip[12];
+        key_length = 8;
+        if ((((ip[6] & 0x1f) << 8) | ip[7]) == 0 && len >= sizeof(struct ether_header) + header_length + 4) {
+          ports = ip + header_length;
+        }
+      }
+      else if (ether_type == ETHERTYPE_IPV6 && len >= sizeof(struct ether_header) + 40) {
+        protocol = ip[6];
+        key = &ip[8];
+        key_length = 32;
+        if (len >= sizeof(struct ether_header) + 44) {
+          ports = ip + 40;
+        }
+      }
+      if (protocol != IPPROTO_TCP && protocol != IPPROTO_UDP) {
+        ports = NULL;
+      }
+
+      /* Jenkins one-at-a-time over the flow 5-tuple */
+      for (unsigned int i = 0; i < key_length; i++) {
+        hash += key[i];
+        hash += hash << 10;
+        hash ^= hash >> 6;
+      }
+      if (ports) {
+        for (unsigned int i = 0; i < 4; i++) {
+          hash += ports[i];
+          hash += hash << 10;
+          hash ^= hash >> 6;
+        }
+      }
+      hash += protocol;
+      hash += hash << 3;
+      hash ^= hash >> 11;
+      hash += hash << 15;
+      return hash % flows.size();
+    }
+
+    /* a TCP segment of an unfragmented IPv4 or IPv6 packet */
+    struct tcp_segment {
+      const unsigned char *ip;
+      const unsigned char *tcp;
+      unsigned int header_length;
+      unsigned int payload;
+      bool ipv6;
+      bool ce;
+    };
+
+    static bool
+    parse_tcp(const unsigned char *packet, unsigned int len, tcp_segment &seg)
+    {
+      const unsigned char *ip = packet + sizeof(struct ether_header);
+      unsigned int ether_type, ip_header, ip_length;
+
+      if (len < sizeof(struct ether_header) + 40) {
+        return false;
+      }
+      len -= sizeof(struct ether_header);
+      ether_type = (packet[12] << 8) | packet[13];
+      if (ether_type == ETHERTYPE_IP && (ip[0] >> 4) == 4) {
+        ip_header = (ip[0] & 0xf) * 4;
+        ip_length = (ip[2] << 8) | ip[3];
+        if (ip[9] != IPPROTO_TCP || (((ip[6] & 0x3f) << 8) | ip[7]) != 0) {
+          return false;
+        }
+        seg.ipv6 = false;
+        seg.ce = (ip[1] & 0x3) == 0x3;
+      }
+      else if (ether_type == ETHERTYPE_IPV6 && (ip[0] >> 4) == 6 && len >= 60) {
+        ip_header = 40;
+        ip_length = 40 + ((ip[4] << 8) | ip[5]);
+        if (ip[6] != IPPROTO_TCP) {
+          return false;
+        }
+        seg.ipv6 = true;
+        seg.ce = (ip[1] & 0x30) == 0x30;
+      }
+      else {
+        return false;
+      }
+      if (ip_length > len || ip_header < 20 || ip_header + 20 > ip_length) {
+        return false;
+      }
+      seg.ip = ip;
+      seg.tcp = ip + ip_header;
+      seg.header_length = (seg.tcp[12] >> 4) * 4;
+      if (seg.header_length < 20 || ip_header + seg.header_length > ip_length) {
+        return false;
+      }
+      seg.payload = ip_length - ip_header - seg.header_length;
+      return true;
+    }
+
+    static uint32_t
+    read32(const unsigned char *p)
+    {
+      return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+
+    /* sequence number a is after b */
+    static bool
+    seq_after(uint32_t a, uint32_t b)
+    {
+      return (int32_t)(a - b) > 0;
+    }
+
+    static bool
+    same_connection(const tcp_segment &a, const tcp_segment &b)
+    {
+      if (a.ipv6 != b.ipv6 || memcmp(a.tcp, b.tcp, 4) != 0) {
+        return false;
+      }
+      return a.ipv6 ? memcmp(a.ip + 8, b.ip + 8, 32) == 0 : memcmp(a.ip + 12, b.ip + 12, 8) == 0;
+    }
+
+    /*
+     * Whether every SACK block of old lies below ack or inside a SACK
+     * block of the newer segment. Returns false for any option other
+     * than NOP, EOL, timestamps and SACK, so unknown signalling is
+     * never thrown away.
+     */
+    static bool
+    sack_covered(const tcp_segment &old, const tcp_segment &seg, uint32_t ack)
+    {
+      const unsigned char *opt = old.tcp + 20, *end = old.tcp + old.header_length;
+      const unsigned char *nopt, *nend = seg.tcp + seg.header_length;
+      uint32_t left, right;
+      bool covered;
+
+      while (opt < end && *opt != 0) {
+        if (*opt == 1) {
+          opt++;
+          continue;
+        }
+        if (opt + 2 > end || opt[1] < 2 || opt + opt[1] > end) {
+          return false;
+        }
+        if (*opt == 5) {
+          for (const unsigned char *block = opt + 2; block + 8 <= opt + opt[1]; block += 8) {
+            left = read32(block);
+            right = read32(block + 4);
+            if (!seq_after(right, ack)) {
+              continue;
+            }
+            covered = false;
+            nopt = seg.tcp + 20;
+            while (!covered && nopt + 2 <= nend && *nopt != 0) {
+              if (*nopt == 1) {
+                nopt++;
+                continue;
+              }
+              if (nopt[1] < 2 || nopt + nopt[1] > nend) {
+                break;
+              }
+              if (*nopt == 5) {
+                for (const unsigned char *nblock = nopt + 2; nblock + 8 <= nopt + nopt[1]; nblock += 8) {
+                  if (!seq_after(read32(nblock), left) && !seq_after(right, read32(nblock + 4))) {
+                    covered = true;
+                  }
+                }
+              }
+              nopt += nopt[1];
+            }
+            if (!covered) {
+              return false;
+            }
+          }
+        }
+        else if (*opt != 8) {
+          return false;
+        }
+        opt += opt[1];
+      }
+      return true;
+    }
+
+    /*
+     * Drop the oldest queued pure ACK of the same connection that desc
+     * makes redundant. One per arrival keeps the latest ACK queued.
+     */
+    void
+    fq_codel_queue::filter_acks(flow &f, packet_desc *desc)
+    {
+      static const unsigned char TCP_SYN = 0x02, TCP_RST = 0x04, TCP_ACK = 0x10, TCP_ECE = 0x40;
+      tcp_segment seg, old;
+      packet_desc *prev = NULL, *p;
+      unsigned char flags, old_flags;
+      uint32_t ack;
+
+      if (!parse_tcp(desc->data, desc->length, seg)) {
+        return;
+      }
+      flags = seg.tcp[13];
+      if ((flags & (TCP_SYN | TCP_RST | TCP_ACK)) != TCP_ACK) {
+        return;
+      }
+      ack = read32(seg.tcp + 8);
+      for (p = f.head; p != desc; prev = p, p = p->next) {
+        if (!parse_tcp(p->data, p->length, old) || !same_connection(seg, old)) {
+          continue;
+        }
+        /* a bare ACK, with ECE only if the newer segment echoes it too */
+        old_flags = old.tcp[13];
+        if (old.payload != 0 || old.ce || old_flags != (TCP_ACK | (old_flags & TCP_ECE & flags)) ||
+            !seq_after(ack, read32(old.tcp + 8)) || !sack_covered(old, seg, ack)) {
+          continue;
+        }
+        if (prev) {
+          prev->next = p->next;
+        }
+        else {
+          f.head = p->next;
+        }
+        f.backlog -= p->length;
+        total_bytes -= p->length;
+        total_packets--;
+        ack_drops++;
+        p->release();
+        return;
+      }
+    }
+
+    void
+    fq_codel_queue::list_push(flow_list &list, int index)
+    {
+      flows[index].next = -1;
+      if (list.tail < 0) {
+        list.head = index;
+      }
+      else {
+        flows[list.tail].next = index;
+      }
+      list.tail = index;
+    }
+
+    int
+    fq_codel_queue::list_pop(flow_list &list)
+    {
+      int index = list.head;
+
+      list.head = flows[index].next;
+      if (list.head < 0) {
+        list.tail = -1;
+      }
+      return index;
+    }
+
+    void
+    fq_codel_queue::enqueue(const struct pcap_pkthdr *hdr, const unsigned char *packet)
+    {
+      profile_scope profile(PROFILE_CAPTURE);
+      packet_desc *desc;
+
+      if (hdr->len > ULE_MAX_FRAME_SIZE) {
+        return;
+      }
+      desc = pool->alloc();
+      if (desc == NULL) {
+        {
+          boost::mutex::scoped_lock lock(mutex);
+          drop_from_fattest();
+        }
+        desc = pool->alloc();
+        if (desc == NULL) {
+          boost::mutex::scoped_lock lock(mutex);
+          overlimit_drops++;
+          return;
+        }
+      }
+      memcpy(desc->data, packet, hdr->len);
+      desc->length = hdr->len;
+      enqueue(desc);
+    }
+
+    void
+    fq_codel_queue::enqueue(packet_desc *desc, uint64_t t)
+    {
+      unsigned int index = classify(desc->data, desc->length);
+      boost::mutex::scoped_lock lock(mutex);
+      flow &f = flows[index];
+
+      desc->timestamp = t;
+      desc->next = NULL;
+      if (f.tail) {
+        f.tail->next = desc;
+      }
+      else {
+        f.head = desc;
+      }
+      f.tail = desc;
+      f.backlog += desc->length;
+      total_packets++;
+      total_bytes += desc->length;
+      if (ack_filter && f.head != desc) {
+        filter_acks(f, desc);
+      }
+      if (f.list == FLOW_INACTIVE) {
+        f.list = FLOW_NEW;
+        f.deficit = quantum;
+        list_push(new_flows, index);
+      }
+      if (total_packets > limit) {
+        drop_from_fattest();
+      }
+    }
+
+    void
+    fq_codel_queue::drop_from_fattest(void)
+    {
+      unsigned int fattest = 0;
+      packet_desc *desc;
+
+      for (unsigned int i = 1; i < flows.size(); i++) {
+        if (flows[i].backlog > flows[fattest].backlog) {
+          fattest = i;
+        }
+      }
+      flow &f = flows[fattest];
+      if (f.head) {
+        desc = f.head;
+        f.head = desc->next;
+        if (f.head == NULL) {
+          f.tail = NULL;
+        }
+        f.backlog -= desc->length;
+        total_bytes -= desc->length;
+        total_packets--;
+        overlimit_drops++;
+        desc->release();
+      }
+    }
+
+    uint64_t
+    fq_codel_queue::control_law(uint64_t t, unsigned int count)
+    {
+      return t + (uint64_t)(interval / std::sqrt((double)count));
+    }
+
+    bool
+    fq_codel_queue::ecn_mark(packet_desc *p)
+    {
+      unsigned char *ip = &p->data[sizeof(struct ether_header)];
+      unsigned int ether_type;
+      unsigned int old_word, new_word, sum;
+
+      if (!ecn || p->length < sizeof(struct ether_header) + 20) {
+        return false;
+      }
+      ether_type = (p->data[12] << 8) | p->data[13];
+      if (ether_type == ETHERTYPE_IP) {
+        if ((ip[1] & 0x3) == 0) {
+          return false;
+        }
+        /* set CE and patch the header checksum (RFC 1624) */
+        old_word = (ip[0] << 8) | ip[1];
+        ip[1] |= 0x3;
+        new_word = (ip[0] << 8) | ip[1];
+        sum = (~((ip[10] << 8) | ip[11]) & 0xffff) + (~old_word & 0xffff) + new_word;
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = ~sum & 0xffff;
+        ip[10] = sum >> 8;
+        ip[11] = sum & 0xff;
+      }
+      else if (ether_type == ETHERTYPE_IPV6) {
+        if ((ip[1] & 0x30) == 0) {
+          return false;
+        }
+        ip[1] |= 0x30;
+      }
+      else {
+        return false;
+      }
+      marks++;
+      return true;
+    }
+
+    bool
+    fq_codel_queue::codel_should_drop(flow &f, packet_desc *p, uint64_t t)
+    {
+      /* a target of zero leaves plain fair queueing */
+      if (target == 0) {
+        f.first_above_time = 0;
+        return false;
+      }
+      if ((t - p->timestamp) < target || f.backlog <= (unsigned int)quantum) {
+        f.first_above_time = 0;
+        return false;
+      }
+      if (f.first_above_time == 0) {
+        f.first_above_time = t + interval;
+        return false;
+      }
+      return t >= f.first_above_time;
+    }
+
+    void
+    fq_codel_queue::dequeue_head(flow &f)
+    {
+      current = f.head;
+      f.head = current->next;
+      if (f.head == NULL) {
+        f.tail = NULL;
+      }
+      current->next = NULL;
+      f.backlog -= current->length;
+      total_bytes -= current->length;
+      total_packets--;
+    }
+
+    void
+    fq_codel_queue::drop_current(void)
+    {
+      current->release();
+      current = NULL;
+      drops++;
+    }
+
+    /*
+     * Move the head of f into current, dropping or marking on the way
+     * as the CoDel state machine dictates. Returns false if f ran dry.
+     */
+    bool
+    fq_codel_queue::codel_dequeue(flow &f, uint64_t t)
+    {
+      bool ok_to_drop;
+      unsigned int delta;
+
+      if (f.head == NULL) {
+        f.first_above_time = 0;
+        return false;
+      }
+      dequeue_head(f);
+      ok_to_drop = codel_should_drop(f, current, t);
+
+      if (f.dropping) {
+        if (!ok_to_drop) {
+          f.dropping = false;
+        }
+        while (f.dropping && t >= f.drop_next) {
+          f.count++;
+          if (ecn_mark(current)) {
+            f.drop_next = control_law(f.drop_next, f.count);
+            return true;
+          }
+          drop_current();
+          if (f.head == NULL) {
+            f.dropping = false;
+            f.first_above_time = 0;
+            return false;
+          }
+          dequeue_head(f);
+          if (!codel_should_drop(f, current, t)) {
+            f.dropping = false;
+          }
+          else {
+            f.drop_next = control_law(f.drop_next, f.count);
+          }
+        }
+      }
+      else if (ok_to_drop) {
+        f.dropping = true;
+        delta = f.count - f.lastcount;
+        if (delta > 1 && (t - f.drop_next) < 16 * interval) {
+          f.count = delta;
+        }
+        else {
+          f.count = 1;
+        }
+        f.drop_next = control_law(t, f.count);
+        f.lastcount = f.count;
+        if (!ecn_mark(current)) {
+          drop_current();
+          if (f.head == NULL) {
+            f.first_above_time = 0;
+            return false;
+          }
+          dequeue_head(f);
+          codel_should_drop(f, current, t);
+        }
+      }
+      return true;
+    }
+
+    packet_desc *
+    fq_codel_queue::next_packet(uint64_t t)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      flow_list *list;
+      packet_desc *desc;
+      int index;
+
+      while (1) {
+        if (new_flows.head >= 0) {
+          list = &new_flows;
+        }
+        else if (old_flows.head >= 0) {
+          list = &old_flows;
+        }
+        else {
+          return NULL;
+        }
+        index = list->head;
+        flow &f = flows[index];
+        if (f.deficit <= 0) {
+          f.deficit += quantum;
+          list_pop(*list);
+          list_push(old_flows, index);
+          f.list = FLOW_OLD;
+          continue;
+        }
+        if (!codel_dequeue(f, t)) {
+          list_pop(*list);
+          if (list == &new_flows && old_flows.head >= 0) {
+            list_push(old_flows, index);
+            f.list = FLOW_OLD;
+          }
+          else {
+            f.list = FLOW_INACTIVE;
+          }
+          continue;
+        }
+        f.deficit -= current->length;
+        desc = current;
+        current = NULL;
+        return desc;
+      }
+    }
+
+    unsigned int
+    fq_codel_queue::size(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return total_packets;
+    }
+
+    unsigned int
+    fq_codel_queue::backlog(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return total_bytes;
+    }
+
+    uint64_t
+    fq_codel_queue::get_drops(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return drops;
+    }
+
+    uint64_t
+    fq_codel_queue::get_overlimit_drops(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return overlimit_drops;
+    }
+
+    uint64_t
+    fq_codel_queue::get_marks(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return marks;
+    }
+
+    uint64_t
+    fq_codel_queue::get_ack_drops(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return ack_drops;
+    }
+
+    void
+    fq_codel_queue::set_params(double target_ms, double interval_ms)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      target = (uint64_t)(target_ms * 1000.0);
+      interval = (uint64_t)(interval_ms * 1000.0);
+    }
+
+    void
+    fq_codel_queue::set_ack_filter(bool ack_filter)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      this->ack_filter = ack_filter;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
+
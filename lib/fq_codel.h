@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_FQ_CODEL_H
+#define INCLUDED_ULE_FQ_CODEL_H
+
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "ts_packetizer.h"
+
+#define FQ_CODEL_FLOWS 1024
+#define FQ_CODEL_LIMIT 10240
+#define FQ_CODEL_QUANTUM 1514
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * FQ-CoDel (RFC 8290) queue between the capture thread and the
+     * packetizer. Frames are hashed into flows, served by deficit round
+     * robin, and each flow runs its own CoDel (RFC 8289) instance that
+     * drops, or ECN marks, packets whose sojourn time stays above target
+     * for longer than interval. Packets are pool descriptors chained
+     * through their next pointers and flows are chained by index, so
+     * queueing never touches the heap. Each descriptor is stamped with
+     * its enqueue time.
+     *
+     * With the ACK filter on, a TCP segment that arrives behind a
+     * queued pure ACK of the same connection replaces it when its
+     * cumulative ACK is newer and covers every SACK block of the old
+     * one, in the conservative spirit of CAKE's ack-filter. ACKs that
+     * carry SYN, FIN, RST, URG, a new ECE or CWR, a CE mark or
+     * unknown TCP options are never dropped, nor are duplicate ACKs.
+     */
+    class fq_codel_queue : public packet_source
+    {
+     private:
+      struct flow {
+        packet_desc *head;
+        packet_desc *tail;
+        int next;
+        unsigned int backlog;
+        int deficit;
+        int list;
+        uint64_t first_above_time;
+        uint64_t drop_next;
+        unsigned int count;
+        unsigned int lastcount;
+        bool dropping;
+      };
+      struct flow_list {
+        int head;
+        int tail;
+      };
+      enum { FLOW_INACTIVE = 0, FLOW_NEW, FLOW_OLD };
+      packet_pool *pool;
+      std::vector<flow> flows;
+      flow_list new_flows;
+      flow_list old_flows;
+      packet_desc *current;
+      unsigned int total_packets;
+      unsigned int total_bytes;
+      unsigned int limit;
+      int quantum;
+      uint64_t target;
+      uint64_t interval;
+      bool ecn;
+      uint32_t perturbation;
+      uint64_t drops;
+      uint64_t overlimit_drops;
+      uint64_t marks;
+      bool ack_filter;
+      uint64_t ack_drops;
+      boost::mutex mutex;
+      unsigned int classify(const unsigned char *, unsigned int);
+      void list_push(flow_list &, int);
+      int list_pop(flow_list &);
+      void dequeue_head(flow &);
+      void drop_current(void);
+      bool codel_should_drop(flow &, packet_desc *, uint64_t);
+      bool codel_dequeue(flow &, uint64_t);
+      bool ecn_mark(packet_desc *);
+      void drop_from_fattest(void);
+      void filter_acks(flow &, packet_desc *);
+      uint64_t control_law(uint64_t, unsigned int);
+
+     public:
+      fq_codel_queue(packet_pool *pool, double target_ms, double interval_ms, bool ecn, unsigned int limit = FQ_CODEL_LIMIT, unsigned int num_flows = FQ_CODEL_FLOWS);
+      ~fq_codel_queue();
+
+      /*
+       * Copy a captured frame into a pool buffer and queue it. When
+       * the pool is dry the fattest flow gives up its head first.
+       */
+      void enqueue(const struct pcap_pkthdr *hdr, const unsigned char *packet);
+      void enqueue(packet_desc *desc) { enqueue(desc, now()); }
+      void enqueue(packet_desc *desc, uint64_t t);
+      packet_desc *next_packet(void) { return next_packet(now()); }
+      packet_desc *next_packet(uint64_t t);
+      unsigned int size(void);
+      unsigned int backlog(void);
+      uint64_t get_drops(void);
+      uint64_t get_overlimit_drops(void);
+      uint64_t get_marks(void);
+      uint64_t get_ack_drops(void);
+      void set_params(double target_ms, double interval_ms);
+      void set_ack_filter(bool ack_filter);
+      static uint64_t now(void);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_FQ_CODEL_H */
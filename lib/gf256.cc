@@ -0,0 +1,140 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gf256.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define GF256_SSSE3
+#endif
+
+#define GF_POLYNOMIAL 0x11d
+
+namespace gr {
+  namespace ule {
+
+    static unsigned char gf_exp[512];
+    static unsigned char gf_log[256];
+    /* products of every constant with each low and high nibble */
+    static unsigned char gf_mul_lo[256][16];
+    static unsigned char gf_mul_hi[256][16];
+    static bool use_ssse3;
+
+    static bool
+    gf256_init(void)
+    {
+      int x = 1;
+
+      for (int i = 0; i < 255; i++) {
+        gf_exp[i] = gf_exp[i + 255] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) {
+          x ^= GF_POLYNOMIAL;
+        }
+      }
+      gf_exp[510] = gf_exp[0];
+      gf_exp[511] = gf_exp[1];
+      gf_log[0] = 0;
+      for (int c = 0; c < 256; c++) {
+        for (int n = 0; n < 16; n++) {
+          gf_mul_lo[c][n] = gf256_mul(c, n);
+          gf_mul_hi[c][n] = gf256_mul(c, n << 4);
+        }
+      }
+#ifdef GF256_SSSE3
+      use_ssse3 = __builtin_cpu_supports("ssse3");
+#else
+      use_ssse3 = false;
+#endif
+      return true;
+    }
+
+    static bool gf256_ready = gf256_init();
+
+    unsigned char
+    gf256_mul(unsigned char a, unsigned char b)
+    {
+      if (a == 0 || b == 0) {
+        return 0;
+      }
+      return gf_exp[gf_log[a] + gf_log[b]];
+    }
+
+    unsigned char
+    gf256_exp(int n)
+    {
+      return gf_exp[n % 255];
+    }
+
+    unsigned char
+    gf256_inv(unsigned char a)
+    {
+      return gf_exp[255 - gf_log[a]];
+    }
+
+#ifdef GF256_SSSE3
+    __attribute__((target("ssse3")))
+    static int
+    region_madd_ssse3(unsigned char *dst, const unsigned char *src, unsigned char c, int length)
+    {
+      const __m128i lo_table = _mm_loadu_si128((const __m128i *)gf_mul_lo[c]);
+      const __m128i hi_table = _mm_loadu_si128((const __m128i *)gf_mul_hi[c]);
+      const __m128i mask = _mm_set1_epi8(0x0f);
+      __m128i s, lo, hi, d;
+      int i;
+
+      for (i = 0; i + 16 <= length; i += 16) {
+        s = _mm_loadu_si128((const __m128i *)(src + i));
+        lo = _mm_shuffle_epi8(lo_table, _mm_and_si128(s, mask));
+        hi = _mm_shuffle_epi8(hi_table, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, _mm_xor_si128(lo, hi)));
+      }
+      return i;
+    }
+#endif
+
+    void
+    gf256_region_madd(unsigned char *dst, const unsigned char *src, unsigned char c, int length)
+    {
+      int i = 0;
+
+      if (c == 0) {
+        return;
+      }
+      if (c == 1) {
+        for (; i < length; i++) {
+          dst[i] ^= src[i];
+        }
+        return;
+      }
+#ifdef GF256_SSSE3
+      if (use_ssse3) {
+        i = region_madd_ssse3(dst, src, c, length);
+      }
+#endif
+      for (; i < length; i++) {
+        dst[i] ^= gf_mul_lo[c][src[i] & 0x0f] ^ gf_mul_hi[c][src[i] >> 4];
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,48 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_GF256_H
+#define INCLUDED_ULE_GF256_H
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * GF(2^8) arithmetic with the field polynomial
+     * x^8 + x^4 + x^3 + x^2 + 1, shared by the packet level FEC and
+     * the RS(204,188) outer code.
+     */
+    unsigned char gf256_mul(unsigned char a, unsigned char b);
+    unsigned char gf256_inv(unsigned char a);
+
+    /* alpha^n, n >= 0, with alpha = x the primitive element */
+    unsigned char gf256_exp(int n);
+
+    /*
+     * dst[i] ^= c * src[i] over a whole region, the inner loop of
+     * encoding and decoding. Uses SSSE3 table lookups when the CPU
+     * has them.
+     */
+    void gf256_region_madd(unsigned char *dst, const unsigned char *src, unsigned char c, int length);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_GF256_H */
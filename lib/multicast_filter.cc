@@ -0,0 +1,435 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/if_ether.h>
+#include "multicast_filter.h"
+
+#define IPPROTO_IGMP_ 2
+#define IPV6_HEADER_SIZE 40
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char v4_mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    static const unsigned char all_nodes[16] = {0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+
+    static void
+    map_v4(const unsigned char *ip, unsigned char *addr)
+    {
+      memcpy(addr, v4_mapped, sizeof(v4_mapped));
+      memcpy(addr + sizeof(v4_mapped), ip, 4);
+    }
+
+    static bool
+    is_v4(const unsigned char *addr)
+    {
+      return memcmp(addr, v4_mapped, sizeof(v4_mapped)) == 0;
+    }
+
+    static bool
+    is_group(const unsigned char *addr)
+    {
+      return is_v4(addr) ? (addr[12] & 0xf0) == 0xe0 : addr[0] == 0xff;
+    }
+
+    static unsigned int
+    hash(const unsigned char *addr)
+    {
+      uint32_t h = 2166136261u;
+
+      for (int i = 0; i < 16; i++) {
+        h = (h ^ addr[i]) * 16777619u;
+      }
+      return h & (MCAST_TABLE_SIZE - 1);
+    }
+
+    /*
+     * Skip the IPv6 extension headers an MLD message can sit behind
+     * (hop-by-hop with the router alert, destination options,
+     * routing). Returns the upper layer protocol with *offset at its
+     * header, or -1 if the chain runs past len.
+     */
+    static int
+    ipv6_upper(const unsigned char *ip6, unsigned int len, unsigned int *offset)
+    {
+      unsigned int off = IPV6_HEADER_SIZE;
+      int next = ip6[6];
+
+      while (next == 0 || next == 43 || next == 60) {
+        if (off + 8 > len) {
+          return -1;
+        }
+        next = ip6[off];
+        off += (ip6[off + 1] + 1) * 8;
+      }
+      if (off > len) {
+        return -1;
+      }
+      *offset = off;
+      return next;
+    }
+
+    multicast_filter::multicast_filter(const char *static_groups)
+      : groups(0), suppressed_frames(0), suppressed_bytes(0)
+    {
+      std::string list(static_groups ? static_groups : "");
+      unsigned char addr[16];
+      size_t start = 0, end;
+      entry *e;
+
+      table.resize(MCAST_TABLE_SIZE);
+      memset(&table[0], 0, MCAST_TABLE_SIZE * sizeof(entry));
+      for (int i = 0; i < 256; i++) {
+        flood_local[i] = true;
+      }
+      while (start <= list.size()) {
+        end = list.find(',', start);
+        if (end == std::string::npos) {
+          end = list.size();
+        }
+        std::string group = list.substr(start, end - start);
+        group.erase(0, group.find_first_not_of(" \t"));
+        group.erase(group.find_last_not_of(" \t") + 1);
+        start = end + 1;
+        if (group.empty()) {
+          continue;
+        }
+        if (group[0] == '!') {
+          group.erase(0, group.find_first_not_of(" \t", 1));
+          if (inet_pton(AF_INET, group.c_str(), addr) != 1 || addr[0] != 224 || addr[1] != 0 || addr[2] != 0) {
+            throw std::runtime_error(group + " is not a link-local multicast group\n");
+          }
+          flood_local[addr[3]] = false;
+          continue;
+        }
+        if (inet_pton(AF_INET, group.c_str(), addr + sizeof(v4_mapped)) == 1) {
+          memcpy(addr, v4_mapped, sizeof(v4_mapped));
+        }
+        else if (inet_pton(AF_INET6, group.c_str(), addr) != 1) {
+          throw std::runtime_error("Invalid static multicast group " + group + "\n");
+        }
+        if (!is_group(addr)) {
+          throw std::runtime_error(group + " is not a multicast group\n");
+        }
+        e = find(addr, true, 0);
+        if (e == NULL) {
+          throw std::runtime_error("Too many static multicast groups\n");
+        }
+        e->is_static = true;
+      }
+    }
+
+    uint64_t
+    multicast_filter::clock(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    multicast_filter::entry *
+    multicast_filter::find(const unsigned char *addr, bool insert, uint64_t now)
+    {
+      unsigned int index = hash(addr);
+      entry *e;
+
+      for (int probe = 0; probe < MCAST_TABLE_SIZE; probe++) {
+        e = &table[index];
+        if (!e->used) {
+          if (!insert) {
+            return NULL;
+          }
+          if (groups == MCAST_MAX_GROUPS) {
+            purge(now);
+            return groups == MCAST_MAX_GROUPS ? NULL : find(addr, true, now);
+          }
+          memset(e, 0, sizeof(entry));
+          memcpy(e->addr, addr, sizeof(e->addr));
+          e->used = true;
+          groups++;
+          return e;
+        }
+        if (memcmp(e->addr, addr, sizeof(e->addr)) == 0) {
+          return e;
+        }
+        index = (index + 1) & (MCAST_TABLE_SIZE - 1);
+      }
+      return NULL;
+    }
+
+    /* rehash the static and live groups, forgetting the rest */
+    void
+    multicast_filter::purge(uint64_t now)
+    {
+      std::vector<entry> old(MCAST_TABLE_SIZE);
+      entry *e;
+
+      memset(&old[0], 0, MCAST_TABLE_SIZE * sizeof(entry));
+      table.swap(old);
+      groups = 0;
+      for (unsigned int i = 0; i < old.size(); i++) {
+        if (old[i].used && (old[i].is_static || old[i].expires > now)) {
+          e = find(old[i].addr, true, now);
+          *e = old[i];
+        }
+      }
+    }
+
+    void
+    multicast_filter::update(const unsigned char *addr, bool join, uint64_t now)
+    {
+      entry *e;
+
+      if (!is_group(addr)) {
+        return;
+      }
+      e = find(addr, join, now);
+      if (e == NULL || e->is_static) {
+        return;
+      }
+      if (join) {
+        e->expires = now + (uint64_t)MCAST_MEMBERSHIP_TIMEOUT * 1000000;
+      }
+      else if (e->expires > now + (uint64_t)MCAST_LEAVE_TIMEOUT * 1000000) {
+        e->expires = now + (uint64_t)MCAST_LEAVE_TIMEOUT * 1000000;
+      }
+    }
+
+    bool
+    multicast_filter::snoop_igmp(const unsigned char *igmp, unsigned int len, uint64_t now)
+    {
+      unsigned char addr[16];
+      unsigned int records, offset, sources;
+      int type;
+
+      if (len < 8) {
+        return false;
+      }
+      switch (igmp[0]) {
+        case 0x12:    /* v1 report */
+        case 0x16:    /* v2 report */
+          map_v4(igmp + 4, addr);
+          update(addr, true, now);
+          return true;
+        case 0x17:    /* v2 leave */
+          map_v4(igmp + 4, addr);
+          update(addr, false, now);
+          return true;
+        case 0x22:    /* v3 report */
+          records = (igmp[6] << 8) | igmp[7];
+          offset = 8;
+          for (unsigned int i = 0; i < records && offset + 8 <= len; i++) {
+            type = igmp[offset];
+            sources = (igmp[offset + 2] << 8) | igmp[offset + 3];
+            map_v4(igmp + offset + 4, addr);
+            if ((type == 1 || type == 3) && sources == 0) {
+              update(addr, false, now);
+            }
+            else if (type != 6) {
+              update(addr, true, now);
+            }
+            offset += 8 + 4 * sources + 4 * igmp[offset + 1];
+          }
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    bool
+    multicast_filter::snoop_mld(const unsigned char *mld, unsigned int len, uint64_t now)
+    {
+      unsigned int records, offset, sources;
+      int type;
+
+      if (len < 24 && mld[0] != 143) {
+        return false;
+      }
+      switch (mld[0]) {
+        case 131:    /* v1 report */
+          update(mld + 8, true, now);
+          return true;
+        case 132:    /* v1 done */
+          update(mld + 8, false, now);
+          return true;
+        case 143:    /* v2 report */
+          if (len < 8) {
+            return false;
+          }
+          records = (mld[6] << 8) | mld[7];
+          offset = 8;
+          for (unsigned int i = 0; i < records && offset + 20 <= len; i++) {
+            type = mld[offset];
+            sources = (mld[offset + 2] << 8) | mld[offset + 3];
+            if ((type == 1 || type == 3) && sources == 0) {
+              update(mld + offset + 4, false, now);
+            }
+            else if (type != 6) {
+              update(mld + offset + 4, true, now);
+            }
+            offset += 20 + 16 * sources + 4 * mld[offset + 1];
+          }
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    bool
+    multicast_filter::snoop(const unsigned char *frame, unsigned int len, uint64_t now)
+    {
+      const unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned int ip_len, header_len, offset;
+      int type;
+
+      if (len < sizeof(struct ether_header) + 20) {
+        return false;
+      }
+      type = (frame[12] << 8) | frame[13];
+      len -= sizeof(struct ether_header);
+      if (type == ETHERTYPE_IP && (ip[0] >> 4) == 4 && ip[9] == IPPROTO_IGMP_) {
+        header_len = (ip[0] & 0xf) * 4;
+        ip_len = (ip[2] << 8) | ip[3];
+        if (ip_len > len) {
+          ip_len = len;
+        }
+        if (header_len < 20 || header_len > ip_len) {
+          return false;
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        return snoop_igmp(ip + header_len, ip_len - header_len, now);
+      }
+      if (type == ETHERTYPE_IPV6 && len >= IPV6_HEADER_SIZE && (ip[0] >> 4) == 6) {
+        ip_len = IPV6_HEADER_SIZE + ((ip[4] << 8) | ip[5]);
+        if (ip_len > len) {
+          ip_len = len;
+        }
+        if (ipv6_upper(ip, ip_len, &offset) != IPPROTO_ICMPV6 || offset >= ip_len) {
+          return false;
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        return snoop_mld(ip + offset, ip_len - offset, now);
+      }
+      return false;
+    }
+
+    bool
+    multicast_filter::admit(const unsigned char *frame, unsigned int len, uint64_t now)
+    {
+      const unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned char addr[16];
+      unsigned int offset;
+      entry *e;
+      int type, upper;
+
+      /* unicast and broadcast */
+      if (len < sizeof(struct ether_header) + 20 || !(frame[0] & 0x01) ||
+          memcmp(frame, "\xff\xff\xff\xff\xff\xff", ETHER_ADDR_LEN) == 0) {
+        return true;
+      }
+      type = (frame[12] << 8) | frame[13];
+      if (type == ETHERTYPE_IP && (ip[0] >> 4) == 4) {
+        if ((ip[16] & 0xf0) != 0xe0 || ip[9] == IPPROTO_IGMP_) {
+          return true;
+        }
+        /* link-local, all hosts and the routing protocols, never reported */
+        if (ip[16] == 224 && ip[17] == 0 && ip[18] == 0 && flood_local[ip[19]]) {
+          return true;
+        }
+        map_v4(ip + 16, addr);
+      }
+      else if (type == ETHERTYPE_IPV6 && len >= sizeof(struct ether_header) + IPV6_HEADER_SIZE && (ip[0] >> 4) == 6) {
+        if (ip[24] != 0xff || memcmp(ip + 24, all_nodes, sizeof(all_nodes)) == 0) {
+          return true;
+        }
+        upper = ipv6_upper(ip, len - sizeof(struct ether_header), &offset);
+        if (upper == IPPROTO_ICMPV6 && offset < len - sizeof(struct ether_header) &&
+            (ip[offset] == 130 || ip[offset] == 131 || ip[offset] == 132 || ip[offset] == 143)) {
+          return true;
+        }
+        memcpy(addr, ip + 24, sizeof(addr));
+      }
+      else {
+        return true;
+      }
+
+      boost::mutex::scoped_lock lock(mutex);
+      e = find(addr, false, now);
+      if (e && (e->is_static || e->expires > now)) {
+        e->frames++;
+        e->bytes += len;
+        return true;
+      }
+      suppressed_frames++;
+      suppressed_bytes += len;
+      return false;
+    }
+
+    std::vector<multicast_group>
+    multicast_filter::get_groups(void)
+    {
+      std::vector<multicast_group> result;
+      multicast_group group;
+      char text[INET6_ADDRSTRLEN];
+      uint64_t now = clock();
+
+      boost::mutex::scoped_lock lock(mutex);
+      for (unsigned int i = 0; i < table.size(); i++) {
+        const entry &e = table[i];
+        if (!e.used) {
+          continue;
+        }
+        if (is_v4(e.addr)) {
+          inet_ntop(AF_INET, e.addr + sizeof(v4_mapped), text, sizeof(text));
+        }
+        else {
+          inet_ntop(AF_INET6, e.addr, text, sizeof(text));
+        }
+        group.address = text;
+        group.frames = e.frames;
+        group.bytes = e.bytes;
+        group.is_static = e.is_static;
+        group.active = e.is_static || e.expires > now;
+        result.push_back(group);
+      }
+      return result;
+    }
+
+    uint64_t
+    multicast_filter::get_suppressed_frames(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return suppressed_frames;
+    }
+
+    uint64_t
+    multicast_filter::get_suppressed_bytes(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return suppressed_bytes;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_MULTICAST_FILTER_H
+#define INCLUDED_ULE_MULTICAST_FILTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#define MCAST_MAX_GROUPS 1024
+#define MCAST_TABLE_SIZE (2 * MCAST_MAX_GROUPS)
+#define MCAST_MEMBERSHIP_TIMEOUT 260    /* RFC 3376 group membership interval, s */
+#define MCAST_LEAVE_TIMEOUT 2           /* last member query time, s */
+/*
+ * "icmp6" only matches ICMPv6 right after the IPv6 header, and every
+ * MLD report sits behind a hop-by-hop Router Alert (RFC 3810 5), so
+ * ICMPv6 after a hop-by-hop header is matched as well. This stays a
+ * fixed offset test the kernel can run, where protochain is not.
+ */
+#define MCAST_SNOOP_FILTER "igmp or icmp6 or (ip6 and ip6[6] == 0 and ip6[40] == 58)"
+
+namespace gr {
+  namespace ule {
+
+    struct multicast_group {
+      std::string address;
+      uint64_t frames;
+      uint64_t bytes;
+      bool is_static;
+      bool active;
+    };
+
+    /*
+     * Group membership table fed by IGMPv1/v2/v3 and MLDv1/v2 reports
+     * snooped from the receivers, plus static groups that never
+     * expire. admit() passes unicast, broadcast, non-IP and membership
+     * traffic untouched, and the IPv4 link-local groups 224.0.0.0/24,
+     * which are never reported, to everyone (RFC 4541 2.1.2). Other
+     * IPv4 and IPv6 multicast only goes to groups with a live member,
+     * counting the frames and bytes of each.
+     * Without source tracking an include report with no sources is a
+     * leave and any other record a join. A leave only shortens the
+     * membership to the last member query time, so a receiver still
+     * in the group keeps it by answering the router's query.
+     *
+     * The table is open addressed, holds up to MCAST_MAX_GROUPS
+     * groups and drops expired ones when it fills. Groups are keyed
+     * as IPv6 addresses, IPv4 ones mapped into ::ffff:0:0/96. Times
+     * are CLOCK_MONOTONIC microseconds. Safe to call from several
+     * threads, unicast frames are admitted without taking the lock.
+     */
+    class multicast_filter
+    {
+     private:
+      struct entry {
+        unsigned char addr[16];
+        uint64_t expires;
+        uint64_t frames;
+        uint64_t bytes;
+        bool used;
+        bool is_static;
+      };
+      std::vector<entry> table;
+      bool flood_local[256];    /* by the last byte of 224.0.0.x */
+      unsigned int groups;
+      uint64_t suppressed_frames;
+      uint64_t suppressed_bytes;
+      boost::mutex mutex;
+      entry *find(const unsigned char *addr, bool insert, uint64_t now);
+      void purge(uint64_t now);
+      void update(const unsigned char *addr, bool join, uint64_t now);
+      bool snoop_igmp(const unsigned char *igmp, unsigned int len, uint64_t now);
+      bool snoop_mld(const unsigned char *mld, unsigned int len, uint64_t now);
+      static uint64_t clock(void);
+
+     public:
+      /*
+       * static_groups is a comma separated list of IPv4 and IPv6
+       * groups. A link-local group written as !group, for example
+       * !224.0.0.251 for mDNS, is not flooded but snooped like any
+       * other. Throws std::runtime_error on anything else.
+       */
+      multicast_filter(const char *static_groups);
+
+      /* Learn from a membership report or leave. Returns true if it was one. */
+      bool snoop(const unsigned char *frame, unsigned int len) { return snoop(frame, len, clock()); }
+      bool snoop(const unsigned char *frame, unsigned int len, uint64_t now);
+
+      /* Whether an Ethernet frame should be encapsulated. */
+      bool admit(const unsigned char *frame, unsigned int len) { return admit(frame, len, clock()); }
+      bool admit(const unsigned char *frame, unsigned int len, uint64_t now);
+
+      std::vector<multicast_group> get_groups(void);
+      uint64_t get_suppressed_frames(void);
+      uint64_t get_suppressed_bytes(void);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_MULTICAST_FILTER_H */
@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include "packet_pool.h"
+
+namespace gr {
+  namespace ule {
+
+    packet_pool::packet_pool(unsigned int count)
+      : count(count), head(0), available(0)
+    {
+      void *p;
+
+      if (count == 0 || count >= POOL_NONE) {
+        throw std::runtime_error("packet_pool: invalid buffer count\n");
+      }
+      if (posix_memalign(&p, POOL_CACHE_LINE, (size_t)count * sizeof(packet_desc)) != 0) {
+        throw std::bad_alloc();
+      }
+      descs = (packet_desc *)p;
+      if (posix_memalign(&p, POOL_CACHE_LINE, (size_t)count * POOL_BUFFER_SIZE) != 0) {
+        free(descs);
+        throw std::bad_alloc();
+      }
+      arena = (unsigned char *)p;
+
+      /* link the buffers in address order, the first one on top */
+      for (unsigned int i = 0; i < count; i++) {
+        packet_desc *d = new (&descs[i]) packet_desc;
+        d->pool = this;
+        d->buffer = &arena[(size_t)i * POOL_BUFFER_SIZE];
+        d->data = d->buffer + POOL_HEADROOM;
+        d->length = 0;
+        d->traffic_class = 0;
+        d->timestamp = 0;
+        d->next = NULL;
+        d->refs.store(0, boost::memory_order_relaxed);
+        d->index = i;
+        d->free_next.store(i + 1 < count ? i + 1 : POOL_NONE, boost::memory_order_relaxed);
+      }
+      available.store(count);
+      head.store(0);
+    }
+
+    packet_pool::~packet_pool()
+    {
+      for (unsigned int i = 0; i < count; i++) {
+        descs[i].~packet_desc();
+      }
+      free(arena);
+      free(descs);
+    }
+
+    /*
+     * The head word holds the index of the top buffer in its low half
+     * and a tag in its high half that every push and pop bumps, so a
+     * pop that raced with a pop and push of the same buffer fails its
+     * compare and exchange and retries.
+     */
+    packet_desc *
+    packet_pool::alloc(void)
+    {
+      uint64_t old_head = head.load(boost::memory_order_acquire);
+      uint64_t new_head;
+      uint32_t index;
+      packet_desc *d;
+
+      do {
+        index = (uint32_t)old_head;
+        if (index == POOL_NONE) {
+          return NULL;
+        }
+        new_head = ((old_head >> 32) + 1) << 32 | descs[index].free_next.load(boost::memory_order_relaxed);
+      } while (!head.compare_exchange_weak(old_head, new_head, boost::memory_order_acquire, boost::memory_order_acquire));
+      available.fetch_sub(1, boost::memory_order_relaxed);
+
+      d = &descs[index];
+      d->data = d->buffer + POOL_HEADROOM;
+      d->length = 0;
+      d->traffic_class = 0;
+      d->timestamp = 0;
+      d->next = NULL;
+      d->refs.store(1, boost::memory_order_relaxed);
+      return d;
+    }
+
+    void
+    packet_pool::push(packet_desc *desc)
+    {
+      uint64_t old_head = head.load(boost::memory_order_relaxed);
+      uint64_t new_head;
+
+      do {
+        desc->free_next.store((uint32_t)old_head, boost::memory_order_relaxed);
+        new_head = ((old_head >> 32) + 1) << 32 | desc->index;
+      } while (!head.compare_exchange_weak(old_head, new_head, boost::memory_order_release, boost::memory_order_relaxed));
+      available.fetch_add(1, boost::memory_order_relaxed);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_PACKET_POOL_H
+#define INCLUDED_ULE_PACKET_POOL_H
+
+#include <stdint.h>
+#include <boost/atomic.hpp>
+
+#define POOL_CACHE_LINE 64
+#define POOL_HEADROOM 64
+#define POOL_BUFFER_SIZE 4224
+#define POOL_NONE 0xffffffff
+
+namespace gr {
+  namespace ule {
+
+    class packet_pool;
+
+    /*
+     * Reference counted handle on one arena buffer. data and length
+     * describe the bytes in use, which start POOL_HEADROOM bytes into
+     * the buffer so headers can be pushed in front in place. timestamp
+     * is the CLOCK_MONOTONIC time in microseconds when the frame was
+     * queued, set by the queue, and traffic_class whatever class the
+     * classifier gave it. next links the descriptor into whichever
+     * queue holds it.
+     */
+    struct packet_desc {
+      unsigned char *data;
+      unsigned int length;
+      unsigned int traffic_class;
+      uint64_t timestamp;
+      packet_desc *next;
+      packet_pool *pool;
+      unsigned char *buffer;
+      boost::atomic<int> refs;
+      uint32_t index;
+      boost::atomic<uint32_t> free_next;
+
+      void ref(void) { refs.fetch_add(1, boost::memory_order_relaxed); }
+      void release(void);
+      unsigned int headroom(void) const { return data - buffer; }
+    } __attribute__((aligned(POOL_CACHE_LINE)));
+
+    /*
+     * Fixed arena of count buffers of POOL_BUFFER_SIZE bytes, each on
+     * its own cache lines, allocated once up front. Free buffers sit on
+     * a lock-free LIFO (a Treiber stack with a generation tag against
+     * ABA), so alloc() and release() can be called from any thread and
+     * never touch the heap. The most recently freed, cache warm buffer
+     * is reused first, and arena pages that are never needed are never
+     * faulted in.
+     */
+    class packet_pool
+    {
+     private:
+      packet_desc *descs;
+      unsigned char *arena;
+      unsigned int count;
+      boost::atomic<uint64_t> head;
+      boost::atomic<unsigned int> available;
+      void push(packet_desc *desc);
+
+      friend struct packet_desc;
+
+     public:
+      packet_pool(unsigned int count);
+      ~packet_pool();
+
+      /*
+       * Take a buffer with one reference, empty and with the full
+       * headroom in front. Returns NULL if the pool is exhausted.
+       */
+      packet_desc *alloc(void);
+      unsigned int size(void) const { return count; }
+      unsigned int free_count(void) const { return available.load(boost::memory_order_relaxed); }
+    };
+
+    inline void
+    packet_desc::release(void)
+    {
+      if (refs.fetch_sub(1, boost::memory_order_release) == 1) {
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        pool->push(this);
+      }
+    }
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_PACKET_POOL_H */
@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "packet_queue.h"
+
+namespace gr {
+  namespace ule {
+
+    packet_queue::packet_queue(unsigned int limit)
+      : head(NULL), tail(NULL), count(0), limit(limit), drops(0)
+    {
+    }
+
+    packet_queue::~packet_queue()
+    {
+      packet_desc *desc;
+
+      while ((desc = next_packet()) != NULL) {
+        desc->release();
+      }
+    }
+
+    bool
+    packet_queue::push(packet_desc *desc)
+    {
+      if (count >= limit) {
+        desc->release();
+        drops++;
+        return false;
+      }
+      desc->next = NULL;
+      if (tail) {
+        tail->next = desc;
+      }
+      else {
+        head = desc;
+      }
+      tail = desc;
+      count++;
+      return true;
+    }
+
+    packet_desc *
+    packet_queue::next_packet(void)
+    {
+      packet_desc *desc = head;
+
+      if (desc == NULL) {
+        return NULL;
+      }
+      head = desc->next;
+      if (head == NULL) {
+        tail = NULL;
+      }
+      desc->next = NULL;
+      count--;
+      return desc;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
+
@@ -0,0 +1,56 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_PACKET_QUEUE_H
+#define INCLUDED_ULE_PACKET_QUEUE_H
+
+#include "ts_packetizer.h"
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Bounded FIFO of pool descriptors, chained through their next
+     * pointers. push() takes over the caller's reference, and
+     * next_packet() hands it on to the packetizer.
+     */
+    class packet_queue : public packet_source
+    {
+     private:
+      packet_desc *head;
+      packet_desc *tail;
+      unsigned int count;
+      unsigned int limit;
+      uint64_t drops;
+
+     public:
+      packet_queue(unsigned int limit);
+      ~packet_queue();
+
+      bool push(packet_desc *desc);
+      packet_desc *next_packet(void);
+      unsigned int size(void) const { return count; }
+      uint64_t get_drops(void) const { return drops; }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_PACKET_QUEUE_H */
@@ -0,0 +1,47 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_PACKET_SOURCE_H
+#define INCLUDED_ULE_PACKET_SOURCE_H
+
+#include <pcap.h>
+#include "packet_pool.h"
+
+#define ULE_MAX_FRAME_SIZE 4110
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Anything that can hand Ethernet frames to the packetizer. Each
+     * frame comes in a pool descriptor whose reference passes to the
+     * caller, who releases it when done.
+     */
+    class packet_source
+    {
+     public:
+      virtual ~packet_source() {}
+      virtual packet_desc *next_packet(void) = 0;
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_PACKET_SOURCE_H */
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include "pcap_capture.h"
+
+namespace gr {
+  namespace ule {
+
+    pcap_t *
+    open_capture(const char *device, const char *mac_address, int timeout)
+    {
+      char errbuf[PCAP_ERRBUF_SIZE];
+      std::string filter;
+      pcap_t* descr;
+
+      if (strlen(device) >= IFNAMSIZ) {
+        throw std::runtime_error("Interface name too long\n");
+      }
+      descr = pcap_create(device, errbuf);
+      if (descr == NULL) {
+        std::stringstream s;
+        s << "Error calling pcap_create(): " << errbuf << std::endl;
+        throw std::runtime_error(s.str());
+      }
+      if (pcap_set_promisc(descr, 0) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_set_promisc()\n");
+      }
+      if (pcap_set_timeout(descr, timeout) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_set_timeout()\n");
+      }
+      if (timeout >= 0 && pcap_set_immediate_mode(descr, 1) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_set_immediate_mode()\n");
+      }
+      if (pcap_set_snaplen(descr, 65536) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_set_snaplen()\n");
+      }
+      if (pcap_set_buffer_size(descr, 1024 * 1024 * 16) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_set_buffer_size()\n");
+      }
+      if (pcap_activate(descr) != 0) {
+        pcap_close(descr);
+        throw std::runtime_error("Error calling pcap_activate()\n");
+      }
+      filter = FILTER;
+      filter += mac_address;
+      try {
+        set_capture_filter(descr, filter.c_str());
+      }
+      catch (...) {
+        pcap_close(descr);
+        throw;
+      }
+
+      return descr;
+    }
+
+    void
+    check_capture_filter(const char *filter)
+    {
+      struct bpf_program fp;
+      pcap_t *dead;
+      int rc;
+
+      dead = pcap_open_dead(DLT_EN10MB, 65536);
+      if (dead == NULL) {
+        throw std::runtime_error("Error calling pcap_open_dead()\n");
+      }
+      rc = pcap_compile(dead, &fp, filter, 0, 0);
+      if (rc == 0) {
+        pcap_freecode(&fp);
+      }
+      pcap_close(dead);
+      if (rc == -1) {
+        throw std::runtime_error("Invalid capture filter\n");
+      }
+    }
+
+    void
+    set_capture_filter(pcap_t *descr, const char *filter)
+    {
+      struct bpf_program fp;
+      bpf_u_int32 netp = 0;
+      int rc;
+
+      if (pcap_compile(descr, &fp, filter, 0, netp) == -1) {
+        throw std::runtime_error("Error calling pcap_compile()\n");
+      }
+      rc = pcap_setfilter(descr, &fp);
+      pcap_freecode(&fp);
+      if (rc == -1) {
+        throw std::runtime_error("Error calling pcap_setfilter()\n");
+      }
+    }
+
+    void
+    join_fanout(pcap_t *descr, int group, ule_fanout_t mode)
+    {
+      int fanout;
+
+      if (mode == FANOUT_CPU) {
+        fanout = PACKET_FANOUT_CPU << 16;
+      }
+      else {
+        /* reassemble fragments first so they hash with their flow */
+        fanout = (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16;
+      }
+      fanout |= group & 0xffff;
+      if (setsockopt(pcap_fileno(descr), SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0) {
+        throw std::runtime_error("Error calling setsockopt(PACKET_FANOUT)\n");
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
+
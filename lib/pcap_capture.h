@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_ULE_PCAP_CAPTURE_H
+#define INCLUDED_ULE_PCAP_CAPTURE_H
+
+#include <ule/ule_config.h>
+#include <pcap.h>
+
+#define DEFAULT_IF "dvb0_0"
+#define FILTER "ether src "
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Open a capture handle on device that passes only the frames
+     * sent by mac_address. A timeout of -1 gives the non-blocking
+     * handle polled from work(), otherwise the handle blocks for at
+     * most timeout milliseconds and delivers frames immediately.
+     * Throws std::runtime_error on failure.
+     */
+    pcap_t *open_capture(const char *device, const char *mac_address, int timeout);
+
+    /*
+     * Replace the BPF filter on an open capture handle. The old
+     * filter stays in place if the expression does not compile.
+     */
+    void set_capture_filter(pcap_t *descr, const char *filter);
+
+    /*
+     * Compile filter for an Ethernet link without a capture handle.
+     * Throws std::runtime_error if it does not compile.
+     */
+    void check_capture_filter(const char *filter);
+
+    /*
+     * Add the socket behind an open capture handle to PACKET_FANOUT
+     * group, which spreads the frames of one interface over every
+     * handle in the group by flow hash or by receiving CPU. Throws
+     * std::runtime_error on failure.
+     */
+    void join_fanout(pcap_t *descr, int group, ule_fanout_t mode);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_PCAP_CAPTURE_H */
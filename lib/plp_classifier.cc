@@ -0,0 +1,192 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <boost/weak_ptr.hpp>
+#include "plp_classifier.h"
+
+namespace gr {
+  namespace ule {
+
+    static boost::mutex registry_mutex;
+    static std::map<std::string, boost::weak_ptr<plp_classifier> > registry;
+
+    plp_classifier::plp_classifier(int num_plps, const std::vector<int> &class_map)
+      : num_plps(num_plps), descr(NULL), capture_running(false), users(0)
+    {
+      if (num_plps < 1) {
+        throw std::runtime_error("ule_plp_source: at least one PLP is required\n");
+      }
+      for (int i = 0; i < NUM_TRAFFIC_CLASSES; i++) {
+        plp_map[i] = i < (int)class_map.size() ? class_map[i] : 0;
+        if (plp_map[i] < 0 || plp_map[i] >= num_plps) {
+          throw std::runtime_error("ule_plp_source: class map names a PLP that does not exist\n");
+        }
+      }
+      /* every queue full, each packetizer holding one and one in hand */
+      pool = new packet_pool(num_plps * (PLP_QUEUE_LIMIT + 1) + 1);
+      for (int i = 0; i < num_plps; i++) {
+        queues.push_back(new packet_queue(PLP_QUEUE_LIMIT));
+        sources.push_back(new plp_queue(this, i));
+      }
+    }
+
+    plp_classifier::~plp_classifier()
+    {
+      if (capture_running) {
+        capture_running = false;
+        capture_thread.join();
+      }
+      if (descr) {
+        pcap_close(descr);
+      }
+      for (int i = 0; i < num_plps; i++) {
+        delete sources[i];
+        delete queues[i];
+      }
+      delete pool;
+    }
+
+    boost::shared_ptr<plp_classifier>
+    plp_classifier::attach(const char *device, const char *mac_address, int num_plps, const std::vector<int> &class_map)
+    {
+      boost::mutex::scoped_lock lock(registry_mutex);
+      boost::shared_ptr<plp_classifier> classifier(new plp_classifier(num_plps, class_map));
+      boost::shared_ptr<plp_classifier> shared = registry[device].lock();
+
+      if (shared) {
+        if (shared->num_plps != num_plps || memcmp(shared->plp_map, classifier->plp_map, sizeof(plp_map)) != 0) {
+          throw std::runtime_error("ule_plp_source: PLP sources on one interface need the same PLP count and class map\n");
+        }
+        return shared;
+      }
+      classifier->descr = open_capture(device, mac_address, PLP_CAPTURE_TIMEOUT);
+      registry[device] = classifier;
+      return classifier;
+    }
+
+    unsigned int
+    plp_classifier::classify(const unsigned char *packet, unsigned int len)
+    {
+      const struct ether_header *eptr = (const struct ether_header *)packet;
+      const unsigned char *ip = packet + sizeof(struct ether_header);
+      unsigned int traffic_class = 0;
+
+      if (len < sizeof(struct ether_header) + 2) {
+        return 0;
+      }
+      switch (ntohs(eptr->ether_type)) {
+        case ETHERTYPE_IP:
+          traffic_class = ip[1] >> 5;
+          break;
+        case ETHERTYPE_IPV6:
+          traffic_class = (ip[0] & 0x0f) >> 1;
+          break;
+        default:
+          break;
+      }
+      return traffic_class;
+    }
+
+    bool
+    plp_classifier::enqueue(const unsigned char *packet, unsigned int len)
+    {
+      packet_desc *desc;
+
+      if (len > ULE_MAX_FRAME_SIZE) {
+        return false;
+      }
+      desc = pool->alloc();
+      if (desc == NULL) {
+        return false;
+      }
+      memcpy(desc->data, packet, len);
+      desc->length = len;
+      desc->traffic_class = classify(packet, len);
+
+      boost::mutex::scoped_lock lock(queue_mutex);
+      return queues[plp_map[desc->traffic_class]]->push(desc);
+    }
+
+    packet_desc *
+    plp_classifier::next_packet(int plp)
+    {
+      boost::mutex::scoped_lock lock(queue_mutex);
+      return queues[plp]->next_packet();
+    }
+
+    unsigned int
+    plp_classifier::queued(int plp)
+    {
+      boost::mutex::scoped_lock lock(queue_mutex);
+      return queues[plp]->size();
+    }
+
+    uint64_t
+    plp_classifier::get_drops(int plp)
+    {
+      boost::mutex::scoped_lock lock(queue_mutex);
+      return queues[plp]->get_drops();
+    }
+
+    void
+    plp_classifier::capture_loop(void)
+    {
+      struct pcap_pkthdr *hdr;
+      const unsigned char *packet;
+      int rc;
+
+      while (capture_running) {
+        rc = pcap_next_ex(descr, &hdr, &packet);
+        if (rc == 1) {
+          enqueue(packet, hdr->caplen);
+        }
+        else if (rc < 0) {
+          break;
+        }
+      }
+    }
+
+    void
+    plp_classifier::start(void)
+    {
+      boost::mutex::scoped_lock lock(registry_mutex);
+
+      if (users++ == 0 && descr) {
+        capture_running = true;
+        capture_thread = boost::thread(boost::bind(&plp_classifier::capture_loop, this));
+      }
+    }
+
+    void
+    plp_classifier::stop(void)
+    {
+      boost::mutex::scoped_lock lock(registry_mutex);
+
+      if (users > 0 && --users == 0 && capture_running) {
+        capture_running = false;
+        capture_thread.join();
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,115 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_PLP_CLASSIFIER_H
+#define INCLUDED_ULE_PLP_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include "packet_queue.h"
+#include "pcap_capture.h"
+
+#define NUM_TRAFFIC_CLASSES 8
+#define PLP_QUEUE_LIMIT 1000
+#define PLP_CAPTURE_TIMEOUT 100
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Capture and queues shared by the PLP sources of one interface.
+     * A capture thread sorts the frames by IP precedence into one
+     * bounded queue per PLP, and each PLP source drains only its own
+     * queue, so a PLP whose output backs up drops from its own queue
+     * and never holds up another.
+     */
+    class plp_classifier
+    {
+     private:
+      class plp_queue : public packet_source
+      {
+       private:
+        plp_classifier *owner;
+        int plp;
+
+       public:
+        plp_queue(plp_classifier *owner, int plp) : owner(owner), plp(plp) {}
+        packet_desc *next_packet(void) { return owner->next_packet(plp); }
+      };
+
+      int num_plps;
+      int plp_map[NUM_TRAFFIC_CLASSES];
+      packet_pool *pool;
+      std::vector<packet_queue *> queues;
+      std::vector<plp_queue *> sources;
+      boost::mutex queue_mutex;
+      pcap_t *descr;
+      boost::thread capture_thread;
+      boost::atomic<bool> capture_running;
+      int users;
+      void capture_loop(void);
+
+     public:
+      /*
+       * Route class c to class_map[c], or PLP 0 where the map is
+       * short. Throws std::runtime_error if num_plps is below 1 or
+       * an entry names a PLP that does not exist.
+       */
+      plp_classifier(int num_plps, const std::vector<int> &class_map);
+      ~plp_classifier();
+
+      /*
+       * The classifier for device, created with a capture of the
+       * frames from mac_address on first use and shared by every
+       * later caller. Throws std::runtime_error if the capture cannot
+       * be opened or the PLP layout differs from the shared one.
+       */
+      static boost::shared_ptr<plp_classifier> attach(const char *device, const char *mac_address, int num_plps, const std::vector<int> &class_map);
+
+      /* IP precedence, or the top bits of the IPv6 traffic class */
+      static unsigned int classify(const unsigned char *packet, unsigned int len);
+      int get_plp(unsigned int traffic_class) const { return plp_map[traffic_class]; }
+      int get_num_plps(void) const { return num_plps; }
+
+      /*
+       * Copy a frame into the queue of its PLP. Returns false if it
+       * was dropped, too long or with the pool or queue full.
+       */
+      bool enqueue(const unsigned char *packet, unsigned int len);
+      packet_desc *next_packet(int plp);
+      packet_source *get_source(int plp) { return sources[plp]; }
+      unsigned int queued(int plp);
+      uint64_t get_drops(int plp);
+
+      /*
+       * The capture thread runs from the first start() to the last
+       * stop(), one pair per PLP source.
+       */
+      void start(void);
+      void stop(void);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_PLP_CLASSIFIER_H */
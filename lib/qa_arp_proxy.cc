@@ -0,0 +1,200 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include "qa_arp_proxy.h"
+#include "arp_proxy.h"
+
+#define SECOND 1000000ULL
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char router_mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    static const unsigned char remote_mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+    static unsigned int
+    arp_frame(unsigned char *frame, int op, const unsigned char *sender_mac, const char *sender, const char *target)
+    {
+      memset(frame, 0, 60);
+      memset(frame, 0xff, 6);
+      memcpy(frame + 6, sender_mac, 6);
+      frame[12] = 0x08;
+      frame[13] = 0x06;
+      frame[15] = 1;
+      frame[16] = 0x08;
+      frame[18] = 6;
+      frame[19] = 4;
+      frame[21] = op;
+      memcpy(frame + 22, sender_mac, 6);
+      inet_pton(AF_INET, sender, frame + 28);
+      inet_pton(AF_INET, target, frame + 38);
+      return 60;
+    }
+
+    /* solicitation or advertisement with a link layer address option */
+    static unsigned int
+    nd_frame(unsigned char *frame, int type, const unsigned char *sender_mac, const char *sender, const char *target)
+    {
+      memset(frame, 0, 86);
+      frame[0] = 0x33;
+      frame[1] = 0x33;
+      frame[2] = 0xff;
+      memcpy(frame + 6, sender_mac, 6);
+      frame[12] = 0x86;
+      frame[13] = 0xdd;
+      frame[14] = 0x60;
+      frame[19] = 32;
+      frame[20] = 58;
+      frame[21] = 255;
+      inet_pton(AF_INET6, sender, frame + 22);
+      inet_pton(AF_INET6, "ff02::1:ff00:2", frame + 38);
+      frame[54] = type;
+      inet_pton(AF_INET6, target, frame + 62);
+      frame[78] = type == 135 ? 1 : 2;
+      frame[79] = 1;
+      memcpy(frame + 80, sender_mac, 6);
+      return 86;
+    }
+
+    static unsigned int
+    icmpv6_sum(const unsigned char *frame, unsigned int len)
+    {
+      uint32_t sum = 58 + len - 54;
+
+      for (unsigned int i = 22; i < 54; i += 2) {
+        sum += (frame[i] << 8) | frame[i + 1];
+      }
+      for (unsigned int i = 54; i < len; i += 2) {
+        sum += (frame[i] << 8) | frame[i + 1];
+      }
+      while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+      }
+      return sum;
+    }
+
+    void
+    qa_arp_proxy::t1_arp()
+    {
+      arp_proxy proxy("10.0.0.2=02:00:00:00:00:02");
+      unsigned char frame[128], reply[ARP_REPLY_SIZE];
+      unsigned int len, reply_len = 0;
+      uint64_t now = 1000 * SECOND;
+
+      /* a remote host is answered locally */
+      len = arp_frame(frame, 1, router_mac, "10.0.0.1", "10.0.0.2");
+      CPPUNIT_ASSERT_EQUAL(ARP_REPLY, proxy.handle(frame, len, reply, &reply_len, now));
+      CPPUNIT_ASSERT_EQUAL(60u, reply_len);
+      CPPUNIT_ASSERT(memcmp(reply, router_mac, 6) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 6, remote_mac, 6) == 0);
+      CPPUNIT_ASSERT_EQUAL(2, (int)reply[21]);
+      CPPUNIT_ASSERT(memcmp(reply + 22, remote_mac, 6) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 28, frame + 38, 4) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 32, router_mac, 6) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 38, frame + 28, 4) == 0);
+
+      /* without a reply buffer it crosses the link */
+      CPPUNIT_ASSERT_EQUAL(ARP_PASS, proxy.handle(frame, len, NULL, NULL, now));
+
+      /* the router is local now, asking for it stays off the link */
+      len = arp_frame(frame, 1, remote_mac, "10.0.0.3", "10.0.0.1");
+      CPPUNIT_ASSERT_EQUAL(ARP_DROP, proxy.handle(frame, len, reply, &reply_len, now));
+
+      /* learnt remote hosts expire */
+      len = arp_frame(frame, 2, remote_mac, "10.0.0.9", "10.0.0.1");
+      CPPUNIT_ASSERT(proxy.learn(frame, len, now));
+      len = arp_frame(frame, 1, router_mac, "10.0.0.1", "10.0.0.9");
+      CPPUNIT_ASSERT_EQUAL(ARP_REPLY, proxy.handle(frame, len, reply, &reply_len, now));
+      CPPUNIT_ASSERT_EQUAL(ARP_PASS, proxy.handle(frame, len, reply, &reply_len, now + (ARP_ENTRY_TIMEOUT + 1) * SECOND));
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, proxy.get_answered());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, proxy.get_dropped());
+      CPPUNIT_ASSERT_THROW(arp_proxy("10.0.0.2"), std::runtime_error);
+      CPPUNIT_ASSERT_THROW(arp_proxy("10.0.0=02:00:00:00:00:02"), std::runtime_error);
+    }
+
+    void
+    qa_arp_proxy::t2_neighbour()
+    {
+      arp_proxy proxy("");
+      unsigned char frame[128], reply[ARP_REPLY_SIZE];
+      unsigned int len, reply_len = 0;
+      uint64_t now = 1000 * SECOND;
+
+      len = nd_frame(frame, 136, remote_mac, "fe80::2", "2001:db8::2");
+      CPPUNIT_ASSERT(proxy.learn(frame, len, now));
+      len = nd_frame(frame, 135, router_mac, "2001:db8::1", "2001:db8::2");
+      CPPUNIT_ASSERT_EQUAL(ARP_REPLY, proxy.handle(frame, len, reply, &reply_len, now));
+      CPPUNIT_ASSERT_EQUAL(86u, reply_len);
+      CPPUNIT_ASSERT(memcmp(reply, router_mac, 6) == 0);
+      CPPUNIT_ASSERT_EQUAL(136, (int)reply[54]);
+      CPPUNIT_ASSERT_EQUAL(0x60, (int)reply[58]);
+      CPPUNIT_ASSERT(memcmp(reply + 22, frame + 62, 16) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 38, frame + 22, 16) == 0);
+      CPPUNIT_ASSERT(memcmp(reply + 80, remote_mac, 6) == 0);
+      CPPUNIT_ASSERT_EQUAL(0xffffu, icmpv6_sum(reply, reply_len));
+
+      /* the router learnt from its solicitation is local */
+      len = nd_frame(frame, 135, remote_mac, "2001:db8::5", "2001:db8::1");
+      CPPUNIT_ASSERT_EQUAL(ARP_DROP, proxy.handle(frame, len, reply, &reply_len, now));
+
+      /* other ICMPv6 is not resolution traffic */
+      frame[54] = 128;
+      CPPUNIT_ASSERT_EQUAL(ARP_PASS, proxy.handle(frame, len, reply, &reply_len, now));
+      CPPUNIT_ASSERT(!proxy.learn(frame, len, now));
+
+      std::vector<arp_neighbour> neighbours = proxy.get_neighbours(now);
+      CPPUNIT_ASSERT_EQUAL((size_t)3, neighbours.size());
+      for (unsigned int i = 0; i < neighbours.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(neighbours[i].address == "2001:db8::2", neighbours[i].remote);
+      }
+    }
+
+    void
+    qa_arp_proxy::t3_rate_limit()
+    {
+      arp_proxy proxy(NULL);
+      unsigned char frame[128];
+      unsigned int len, passed = 0;
+      uint64_t now = 1000 * SECOND;
+
+      len = arp_frame(frame, 1, router_mac, "10.0.0.1", "10.0.0.7");
+      for (int i = 0; i < 100; i++) {
+        if (proxy.handle(frame, len, NULL, NULL, now) == ARP_PASS) {
+          passed++;
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL((unsigned int)ARP_PASS_BURST, passed);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)(100 - ARP_PASS_BURST), proxy.get_limited());
+      for (int i = 0; i < 100; i++) {
+        if (proxy.handle(frame, len, NULL, NULL, now + SECOND) == ARP_PASS) {
+          passed++;
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL((unsigned int)(ARP_PASS_BURST + ARP_PASS_RATE), passed);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,444 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include "qa_fq_codel.h"
+#include "fq_codel.h"
+#include "traffic_generator.h"
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char dst_mac[ETHER_ADDR_LEN] = {0x02, 0x00, 0x48, 0x55, 0x4c, 0x45};
+
+    static void
+    put32(unsigned char *p, uint32_t value)
+    {
+      p[0] = value >> 24;
+      p[1] = value >> 16;
+      p[2] = value >> 8;
+      p[3] = value;
+    }
+
+    static uint32_t
+    get32(const unsigned char *p)
+    {
+      return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+
+    /* IPv4 TCP segment of one connection, with an optional SACK block */
+    static packet_desc *
+    tcp_segment(packet_pool &pool, uint32_t ack, int flags, uint32_t sack_left, uint32_t sack_right)
+    {
+      packet_desc *desc = pool.alloc();
+      unsigned char *ip = desc->data + sizeof(struct ether_header);
+      unsigned char *tcp = ip + 20;
+      unsigned int tcp_length = sack_right ? 32 : 20;
+
+      memset(desc->data, 0, 64);
+      memcpy(desc->data, dst_mac, ETHER_ADDR_LEN);
+      desc->data[12] = 0x08;
+      ip[0] = 0x45;
+      ip[3] = 20 + tcp_length;
+      ip[8] = 64;
+      ip[9] = IPPROTO_TCP;
+      ip[12] = 10;
+      ip[15] = 1;
+      ip[16] = 10;
+      ip[19] = 2;
+      tcp[0] = 0x40;
+      tcp[3] = 80;
+      put32(tcp + 8, ack);
+      tcp[12] = (tcp_length / 4) << 4;
+      tcp[13] = flags;
+      if (sack_right) {
+        tcp[20] = 1;
+        tcp[21] = 1;
+        tcp[22] = 5;
+        tcp[23] = 10;
+        put32(tcp + 24, sack_left);
+        put32(tcp + 28, sack_right);
+      }
+      desc->length = sizeof(struct ether_header) + 20 + tcp_length;
+      return desc;
+    }
+
+    /*
+     * IPv4 UDP frame of length bytes from source port port, with seq
+     * in the first payload byte and a valid header checksum.
+     */
+    static unsigned int
+    udp_frame(unsigned char *frame, int port, unsigned int length, int tos, int seq)
+    {
+      unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned char *udp = ip + 20;
+      unsigned int sum = 0;
+
+      memset(frame, 0, length);
+      memcpy(frame, dst_mac, ETHER_ADDR_LEN);
+      frame[12] = 0x08;
+      ip[0] = 0x45;
+      ip[1] = tos;
+      ip[2] = (length - sizeof(struct ether_header)) >> 8;
+      ip[3] = (length - sizeof(struct ether_header)) & 0xff;
+      ip[8] = 64;
+      ip[9] = IPPROTO_UDP;
+      ip[12] = 10;
+      ip[15] = 1;
+      ip[16] = 10;
+      ip[19] = 2;
+      udp[0] = port >> 8;
+      udp[1] = port & 0xff;
+      udp[3] = 53;
+      udp[4] = (length - sizeof(struct ether_header) - 20) >> 8;
+      udp[5] = (length - sizeof(struct ether_header) - 20) & 0xff;
+      udp[8] = seq;
+      for (int i = 0; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+      }
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum = (sum & 0xffff) + (sum >> 16);
+      ip[10] = (~sum >> 8) & 0xff;
+      ip[11] = ~sum & 0xff;
+      return length;
+    }
+
+    static packet_desc *
+    udp_frame(packet_pool &pool, int port, unsigned int length, int tos, int seq)
+    {
+      packet_desc *desc = pool.alloc();
+
+      desc->length = udp_frame(desc->data, port, length, tos, seq);
+      return desc;
+    }
+
+    static bool
+    ip_checksum_ok(const packet_desc *desc)
+    {
+      const unsigned char *ip = desc->data + sizeof(struct ether_header);
+      unsigned int sum = 0;
+
+      for (int i = 0; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+      }
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum = (sum & 0xffff) + (sum >> 16);
+      return sum == 0xffff;
+    }
+
+    static int
+    udp_port(const packet_desc *desc)
+    {
+      const unsigned char *udp = desc->data + sizeof(struct ether_header) + 20;
+
+      return (udp[0] << 8) | udp[1];
+    }
+
+    static int
+    udp_seq(const packet_desc *desc)
+    {
+      return desc->data[sizeof(struct ether_header) + 28];
+    }
+
+    static unsigned int
+    drain(fq_codel_queue &queue)
+    {
+      packet_desc *desc;
+      unsigned int count = 0;
+
+      while ((desc = queue.next_packet()) != NULL) {
+        desc->release();
+        count++;
+      }
+      return count;
+    }
+
+    /* a backlog of ACKs shrinks to the newest of each connection */
+    void
+    qa_fq_codel::t1_ack_thinning()
+    {
+      traffic_generator gen(TRAFFIC_ACK, 1000000, 4, 1514, 3, dst_mac);
+      packet_pool pool(1100);
+      fq_codel_queue queue(&pool, 0.0, 100.0, false);
+      std::map<uint32_t, uint32_t> last_ack, newest_ack;
+      unsigned char frame[GEN_MAX_FRAME];
+      unsigned int data_segments = 0, dequeued = 0, data_dequeued = 0;
+      struct pcap_pkthdr hdr;
+      packet_desc *desc;
+      uint32_t connection;
+      double due;
+
+      queue.set_ack_filter(true);
+      for (int i = 0; i < 1000; i++) {
+        hdr.len = hdr.caplen = gen.next_frame(frame, &due);
+        if (hdr.len > 66) {
+          data_segments++;
+        }
+        newest_ack[get32(frame + 34)] = get32(frame + 42);
+        queue.enqueue(&hdr, frame);
+      }
+      CPPUNIT_ASSERT(queue.get_ack_drops() > 0);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, queue.get_ack_drops() + queue.size());
+      while ((desc = queue.next_packet()) != NULL) {
+        connection = get32(desc->data + 34);
+        if (last_ack.count(connection)) {
+          CPPUNIT_ASSERT((int32_t)(get32(desc->data + 42) - last_ack[connection]) > 0);
+        }
+        last_ack[connection] = get32(desc->data + 42);
+        if (desc->length > 66) {
+          data_dequeued++;
+        }
+        dequeued++;
+        desc->release();
+      }
+      CPPUNIT_ASSERT_EQUAL(data_segments, data_dequeued);
+      CPPUNIT_ASSERT(dequeued < 1000 / 2);
+      CPPUNIT_ASSERT(last_ack == newest_ack);
+    }
+
+    void
+    qa_fq_codel::t2_ack_semantics()
+    {
+      packet_pool pool(16);
+      fq_codel_queue queue(&pool, 0.0, 100.0, false);
+
+      /* off by default */
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 0, 0));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(2u, drain(queue));
+
+      queue.set_ack_filter(true);
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 0, 0));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(1u, drain(queue));
+
+      /* duplicate ACKs drive fast retransmit */
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 0, 0));
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(2u, drain(queue));
+
+      /* a SACK block above the new ACK must be repeated */
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 3000, 4000));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(2u, drain(queue));
+      queue.enqueue(tcp_segment(pool, 1000, 0x10, 3000, 4000));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 3000, 5000));
+      CPPUNIT_ASSERT_EQUAL(1u, drain(queue));
+
+      /* ECE is only dropped when echoed again, SYN and FIN never */
+      queue.enqueue(tcp_segment(pool, 1000, 0x50, 0, 0));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(2u, drain(queue));
+      queue.enqueue(tcp_segment(pool, 1000, 0x50, 0, 0));
+      queue.enqueue(tcp_segment(pool, 2000, 0x50, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(1u, drain(queue));
+      queue.enqueue(tcp_segment(pool, 1000, 0x11, 0, 0));
+      queue.enqueue(tcp_segment(pool, 2000, 0x10, 0, 0));
+      queue.enqueue(tcp_segment(pool, 3000, 0x12, 0, 0));
+      CPPUNIT_ASSERT_EQUAL(3u, drain(queue));
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)3, queue.get_ack_drops());
+    }
+
+    /*
+     * One standing flow read a packet a millisecond with a 5 ms
+     * target and 100 ms interval. Nothing goes until the sojourn time
+     * has been above target for an interval, then the drops come at
+     * interval / sqrt(count) spacing.
+     */
+    void
+    qa_fq_codel::t3_codel_drop()
+    {
+      const uint64_t start = 1000000;
+      packet_pool pool(400);
+      fq_codel_queue queue(&pool, 5.0, 100.0, false);
+      std::vector<uint64_t> drop_times, expected;
+      packet_desc *desc;
+      uint64_t drops, t;
+
+      for (int i = 0; i < 400; i++) {
+        queue.enqueue(udp_frame(pool, 1000, 1000, 0, i & 0xff), start);
+      }
+      for (t = start + 10000; t < start + 380000; t += 1000) {
+        drops = queue.get_drops();
+        desc = queue.next_packet(t);
+        CPPUNIT_ASSERT(desc != NULL);
+        desc->release();
+        if (queue.get_drops() != drops) {
+          CPPUNIT_ASSERT_EQUAL(drops + 1, queue.get_drops());
+          drop_times.push_back(t - start);
+        }
+      }
+      /* 110 ms, then + 100, + 70.7 and + 57.7 rounded up to the next read */
+      expected.push_back(110000);
+      expected.push_back(210000);
+      expected.push_back(281000);
+      expected.push_back(339000);
+      CPPUNIT_ASSERT(drop_times == expected);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, queue.get_marks());
+      CPPUNIT_ASSERT_EQUAL(400u - 370u - 4u, queue.size());
+    }
+
+    /* the same flow sent ECT(0) is marked CE at the same times instead */
+    void
+    qa_fq_codel::t4_ecn_mark()
+    {
+      const uint64_t start = 1000000;
+      packet_pool pool(400);
+      fq_codel_queue queue(&pool, 5.0, 100.0, true);
+      std::vector<uint64_t> mark_times, expected;
+      packet_desc *desc;
+      uint64_t t;
+
+      for (int i = 0; i < 400; i++) {
+        queue.enqueue(udp_frame(pool, 1000, 1000, 0x02, i & 0xff), start);
+      }
+      for (t = start + 10000; t < start + 380000; t += 1000) {
+        desc = queue.next_packet(t);
+        CPPUNIT_ASSERT(desc != NULL);
+        CPPUNIT_ASSERT(ip_checksum_ok(desc));
+        if ((desc->data[sizeof(struct ether_header) + 1] & 0x3) == 0x3) {
+          mark_times.push_back(t - start);
+        }
+        else {
+          CPPUNIT_ASSERT_EQUAL(0x02, (int)desc->data[sizeof(struct ether_header) + 1]);
+        }
+        desc->release();
+      }
+      expected.push_back(110000);
+      expected.push_back(210000);
+      expected.push_back(281000);
+      expected.push_back(339000);
+      CPPUNIT_ASSERT(mark_times == expected);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4, queue.get_marks());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, queue.get_drops());
+      CPPUNIT_ASSERT_EQUAL(400u - 370u, queue.size());
+    }
+
+    /*
+     * A sparse flow goes ahead of a standing one, and two standing
+     * flows share the link by bytes, not packets. Plenty of buckets
+     * keep the flows from colliding under the random perturbation.
+     */
+    void
+    qa_fq_codel::t5_drr_fairness()
+    {
+      packet_pool pool(200);
+      fq_codel_queue queue(&pool, 0.0, 100.0, false, FQ_CODEL_LIMIT, FQ_CODEL_FLOWS * 64);
+      unsigned int bulk_bytes = 0, small_bytes = 0;
+      int diff;
+      packet_desc *desc;
+
+      for (int i = 0; i < 10; i++) {
+        queue.enqueue(udp_frame(pool, 1000, 1500, 0, i), 0);
+      }
+      for (int i = 0; i < 3; i++) {
+        desc = queue.next_packet(0);
+        CPPUNIT_ASSERT_EQUAL(1000, udp_port(desc));
+        desc->release();
+      }
+      queue.enqueue(udp_frame(pool, 2000, 100, 0, 0), 0);
+      desc = queue.next_packet(0);
+      CPPUNIT_ASSERT_EQUAL(2000, udp_port(desc));
+      desc->release();
+      CPPUNIT_ASSERT_EQUAL(7u, drain(queue));
+
+      for (int i = 0; i < 20; i++) {
+        queue.enqueue(udp_frame(pool, 1000, 1500, 0, i), 0);
+      }
+      for (int i = 0; i < 100; i++) {
+        queue.enqueue(udp_frame(pool, 3000, 300, 0, i), 0);
+      }
+      while (bulk_bytes < 20 * 1500 && small_bytes < 100 * 300) {
+        desc = queue.next_packet(0);
+        if (udp_port(desc) == 1000) {
+          bulk_bytes += desc->length;
+        }
+        else {
+          small_bytes += desc->length;
+        }
+        desc->release();
+        diff = (int)bulk_bytes - (int)small_bytes;
+        CPPUNIT_ASSERT(std::abs(diff) <= FQ_CODEL_QUANTUM + 1500);
+      }
+      drain(queue);
+    }
+
+    /*
+     * Over the packet limit, or with the pool dry, the head of the
+     * flow with the largest backlog goes.
+     */
+    void
+    qa_fq_codel::t6_drop_from_fattest()
+    {
+      packet_pool pool(16);
+      fq_codel_queue queue(&pool, 0.0, 100.0, false, 10, FQ_CODEL_FLOWS * 64);
+      unsigned char frame[1500];
+      struct pcap_pkthdr hdr;
+      packet_desc *desc;
+      int next_bulk = 2, small = 0;
+
+      for (int i = 0; i < 8; i++) {
+        queue.enqueue(udp_frame(pool, 1000, 1500, 0, i), 0);
+      }
+      for (int i = 0; i < 4; i++) {
+        queue.enqueue(udp_frame(pool, 2000, 100, 0, i), 0);
+      }
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, queue.get_overlimit_drops());
+      CPPUNIT_ASSERT_EQUAL(10u, queue.size());
+      CPPUNIT_ASSERT_EQUAL(6u * 1500 + 4u * 100, queue.backlog());
+      while ((desc = queue.next_packet(0)) != NULL) {
+        if (udp_port(desc) == 1000) {
+          CPPUNIT_ASSERT_EQUAL(next_bulk++, udp_seq(desc));
+        }
+        else {
+          CPPUNIT_ASSERT_EQUAL(small++, udp_seq(desc));
+        }
+        desc->release();
+      }
+      CPPUNIT_ASSERT_EQUAL(8, next_bulk);
+      CPPUNIT_ASSERT_EQUAL(4, small);
+
+      /* 16 buffers, the 17th frame makes room at the bulk flow's head */
+      fq_codel_queue roomy(&pool, 0.0, 100.0, false, FQ_CODEL_LIMIT, FQ_CODEL_FLOWS * 64);
+      for (int i = 0; i < 15; i++) {
+        hdr.len = hdr.caplen = udp_frame(frame, 1000, 1500, 0, i);
+        roomy.enqueue(&hdr, frame);
+      }
+      for (int i = 0; i < 2; i++) {
+        hdr.len = hdr.caplen = udp_frame(frame, 2000, 100, 0, i);
+        roomy.enqueue(&hdr, frame);
+      }
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, roomy.get_overlimit_drops());
+      CPPUNIT_ASSERT_EQUAL(16u, roomy.size());
+      desc = roomy.next_packet(0);
+      CPPUNIT_ASSERT_EQUAL(1000, udp_port(desc));
+      CPPUNIT_ASSERT_EQUAL(1, udp_seq(desc));
+      desc->release();
+      CPPUNIT_ASSERT_EQUAL(15u, drain(roomy));
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
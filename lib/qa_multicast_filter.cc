@@ -0,0 +1,282 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <pcap.h>
+#include "qa_multicast_filter.h"
+#include "multicast_filter.h"
+
+#define SECOND 1000000ULL
+
+namespace gr {
+  namespace ule {
+
+    /* Ethernet + IPv4 header to group, returns the payload offset */
+    static unsigned int
+    ipv4_frame(unsigned char *frame, const char *group, int protocol, unsigned int payload)
+    {
+      unsigned int ip_length = 20 + payload;
+
+      memset(frame, 0, 14 + ip_length);
+      frame[0] = 0x01;
+      frame[1] = 0x00;
+      frame[2] = 0x5e;
+      frame[12] = 0x08;
+      frame[13] = 0x00;
+      frame[14] = 0x45;
+      frame[16] = ip_length >> 8;
+      frame[17] = ip_length & 0xff;
+      frame[22] = 1;
+      frame[23] = protocol;
+      inet_pton(AF_INET, group, frame + 30);
+      return 34;
+    }
+
+    /* Ethernet + IPv6 header to group with a hop-by-hop router alert */
+    static unsigned int
+    ipv6_frame(unsigned char *frame, const char *group, int protocol, unsigned int payload, bool hop_by_hop)
+    {
+      unsigned int offset = 54;
+
+      memset(frame, 0, 62 + payload);
+      frame[0] = 0x33;
+      frame[1] = 0x33;
+      frame[12] = 0x86;
+      frame[13] = 0xdd;
+      frame[14] = 0x60;
+      frame[21] = hop_by_hop ? 0 : protocol;
+      frame[22] = 1;
+      inet_pton(AF_INET6, group, frame + 38);
+      if (hop_by_hop) {
+        frame[offset] = protocol;
+        frame[offset + 2] = 0x05;    /* router alert */
+        frame[offset + 3] = 0x02;
+        offset += 8;
+      }
+      payload += offset - 54;
+      frame[18] = payload >> 8;
+      frame[19] = payload & 0xff;
+      return offset;
+    }
+
+    void
+    qa_multicast_filter::t1_static()
+    {
+      multicast_filter filter("239.1.1.1, ff3e::8000:1");
+      unsigned char frame[128];
+      std::vector<multicast_group> groups;
+
+      ipv4_frame(frame, "239.1.1.1", 17, 8);
+      CPPUNIT_ASSERT(filter.admit(frame, 62, 1000 * SECOND));
+      ipv4_frame(frame, "239.1.1.2", 17, 8);
+      CPPUNIT_ASSERT(!filter.admit(frame, 62, 1000 * SECOND));
+      ipv6_frame(frame, "ff3e::8000:1", 17, 8, false);
+      CPPUNIT_ASSERT(filter.admit(frame, 70, 1000 * SECOND));
+
+      /* unicast, broadcast and all hosts pass */
+      ipv4_frame(frame, "239.1.1.2", 17, 8);
+      frame[0] = 0x02;
+      CPPUNIT_ASSERT(filter.admit(frame, 62, 0));
+      memset(frame, 0xff, 6);
+      CPPUNIT_ASSERT(filter.admit(frame, 62, 0));
+      ipv4_frame(frame, "224.0.0.1", 17, 8);
+      CPPUNIT_ASSERT(filter.admit(frame, 62, 0));
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, filter.get_suppressed_frames());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)62, filter.get_suppressed_bytes());
+      groups = filter.get_groups();
+      CPPUNIT_ASSERT_EQUAL((size_t)2, groups.size());
+      for (unsigned int i = 0; i < groups.size(); i++) {
+        CPPUNIT_ASSERT(groups[i].is_static && groups[i].active);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, groups[i].frames);
+      }
+
+      CPPUNIT_ASSERT_THROW(multicast_filter("10.0.0.1"), std::runtime_error);
+      CPPUNIT_ASSERT_THROW(multicast_filter("239.1.1"), std::runtime_error);
+    }
+
+    void
+    qa_multicast_filter::t2_igmp()
+    {
+      multicast_filter filter("");
+      unsigned char report[128], data[128];
+      unsigned int offset;
+      uint64_t now = 1000 * SECOND;
+
+      ipv4_frame(data, "239.2.2.2", 17, 8);
+      CPPUNIT_ASSERT(!filter.admit(data, 62, now + (MCAST_LEAVE_TIMEOUT + 1) * SECOND));
+
+      /* v2 join */
+      offset = ipv4_frame(report, "239.2.2.2", 2, 8);
+      report[offset] = 0x16;
+      inet_pton(AF_INET, "239.2.2.2", report + offset + 4);
+      CPPUNIT_ASSERT(filter.admit(report, offset + 8, now));
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 8, now));
+      CPPUNIT_ASSERT(filter.admit(data, 62, now));
+      CPPUNIT_ASSERT(filter.admit(data, 62, now + (MCAST_MEMBERSHIP_TIMEOUT - 1) * SECOND));
+      CPPUNIT_ASSERT(!filter.admit(data, 62, now + (MCAST_MEMBERSHIP_TIMEOUT + 1) * SECOND));
+
+      /* v2 leave waits for the last member query time */
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 8, now));
+      ipv4_frame(report, "224.0.0.2", 2, 8);
+      report[offset] = 0x17;
+      inet_pton(AF_INET, "239.2.2.2", report + offset + 4);
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 8, now));
+      CPPUNIT_ASSERT(filter.admit(data, 62, now + SECOND));
+      CPPUNIT_ASSERT(!filter.admit(data, 62, now + (MCAST_LEAVE_TIMEOUT + 1) * SECOND));
+
+      /* v3 report, a join and an exclude-none leave */
+      offset = ipv4_frame(report, "224.0.0.22", 2, 24);
+      report[offset] = 0x22;
+      report[offset + 7] = 2;
+      report[offset + 8] = 4;     /* change to exclude */
+      inet_pton(AF_INET, "239.3.3.3", report + offset + 12);
+      report[offset + 16] = 3;    /* change to include */
+      inet_pton(AF_INET, "239.2.2.2", report + offset + 20);
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 24, now));
+      ipv4_frame(data, "239.3.3.3", 17, 8);
+      CPPUNIT_ASSERT(filter.admit(data, 62, now));
+      ipv4_frame(data, "239.2.2.2", 17, 8);
+      CPPUNIT_ASSERT(!filter.admit(data, 62, now + (MCAST_LEAVE_TIMEOUT + 1) * SECOND));
+
+      /* queries and other traffic are not reports */
+      report[offset] = 0x11;
+      CPPUNIT_ASSERT(!filter.snoop(report, offset + 24, now));
+      CPPUNIT_ASSERT(!filter.snoop(data, 62, now));
+    }
+
+    void
+    qa_multicast_filter::t3_mld()
+    {
+      multicast_filter filter(NULL);
+      unsigned char report[160], data[128];
+      unsigned int offset;
+      uint64_t now = 1000 * SECOND;
+
+      ipv6_frame(data, "ff3e::1234", 17, 8, false);
+      CPPUNIT_ASSERT(!filter.admit(data, 70, now));
+
+      /* v2 report behind the router alert */
+      offset = ipv6_frame(report, "ff02::16", 58, 28, true);
+      report[offset] = 143;
+      report[offset + 7] = 1;
+      report[offset + 8] = 2;     /* mode is exclude */
+      inet_pton(AF_INET6, "ff3e::1234", report + offset + 12);
+      CPPUNIT_ASSERT(filter.admit(report, offset + 28, now));
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 28, now));
+      CPPUNIT_ASSERT(filter.admit(data, 70, now));
+
+      /* v1 done */
+      offset = ipv6_frame(report, "ff02::2", 58, 24, true);
+      report[offset] = 132;
+      inet_pton(AF_INET6, "ff3e::1234", report + offset + 8);
+      CPPUNIT_ASSERT(filter.snoop(report, offset + 24, now));
+      CPPUNIT_ASSERT(!filter.admit(data, 70, now + (MCAST_LEAVE_TIMEOUT + 1) * SECOND));
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, filter.get_groups()[0].frames);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, filter.get_suppressed_frames());
+    }
+
+    void
+    qa_multicast_filter::t4_link_local()
+    {
+      multicast_filter flood("");
+      multicast_filter snooped("!224.0.0.251");
+      unsigned char report[128], data[128];
+      unsigned int offset;
+      uint64_t now = 1000 * SECOND;
+
+      /* 224.0.0.0/24 is flooded, the next block is not */
+      ipv4_frame(data, "224.0.0.251", 17, 8);
+      CPPUNIT_ASSERT(flood.admit(data, 62, now));
+      ipv4_frame(data, "224.0.0.5", 89, 8);
+      CPPUNIT_ASSERT(flood.admit(data, 62, now));
+      ipv4_frame(data, "224.0.1.1", 17, 8);
+      CPPUNIT_ASSERT(!flood.admit(data, 62, now));
+
+      /* an opted out group needs a member like any other */
+      ipv4_frame(data, "224.0.0.251", 17, 8);
+      CPPUNIT_ASSERT(!snooped.admit(data, 62, now));
+      ipv4_frame(data, "224.0.0.5", 89, 8);
+      CPPUNIT_ASSERT(snooped.admit(data, 62, now));
+      offset = ipv4_frame(report, "224.0.0.251", 2, 8);
+      report[offset] = 0x16;
+      inet_pton(AF_INET, "224.0.0.251", report + offset + 4);
+      CPPUNIT_ASSERT(snooped.snoop(report, offset + 8, now));
+      ipv4_frame(data, "224.0.0.251", 17, 8);
+      CPPUNIT_ASSERT(snooped.admit(data, 62, now));
+      CPPUNIT_ASSERT_EQUAL((size_t)1, snooped.get_groups().size());
+
+      CPPUNIT_ASSERT_THROW(multicast_filter("!239.1.1.1"), std::runtime_error);
+      CPPUNIT_ASSERT_THROW(multicast_filter("!ff02::fb"), std::runtime_error);
+    }
+
+    /* whether the capture filter expression passes frame */
+    static bool
+    bpf_match(const char *expression, const unsigned char *frame, unsigned int len)
+    {
+      pcap_t *dead = pcap_open_dead(DLT_EN10MB, 65535);
+      struct bpf_program program;
+      struct pcap_pkthdr hdr;
+      bool match;
+
+      CPPUNIT_ASSERT(pcap_compile(dead, &program, expression, 1, PCAP_NETMASK_UNKNOWN) == 0);
+      memset(&hdr, 0, sizeof(hdr));
+      hdr.caplen = hdr.len = len;
+      match = pcap_offline_filter(&program, &hdr, frame) != 0;
+      pcap_freecode(&program);
+      pcap_close(dead);
+      return match;
+    }
+
+    /* the reports reach snoop() through the BPF filter on a real interface */
+    void
+    qa_multicast_filter::t5_snoop_filter()
+    {
+      static const char *filters[] = {MCAST_SNOOP_FILTER, MCAST_SNOOP_FILTER " or arp"};
+      unsigned char frame[160];
+      unsigned int offset;
+
+      for (int i = 0; i < 2; i++) {
+        offset = ipv6_frame(frame, "ff02::16", 58, 28, true);
+        frame[offset] = 143;
+        CPPUNIT_ASSERT(bpf_match(filters[i], frame, offset + 28));
+        offset = ipv6_frame(frame, "ff02::1", 58, 24, false);
+        frame[offset] = 130;
+        CPPUNIT_ASSERT(bpf_match(filters[i], frame, offset + 24));
+        offset = ipv4_frame(frame, "224.0.0.22", 2, 24);
+        CPPUNIT_ASSERT(bpf_match(filters[i], frame, offset + 24));
+
+        /* multicast data is not for the snooper */
+        offset = ipv6_frame(frame, "ff3e::1234", 17, 8, false);
+        CPPUNIT_ASSERT(!bpf_match(filters[i], frame, offset + 8));
+        offset = ipv6_frame(frame, "ff3e::1234", 17, 8, true);
+        CPPUNIT_ASSERT(!bpf_match(filters[i], frame, offset + 8));
+        offset = ipv4_frame(frame, "239.2.2.2", 17, 8);
+        CPPUNIT_ASSERT(!bpf_match(filters[i], frame, offset + 8));
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
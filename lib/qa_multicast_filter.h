@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_MULTICAST_FILTER_H_
+#define _QA_MULTICAST_FILTER_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace ule {
+
+    class qa_multicast_filter : public CppUnit::TestCase
+    {
+    public:
+      CPPUNIT_TEST_SUITE(qa_multicast_filter);
+      CPPUNIT_TEST(t1_static);
+      CPPUNIT_TEST(t2_igmp);
+      CPPUNIT_TEST(t3_mld);
+      CPPUNIT_TEST(t4_link_local);
+      CPPUNIT_TEST(t5_snoop_filter);
+      CPPUNIT_TEST_SUITE_END();
+
+    private:
+      void t1_static();
+      void t2_igmp();
+      void t3_mld();
+      void t4_link_local();
+      void t5_snoop_filter();
+    };
+
+  } /* namespace ule */
+} /* namespace gr */
+
+#endif /* _QA_MULTICAST_FILTER_H_ */
@@ -0,0 +1,189 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <boost/thread.hpp>
+#include "qa_packet_pool.h"
+#include "packet_pool.h"
+#include "sndu_builder.h"
+#include "sndu_security.h"
+
+#define TEST_KEY_128 "000102030405060708090a0b0c0d0e0f10111213"
+#define TEST_POOL_SIZE 64
+#define TEST_THREADS 4
+#define TEST_ROUNDS 100000
+
+namespace gr {
+  namespace ule {
+
+    static void
+    test_frame(unsigned char *frame, unsigned int len)
+    {
+      for (unsigned int i = 0; i < len; i++) {
+        frame[i] = (i * 7) & 0xff;
+      }
+      /* the source address is not carried */
+      memset(frame + ETHER_ADDR_LEN, 0, ETHER_ADDR_LEN);
+      frame[12] = 0x08;
+      frame[13] = 0x00;
+    }
+
+    void
+    qa_packet_pool::t1_alloc_release()
+    {
+      packet_pool pool(TEST_POOL_SIZE);
+      packet_desc *descs[TEST_POOL_SIZE];
+
+      for (int i = 0; i < TEST_POOL_SIZE; i++) {
+        descs[i] = pool.alloc();
+        CPPUNIT_ASSERT(descs[i] != NULL);
+        CPPUNIT_ASSERT_EQUAL(0ul, (unsigned long)descs[i] % POOL_CACHE_LINE);
+        CPPUNIT_ASSERT_EQUAL(0ul, (unsigned long)descs[i]->buffer % POOL_CACHE_LINE);
+        CPPUNIT_ASSERT_EQUAL((unsigned int)POOL_HEADROOM, descs[i]->headroom());
+        CPPUNIT_ASSERT_EQUAL(0u, descs[i]->length);
+      }
+      CPPUNIT_ASSERT(pool.alloc() == NULL);
+      CPPUNIT_ASSERT_EQUAL(0u, pool.free_count());
+
+      /* a second reference keeps the buffer out of the pool */
+      descs[0]->ref();
+      descs[0]->release();
+      CPPUNIT_ASSERT(pool.alloc() == NULL);
+      descs[0]->release();
+      CPPUNIT_ASSERT_EQUAL(1u, pool.free_count());
+
+      /* the last buffer freed is the first reused */
+      CPPUNIT_ASSERT(pool.alloc() == descs[0]);
+      for (int i = 0; i < TEST_POOL_SIZE; i++) {
+        descs[i]->release();
+      }
+      CPPUNIT_ASSERT_EQUAL((unsigned int)TEST_POOL_SIZE, pool.free_count());
+    }
+
+    void
+    qa_packet_pool::t2_build_in_place()
+    {
+      packet_pool pool(4);
+      sndu_security tx(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      sndu_security rx(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      unsigned char frame[ULE_MAX_FRAME_SIZE], copy[ULE_MAX_FRAME_SIZE], sndu[SNDU_MAX_SIZE];
+      unsigned int length, crc32;
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      for (unsigned int len = sizeof(struct ether_header); len <= ULE_MAX_FRAME_SIZE; len += 587) {
+        test_frame(frame, len);
+        /* length, type, NPA address, PDU, CRC32 */
+        length = len - sizeof(struct ether_header) + ETHER_ADDR_LEN + SNDU_CRC_SIZE;
+        sndu[0] = (length >> 8) & 0x7f;
+        sndu[1] = length & 0xff;
+        sndu[2] = frame[12];
+        sndu[3] = frame[13];
+        memcpy(sndu + SNDU_BASE_HEADER_SIZE, frame, ETHER_ADDR_LEN);
+        memcpy(sndu + SNDU_BASE_HEADER_SIZE + ETHER_ADDR_LEN, frame + sizeof(struct ether_header), len - sizeof(struct ether_header));
+        length += SNDU_BASE_HEADER_SIZE;
+        crc32 = sndu_crc32(sndu, length - SNDU_CRC_SIZE);
+        sndu[length - 4] = (crc32 >> 24) & 0xff;
+        sndu[length - 3] = (crc32 >> 16) & 0xff;
+        sndu[length - 2] = (crc32 >> 8) & 0xff;
+        sndu[length - 1] = crc32 & 0xff;
+
+        desc = pool.alloc();
+        memcpy(desc->data, frame, len);
+        desc->length = len;
+        desc = build_sndu(desc, rewrite);
+        CPPUNIT_ASSERT(desc != NULL);
+        CPPUNIT_ASSERT_EQUAL(length, desc->length);
+        CPPUNIT_ASSERT(memcmp(sndu, desc->data, length) == 0);
+        desc->release();
+      }
+
+      /* sealed in place, it opens to the original frame */
+      rewrite.security = &tx;
+      test_frame(frame, ULE_MAX_FRAME_SIZE);
+      desc = pool.alloc();
+      memcpy(desc->data, frame, ULE_MAX_FRAME_SIZE);
+      desc->length = ULE_MAX_FRAME_SIZE;
+      desc = build_sndu(desc, rewrite);
+      CPPUNIT_ASSERT(desc != NULL);
+      CPPUNIT_ASSERT_EQUAL((unsigned int)(POOL_HEADROOM - SEC_SEAL_OFFSET), desc->headroom());
+      CPPUNIT_ASSERT_EQUAL((unsigned int)ULE_MAX_FRAME_SIZE, rx.open(desc->data, desc->length, copy));
+      CPPUNIT_ASSERT(memcmp(frame, copy, ULE_MAX_FRAME_SIZE) == 0);
+      desc->release();
+
+      /* a runt is dropped and its buffer freed */
+      desc = pool.alloc();
+      desc->length = sizeof(struct ether_header) - 1;
+      CPPUNIT_ASSERT(build_sndu(desc, rewrite) == NULL);
+      CPPUNIT_ASSERT_EQUAL(4u, pool.free_count());
+    }
+
+    struct churn_state {
+      packet_pool *pool;
+      boost::atomic<int> owners[TEST_THREADS * 4];
+      boost::atomic<int> errors;
+    };
+
+    static void
+    churn(churn_state *state)
+    {
+      packet_desc *held[4];
+
+      for (int round = 0; round < TEST_ROUNDS; round++) {
+        for (int i = 0; i < 4; i++) {
+          while ((held[i] = state->pool->alloc()) == NULL) {
+          }
+          /* nobody else may own it while we do */
+          if (state->owners[held[i]->index].exchange(1) != 0) {
+            state->errors++;
+          }
+        }
+        for (int i = 0; i < 4; i++) {
+          state->owners[held[i]->index].store(0);
+          held[i]->release();
+        }
+      }
+    }
+
+    void
+    qa_packet_pool::t3_threads()
+    {
+      packet_pool pool(TEST_THREADS * 4);
+      boost::thread_group threads;
+      churn_state state;
+
+      state.pool = &pool;
+      for (int i = 0; i < TEST_THREADS * 4; i++) {
+        state.owners[i] = 0;
+      }
+      state.errors = 0;
+      for (int i = 0; i < TEST_THREADS; i++) {
+        threads.create_thread(boost::bind(churn, &state));
+      }
+      threads.join_all();
+      CPPUNIT_ASSERT_EQUAL(0, state.errors.load());
+      CPPUNIT_ASSERT_EQUAL((unsigned int)TEST_THREADS * 4, pool.free_count());
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,173 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <vector>
+#include "qa_plp_classifier.h"
+#include "plp_classifier.h"
+#include "ts_packetizer.h"
+
+#define TEST_FRAME_SIZE 100
+#define TEST_MARKER "PLPCLASS"
+#define TEST_MARKER_SIZE 8
+
+namespace gr {
+  namespace ule {
+
+    /* the [1, 1, 1, 1, 1, 0, 0, 0] layout from the README */
+    static std::vector<int>
+    test_map(void)
+    {
+      static const int map[NUM_TRAFFIC_CLASSES] = {1, 1, 1, 1, 1, 0, 0, 0};
+
+      return std::vector<int>(map, map + NUM_TRAFFIC_CLASSES);
+    }
+
+    /*
+     * IPv4, IPv6 or ARP frame of traffic class tc, with a marker and
+     * the class in its payload to find it in the Transport Stream.
+     */
+    static unsigned int
+    test_frame(unsigned char *frame, unsigned short ether_type, unsigned int tc)
+    {
+      unsigned char *ip = frame + sizeof(struct ether_header);
+
+      memset(frame, 0, TEST_FRAME_SIZE);
+      memset(frame, 0x02, ETHER_ADDR_LEN);
+      frame[12] = ether_type >> 8;
+      frame[13] = ether_type & 0xff;
+      if (ether_type == ETHERTYPE_IP) {
+        ip[0] = 0x45;
+        ip[1] = tc << 5;
+        ip[3] = TEST_FRAME_SIZE - sizeof(struct ether_header);
+        ip[9] = IPPROTO_UDP;
+      }
+      else if (ether_type == ETHERTYPE_IPV6) {
+        ip[0] = 0x60 | (tc << 1);
+        ip[5] = TEST_FRAME_SIZE - sizeof(struct ether_header) - 40;
+        ip[6] = IPPROTO_UDP;
+      }
+      memcpy(frame + TEST_FRAME_SIZE - TEST_MARKER_SIZE - 1, TEST_MARKER, TEST_MARKER_SIZE);
+      frame[TEST_FRAME_SIZE - 1] = tc;
+      return TEST_FRAME_SIZE;
+    }
+
+    /* the classes whose marker shows up in the ULE cells of a stream */
+    static std::vector<bool>
+    classes_in_stream(const unsigned char *ts, int len)
+    {
+      std::vector<bool> found(NUM_TRAFFIC_CLASSES, false);
+      const unsigned char *cell, *marker;
+
+      for (int i = 0; i < len; i += MPEG2_PACKET_SIZE) {
+        cell = ts + i;
+        if ((((cell[1] & 0x1f) << 8) | cell[2]) != ULE_PID) {
+          continue;
+        }
+        for (int j = TS_HEADER_SIZE; j + TEST_MARKER_SIZE < MPEG2_PACKET_SIZE; j++) {
+          marker = cell + j;
+          if (memcmp(marker, TEST_MARKER, TEST_MARKER_SIZE) == 0 && marker[TEST_MARKER_SIZE] < NUM_TRAFFIC_CLASSES) {
+            found[marker[TEST_MARKER_SIZE]] = true;
+          }
+        }
+      }
+      return found;
+    }
+
+    void
+    qa_plp_classifier::t1_routing()
+    {
+      static const unsigned short types[] = {ETHERTYPE_IP, ETHERTYPE_IPV6};
+      plp_classifier classifier(2, test_map());
+      unsigned char frame[TEST_FRAME_SIZE];
+      packet_desc *desc;
+
+      for (int t = 0; t < 2; t++) {
+        for (unsigned int tc = 0; tc < NUM_TRAFFIC_CLASSES; tc++) {
+          test_frame(frame, types[t], tc);
+          CPPUNIT_ASSERT_EQUAL(tc, plp_classifier::classify(frame, TEST_FRAME_SIZE));
+          CPPUNIT_ASSERT(classifier.enqueue(frame, TEST_FRAME_SIZE));
+        }
+      }
+      /* non-IP frames are class 0 */
+      test_frame(frame, ETHERTYPE_ARP, 7);
+      CPPUNIT_ASSERT_EQUAL(0u, plp_classifier::classify(frame, TEST_FRAME_SIZE));
+      CPPUNIT_ASSERT(classifier.enqueue(frame, TEST_FRAME_SIZE));
+
+      CPPUNIT_ASSERT_EQUAL(6u, classifier.queued(0));
+      CPPUNIT_ASSERT_EQUAL(11u, classifier.queued(1));
+      for (int plp = 0; plp < 2; plp++) {
+        while ((desc = classifier.get_source(plp)->next_packet()) != NULL) {
+          CPPUNIT_ASSERT_EQUAL(plp, classifier.get_plp(desc->traffic_class));
+          desc->release();
+        }
+      }
+
+      std::vector<int> bad = test_map();
+      bad[6] = 2;
+      CPPUNIT_ASSERT_THROW(plp_classifier(2, bad), std::runtime_error);
+      CPPUNIT_ASSERT_THROW(plp_classifier(0, test_map()), std::runtime_error);
+    }
+
+    /*
+     * PLP 0 is never drained, as if its output had stalled. It drops
+     * at its own queue limit while everything for PLP 1 gets through
+     * and is packed into the PLP 1 stream alone.
+     */
+    void
+    qa_plp_classifier::t2_independent_plps()
+    {
+      plp_classifier classifier(2, test_map());
+      ts_packetizer packetizer(ULE_PID, "TEST", PING_REPLY_OFF, IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0", NPD_OFF, DBIT_OFF, PACKING_ON);
+      std::vector<unsigned char> ts(MPEG2_PACKET_SIZE * 200);
+      unsigned char frame[TEST_FRAME_SIZE];
+      std::vector<bool> found(NUM_TRAFFIC_CLASSES, false), chunk;
+      unsigned int accepted = 0;
+      int produced;
+
+      for (int i = 0; i < 2 * PLP_QUEUE_LIMIT; i++) {
+        test_frame(frame, ETHERTYPE_IP, 5 + i % 3);
+        classifier.enqueue(frame, TEST_FRAME_SIZE);
+        test_frame(frame, ETHERTYPE_IP, i % 5);
+        if (classifier.enqueue(frame, TEST_FRAME_SIZE)) {
+          accepted++;
+        }
+        if (classifier.queued(1) >= PLP_QUEUE_LIMIT / 2) {
+          produced = packetizer.packetize(&ts[0], ts.size(), classifier.get_source(1));
+          chunk = classes_in_stream(&ts[0], produced);
+          for (unsigned int tc = 0; tc < NUM_TRAFFIC_CLASSES; tc++) {
+            found[tc] = found[tc] || chunk[tc];
+          }
+        }
+      }
+
+      CPPUNIT_ASSERT_EQUAL((unsigned int)(2 * PLP_QUEUE_LIMIT), accepted);
+      CPPUNIT_ASSERT_EQUAL(0ul, (unsigned long)classifier.get_drops(1));
+      CPPUNIT_ASSERT_EQUAL((unsigned int)PLP_QUEUE_LIMIT, classifier.queued(0));
+      CPPUNIT_ASSERT_EQUAL((unsigned long)PLP_QUEUE_LIMIT, (unsigned long)classifier.get_drops(0));
+      for (unsigned int tc = 0; tc < NUM_TRAFFIC_CLASSES; tc++) {
+        CPPUNIT_ASSERT_EQUAL(classifier.get_plp(tc) == 1, (bool)found[tc]);
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
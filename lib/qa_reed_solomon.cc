@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <cstring>
+#include "qa_reed_solomon.h"
+#include "gf256.h"
+#include "reed_solomon.h"
+
+#define RS_N 204
+#define RS_K 188
+
+namespace gr {
+  namespace ule {
+
+    /* every RS(204,188) codeword has roots alpha^0 .. alpha^15 */
+    void
+    qa_reed_solomon::t1_syndromes()
+    {
+      reed_solomon rs(RS_N - RS_K);
+      unsigned char codeword[RS_N];
+      unsigned char syndrome;
+
+      for (int trial = 0; trial < 16; trial++) {
+        for (int i = 0; i < RS_K; i++) {
+          codeword[i] = rand() & 0xff;
+        }
+        codeword[0] = 0x47;
+        rs.encode(codeword, RS_K, codeword + RS_K);
+        for (int root = 0; root < RS_N - RS_K; root++) {
+          syndrome = 0;
+          for (int i = 0; i < RS_N; i++) {
+            syndrome = gf256_mul(syndrome, gf256_exp(root)) ^ codeword[i];
+          }
+          CPPUNIT_ASSERT_EQUAL(0, (int)syndrome);
+        }
+      }
+    }
+
+    /* the parity of a sum is the sum of the parities */
+    void
+    qa_reed_solomon::t2_linear()
+    {
+      reed_solomon rs(RS_N - RS_K);
+      unsigned char a[RS_K], b[RS_K], sum[RS_K];
+      unsigned char pa[RS_N - RS_K], pb[RS_N - RS_K], psum[RS_N - RS_K];
+
+      memset(a, 0, sizeof(a));
+      rs.encode(a, RS_K, pa);
+      for (int i = 0; i < RS_N - RS_K; i++) {
+        CPPUNIT_ASSERT_EQUAL(0, (int)pa[i]);
+      }
+      for (int i = 0; i < RS_K; i++) {
+        a[i] = rand() & 0xff;
+        b[i] = rand() & 0xff;
+        sum[i] = a[i] ^ b[i];
+      }
+      rs.encode(a, RS_K, pa);
+      rs.encode(b, RS_K, pb);
+      rs.encode(sum, RS_K, psum);
+      for (int i = 0; i < RS_N - RS_K; i++) {
+        CPPUNIT_ASSERT_EQUAL((int)(pa[i] ^ pb[i]), (int)psum[i]);
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
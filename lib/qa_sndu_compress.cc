@@ -0,0 +1,199 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+#include <netinet/ip.h>
+#include "qa_sndu_compress.h"
+#include "sndu_compress.h"
+#include "sndu_encap.h"
+#include "sndu_security.h"
+
+#define TEST_KEY_128 "000102030405060708090a0b0c0d0e0f10111213"
+#define TEST_PORT 5004
+#define TEST_RECORD "{\"sensor\": \"temperature\", \"unit\": \"celsius\", \"value\": "
+
+namespace gr {
+  namespace ule {
+
+#ifdef HAVE_ZSTD
+    /* IPv4 UDP to port with JSON records, or random bytes */
+    static void
+    test_frame(unsigned char *frame, unsigned int len, int port, bool random)
+    {
+      unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned char *udp = ip + sizeof(struct ip);
+      unsigned int ip_length = len - sizeof(struct ether_header);
+      unsigned int record = strlen(TEST_RECORD);
+
+      for (unsigned int i = 0; i < len; i++) {
+        frame[i] = random ? rand() & 0xff : TEST_RECORD[i % record];
+      }
+      memset(frame + ETHER_ADDR_LEN, 0, ETHER_ADDR_LEN);
+      frame[12] = 0x08;
+      frame[13] = 0x00;
+      memset(ip, 0, sizeof(struct ip) + 8);
+      ip[0] = 0x45;
+      ip[2] = (ip_length >> 8) & 0xff;
+      ip[3] = ip_length & 0xff;
+      ip[8] = 64;
+      ip[9] = IPPROTO_UDP;
+      udp[2] = (port >> 8) & 0xff;
+      udp[3] = port & 0xff;
+    }
+
+    /* a raw content dictionary of the records, removed by the caller */
+    static std::string
+    test_dictionary(void)
+    {
+      char path[] = "/tmp/qa_sndu_compress.XXXXXX";
+      std::string dict;
+      int fd;
+
+      for (int i = 0; i < 64; i++) {
+        dict += TEST_RECORD;
+      }
+      fd = mkstemp(path);
+      CPPUNIT_ASSERT(fd >= 0);
+      CPPUNIT_ASSERT_EQUAL((ssize_t)dict.size(), write(fd, dict.data(), dict.size()));
+      close(fd);
+      return path;
+    }
+
+    void
+    qa_sndu_compress::t1_round_trip()
+    {
+      std::string dict = test_dictionary();
+      sndu_compress compress(COMPRESS_ZSTD, "5004=" + dict + ",*=");
+      unsigned char frame[ULE_MAX_FRAME_SIZE];
+      unsigned char original[ULE_MAX_FRAME_SIZE];
+      unsigned char out[ULE_MAX_FRAME_SIZE];
+      unsigned int length, frames = 0;
+
+      unlink(dict.c_str());
+      /*
+       * Both classes come back intact. Without a dictionary a frame
+       * needs a few records of its own before it shrinks.
+       */
+      for (int port = TEST_PORT; port <= TEST_PORT + 1; port++) {
+        for (unsigned int len = port == TEST_PORT ? 100 : 449; len <= ULE_MAX_FRAME_SIZE; len += 349) {
+          test_frame(frame, len, port, false);
+          memcpy(original, frame, len);
+          length = compress.compress(frame, len);
+          CPPUNIT_ASSERT(length < len);
+          CPPUNIT_ASSERT_EQUAL((unsigned int)ULE_TYPE_COMPRESSED, (unsigned int)((frame[12] << 8) | frame[13]));
+          CPPUNIT_ASSERT_EQUAL(port == TEST_PORT ? 0 : 1, (int)frame[sizeof(struct ether_header)]);
+          CPPUNIT_ASSERT_EQUAL(len, compress.decompress(frame, length, out));
+          CPPUNIT_ASSERT(memcmp(original, out, len) == 0);
+          frames++;
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL((uint64_t)frames, compress.get_compressed());
+      CPPUNIT_ASSERT(compress.get_bytes_out() < compress.get_bytes_in());
+
+      /* incompressible and unclassified frames go out unchanged */
+      test_frame(frame, ULE_MAX_FRAME_SIZE, TEST_PORT, true);
+      memcpy(original, frame, ULE_MAX_FRAME_SIZE);
+      CPPUNIT_ASSERT_EQUAL((unsigned int)ULE_MAX_FRAME_SIZE, compress.compress(frame, ULE_MAX_FRAME_SIZE));
+      CPPUNIT_ASSERT(memcmp(original, frame, ULE_MAX_FRAME_SIZE) == 0);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, compress.get_skipped());
+      frame[12] = 0x88;
+      frame[13] = 0xb5;
+      CPPUNIT_ASSERT_EQUAL(200u, compress.compress(frame, 200));
+
+      /* an unknown class is rejected */
+      test_frame(frame, 500, TEST_PORT, false);
+      length = compress.compress(frame, 500);
+      frame[sizeof(struct ether_header)] = 2;
+      CPPUNIT_ASSERT_EQUAL(0u, compress.decompress(frame, length, out));
+
+      CPPUNIT_ASSERT_THROW(sndu_compress(COMPRESS_ZSTD, "http=" + dict), std::runtime_error);
+      CPPUNIT_ASSERT_THROW(sndu_compress(COMPRESS_ZSTD, "80=" + dict), std::runtime_error);
+    }
+
+    /* the specialised builders compress like the generic one */
+    void
+    qa_sndu_compress::t2_builders()
+    {
+      packet_pool pool(4);
+      sndu_compress compress(COMPRESS_ZSTD, "*=");
+      sndu_security tx_generic(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      sndu_security tx_special(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      unsigned char frame[ULE_MAX_FRAME_SIZE];
+      sndu_rewrite rewrite;
+      packet_desc *generic, *special;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      rewrite.compress = &compress;
+      inet_pton(AF_INET, "10.0.0.1", rewrite.src_addr);
+      inet_pton(AF_INET, "10.0.0.2", rewrite.dst_addr);
+      for (int option = 0; option < 16; option++) {
+        rewrite.ping_reply = option & 1;
+        rewrite.ipaddr_spoof = (option >> 1) & 1;
+        rewrite.dbit = (option >> 2) & 1;
+        rewrite.security = (option & 8) ? &tx_generic : NULL;
+        for (unsigned int len = 449; len <= ULE_MAX_FRAME_SIZE; len += 301) {
+          test_frame(frame, len, TEST_PORT, false);
+          generic = pool.alloc();
+          memcpy(generic->data, frame, len);
+          generic->length = len;
+          generic = build_sndu(generic, rewrite);
+
+          rewrite.security = (option & 8) ? &tx_special : NULL;
+          special = pool.alloc();
+          memcpy(special->data, frame, len);
+          special->length = len;
+          special = select_sndu_builder(rewrite)(special, rewrite);
+          rewrite.security = (option & 8) ? &tx_generic : NULL;
+
+          CPPUNIT_ASSERT(generic != NULL && special != NULL);
+          CPPUNIT_ASSERT_EQUAL(generic->length, special->length);
+          CPPUNIT_ASSERT(memcmp(generic->data, special->data, generic->length) == 0);
+          CPPUNIT_ASSERT_EQUAL(0u, sndu_crc32(special->data, special->length));
+          if (!(option & 8)) {
+            CPPUNIT_ASSERT(special->length < len);
+            CPPUNIT_ASSERT_EQUAL((unsigned int)ULE_TYPE_COMPRESSED, (unsigned int)((special->data[2] << 8) | special->data[3]));
+          }
+          generic->release();
+          special->release();
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL(4u, pool.free_count());
+    }
+#else
+    void
+    qa_sndu_compress::t1_round_trip()
+    {
+      CPPUNIT_ASSERT_THROW(sndu_compress(COMPRESS_ZSTD, "*="), std::runtime_error);
+    }
+
+    void
+    qa_sndu_compress::t2_builders()
+    {
+    }
+#endif
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,201 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "qa_sndu_encap.h"
+#include "crc32.h"
+#include "sndu_encap.h"
+#include "sndu_security.h"
+#include "ts_packetizer.h"
+
+#define TEST_KEY_128 "000102030405060708090a0b0c0d0e0f10111213"
+#define TEST_FRAMES 40
+
+namespace gr {
+  namespace ule {
+
+    /* ICMP echo request, so the ping reply rewrite has work to do */
+    static void
+    test_frame(unsigned char *frame, unsigned int len)
+    {
+      unsigned int ip_length = len - sizeof(struct ether_header);
+
+      for (unsigned int i = 0; i < len; i++) {
+        frame[i] = (i * 13) & 0xff;
+      }
+      memset(frame + ETHER_ADDR_LEN, 0, ETHER_ADDR_LEN);
+      frame[12] = 0x08;
+      frame[13] = 0x00;
+      if (ip_length >= sizeof(struct ip) + 4) {
+        frame[14] = 0x45;
+        frame[16] = (ip_length >> 8) & 0xff;
+        frame[17] = ip_length & 0xff;
+        frame[20] = 0x00;
+        frame[21] = 0x00;
+        frame[23] = 0x01;
+        frame[34] = 0x08;
+      }
+    }
+
+    class test_packet_source : public packet_source
+    {
+     private:
+      packet_pool pool;
+      unsigned int len;
+      int count;
+
+     public:
+      test_packet_source(unsigned int len, int count) : pool(4), len(len), count(count) {}
+
+      packet_desc *next_packet(void)
+      {
+        packet_desc *desc;
+
+        if (count == 0) {
+          return NULL;
+        }
+        count--;
+        desc = pool.alloc();
+        test_frame(desc->data, len);
+        desc->length = len;
+        return desc;
+      }
+    };
+
+    /* one bit at a time, straight from the polynomial */
+    static unsigned int
+    crc32_bitwise(const unsigned char *buf, int size)
+    {
+      unsigned int crc = 0xffffffff;
+
+      for (int i = 0; i < size; i++) {
+        crc ^= buf[i] << 24;
+        for (int bit = 0; bit < 8; bit++) {
+          crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+      }
+      return crc;
+    }
+
+    void
+    qa_sndu_encap::t1_crc32()
+    {
+      const unsigned char check[] = "123456789";
+      unsigned char buf[1500];
+
+      CPPUNIT_ASSERT_EQUAL(0x0376e6e7u, crc32_mpeg2(check, 9));
+      for (unsigned int i = 0; i < sizeof(buf); i++) {
+        buf[i] = rand() & 0xff;
+      }
+      for (int size = 0; size <= 64; size++) {
+        CPPUNIT_ASSERT_EQUAL(crc32_bitwise(buf, size), crc32_mpeg2(buf, size));
+      }
+      CPPUNIT_ASSERT_EQUAL(crc32_bitwise(buf + 3, sizeof(buf) - 3), crc32_mpeg2(buf + 3, sizeof(buf) - 3));
+      CPPUNIT_ASSERT_EQUAL(crc32_mpeg2(buf, sizeof(buf)), sndu_crc32(buf, sizeof(buf)));
+    }
+
+    /* every specialised builder matches the generic one */
+    void
+    qa_sndu_encap::t2_builders()
+    {
+      packet_pool pool(4);
+      sndu_security tx_generic(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      sndu_security tx_special(SECURITY_AES128_GCM, TEST_KEY_128, 1);
+      unsigned char frame[ULE_MAX_FRAME_SIZE];
+      sndu_rewrite rewrite;
+      packet_desc *generic, *special;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      inet_pton(AF_INET, "10.0.0.1", rewrite.src_addr);
+      inet_pton(AF_INET, "10.0.0.2", rewrite.dst_addr);
+      for (int option = 0; option < 16; option++) {
+        rewrite.ping_reply = option & 1;
+        rewrite.ipaddr_spoof = (option >> 1) & 1;
+        rewrite.dbit = (option >> 2) & 1;
+        rewrite.security = (option & 8) ? &tx_generic : NULL;
+        for (unsigned int len = sizeof(struct ether_header) + sizeof(struct ip) + 8; len <= ULE_MAX_FRAME_SIZE; len += 301) {
+          test_frame(frame, len);
+          generic = pool.alloc();
+          memcpy(generic->data, frame, len);
+          generic->length = len;
+          generic = build_sndu(generic, rewrite);
+
+          rewrite.security = (option & 8) ? &tx_special : NULL;
+          special = pool.alloc();
+          memcpy(special->data, frame, len);
+          special->length = len;
+          special = select_sndu_builder(rewrite)(special, rewrite);
+          rewrite.security = (option & 8) ? &tx_generic : NULL;
+
+          CPPUNIT_ASSERT(generic != NULL && special != NULL);
+          CPPUNIT_ASSERT_EQUAL(generic->length, special->length);
+          CPPUNIT_ASSERT(memcmp(generic->data, special->data, generic->length) == 0);
+          CPPUNIT_ASSERT_EQUAL(0u, sndu_crc32(special->data, special->length));
+          generic->release();
+          special->release();
+        }
+      }
+
+      /* runts are dropped by every builder */
+      rewrite.security = NULL;
+      special = pool.alloc();
+      special->length = sizeof(struct ether_header) - 1;
+      CPPUNIT_ASSERT(select_sndu_builder(rewrite)(special, rewrite) == NULL);
+      CPPUNIT_ASSERT_EQUAL(4u, pool.free_count());
+    }
+
+    static int
+    count_starts(ule_packing_t packing, bool *aligned)
+    {
+      test_packet_source source(100, TEST_FRAMES);
+      ts_packetizer packetizer(ULE_PID, "TEST", PING_REPLY_OFF, IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0", NPD_OFF, DBIT_OFF, packing);
+      std::vector<unsigned char> out(MPEG2_PACKET_SIZE * 100);
+      int starts = 0;
+
+      packetizer.packetize(&out[0], out.size(), &source);
+      *aligned = true;
+      for (unsigned int i = 0; i < out.size(); i += MPEG2_PACKET_SIZE) {
+        const unsigned char *cell = &out[i];
+
+        if ((((cell[1] & 0x1f) << 8) | cell[2]) == ULE_PID && (cell[1] & 0x40)) {
+          starts++;
+          *aligned = *aligned && cell[TS_HEADER_SIZE] == 0;
+        }
+      }
+      return starts;
+    }
+
+    /* unpacked, every SNDU starts its own cell */
+    void
+    qa_sndu_encap::t3_packing()
+    {
+      bool aligned;
+
+      CPPUNIT_ASSERT_EQUAL(TEST_FRAMES, count_starts(PACKING_OFF, &aligned));
+      CPPUNIT_ASSERT(aligned);
+      CPPUNIT_ASSERT(count_starts(PACKING_ON, &aligned) < TEST_FRAMES);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
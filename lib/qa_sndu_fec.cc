@@ -0,0 +1,236 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "qa_sndu_fec.h"
+#include "gf256.h"
+#include "sndu_fec.h"
+
+namespace gr {
+  namespace ule {
+
+    /* hands out a fixed list of SNDUs, then runs dry */
+    class test_sndu_source : public sndu_source
+    {
+     private:
+      packet_pool pool;
+      std::vector<std::vector<unsigned char> > sndus;
+      unsigned int next;
+
+     public:
+      test_sndu_source(int count) : pool(4), next(0)
+      {
+        sndu_rewrite rewrite;
+        packet_desc *desc;
+        unsigned int len;
+
+        memset(&rewrite, 0, sizeof(rewrite));
+        for (int i = 0; i < count; i++) {
+          len = 60 + (rand() % 1400);
+          desc = pool.alloc();
+          for (unsigned int j = 0; j < len; j++) {
+            desc->data[j] = rand() & 0xff;
+          }
+          desc->data[12] = 0x08;
+          desc->data[13] = 0x00;
+          desc->length = len;
+          desc = build_sndu(desc, rewrite);
+          sndus.push_back(std::vector<unsigned char>(desc->data, desc->data + desc->length));
+          desc->release();
+        }
+      }
+
+      const std::vector<std::vector<unsigned char> > &all() const { return sndus; }
+      packet_pool *get_pool() { return &pool; }
+
+      packet_desc *next_sndu(const sndu_rewrite &rewrite)
+      {
+        packet_desc *desc;
+
+        if (next == sndus.size()) {
+          return NULL;
+        }
+        desc = pool.alloc();
+        desc->length = sndus[next].size();
+        memcpy(desc->data, &sndus[next++][0], desc->length);
+        return desc;
+      }
+    };
+
+    static std::vector<std::vector<unsigned char> >
+    encode(test_sndu_source &source, int k, int r)
+    {
+      std::vector<std::vector<unsigned char> > stream;
+      fec_sndu_source fec(&source, source.get_pool(), k, r);
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+      uint64_t now = FEC_MAX_BLOCK_AGE;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      while ((desc = fec.next_sndu(rewrite, now)) != NULL) {
+        stream.push_back(std::vector<unsigned char>(desc->data, desc->data + desc->length));
+        desc->release();
+      }
+      /* a partial block waits out its latency budget */
+      now += FEC_MAX_BLOCK_AGE;
+      while ((desc = fec.next_sndu(rewrite, now)) != NULL) {
+        stream.push_back(std::vector<unsigned char>(desc->data, desc->data + desc->length));
+        desc->release();
+      }
+      /* every buffer came back */
+      CPPUNIT_ASSERT_EQUAL(4u, source.get_pool()->free_count());
+      return stream;
+    }
+
+    static std::vector<std::vector<unsigned char> >
+    decode(const std::vector<std::vector<unsigned char> > &stream, const std::vector<int> &drop, sndu_fec_decoder &decoder)
+    {
+      std::vector<std::vector<unsigned char> > received;
+      std::vector<unsigned char> sndu;
+
+      for (unsigned int i = 0; i < stream.size(); i++) {
+        if (std::find(drop.begin(), drop.end(), (int)i) == drop.end()) {
+          decoder.push(&stream[i][0], stream[i].size());
+        }
+        while (decoder.pop(sndu)) {
+          received.push_back(sndu);
+        }
+      }
+      return received;
+    }
+
+    void
+    qa_sndu_fec::t1_gf256()
+    {
+      unsigned char src[100], dst[100], ref[100];
+
+      for (int a = 1; a < 256; a++) {
+        CPPUNIT_ASSERT_EQUAL(1, (int)gf256_mul(a, gf256_inv(a)));
+      }
+      for (int i = 0; i < 100; i++) {
+        src[i] = rand() & 0xff;
+        dst[i] = ref[i] = rand() & 0xff;
+        ref[i] ^= gf256_mul(0x53, src[i]);
+      }
+      gf256_region_madd(dst, src, 0x53, 100);
+      CPPUNIT_ASSERT(memcmp(dst, ref, 100) == 0);
+    }
+
+    void
+    qa_sndu_fec::t2_no_loss()
+    {
+      test_sndu_source source(32);
+      sndu_fec_decoder decoder;
+      std::vector<std::vector<unsigned char> > stream = encode(source, 8, 2);
+      std::vector<std::vector<unsigned char> > received = decode(stream, std::vector<int>(), decoder);
+
+      CPPUNIT_ASSERT_EQUAL((size_t)40, stream.size());
+      CPPUNIT_ASSERT(received == source.all());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, decoder.get_recovered());
+    }
+
+    void
+    qa_sndu_fec::t3_recover()
+    {
+      test_sndu_source source(32);
+      sndu_fec_decoder decoder;
+      std::vector<std::vector<unsigned char> > stream = encode(source, 8, 3);
+      std::vector<int> drop;
+
+      /* three sources of the first block, a source and a repair of the second */
+      drop.push_back(0);
+      drop.push_back(4);
+      drop.push_back(7);
+      drop.push_back(13);
+      drop.push_back(19);
+      std::vector<std::vector<unsigned char> > received = decode(stream, drop, decoder);
+      std::vector<std::vector<unsigned char> > expected = source.all();
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4, decoder.get_recovered());
+      std::sort(received.begin(), received.end());
+      std::sort(expected.begin(), expected.end());
+      CPPUNIT_ASSERT(received == expected);
+    }
+
+    void
+    qa_sndu_fec::t4_partial_block()
+    {
+      test_sndu_source source(5);
+      sndu_fec_decoder decoder;
+      std::vector<std::vector<unsigned char> > stream = encode(source, 16, 8);
+      std::vector<int> drop;
+
+      /* the block closed after 5 SNDUs with ceil(8 * 5 / 16) repairs */
+      CPPUNIT_ASSERT_EQUAL((size_t)8, stream.size());
+      CPPUNIT_ASSERT_EQUAL(3, (int)stream[5][7]);
+      drop.push_back(1);
+      drop.push_back(3);
+      std::vector<std::vector<unsigned char> > received = decode(stream, drop, decoder);
+      std::vector<std::vector<unsigned char> > expected = source.all();
+
+      std::sort(received.begin(), received.end());
+      std::sort(expected.begin(), expected.end());
+      CPPUNIT_ASSERT(received == expected);
+
+      /* one more loss than there are repairs cannot be rebuilt */
+      sndu_fec_decoder short_decoder;
+      drop.push_back(0);
+      drop.push_back(4);
+      received = decode(stream, drop, short_decoder);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, received.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, short_decoder.get_recovered());
+    }
+
+    void
+    qa_sndu_fec::t5_block_age()
+    {
+      test_sndu_source source(5);
+      fec_sndu_source fec(&source, source.get_pool(), 16, 2);
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+      uint64_t start = 1000000;
+      int sources = 0;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      while ((desc = fec.next_sndu(rewrite, start)) != NULL) {
+        desc->release();
+        sources++;
+      }
+      CPPUNIT_ASSERT_EQUAL(5, sources);
+
+      /* no repairs while the block is inside its latency budget */
+      CPPUNIT_ASSERT(fec.next_sndu(rewrite, start + FEC_MAX_BLOCK_AGE - 1) == NULL);
+
+      /* then a single repair, 20% overhead rather than 40% */
+      desc = fec.next_sndu(rewrite, start + FEC_MAX_BLOCK_AGE);
+      CPPUNIT_ASSERT(desc != NULL);
+      CPPUNIT_ASSERT_EQUAL(ULE_TYPE_FEC_REPAIR, (desc->data[2] << 8) | desc->data[3]);
+      CPPUNIT_ASSERT_EQUAL(1, (int)desc->data[7]);
+      desc->release();
+      CPPUNIT_ASSERT(fec.next_sndu(rewrite, start + FEC_MAX_BLOCK_AGE) == NULL);
+      CPPUNIT_ASSERT_EQUAL(4u, source.get_pool()->free_count());
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
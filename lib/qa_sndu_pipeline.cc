@@ -0,0 +1,143 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include <boost/thread.hpp>
+#include "qa_sndu_pipeline.h"
+#include "sndu_pipeline.h"
+
+#define TEST_FRAMES 5000
+#define TEST_WORKERS 4
+
+namespace gr {
+  namespace ule {
+
+    /* numbered frames of varying length, counting what was taken */
+    class numbered_source : public packet_source
+    {
+     private:
+      packet_pool pool;
+      uint32_t total;
+
+     public:
+      uint32_t taken;
+
+      numbered_source(uint32_t total, unsigned int buffers) : pool(buffers), total(total), taken(0) {}
+
+      packet_desc *next_packet(void)
+      {
+        packet_desc *desc;
+
+        if (taken == total || (desc = pool.alloc()) == NULL) {
+          return NULL;
+        }
+        desc->length = sizeof(struct ether_header) + 20 + (taken * 37) % 1400;
+        memset(desc->data, 0x02, desc->length);
+        desc->data[12] = 0x08;
+        desc->data[13] = 0x00;
+        memcpy(desc->data + sizeof(struct ether_header), &taken, sizeof(taken));
+        taken++;
+        return desc;
+      }
+    };
+
+    /* stalls some frames so the workers finish out of order */
+    static packet_desc *
+    uneven_build(packet_desc *desc, const sndu_rewrite &rewrite)
+    {
+      uint32_t seq;
+
+      memcpy(&seq, desc->data + sizeof(struct ether_header), sizeof(seq));
+      if (seq % 7 == 0) {
+        boost::this_thread::sleep(boost::posix_time::microseconds(50 + (seq % 5) * 50));
+      }
+      return build_sndu(desc, rewrite);
+    }
+
+    static uint32_t
+    sndu_seq(packet_desc *desc)
+    {
+      uint32_t seq;
+
+      /* after the ULE header and NPA address */
+      memcpy(&seq, desc->data + SNDU_BASE_HEADER_SIZE + ETHER_ADDR_LEN, sizeof(seq));
+      return seq;
+    }
+
+    void
+    qa_sndu_pipeline::t1_order()
+    {
+      numbered_source source(TEST_FRAMES, TEST_WORKERS * PIPELINE_AHEAD + 1);
+      sndu_pipeline pipeline(&source, TEST_WORKERS);
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+      uint32_t expected = 0;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      rewrite.build = uneven_build;
+      pipeline.start();
+      while (expected < TEST_FRAMES) {
+        desc = pipeline.next_sndu(rewrite);
+        if (desc == NULL) {
+          continue;
+        }
+        CPPUNIT_ASSERT_EQUAL(expected, sndu_seq(desc));
+        CPPUNIT_ASSERT_EQUAL(0u, sndu_crc32(desc->data, desc->length));
+        desc->release();
+        expected++;
+        /* a restart picks up where it stopped */
+        if (expected == TEST_FRAMES / 2) {
+          pipeline.stop();
+          pipeline.start();
+        }
+      }
+      pipeline.stop();
+      CPPUNIT_ASSERT(pipeline.next_sndu(rewrite) == NULL);
+      CPPUNIT_ASSERT_EQUAL(0u, pipeline.in_flight());
+    }
+
+    void
+    qa_sndu_pipeline::t2_window()
+    {
+      numbered_source source(TEST_FRAMES, TEST_FRAMES);
+      sndu_pipeline pipeline(&source, TEST_WORKERS);
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      rewrite.build = uneven_build;
+      CPPUNIT_ASSERT_EQUAL((unsigned int)(TEST_WORKERS * PIPELINE_AHEAD), pipeline.get_depth());
+      pipeline.start();
+      /* the rest stays with the source, whatever it has ready */
+      for (uint32_t i = 0; i < 100; i++) {
+        desc = pipeline.next_sndu(rewrite);
+        CPPUNIT_ASSERT(desc != NULL);
+        CPPUNIT_ASSERT_EQUAL(i, sndu_seq(desc));
+        desc->release();
+        CPPUNIT_ASSERT(source.taken - (i + 1) <= pipeline.get_depth());
+        CPPUNIT_ASSERT(pipeline.in_flight() <= pipeline.get_depth());
+      }
+      pipeline.stop();
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
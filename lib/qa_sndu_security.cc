@@ -0,0 +1,158 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include "qa_sndu_security.h"
+#include "packet_pool.h"
+#include "sndu_builder.h"
+#include "sndu_security.h"
+
+#define TEST_KEY_128 "000102030405060708090a0b0c0d0e0f10111213"
+#define TEST_KEY_256 "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f20212223"
+#define TEST_SPI 0x35
+#define TEST_FRAME_SIZE 100
+
+namespace gr {
+  namespace ule {
+
+    static void
+    test_frame(unsigned char *frame, unsigned int len)
+    {
+      static const unsigned char dst[ETHER_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+      memcpy(frame, dst, ETHER_ADDR_LEN);
+      memset(frame + ETHER_ADDR_LEN, 0, ETHER_ADDR_LEN);
+      frame[12] = 0x08;
+      frame[13] = 0x00;
+      for (unsigned int i = sizeof(struct ether_header); i < len; i++) {
+        frame[i] = i & 0xff;
+      }
+    }
+
+    static unsigned int
+    seal(sndu_security *security, const unsigned char *frame, unsigned int len, unsigned char *sndu)
+    {
+      packet_pool pool(1);
+      sndu_rewrite rewrite;
+      packet_desc *desc;
+      unsigned int length;
+
+      memset(&rewrite, 0, sizeof(rewrite));
+      rewrite.security = security;
+      desc = pool.alloc();
+      memcpy(desc->data, frame, len);
+      desc->length = len;
+      desc = build_sndu(desc, rewrite);
+      CPPUNIT_ASSERT(desc != NULL);
+      length = desc->length;
+      memcpy(sndu, desc->data, length);
+      desc->release();
+      return length;
+    }
+
+    void
+    qa_sndu_security::t1_round_trip()
+    {
+      sndu_security tx128(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      sndu_security rx128(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      sndu_security tx256(SECURITY_AES256_GCM, TEST_KEY_256, TEST_SPI);
+      sndu_security rx256(SECURITY_AES256_GCM, TEST_KEY_256, TEST_SPI);
+      unsigned char frame[ULE_MAX_FRAME_SIZE], sndu[SNDU_MAX_SIZE], out[ULE_MAX_FRAME_SIZE];
+      unsigned int length;
+
+      test_frame(frame, ULE_MAX_FRAME_SIZE);
+      length = seal(&tx128, frame, TEST_FRAME_SIZE, sndu);
+      CPPUNIT_ASSERT(length > TEST_FRAME_SIZE);
+      CPPUNIT_ASSERT_EQUAL(ULE_TYPE_SECURITY, (sndu[2] << 8) | sndu[3]);
+      /* the payload is not sent in clear */
+      CPPUNIT_ASSERT(memcmp(sndu + length - SNDU_CRC_SIZE - SEC_TAG_SIZE - 32, frame + TEST_FRAME_SIZE - 32, 32) != 0);
+      CPPUNIT_ASSERT_EQUAL((unsigned int)TEST_FRAME_SIZE, rx128.open(sndu, length, out));
+      CPPUNIT_ASSERT(memcmp(frame, out, TEST_FRAME_SIZE) == 0);
+
+      length = seal(&tx256, frame, ULE_MAX_FRAME_SIZE, sndu);
+      CPPUNIT_ASSERT(length <= SNDU_MAX_SIZE);
+      CPPUNIT_ASSERT_EQUAL((unsigned int)ULE_MAX_FRAME_SIZE, rx256.open(sndu, length, out));
+      CPPUNIT_ASSERT(memcmp(frame, out, ULE_MAX_FRAME_SIZE) == 0);
+    }
+
+    void
+    qa_sndu_security::t2_tamper()
+    {
+      sndu_security tx(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      sndu_security rx(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      sndu_security wrong(SECURITY_AES128_GCM, "ff0102030405060708090a0b0c0d0e0f10111213", TEST_SPI);
+      unsigned char frame[TEST_FRAME_SIZE], sndu[SNDU_MAX_SIZE], out[ULE_MAX_FRAME_SIZE];
+      unsigned int length, crc32;
+
+      test_frame(frame, TEST_FRAME_SIZE);
+      length = seal(&tx, frame, TEST_FRAME_SIZE, sndu);
+      CPPUNIT_ASSERT_EQUAL(0U, wrong.open(sndu, length, out));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, wrong.get_auth_failures());
+
+      /* flip a ciphertext bit and repair the CRC, GCM must catch it */
+      sndu[40] ^= 0x01;
+      crc32 = sndu_crc32(sndu, length - SNDU_CRC_SIZE);
+      sndu[length - 4] = (crc32 >> 24) & 0xff;
+      sndu[length - 3] = (crc32 >> 16) & 0xff;
+      sndu[length - 2] = (crc32 >> 8) & 0xff;
+      sndu[length - 1] = crc32 & 0xff;
+      CPPUNIT_ASSERT_EQUAL(0U, rx.open(sndu, length, out));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, rx.get_auth_failures());
+
+      /* the untouched SNDU still opens, the failure did not move the window */
+      sndu[40] ^= 0x01;
+      crc32 = sndu_crc32(sndu, length - SNDU_CRC_SIZE);
+      sndu[length - 4] = (crc32 >> 24) & 0xff;
+      sndu[length - 3] = (crc32 >> 16) & 0xff;
+      sndu[length - 2] = (crc32 >> 8) & 0xff;
+      sndu[length - 1] = crc32 & 0xff;
+      CPPUNIT_ASSERT_EQUAL((unsigned int)TEST_FRAME_SIZE, rx.open(sndu, length, out));
+    }
+
+    void
+    qa_sndu_security::t3_replay()
+    {
+      sndu_security tx(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      sndu_security rx(SECURITY_AES128_GCM, TEST_KEY_128, TEST_SPI);
+      unsigned char frame[TEST_FRAME_SIZE], out[ULE_MAX_FRAME_SIZE];
+      static unsigned char sndus[SEC_REPLAY_WINDOW + 2][SNDU_MAX_SIZE];
+      unsigned int lengths[SEC_REPLAY_WINDOW + 2];
+
+      test_frame(frame, TEST_FRAME_SIZE);
+      for (int i = 0; i < SEC_REPLAY_WINDOW + 2; i++) {
+        lengths[i] = seal(&tx, frame, TEST_FRAME_SIZE, sndus[i]);
+      }
+      /* out of order inside the window is accepted once */
+      CPPUNIT_ASSERT(rx.open(sndus[5], lengths[5], out) != 0);
+      CPPUNIT_ASSERT(rx.open(sndus[2], lengths[2], out) != 0);
+      CPPUNIT_ASSERT_EQUAL(0U, rx.open(sndus[2], lengths[2], out));
+      CPPUNIT_ASSERT_EQUAL(0U, rx.open(sndus[5], lengths[5], out));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, rx.get_replays());
+
+      /* once the window has moved on, older SNDUs are refused */
+      CPPUNIT_ASSERT(rx.open(sndus[SEC_REPLAY_WINDOW + 1], lengths[SEC_REPLAY_WINDOW + 1], out) != 0);
+      CPPUNIT_ASSERT_EQUAL(0U, rx.open(sndus[0], lengths[0], out));
+      CPPUNIT_ASSERT(rx.open(sndus[SEC_REPLAY_WINDOW], lengths[SEC_REPLAY_WINDOW], out) != 0);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
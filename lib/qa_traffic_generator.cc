@@ -0,0 +1,103 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <cstring>
+#include "qa_traffic_generator.h"
+#include "traffic_generator.h"
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char dst_mac[ETHER_ADDR_LEN] = {0x02, 0x00, 0x48, 0x55, 0x4c, 0x45};
+
+    static bool
+    ip_checksum_ok(const unsigned char *frame)
+    {
+      const unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned int sum = 0;
+
+      for (int i = 0; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+      }
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum += sum >> 16;
+      return sum == 0xffff;
+    }
+
+    /* the same seed gives the same frames */
+    void
+    qa_traffic_generator::t1_repeatable()
+    {
+      traffic_generator a(TRAFFIC_IMIX, 1000000, 64, 1514, 7, dst_mac);
+      traffic_generator b(TRAFFIC_IMIX, 1000000, 64, 1514, 7, dst_mac);
+      unsigned char fa[GEN_MAX_FRAME], fb[GEN_MAX_FRAME];
+      unsigned int la, lb;
+      double due;
+
+      for (int i = 0; i < 1000; i++) {
+        la = a.next_frame(fa, &due);
+        lb = b.next_frame(fb, &due);
+        CPPUNIT_ASSERT_EQUAL(la, lb);
+        CPPUNIT_ASSERT(memcmp(fa, fb, la) == 0);
+        CPPUNIT_ASSERT(memcmp(fa, dst_mac, ETHER_ADDR_LEN) == 0);
+        CPPUNIT_ASSERT(ip_checksum_ok(fa));
+      }
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, a.get_generated());
+    }
+
+    /* 60, 590 and 1514 byte frames in the ratio 7:4:1 */
+    void
+    qa_traffic_generator::t2_imix()
+    {
+      traffic_generator gen(TRAFFIC_IMIX, 1000000, 16, 1514, 1, dst_mac);
+      unsigned char frame[GEN_MAX_FRAME];
+      int count[3] = {0, 0, 0};
+      unsigned int length;
+      double due;
+
+      for (int i = 0; i < 120000; i++) {
+        length = gen.next_frame(frame, &due);
+        CPPUNIT_ASSERT(length == 60 || length == 590 || length == 1514);
+        count[length == 60 ? 0 : (length == 590 ? 1 : 2)]++;
+      }
+      CPPUNIT_ASSERT(count[0] > 69000 && count[0] < 71000);
+      CPPUNIT_ASSERT(count[1] > 39000 && count[1] < 41000);
+      CPPUNIT_ASSERT(count[2] > 9500 && count[2] < 10500);
+    }
+
+    /* fixed frames are spaced exactly one frame time apart */
+    void
+    qa_traffic_generator::t3_pacing()
+    {
+      traffic_generator gen(TRAFFIC_FIXED, 8000000, 1, 1000, 1, dst_mac);
+      unsigned char frame[GEN_MAX_FRAME];
+      double first, due;
+
+      CPPUNIT_ASSERT_EQUAL(1000u, gen.next_frame(frame, &first));
+      for (int i = 1; i < 50; i++) {
+        gen.next_frame(frame, &due);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(first + i * 0.001, due, 1e-9);
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "qa_ts_conformance.h"
+#include "ts_conformance.h"
+#include "sndu_builder.h"
+
+#define TEST_RATE 10000000
+#define TEST_PMT_PID 0x30
+#define TEST_DATA_PID 0x35
+
+namespace gr {
+  namespace ule {
+
+    static void
+    make_cell(unsigned char *cell, int pid, int cc, bool start)
+    {
+      memset(cell, 0xff, MPEG2_PACKET_SIZE);
+      cell[0] = TS_SYNC_BYTE;
+      cell[1] = (start ? 0x40 : 0x00) | ((pid >> 8) & 0x1f);
+      cell[2] = pid & 0xff;
+      cell[3] = 0x10 | (cc & 0xf);
+    }
+
+    /* one section per cell, table_id 0x00 for the PAT or 0x02 */
+    static void
+    make_section(unsigned char *cell, int pid, int cc, int table_id)
+    {
+      unsigned char *section = cell + 5;
+      unsigned int crc;
+
+      make_cell(cell, pid, cc, true);
+      cell[4] = 0;
+      section[0] = table_id;
+      section[1] = 0xb0;
+      section[2] = 13;
+      memset(section + 3, 0, 5);
+      section[8] = 0x00;
+      section[9] = 0x01;
+      section[10] = 0xe0 | (TEST_PMT_PID >> 8);
+      section[11] = TEST_PMT_PID & 0xff;
+      crc = sndu_crc32(section, 12);
+      section[12] = crc >> 24;
+      section[13] = (crc >> 16) & 0xff;
+      section[14] = (crc >> 8) & 0xff;
+      section[15] = crc & 0xff;
+    }
+
+    static std::vector<unsigned char>
+    make_stream(int cells)
+    {
+      std::vector<unsigned char> stream(cells * MPEG2_PACKET_SIZE);
+
+      for (int i = 0; i < cells; i++) {
+        make_cell(&stream[i * MPEG2_PACKET_SIZE], TEST_DATA_PID, i, false);
+      }
+      return stream;
+    }
+
+    /* sync is found in odd sized, misaligned pieces and lost on 2 bad bytes */
+    void
+    qa_ts_conformance::t1_sync()
+    {
+      ts_conformance analyzer(TEST_RATE);
+      std::vector<unsigned char> stream = make_stream(1000);
+      unsigned int offset = 0, length;
+
+      stream.insert(stream.begin(), 77, TS_SYNC_BYTE);
+      stream[77 + 500 * MPEG2_PACKET_SIZE] = 0x00;
+      stream[77 + 501 * MPEG2_PACKET_SIZE] = 0x00;
+      for (int i = 0; offset < stream.size(); i++) {
+        length = std::min((unsigned int)(stream.size() - offset), 1u + (i * 97) % 400);
+        analyzer.analyze(&stream[offset], length);
+        offset += length;
+      }
+      CPPUNIT_ASSERT(analyzer.get_sync());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, analyzer.get_errors(CHECK_SYNC_BYTE));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, analyzer.get_errors(CHECK_SYNC_LOSS));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, analyzer.get_errors(CHECK_CC));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)998, analyzer.get_pid_cells(TEST_DATA_PID));
+    }
+
+    void
+    qa_ts_conformance::t2_continuity()
+    {
+      ts_conformance analyzer(TEST_RATE);
+      std::vector<unsigned char> stream = make_stream(100);
+      unsigned char copy[MPEG2_PACKET_SIZE];
+
+      /* a lost cell, an allowed duplicate, then two in a row */
+      stream.erase(stream.begin() + 10 * MPEG2_PACKET_SIZE, stream.begin() + 11 * MPEG2_PACKET_SIZE);
+      memcpy(copy, &stream[40 * MPEG2_PACKET_SIZE], MPEG2_PACKET_SIZE);
+      stream.insert(stream.begin() + 41 * MPEG2_PACKET_SIZE, copy, copy + MPEG2_PACKET_SIZE);
+      memcpy(copy, &stream[70 * MPEG2_PACKET_SIZE], MPEG2_PACKET_SIZE);
+      stream.insert(stream.begin() + 71 * MPEG2_PACKET_SIZE, copy, copy + MPEG2_PACKET_SIZE);
+      stream.insert(stream.begin() + 71 * MPEG2_PACKET_SIZE, copy, copy + MPEG2_PACKET_SIZE);
+      /* an adaptation only cell keeps the counter */
+      memcpy(copy, &stream[89 * MPEG2_PACKET_SIZE], MPEG2_PACKET_SIZE);
+      copy[3] = 0x20 | (copy[3] & 0x0f);
+      copy[4] = 183;
+      copy[5] = 0x00;
+      stream.insert(stream.begin() + 90 * MPEG2_PACKET_SIZE, copy, copy + MPEG2_PACKET_SIZE);
+      analyzer.analyze(&stream[0], stream.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, analyzer.get_errors(CHECK_CC));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, analyzer.get_pid_cc_errors(TEST_DATA_PID));
+      analyzer.gap(10 * MPEG2_PACKET_SIZE);
+      analyzer.analyze(&stream[0], stream.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4, analyzer.get_errors(CHECK_CC));
+    }
+
+    /* PAT and PMT every 0.1 s pass, a bad CRC and a 0.6 s hole do not */
+    void
+    qa_ts_conformance::t3_psi()
+    {
+      ts_conformance analyzer(TEST_RATE);
+      int period = (int)(0.1 * TEST_RATE / (MPEG2_PACKET_SIZE * 8));
+      int cells = 40 * period;
+      std::vector<unsigned char> stream = make_stream(cells);
+      int pat_cc = 0, pmt_cc = 0;
+
+      for (int i = 0; i < cells; i += period) {
+        if (i >= 20 * period && i < 26 * period) {
+          continue;
+        }
+        make_section(&stream[i * MPEG2_PACKET_SIZE], 0, pat_cc++, 0x00);
+        make_section(&stream[(i + 1) * MPEG2_PACKET_SIZE], TEST_PMT_PID, pmt_cc++, 0x02);
+      }
+      stream[(30 * period + 1) * MPEG2_PACKET_SIZE + 12] ^= 0x01;
+      analyzer.analyze(&stream[0], stream.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, analyzer.get_errors(CHECK_CRC));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, analyzer.get_errors(CHECK_PAT));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, analyzer.get_errors(CHECK_PMT));
+      CPPUNIT_ASSERT(analyzer.get_pid_bitrate(TEST_DATA_PID) > 0);
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -26,11 +26,37 @@
  */
 
 #include "qa_ule.h"
+#include "qa_reed_solomon.h"
+#include "qa_sndu_security.h"
+#include "qa_sndu_compress.h"
+#include "qa_sndu_fec.h"
+#include "qa_traffic_generator.h"
+#include "qa_ts_conformance.h"
+#include "qa_packet_pool.h"
+#include "qa_sndu_encap.h"
+#include "qa_multicast_filter.h"
+#include "qa_arp_proxy.h"
+#include "qa_fq_codel.h"
+#include "qa_plp_classifier.h"
+#include "qa_sndu_pipeline.h"
 
 CppUnit::TestSuite *
 qa_ule::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("ule");
+  s->addTest(gr::ule::qa_reed_solomon::suite());
+  s->addTest(gr::ule::qa_sndu_security::suite());
+  s->addTest(gr::ule::qa_sndu_compress::suite());
+  s->addTest(gr::ule::qa_sndu_fec::suite());
+  s->addTest(gr::ule::qa_traffic_generator::suite());
+  s->addTest(gr::ule::qa_ts_conformance::suite());
+  s->addTest(gr::ule::qa_packet_pool::suite());
+  s->addTest(gr::ule::qa_sndu_encap::suite());
+  s->addTest(gr::ule::qa_multicast_filter::suite());
+  s->addTest(gr::ule::qa_arp_proxy::suite());
+  s->addTest(gr::ule::qa_fq_codel::suite());
+  s->addTest(gr::ule::qa_plp_classifier::suite());
+  s->addTest(gr::ule::qa_sndu_pipeline::suite());
 
   return s;
 }
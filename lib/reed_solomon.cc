@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "gf256.h"
+#include "reed_solomon.h"
+
+namespace gr {
+  namespace ule {
+
+    reed_solomon::reed_solomon(int parity)
+    {
+      if (parity < 1 || parity > RS_MAX_PARITY) {
+        throw std::runtime_error("Reed-Solomon parity length out of range\n");
+      }
+      this->parity = parity;
+
+      /* g(x) = (x - alpha^0)(x - alpha^1) ... highest coefficient first */
+      memset(generator, 0, sizeof(generator));
+      generator[0] = 1;
+      for (int i = 0; i < parity; i++) {
+        for (int j = i + 1; j > 0; j--) {
+          generator[j] ^= gf256_mul(generator[j - 1], gf256_exp(i));
+        }
+      }
+    }
+
+    /* parity bytes of length data bytes, written to out */
+    void
+    reed_solomon::encode(const unsigned char *data, int length, unsigned char *out) const
+    {
+      unsigned char feedback;
+
+      memset(out, 0, parity);
+      for (int i = 0; i < length; i++) {
+        feedback = data[i] ^ out[0];
+        memmove(out, out + 1, parity - 1);
+        out[parity - 1] = 0;
+        gf256_region_madd(out, generator + 1, feedback, parity);
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_REED_SOLOMON_H
+#define INCLUDED_ULE_REED_SOLOMON_H
+
+#define RS_MAX_PARITY 32
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Systematic Reed-Solomon encoder over GF(256) with the field
+     * polynomial x^8 + x^4 + x^3 + x^2 + 1 and generator roots
+     * alpha^0 .. alpha^(parity - 1), as in ETSI EN 300 744. Shortened
+     * codes such as RS(204,188) need no padding, the leading zeros do
+     * not change the parity. The field arithmetic is the one in
+     * gf256.h.
+     */
+    class reed_solomon
+    {
+     private:
+      int parity;
+      unsigned char generator[RS_MAX_PARITY + 1];
+
+     public:
+      reed_solomon(int parity);
+
+      void encode(const unsigned char *data, int length, unsigned char *out) const;
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_REED_SOLOMON_H */
@@ -0,0 +1,227 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <boost/static_assert.hpp>
+#include "sndu_builder.h"
+#include "crc32.h"
+#include "sndu_security.h"
+#include "sndu_compress.h"
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+    BOOST_STATIC_ASSERT(POOL_HEADROOM >= SEC_SEAL_OFFSET);
+    BOOST_STATIC_ASSERT(POOL_HEADROOM + ULE_MAX_FRAME_SIZE + SNDU_CRC_SIZE + SNDU_SECURITY_OVERHEAD - SEC_SEAL_OFFSET <= POOL_BUFFER_SIZE);
+
+    unsigned int
+    sndu_crc32(const unsigned char *buf, int size)
+    {
+      profile_scope profile(PROFILE_CRC);
+      return crc32_mpeg2(buf, size);
+    }
+
+    static int
+    checksum(unsigned short *addr, int count, int sum)
+    {
+      while (count > 1) {
+        sum += *addr++;
+        count -= 2;
+      }
+      if (count > 0) {
+        sum += *(unsigned char *)addr;
+      }
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum += (sum >> 16);
+      return (~sum);
+    }
+
+    void
+    rewrite_ping_reply(unsigned char *frame)
+    {
+      unsigned short *csum_ptr;
+      unsigned short header_length, total_length, type_code, fragment_offset;
+      int csum;
+      struct ip *ip_ptr;
+      unsigned char *saddr_ptr, *daddr_ptr;
+      unsigned char addr[sizeof(in_addr)];
+
+      /* jam ping reply and calculate new checksum */
+      ip_ptr = (struct ip*)(frame + sizeof(struct ether_header));
+      csum_ptr = (unsigned short *)ip_ptr;
+      header_length = (*csum_ptr & 0xf) * 4;
+      csum_ptr = &ip_ptr->ip_len;
+      total_length = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
+      csum_ptr = &ip_ptr->ip_off;
+      fragment_offset = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
+
+      csum_ptr = (unsigned short *)(frame + sizeof(struct ether_header) + sizeof(struct ip));
+      type_code = *csum_ptr;
+      type_code = (type_code & 0xff00) | 0x0;
+      if ((fragment_offset & 0x1fff) == 0) {
+        *csum_ptr++ = type_code;
+        *csum_ptr = 0x0000;
+        csum_ptr = (unsigned short *)(frame + sizeof(struct ether_header) + sizeof(struct ip));
+        csum = checksum(csum_ptr, total_length - header_length, 0);
+        csum_ptr++;
+        *csum_ptr = csum;
+      }
+
+      /* swap IP adresses */
+      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
+      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
+      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
+        addr[i] = *daddr_ptr++;
+      }
+      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
+      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
+        *daddr_ptr++ = *saddr_ptr++;
+      }
+      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
+      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
+        *saddr_ptr++ = addr[i];
+      }
+    }
+
+    void
+    rewrite_ipaddr_spoof(unsigned char *frame, const unsigned char *src_addr, const unsigned char *dst_addr)
+    {
+      unsigned short *csum_ptr;
+      unsigned short header_length, fragment_offset;
+      int csum;
+      struct ip *ip_ptr;
+      unsigned char *saddr_ptr, *daddr_ptr;
+
+      ip_ptr = (struct ip*)(frame + sizeof(struct ether_header));
+
+      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
+      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
+        *saddr_ptr++ = src_addr[i];
+      }
+
+      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
+      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
+        *daddr_ptr++ = dst_addr[i];
+      }
+
+      csum_ptr = (unsigned short *)ip_ptr;
+      header_length = (*csum_ptr & 0xf) * 4;
+      csum_ptr = &ip_ptr->ip_off;
+      fragment_offset = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
+
+      if ((fragment_offset & 0x1fff) == 0) {
+        csum_ptr = &ip_ptr->ip_sum;
+        *csum_ptr = 0x0000;
+        csum_ptr = (unsigned short *)ip_ptr;
+        csum = checksum(csum_ptr, header_length, 0);
+        csum_ptr = &ip_ptr->ip_sum;
+        *csum_ptr = csum;
+
+        csum_ptr = (unsigned short *)(frame + sizeof(struct ether_header) + sizeof(struct ip) + 6);
+        *csum_ptr = 0x0000;
+      }
+    }
+
+    static inline void
+    apply_rewrites(unsigned char *frame, const sndu_rewrite &rewrite)
+    {
+      if (!rewrite.ping_reply && !rewrite.ipaddr_spoof) {
+        return;
+      }
+      profile_scope profile(PROFILE_REWRITE);
+      if (rewrite.ping_reply) {
+        rewrite_ping_reply(frame);
+      }
+      if (rewrite.ipaddr_spoof) {
+        rewrite_ipaddr_spoof(frame, rewrite.src_addr, rewrite.dst_addr);
+      }
+    }
+
+    packet_desc *
+    build_sndu(packet_desc *desc, const sndu_rewrite &rewrite)
+    {
+      unsigned char *frame = desc->data;
+      unsigned int len = desc->length;
+      unsigned int length, crc32;
+      unsigned char type[2];
+      unsigned char *ptr;
+
+      if (len < sizeof(struct ether_header) || len > ULE_MAX_FRAME_SIZE) {
+        desc->release();
+        return NULL;
+      }
+      apply_rewrites(frame, rewrite);
+      if (rewrite.compress) {
+        len = rewrite.compress->compress(frame, len);
+      }
+      if (rewrite.security) {
+        desc->data = frame - SEC_SEAL_OFFSET;
+        desc->length = rewrite.security->seal(frame, len, desc->data);
+        return desc;
+      }
+
+      if (rewrite.dbit) {
+        /* the Ethertype is already where the type field goes */
+        ptr = frame + sizeof(struct ether_header) - SNDU_BASE_HEADER_SIZE;
+        length = len - sizeof(struct ether_header) + SNDU_CRC_SIZE;
+        ptr[0] = 0x80 | ((length >> 8) & 0x7f);    /* D bit set, no NPA address */
+        ptr[1] = length & 0xff;
+      }
+      else {
+        /* the destination address moves up over the source address */
+        type[0] = frame[2 * ETHER_ADDR_LEN];
+        type[1] = frame[2 * ETHER_ADDR_LEN + 1];
+        memcpy(frame + sizeof(struct ether_header) - ETHER_ADDR_LEN, frame, ETHER_ADDR_LEN);
+        ptr = frame + sizeof(struct ether_header) - SNDU_BASE_HEADER_SIZE - ETHER_ADDR_LEN;
+        length = len - sizeof(struct ether_header) + ETHER_ADDR_LEN + SNDU_CRC_SIZE;
+        ptr[0] = (length >> 8) & 0x7f;    /* D bit clear, NPA address present */
+        ptr[1] = length & 0xff;
+        ptr[2] = type[0];
+        ptr[3] = type[1];
+      }
+      desc->data = ptr;
+      ptr += length + SNDU_BASE_HEADER_SIZE - SNDU_CRC_SIZE;
+      crc32 = sndu_crc32(desc->data, ptr - desc->data);
+      *ptr++ = (crc32 >> 24) & 0xff;
+      *ptr++ = (crc32 >> 16) & 0xff;
+      *ptr++ = (crc32 >> 8) & 0xff;
+      *ptr++ = crc32 & 0xff;
+      desc->length = ptr - desc->data;
+      return desc;
+    }
+
+    packet_desc *
+    serial_sndu_source::next_sndu(const sndu_rewrite &rewrite)
+    {
+      packet_desc *desc;
+
+      while ((desc = source->next_packet()) != NULL) {
+        ULE_PROBE_SNDU_START(desc, desc->length);
+        desc = rewrite.build(desc, rewrite);
+        if (desc) {
+          return desc;
+        }
+      }
+      return NULL;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
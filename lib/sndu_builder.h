@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_BUILDER_H
+#define INCLUDED_ULE_SNDU_BUILDER_H
+
+#include <arpa/inet.h>
+#include <netinet/if_ether.h>
+#include <netinet/ip.h>
+#include "packet_source.h"
+
+#define SNDU_BASE_HEADER_SIZE 4
+#define SNDU_CRC_SIZE 4
+#define SNDU_SECURITY_OVERHEAD 28    /* SPI, sequence number and GCM tag */
+#define SNDU_MAX_SIZE (ULE_MAX_FRAME_SIZE + SNDU_BASE_HEADER_SIZE + SNDU_CRC_SIZE + SNDU_SECURITY_OVERHEAD)
+
+namespace gr {
+  namespace ule {
+
+    class sndu_security;
+    class sndu_compress;
+    struct sndu_rewrite;
+
+    typedef packet_desc *(*sndu_build_fn)(packet_desc *desc, const sndu_rewrite &rewrite);
+
+    /*
+     * Header rewrites applied to each frame before it is encapsulated.
+     * Addresses are in network byte order. With dbit set the SNDU
+     * carries no NPA address. With compress set the PDU is
+     * compressed after the rewrites, where it shrinks. With security
+     * set the SNDU is sealed with it, always with an NPA address.
+     * build is the specialised builder select_sndu_builder() picked
+     * for the other fields.
+     */
+    struct sndu_rewrite {
+      int ping_reply;
+      int ipaddr_spoof;
+      int dbit;
+      unsigned char src_addr[sizeof(in_addr)];
+      unsigned char dst_addr[sizeof(in_addr)];
+      sndu_security *security;
+      sndu_compress *compress;
+      sndu_build_fn build;
+    };
+
+    void rewrite_ping_reply(unsigned char *frame);
+    void rewrite_ipaddr_spoof(unsigned char *frame, const unsigned char *src_addr, const unsigned char *dst_addr);
+
+    /* MPEG-2 CRC32 as carried at the end of an SNDU, profiled as PROFILE_CRC */
+    unsigned int sndu_crc32(const unsigned char *buf, int size);
+
+    /*
+     * Build a complete SNDU (length, type, NPA destination address
+     * unless dbit is set, PDU and CRC32) in place on the Ethernet
+     * frame in desc. The SNDU header overwrites the tail of the 14
+     * byte Ethernet header so the PDU never moves, and a sealed SNDU
+     * is encrypted where it lies. Returns desc, or
+     * NULL with desc released if the frame cannot be encapsulated.
+     * This is the generic path, testing every option per frame. The
+     * encapsulators call rewrite.build instead.
+     */
+    packet_desc *build_sndu(packet_desc *desc, const sndu_rewrite &rewrite);
+
+    /*
+     * Anything that can hand complete SNDUs to the packetizer in
+     * order, as pool descriptors whose reference passes to the caller.
+     */
+    class sndu_source
+    {
+     public:
+      virtual ~sndu_source() {}
+      virtual packet_desc *next_sndu(const sndu_rewrite &rewrite) = 0;
+    };
+
+    /*
+     * Builds each SNDU on the calling thread with rewrite.build.
+     */
+    class serial_sndu_source : public sndu_source
+    {
+     private:
+      packet_source *source;
+
+     public:
+      serial_sndu_source(packet_source *source) : source(source) {}
+
+      packet_desc *next_sndu(const sndu_rewrite &rewrite);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_BUILDER_H */
@@ -0,0 +1,338 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <time.h>
+#include <netinet/if_ether.h>
+#include <netinet/in.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "packet_source.h"
+#include "sndu_compress.h"
+
+namespace gr {
+  namespace ule {
+
+#ifdef HAVE_ZSTD
+    struct compress_class {
+      int port;
+      ZSTD_CDict *cdict;
+      ZSTD_DDict *ddict;
+    };
+
+    struct compress_context {
+      ZSTD_CCtx *cctx;
+      ZSTD_DCtx *dctx;
+    };
+
+    static void
+    free_context(compress_context *ctx)
+    {
+      ZSTD_freeCCtx(ctx->cctx);
+      ZSTD_freeDCtx(ctx->dctx);
+      delete ctx;
+    }
+
+    static std::string
+    read_dictionary(const std::string &path)
+    {
+      std::ifstream file(path.c_str(), std::ios::binary);
+      std::string dict((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+      if (!file || dict.empty() || dict.size() > COMPRESS_MAX_DICT_SIZE) {
+        throw std::runtime_error("Cannot read compression dictionary " + path + "\n");
+      }
+      return dict;
+    }
+#else
+    struct compress_class {
+      int port;
+    };
+
+    struct compress_context {
+    };
+
+    static void
+    free_context(compress_context *ctx)
+    {
+      delete ctx;
+    }
+#endif
+
+    sndu_compress::sndu_compress(ule_compress_t mode, const std::string &classes)
+      : default_class(-1),
+        contexts(free_context),
+        decompress_context(NULL),
+        compressed(0),
+        skipped(0),
+        bytes_in(0),
+        bytes_out(0),
+        cpu_ns(0)
+    {
+      if (mode != COMPRESS_ZSTD) {
+        throw std::runtime_error("Unknown ULE compression mode\n");
+      }
+#ifndef HAVE_ZSTD
+      (void)classes;
+      throw std::runtime_error("ULE was built without zstd compression\n");
+#else
+      try {
+        parse_classes(classes);
+      }
+      catch (...) {
+        free_classes();
+        throw;
+      }
+#endif
+    }
+
+    sndu_compress::~sndu_compress()
+    {
+      free_classes();
+      if (decompress_context) {
+        free_context(decompress_context);
+      }
+    }
+
+    void
+    sndu_compress::parse_classes(const std::string &classes)
+    {
+#ifdef HAVE_ZSTD
+      size_t start = 0, end, equals;
+      compress_class *c;
+      char *rest;
+
+      while (start <= classes.size()) {
+        end = classes.find(',', start);
+        if (end == std::string::npos) {
+          end = classes.size();
+        }
+        std::string entry = classes.substr(start, end - start);
+        entry.erase(0, entry.find_first_not_of(" \t"));
+        entry.erase(entry.find_last_not_of(" \t") + 1);
+        start = end + 1;
+        if (entry.empty()) {
+          continue;
+        }
+        equals = entry.find('=');
+        std::string port = entry.substr(0, equals);
+        std::string path = equals == std::string::npos ? std::string() : entry.substr(equals + 1);
+        if (this->classes.size() == COMPRESS_MAX_CLASSES) {
+          throw std::runtime_error("Too many compression classes\n");
+        }
+        c = new compress_class;
+        c->cdict = NULL;
+        c->ddict = NULL;
+        this->classes.push_back(c);
+        if (port == "*") {
+          c->port = -1;
+          default_class = this->classes.size() - 1;
+        }
+        else {
+          c->port = strtol(port.c_str(), &rest, 10);
+          if (port.empty() || *rest != '\0' || c->port < 0 || c->port > 65535) {
+            throw std::runtime_error("Invalid compression class " + entry + "\n");
+          }
+        }
+        if (!path.empty()) {
+          std::string dict = read_dictionary(path);
+          c->cdict = ZSTD_createCDict(dict.data(), dict.size(), COMPRESS_LEVEL);
+          c->ddict = ZSTD_createDDict(dict.data(), dict.size());
+          if (c->cdict == NULL || c->ddict == NULL) {
+            throw std::runtime_error("Invalid compression dictionary " + path + "\n");
+          }
+        }
+      }
+      if (this->classes.empty()) {
+        throw std::runtime_error("No compression classes\n");
+      }
+#else
+      (void)classes;
+#endif
+    }
+
+    void
+    sndu_compress::free_classes(void)
+    {
+      for (unsigned int i = 0; i < classes.size(); i++) {
+#ifdef HAVE_ZSTD
+        ZSTD_freeCDict(classes[i]->cdict);
+        ZSTD_freeDDict(classes[i]->ddict);
+#endif
+        delete classes[i];
+      }
+      classes.clear();
+    }
+
+    /*
+     * The frame header saves a few bytes on every packet without the
+     * dictionary ID, the content size and the checksum. The SNDU CRC32
+     * already covers the compressed data.
+     */
+    compress_context *
+    sndu_compress::context(void)
+    {
+      compress_context *ctx = contexts.get();
+
+      if (ctx == NULL) {
+        ctx = new compress_context;
+#ifdef HAVE_ZSTD
+        ctx->cctx = ZSTD_createCCtx();
+        ctx->dctx = NULL;
+        ZSTD_CCtx_setParameter(ctx->cctx, ZSTD_c_compressionLevel, COMPRESS_LEVEL);
+        ZSTD_CCtx_setParameter(ctx->cctx, ZSTD_c_dictIDFlag, 0);
+        ZSTD_CCtx_setParameter(ctx->cctx, ZSTD_c_contentSizeFlag, 0);
+        ZSTD_CCtx_setParameter(ctx->cctx, ZSTD_c_checksumFlag, 0);
+#endif
+        contexts.reset(ctx);
+      }
+      return ctx;
+    }
+
+    /* the class of the UDP or TCP destination port, or -1 */
+    int
+    sndu_compress::classify(const unsigned char *frame, unsigned int len) const
+    {
+      const unsigned char *ip = frame + sizeof(struct ether_header);
+      const unsigned char *ports = NULL;
+      unsigned int ether_type, protocol = 0;
+      int port;
+
+      if (len < sizeof(struct ether_header) + 40) {
+        return -1;
+      }
+      ether_type = (frame[12] << 8) | frame[13];
+      if (ether_type == ETHERTYPE_IP && (ip[0] >> 4) == 4) {
+        protocol = ip[9];
+        /* only the first fragment has the ports */
+        if ((((ip[6] & 0x1f) << 8) | ip[7]) == 0) {
+          ports = ip + (ip[0] & 0xf) * 4;
+        }
+      }
+      else if (ether_type == ETHERTYPE_IPV6 && (ip[0] >> 4) == 6 && len >= sizeof(struct ether_header) + 44) {
+        protocol = ip[6];
+        ports = ip + 40;
+      }
+      else {
+        return -1;
+      }
+      if ((protocol != IPPROTO_UDP && protocol != IPPROTO_TCP) || ports == NULL || ports + 4 > frame + len) {
+        return default_class;
+      }
+      port = (ports[2] << 8) | ports[3];
+      for (unsigned int i = 0; i < classes.size(); i++) {
+        if (classes[i]->port == port) {
+          return i;
+        }
+      }
+      return default_class;
+    }
+
+    unsigned int
+    sndu_compress::compress(unsigned char *frame, unsigned int len)
+    {
+#ifdef HAVE_ZSTD
+      unsigned char scratch[ULE_MAX_FRAME_SIZE];
+      unsigned int pdu_length = len - sizeof(struct ether_header);
+      unsigned char *pdu = frame + sizeof(struct ether_header);
+      compress_context *ctx;
+      struct timespec start, stop;
+      size_t size;
+      int id;
+
+      id = classify(frame, len);
+      if (id < 0 || pdu_length <= COMPRESS_HEADER_SIZE + 1) {
+        return len;
+      }
+      ctx = context();
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+      ZSTD_CCtx_refCDict(ctx->cctx, classes[id]->cdict);
+      /* anything that does not save at least a byte fails to fit */
+      size = ZSTD_compress2(ctx->cctx, scratch, pdu_length - COMPRESS_HEADER_SIZE - 1, pdu, pdu_length);
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop);
+      cpu_ns += (stop.tv_sec - start.tv_sec) * 1000000000LL + (stop.tv_nsec - start.tv_nsec);
+      bytes_in += pdu_length;
+      if (ZSTD_isError(size)) {
+        bytes_out += pdu_length;
+        skipped++;
+        return len;
+      }
+      bytes_out += size + COMPRESS_HEADER_SIZE;
+      compressed++;
+      pdu[0] = id;
+      pdu[1] = frame[2 * ETHER_ADDR_LEN];
+      pdu[2] = frame[2 * ETHER_ADDR_LEN + 1];
+      memcpy(pdu + COMPRESS_HEADER_SIZE, scratch, size);
+      frame[2 * ETHER_ADDR_LEN] = ULE_TYPE_COMPRESSED >> 8;
+      frame[2 * ETHER_ADDR_LEN + 1] = ULE_TYPE_COMPRESSED & 0xff;
+      return sizeof(struct ether_header) + COMPRESS_HEADER_SIZE + size;
+#else
+      (void)frame;
+      return len;
+#endif
+    }
+
+    unsigned int
+    sndu_compress::decompress(const unsigned char *frame, unsigned int len, unsigned char *out)
+    {
+#ifdef HAVE_ZSTD
+      const unsigned char *pdu = frame + sizeof(struct ether_header);
+      size_t size;
+      int id;
+
+      if (len < sizeof(struct ether_header) + COMPRESS_HEADER_SIZE ||
+          ((frame[12] << 8) | frame[13]) != ULE_TYPE_COMPRESSED) {
+        return 0;
+      }
+      id = pdu[0];
+      if (id >= (int)classes.size()) {
+        return 0;
+      }
+      if (decompress_context == NULL) {
+        decompress_context = new compress_context;
+        decompress_context->cctx = NULL;
+        decompress_context->dctx = ZSTD_createDCtx();
+      }
+      size = ZSTD_decompress_usingDDict(decompress_context->dctx, out + sizeof(struct ether_header),
+                                        ULE_MAX_FRAME_SIZE - sizeof(struct ether_header),
+                                        pdu + COMPRESS_HEADER_SIZE, len - sizeof(struct ether_header) - COMPRESS_HEADER_SIZE,
+                                        classes[id]->ddict);
+      if (ZSTD_isError(size)) {
+        return 0;
+      }
+      memcpy(out, frame, 2 * ETHER_ADDR_LEN);
+      out[2 * ETHER_ADDR_LEN] = pdu[1];
+      out[2 * ETHER_ADDR_LEN + 1] = pdu[2];
+      return sizeof(struct ether_header) + size;
+#else
+      (void)frame;
+      (void)len;
+      (void)out;
+      return 0;
+#endif
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,118 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_COMPRESS_H
+#define INCLUDED_ULE_SNDU_COMPRESS_H
+
+#include <ule/ule_config.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
+/*
+ * Mandatory extension header (H-LEN 0) carrying a zstd compressed
+ * PDU. The value is not IANA assigned, both ends must agree on it.
+ */
+#define ULE_TYPE_COMPRESSED 0x0082
+#define COMPRESS_CLASS_SIZE 1
+#define COMPRESS_NEXT_TYPE_SIZE 2
+#define COMPRESS_HEADER_SIZE (COMPRESS_CLASS_SIZE + COMPRESS_NEXT_TYPE_SIZE)
+#define COMPRESS_LEVEL 3
+#define COMPRESS_MAX_CLASSES 255
+#define COMPRESS_MAX_DICT_SIZE (1024 * 1024)
+
+namespace gr {
+  namespace ule {
+
+    struct compress_class;
+    struct compress_context;
+
+    /*
+     * Per SNDU payload compression with zstd and a shared dictionary
+     * per flow class. The classes are a comma separated list of
+     * port=dictionary pairs, matched against the UDP or TCP
+     * destination port, where * matches any other port and an empty
+     * dictionary compresses without one. The dictionaries are the
+     * output of zstd --train on samples of each class. A compressed
+     * frame keeps its Ethernet header with type 0x0082 and carries
+     *
+     *   class | next type | Z(PDU)
+     *
+     * so that the SNDU built from it is
+     *
+     *   length | 0x0082 | NPA | class | next type | Z(PDU) | CRC32
+     *
+     * and can still be sealed. A frame is only compressed when that
+     * makes it smaller. Compression may be called from several
+     * threads at once, each keeps its own zstd context. Without zstd
+     * at build time (HAVE_ZSTD) the constructor throws.
+     */
+    class sndu_compress
+    {
+     private:
+      std::vector<compress_class *> classes;
+      int default_class;
+      boost::thread_specific_ptr<compress_context> contexts;
+      compress_context *decompress_context;
+      compress_context *context(void);
+      boost::atomic<uint64_t> compressed;
+      boost::atomic<uint64_t> skipped;
+      boost::atomic<uint64_t> bytes_in;
+      boost::atomic<uint64_t> bytes_out;
+      boost::atomic<uint64_t> cpu_ns;
+      int classify(const unsigned char *frame, unsigned int len) const;
+      void parse_classes(const std::string &classes);
+      void free_classes(void);
+
+     public:
+      sndu_compress(ule_compress_t mode, const std::string &classes);
+      ~sndu_compress();
+
+      /*
+       * Compress the Ethernet frame in place if it belongs to a class
+       * and shrinks. Returns the new frame length, or len untouched.
+       */
+      unsigned int compress(unsigned char *frame, unsigned int len);
+
+      /*
+       * Rebuild the original Ethernet frame of a compressed one in
+       * out, which holds ULE_MAX_FRAME_SIZE bytes. Returns its length,
+       * or 0 if the frame is malformed or names an unknown class. For
+       * a single receive thread.
+       */
+      unsigned int decompress(const unsigned char *frame, unsigned int len, unsigned char *out);
+
+      uint64_t get_compressed() const { return compressed; }
+      uint64_t get_skipped() const { return skipped; }
+
+      //! PDU bytes of the classified frames, and what they compressed to.
+      uint64_t get_bytes_in() const { return bytes_in; }
+      uint64_t get_bytes_out() const { return bytes_out; }
+
+      //! Thread CPU time spent compressing, in nanoseconds.
+      uint64_t get_cpu_ns() const { return cpu_ns; }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_COMPRESS_H */
@@ -0,0 +1,192 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include "sndu_encap.h"
+#include "sndu_security.h"
+#include "sndu_compress.h"
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+    /* Rewrite policy: the IP header rewrites made before encapsulation. */
+    template <bool PingReply, bool Spoof>
+    struct header_rewrite
+    {
+      static inline void apply(unsigned char *frame, const sndu_rewrite &rewrite)
+      {
+        if (!PingReply && !Spoof) {
+          return;
+        }
+        profile_scope profile(PROFILE_REWRITE);
+        if (PingReply) {
+          rewrite_ping_reply(frame);
+        }
+        if (Spoof) {
+          rewrite_ipaddr_spoof(frame, rewrite.src_addr, rewrite.dst_addr);
+        }
+      }
+    };
+
+    /*
+     * Address policies: lay the type (and NPA address) over the tail
+     * of the Ethernet header and return the start of the SNDU.
+     */
+    struct npa_address
+    {
+      static const unsigned int header_size = SNDU_BASE_HEADER_SIZE + ETHER_ADDR_LEN;
+      static const unsigned char d_bit = 0x00;    /* D bit clear, NPA address present */
+
+      static inline unsigned char *header(unsigned char *frame)
+      {
+        unsigned char *ptr = frame + sizeof(struct ether_header) - header_size;
+
+        /* the type lands in the source address, then the destination moves up */
+        ptr[2] = frame[2 * ETHER_ADDR_LEN];
+        ptr[3] = frame[2 * ETHER_ADDR_LEN + 1];
+        memcpy(ptr + SNDU_BASE_HEADER_SIZE, frame, ETHER_ADDR_LEN);
+        return ptr;
+      }
+    };
+
+    struct no_npa_address
+    {
+      static const unsigned int header_size = SNDU_BASE_HEADER_SIZE;
+      static const unsigned char d_bit = 0x80;    /* D bit set, no NPA address */
+
+      static inline unsigned char *header(unsigned char *frame)
+      {
+        /* the Ethertype is already where the type field goes */
+        return frame + sizeof(struct ether_header) - header_size;
+      }
+    };
+
+    template <class Rewrite, class Address>
+    static packet_desc *
+    build_clear(packet_desc *desc, const sndu_rewrite &rewrite)
+    {
+      unsigned char *frame = desc->data;
+      unsigned int len = desc->length;
+      unsigned int length, crc32;
+      unsigned char *ptr, *end;
+
+      if (len < sizeof(struct ether_header) || len > ULE_MAX_FRAME_SIZE) {
+        desc->release();
+        return NULL;
+      }
+      Rewrite::apply(frame, rewrite);
+      ptr = Address::header(frame);
+      length = len - sizeof(struct ether_header) + Address::header_size - SNDU_BASE_HEADER_SIZE + SNDU_CRC_SIZE;
+      ptr[0] = Address::d_bit | ((length >> 8) & 0x7f);
+      ptr[1] = length & 0xff;
+      end = frame + len;
+      crc32 = sndu_crc32(ptr, end - ptr);
+      end[0] = (crc32 >> 24) & 0xff;
+      end[1] = (crc32 >> 16) & 0xff;
+      end[2] = (crc32 >> 8) & 0xff;
+      end[3] = crc32 & 0xff;
+      desc->data = ptr;
+      desc->length = end + SNDU_CRC_SIZE - ptr;
+      return desc;
+    }
+
+    template <class Rewrite>
+    static packet_desc *
+    build_sealed(packet_desc *desc, const sndu_rewrite &rewrite)
+    {
+      unsigned char *frame = desc->data;
+      unsigned int len = desc->length;
+
+      if (len < sizeof(struct ether_header) || len > ULE_MAX_FRAME_SIZE) {
+        desc->release();
+        return NULL;
+      }
+      Rewrite::apply(frame, rewrite);
+      desc->data = frame - SEC_SEAL_OFFSET;
+      desc->length = rewrite.security->seal(frame, len, desc->data);
+      return desc;
+    }
+
+    /* indexed by [ping_reply][ipaddr_spoof][dbit] */
+    static const sndu_build_fn clear_builders[2][2][2] = {
+      {
+        {build_clear<header_rewrite<false, false>, npa_address>,
+         build_clear<header_rewrite<false, false>, no_npa_address>},
+        {build_clear<header_rewrite<false, true>, npa_address>,
+         build_clear<header_rewrite<false, true>, no_npa_address>},
+      },
+      {
+        {build_clear<header_rewrite<true, false>, npa_address>,
+         build_clear<header_rewrite<true, false>, no_npa_address>},
+        {build_clear<header_rewrite<true, true>, npa_address>,
+         build_clear<header_rewrite<true, true>, no_npa_address>},
+      },
+    };
+
+    /* indexed by [ping_reply][ipaddr_spoof] */
+    static const sndu_build_fn sealed_builders[2][2] = {
+      {build_sealed<header_rewrite<false, false> >, build_sealed<header_rewrite<false, true> >},
+      {build_sealed<header_rewrite<true, false> >, build_sealed<header_rewrite<true, true> >},
+    };
+
+    /*
+     * The rewrites see the uncompressed IP header, then the compressed
+     * frame goes through the builder without rewrites.
+     */
+    template <class Rewrite>
+    static packet_desc *
+    build_compressed(packet_desc *desc, const sndu_rewrite &rewrite)
+    {
+      if (desc->length < sizeof(struct ether_header) || desc->length > ULE_MAX_FRAME_SIZE) {
+        desc->release();
+        return NULL;
+      }
+      Rewrite::apply(desc->data, rewrite);
+      desc->length = rewrite.compress->compress(desc->data, desc->length);
+      if (rewrite.security) {
+        return sealed_builders[0][0](desc, rewrite);
+      }
+      return clear_builders[0][0][rewrite.dbit ? 1 : 0](desc, rewrite);
+    }
+
+    /* indexed by [ping_reply][ipaddr_spoof] */
+    static const sndu_build_fn compressed_builders[2][2] = {
+      {build_compressed<header_rewrite<false, false> >, build_compressed<header_rewrite<false, true> >},
+      {build_compressed<header_rewrite<true, false> >, build_compressed<header_rewrite<true, true> >},
+    };
+
+    sndu_build_fn
+    select_sndu_builder(const sndu_rewrite &rewrite)
+    {
+      int ping_reply = rewrite.ping_reply ? 1 : 0;
+      int ipaddr_spoof = rewrite.ipaddr_spoof ? 1 : 0;
+
+      if (rewrite.compress) {
+        return compressed_builders[ping_reply][ipaddr_spoof];
+      }
+      if (rewrite.security) {
+        return sealed_builders[ping_reply][ipaddr_spoof];
+      }
+      return clear_builders[ping_reply][ipaddr_spoof][rewrite.dbit ? 1 : 0];
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
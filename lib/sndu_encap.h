@@ -0,0 +1,42 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_ENCAP_H
+#define INCLUDED_ULE_SNDU_ENCAP_H
+
+#include "sndu_builder.h"
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Pick the in place builder compiled for the ping_reply,
+     * ipaddr_spoof, dbit, security and compress settings in rewrite.
+     * Each one is an instantiation of a single template on a rewrite
+     * policy and an address policy, so the options cost nothing per
+     * frame. The CRC is the same as build_sndu() uses, and the result
+     * matches it byte for byte.
+     */
+    sndu_build_fn select_sndu_builder(const sndu_rewrite &rewrite);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_ENCAP_H */
@@ -0,0 +1,435 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+#include <boost/static_assert.hpp>
+#include "gf256.h"
+#include "sndu_fec.h"
+
+namespace gr {
+  namespace ule {
+
+    BOOST_STATIC_ASSERT(POOL_HEADROOM >= FEC_SOURCE_OVERHEAD);
+    BOOST_STATIC_ASSERT(POOL_HEADROOM + SNDU_BASE_HEADER_SIZE + FEC_REPAIR_HEADER_SIZE + FEC_MAX_SYMBOL + SNDU_CRC_SIZE <= POOL_BUFFER_SIZE);
+
+    /* rows and columns come from disjoint sets, so no entry is 1/0 */
+    unsigned char
+    fec_coefficient(int repair, int source)
+    {
+      return gf256_inv((FEC_MAX_K + repair) ^ source);
+    }
+
+    static unsigned int
+    sndu_size(const unsigned char *sndu)
+    {
+      return (((sndu[0] & 0x7f) << 8) | sndu[1]) + SNDU_BASE_HEADER_SIZE;
+    }
+
+    static void
+    append_crc(unsigned char *sndu, unsigned int length)
+    {
+      unsigned int crc32 = sndu_crc32(sndu, length);
+
+      sndu[length++] = (crc32 >> 24) & 0xff;
+      sndu[length++] = (crc32 >> 16) & 0xff;
+      sndu[length++] = (crc32 >> 8) & 0xff;
+      sndu[length] = crc32 & 0xff;
+    }
+
+    static bool
+    check_crc(const unsigned char *sndu, unsigned int length)
+    {
+      unsigned int crc32 = sndu_crc32(sndu, length - SNDU_CRC_SIZE);
+
+      return sndu[length - 4] == ((crc32 >> 24) & 0xff) && sndu[length - 3] == ((crc32 >> 16) & 0xff) &&
+             sndu[length - 2] == ((crc32 >> 8) & 0xff) && sndu[length - 1] == (crc32 & 0xff);
+    }
+
+    fec_sndu_source::fec_sndu_source(sndu_source *source, packet_pool *pool, int k, int r)
+      : source(source), pool(pool), k(k), r(r)
+    {
+      if (k < 1 || k > FEC_MAX_K) {
+        throw std::runtime_error("FEC block size must be 1 to 128 SNDUs\n");
+      }
+      if (r < 1 || r > FEC_MAX_R) {
+        throw std::runtime_error("FEC repair count must be 1 to 64 SNDUs\n");
+      }
+      count = 0;
+      repairs_sent = 0;
+      block_repairs = r;
+      repairs_ready = false;
+      block_start = 0;
+      symbol_length = 0;
+      block = 0;
+      repairs = new unsigned char[r * FEC_MAX_SYMBOL];
+      memset(repairs, 0, r * FEC_MAX_SYMBOL);
+    }
+
+    fec_sndu_source::~fec_sndu_source()
+    {
+      delete[] repairs;
+    }
+
+    /*
+     * Returns NULL without sending anything if the pool is dry, the
+     * repair goes out on a later call.
+     */
+    packet_desc *
+    fec_sndu_source::next_repair(void)
+    {
+      unsigned char *repair = &repairs[repairs_sent * FEC_MAX_SYMBOL];
+      packet_desc *desc = pool->alloc();
+      unsigned char *ptr;
+      unsigned int sndu_length;
+
+      if (desc == NULL) {
+        return NULL;
+      }
+      ptr = desc->data;
+      sndu_length = FEC_REPAIR_HEADER_SIZE + symbol_length + SNDU_CRC_SIZE;
+      *ptr++ = 0x80 | ((sndu_length >> 8) & 0x7f);    /* D bit set, no NPA address */
+      *ptr++ = sndu_length & 0xff;
+      *ptr++ = (ULE_TYPE_FEC_REPAIR >> 8) & 0xff;
+      *ptr++ = ULE_TYPE_FEC_REPAIR & 0xff;
+      *ptr++ = block >> 8;
+      *ptr++ = block & 0xff;
+      *ptr++ = count;
+      *ptr++ = block_repairs;
+      *ptr++ = repairs_sent;
+      *ptr++ = 0;
+      memcpy(ptr, repair, symbol_length);
+      memset(repair, 0, symbol_length);
+      ptr += symbol_length;
+      append_crc(desc->data, ptr - desc->data);
+      desc->length = ptr - desc->data + SNDU_CRC_SIZE;
+
+      if (++repairs_sent == block_repairs) {
+        /* a short block leaves the repairs it did not send non-zero */
+        for (int j = repairs_sent; j < r; j++) {
+          memset(&repairs[j * FEC_MAX_SYMBOL], 0, symbol_length);
+        }
+        repairs_ready = false;
+        repairs_sent = 0;
+        count = 0;
+        symbol_length = 0;
+        block++;
+      }
+      return desc;
+    }
+
+    uint64_t
+    fec_sndu_source::clock(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    packet_desc *
+    fec_sndu_source::next_sndu(const sndu_rewrite &rewrite, uint64_t now)
+    {
+      packet_desc *desc;
+      unsigned char *sndu;
+      unsigned int header_length, symbol;
+
+      if (repairs_ready) {
+        return next_repair();
+      }
+      desc = source->next_sndu(rewrite);
+      if (desc == NULL) {
+        if (count > 0 && now - block_start >= FEC_MAX_BLOCK_AGE) {
+          /* idle past the latency budget, close the block with
+             repairs in proportion to the SNDUs it holds */
+          block_repairs = (r * count + k - 1) / k;
+          repairs_ready = true;
+          return next_repair();
+        }
+        return NULL;
+      }
+
+      if (count == 0) {
+        block_start = now;
+      }
+      sndu = desc->data;
+      symbol = desc->length - SNDU_CRC_SIZE;
+      for (int j = 0; j < r; j++) {
+        gf256_region_madd(&repairs[j * FEC_MAX_SYMBOL], sndu, fec_coefficient(j, count), symbol);
+      }
+      if (symbol > symbol_length) {
+        symbol_length = symbol;
+      }
+
+      /* move the header back into the headroom to open a gap for the
+         FEC header, and the Type out to the Next-Type field in it */
+      header_length = SNDU_BASE_HEADER_SIZE + ((sndu[0] & 0x80) ? 0 : ETHER_ADDR_LEN);
+      desc->data -= FEC_SOURCE_OVERHEAD;
+      desc->length += FEC_SOURCE_OVERHEAD;
+      memmove(desc->data, sndu, header_length);
+      sndu = desc->data;
+      sndu[header_length + 4] = sndu[2];
+      sndu[header_length + 5] = sndu[3];
+      sndu[0] = (sndu[0] & 0x80) | (((desc->length - SNDU_BASE_HEADER_SIZE) >> 8) & 0x7f);
+      sndu[1] = (desc->length - SNDU_BASE_HEADER_SIZE) & 0xff;
+      sndu[2] = (ULE_TYPE_FEC_SOURCE >> 8) & 0xff;
+      sndu[3] = ULE_TYPE_FEC_SOURCE & 0xff;
+      sndu[header_length] = block >> 8;
+      sndu[header_length + 1] = block & 0xff;
+      sndu[header_length + 2] = count;
+      sndu[header_length + 3] = 0;
+      append_crc(sndu, desc->length - SNDU_CRC_SIZE);
+
+      if (++count == k) {
+        block_repairs = r;
+        repairs_ready = true;
+      }
+      return desc;
+    }
+
+    sndu_fec_decoder::sndu_fec_decoder()
+    {
+      recovered = 0;
+      lost = 0;
+    }
+
+    void
+    sndu_fec_decoder::retire(const fec_block &b)
+    {
+      if (b.done || b.k < 0) {
+        return;
+      }
+      for (int i = 0; i < b.k; i++) {
+        if (b.sources[i].empty()) {
+          lost++;
+        }
+      }
+    }
+
+    sndu_fec_decoder::fec_block &
+    sndu_fec_decoder::find_block(uint16_t id)
+    {
+      for (unsigned int i = 0; i < blocks.size(); i++) {
+        if (blocks[i].id == id) {
+          return blocks[i];
+        }
+      }
+      if (blocks.size() == FEC_DECODER_BLOCKS) {
+        retire(blocks.front());
+        blocks.pop_front();
+      }
+      blocks.push_back(fec_block());
+      fec_block &b = blocks.back();
+      b.id = id;
+      b.k = -1;
+      b.done = false;
+      b.symbol_length = 0;
+      b.sources.resize(FEC_MAX_K);
+      return b;
+    }
+
+    void
+    sndu_fec_decoder::emit(const unsigned char *symbol, unsigned int length)
+    {
+      std::vector<unsigned char> sndu(length + SNDU_CRC_SIZE);
+
+      memcpy(&sndu[0], symbol, length);
+      append_crc(&sndu[0], length);
+      output.push_back(sndu);
+    }
+
+    /*
+     * Solve for the m missing sources with the first m repairs: take
+     * the known sources out of each repair, then multiply by the
+     * inverse of the m x m Cauchy submatrix.
+     */
+    void
+    sndu_fec_decoder::decode(fec_block &b)
+    {
+      std::vector<int> missing;
+      unsigned char matrix[FEC_MAX_R][FEC_MAX_R];
+      unsigned char inverse[FEC_MAX_R][FEC_MAX_R];
+      unsigned char pivot, factor;
+      unsigned int length;
+      int m;
+
+      if (b.done || b.k < 0) {
+        return;
+      }
+      for (int i = 0; i < b.k; i++) {
+        if (b.sources[i].empty()) {
+          missing.push_back(i);
+        }
+      }
+      m = missing.size();
+      if (m == 0) {
+        b.done = true;
+        return;
+      }
+      if (m > (int)b.repairs.size()) {
+        return;
+      }
+
+      std::vector<std::vector<unsigned char> > syndromes(m);
+      for (int a = 0; a < m; a++) {
+        syndromes[a] = b.repairs[a];
+        for (int i = 0; i < b.k; i++) {
+          if (!b.sources[i].empty()) {
+            length = b.sources[i].size();
+            if (length > b.symbol_length) {
+              length = b.symbol_length;
+            }
+            gf256_region_madd(&syndromes[a][0], &b.sources[i][0], fec_coefficient(b.repair_index[a], i), length);
+          }
+        }
+        for (int c = 0; c < m; c++) {
+          matrix[a][c] = fec_coefficient(b.repair_index[a], missing[c]);
+          inverse[a][c] = a == c;
+        }
+      }
+
+      /* Gauss-Jordan, every square Cauchy submatrix is invertible */
+      for (int c = 0; c < m; c++) {
+        int p = c;
+        while (matrix[p][c] == 0) {
+          p++;
+        }
+        if (p != c) {
+          for (int j = 0; j < m; j++) {
+            std::swap(matrix[p][j], matrix[c][j]);
+            std::swap(inverse[p][j], inverse[c][j]);
+          }
+        }
+        pivot = gf256_inv(matrix[c][c]);
+        for (int j = 0; j < m; j++) {
+          matrix[c][j] = gf256_mul(matrix[c][j], pivot);
+          inverse[c][j] = gf256_mul(inverse[c][j], pivot);
+        }
+        for (int row = 0; row < m; row++) {
+          if (row != c && matrix[row][c] != 0) {
+            factor = matrix[row][c];
+            for (int j = 0; j < m; j++) {
+              matrix[row][j] ^= gf256_mul(factor, matrix[c][j]);
+              inverse[row][j] ^= gf256_mul(factor, inverse[c][j]);
+            }
+          }
+        }
+      }
+
+      std::vector<unsigned char> symbol(b.symbol_length);
+      for (int c = 0; c < m; c++) {
+        memset(&symbol[0], 0, b.symbol_length);
+        for (int a = 0; a < m; a++) {
+          gf256_region_madd(&symbol[0], &syndromes[a][0], inverse[c][a], b.symbol_length);
+        }
+        /* the rebuilt length field says how much of the symbol is SNDU */
+        length = sndu_size(&symbol[0]) - SNDU_CRC_SIZE;
+        if (length <= b.symbol_length && length >= SNDU_BASE_HEADER_SIZE) {
+          b.sources[missing[c]].assign(symbol.begin(), symbol.begin() + length);
+          emit(&symbol[0], length);
+          recovered++;
+        }
+        else {
+          lost++;
+        }
+      }
+      b.done = true;
+    }
+
+    void
+    sndu_fec_decoder::push(const unsigned char *sndu, unsigned int length)
+    {
+      unsigned int type, header_length, symbol;
+      uint16_t id;
+      int index;
+
+      if (length < SNDU_BASE_HEADER_SIZE + SNDU_CRC_SIZE || sndu_size(sndu) != length || !check_crc(sndu, length)) {
+        return;
+      }
+      type = (sndu[2] << 8) | sndu[3];
+      if (type == ULE_TYPE_FEC_SOURCE) {
+        header_length = SNDU_BASE_HEADER_SIZE + ((sndu[0] & 0x80) ? 0 : ETHER_ADDR_LEN);
+        if (length < header_length + FEC_SOURCE_OVERHEAD + SNDU_CRC_SIZE) {
+          return;
+        }
+        id = (sndu[header_length] << 8) | sndu[header_length + 1];
+        index = sndu[header_length + 2];
+        if (index >= FEC_MAX_K) {
+          return;
+        }
+        /* rebuild the SNDU as it was before the FEC header went in */
+        symbol = length - FEC_SOURCE_OVERHEAD - SNDU_CRC_SIZE;
+        std::vector<unsigned char> original(symbol);
+        memcpy(&original[0], sndu, header_length);
+        original[0] = (sndu[0] & 0x80) | (((symbol + SNDU_CRC_SIZE - SNDU_BASE_HEADER_SIZE) >> 8) & 0x7f);
+        original[1] = (symbol + SNDU_CRC_SIZE - SNDU_BASE_HEADER_SIZE) & 0xff;
+        original[2] = sndu[header_length + 4];
+        original[3] = sndu[header_length + 5];
+        memcpy(&original[header_length], &sndu[header_length + FEC_SOURCE_OVERHEAD], symbol - header_length);
+        emit(&original[0], symbol);
+        fec_block &b = find_block(id);
+        if (b.sources[index].empty()) {
+          b.sources[index].swap(original);
+        }
+        decode(b);
+      }
+      else if (type == ULE_TYPE_FEC_REPAIR && (sndu[0] & 0x80)) {
+        if (length < SNDU_BASE_HEADER_SIZE + FEC_REPAIR_HEADER_SIZE + SNDU_CRC_SIZE) {
+          return;
+        }
+        id = (sndu[4] << 8) | sndu[5];
+        fec_block &b = find_block(id);
+        symbol = length - SNDU_BASE_HEADER_SIZE - FEC_REPAIR_HEADER_SIZE - SNDU_CRC_SIZE;
+        if (b.done || sndu[6] == 0 || sndu[6] > FEC_MAX_K || sndu[8] >= FEC_MAX_R ||
+            (b.k >= 0 && (b.k != sndu[6] || b.symbol_length != symbol))) {
+          return;
+        }
+        b.k = sndu[6];
+        b.symbol_length = symbol;
+        for (unsigned int i = 0; i < b.repair_index.size(); i++) {
+          if (b.repair_index[i] == sndu[8]) {
+            return;
+          }
+        }
+        b.repair_index.push_back(sndu[8]);
+        b.repairs.push_back(std::vector<unsigned char>(sndu + SNDU_BASE_HEADER_SIZE + FEC_REPAIR_HEADER_SIZE,
+                                                       sndu + SNDU_BASE_HEADER_SIZE + FEC_REPAIR_HEADER_SIZE + symbol));
+        decode(b);
+      }
+      else {
+        output.push_back(std::vector<unsigned char>(sndu, sndu + length));
+      }
+    }
+
+    bool
+    sndu_fec_decoder::pop(std::vector<unsigned char> &sndu)
+    {
+      if (output.empty()) {
+        return false;
+      }
+      sndu.swap(output.front());
+      output.pop_front();
+      return true;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_FEC_H
+#define INCLUDED_ULE_SNDU_FEC_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include "sndu_builder.h"
+
+/*
+ * Source SNDUs carry an optional extension header (H-LEN 3) with the
+ * block number and their index in it, which receivers without FEC
+ * skip. Repair SNDUs use a mandatory extension header. Neither type
+ * is IANA assigned, both ends must agree on them.
+ */
+#define ULE_TYPE_FEC_SOURCE 0x0381
+#define ULE_TYPE_FEC_REPAIR 0x0081
+#define FEC_TAG_SIZE 4
+#define FEC_SOURCE_OVERHEAD (FEC_TAG_SIZE + 2)
+#define FEC_REPAIR_HEADER_SIZE 6
+#define FEC_MAX_K 128
+#define FEC_MAX_R 64
+#define FEC_MAX_SYMBOL (SNDU_MAX_SIZE - SNDU_CRC_SIZE)
+#define FEC_DECODER_BLOCKS 8
+#define FEC_MAX_BLOCK_AGE 20000        /* longest a partial block waits for more SNDUs, us */
+
+namespace gr {
+  namespace ule {
+
+    /* Cauchy matrix entry for repair j and source i */
+    unsigned char fec_coefficient(int repair, int source);
+
+    /*
+     * Erasure FEC across blocks of up to k SNDUs. Each SNDU from the
+     * wrapped source, less its CRC, is one symbol. r repair symbols
+     * per block are computed with a systematic Cauchy Reed-Solomon
+     * code over GF(2^8), so any k of the k + r SNDUs of a block
+     * rebuild the rest. Repairs are accumulated as the SNDUs pass, so
+     * only the repair symbols are held. A partial block is closed
+     * once the source is dry and its first SNDU is FEC_MAX_BLOCK_AGE
+     * old, with ceil(r * count / k) repairs so light traffic keeps
+     * about the r / k overhead of a full block.
+     * Source SNDUs are tagged in place in their buffers, repair SNDUs
+     * are built in buffers from pool.
+     */
+    class fec_sndu_source : public sndu_source
+    {
+     private:
+      sndu_source *source;
+      packet_pool *pool;
+      int k;
+      int r;
+      int count;
+      int repairs_sent;
+      int block_repairs;
+      bool repairs_ready;
+      uint64_t block_start;
+      unsigned int symbol_length;
+      uint16_t block;
+      unsigned char *repairs;
+      packet_desc *next_repair(void);
+      static uint64_t clock(void);
+
+     public:
+      fec_sndu_source(sndu_source *source, packet_pool *pool, int k, int r);
+      ~fec_sndu_source();
+
+      packet_desc *next_sndu(const sndu_rewrite &rewrite) { return next_sndu(rewrite, clock()); }
+      packet_desc *next_sndu(const sndu_rewrite &rewrite, uint64_t now);
+    };
+
+    /*
+     * Receive side. Every SNDU with a good CRC is pushed in. Source
+     * SNDUs come back out at once without their FEC header, anything
+     * else unchanged, and SNDUs rebuilt from repairs as soon as a
+     * block has enough of them. Repairs are consumed.
+     */
+    class sndu_fec_decoder
+    {
+     private:
+      struct fec_block {
+        uint16_t id;
+        int k;
+        bool done;
+        unsigned int symbol_length;
+        std::vector<std::vector<unsigned char> > sources;
+        std::vector<std::vector<unsigned char> > repairs;
+        std::vector<int> repair_index;
+      };
+      std::deque<fec_block> blocks;
+      std::deque<std::vector<unsigned char> > output;
+      uint64_t recovered;
+      uint64_t lost;
+      fec_block &find_block(uint16_t id);
+      void retire(const fec_block &b);
+      void decode(fec_block &b);
+      void emit(const unsigned char *symbol, unsigned int length);
+
+     public:
+      sndu_fec_decoder();
+
+      void push(const unsigned char *sndu, unsigned int length);
+      bool pop(std::vector<unsigned char> &sndu);
+      uint64_t get_recovered() const { return recovered; }
+      uint64_t get_lost() const { return lost; }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_FEC_H */
@@ -0,0 +1,197 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "sndu_pipeline.h"
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+    sndu_pipeline::sndu_pipeline(packet_source *source, int num_workers)
+      : source(source),
+        num_workers(num_workers),
+        depth(num_workers * PIPELINE_AHEAD),
+        dispatched(0),
+        retired(0),
+        queued(0),
+        next_job(0),
+        waiting(false),
+        running(false)
+    {
+      if (num_workers < 1) {
+        throw std::runtime_error("sndu_pipeline: at least one worker is required\n");
+      }
+      slots = new slot[depth];
+      for (unsigned int i = 0; i < depth; i++) {
+        slots[i].state = SLOT_FREE;
+        slots[i].desc = NULL;
+      }
+    }
+
+    sndu_pipeline::~sndu_pipeline()
+    {
+      stop();
+      while (retired != dispatched) {
+        if (slots[retired % depth].desc) {
+          slots[retired % depth].desc->release();
+        }
+        retired++;
+      }
+      delete[] slots;
+    }
+
+    void
+    sndu_pipeline::start(void)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+
+      if (running) {
+        return;
+      }
+      running = true;
+      for (int i = 0; i < num_workers; i++) {
+        workers.create_thread(boost::bind(&sndu_pipeline::worker, this));
+      }
+    }
+
+    void
+    sndu_pipeline::stop(void)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!running) {
+          return;
+        }
+        running = false;
+        job_ready.notify_all();
+      }
+      workers.join_all();
+
+      /* finish what was dispatched so a restart resumes in order */
+      while (next_job != queued) {
+        build(next_job++);
+      }
+    }
+
+    void
+    sndu_pipeline::build(uint64_t seq)
+    {
+      slot &s = slots[seq % depth];
+
+      ULE_PROBE_SNDU_START(s.desc, s.desc->length);
+      s.desc = s.rewrite.build(s.desc, s.rewrite);
+      s.state.store(SLOT_DONE);
+      if (waiting.load()) {
+        boost::mutex::scoped_lock lock(mutex);
+        job_done.notify_all();
+      }
+    }
+
+    void
+    sndu_pipeline::worker(void)
+    {
+      uint64_t seq;
+
+      while (1) {
+        {
+          boost::mutex::scoped_lock lock(mutex);
+          while (running && next_job == queued) {
+            job_ready.wait(lock);
+          }
+          if (!running) {
+            return;
+          }
+          seq = next_job++;
+        }
+        build(seq);
+      }
+    }
+
+    /*
+     * Park the frames the source has ready in the free slots, at most
+     * PIPELINE_AHEAD per worker beyond the last one retired, and
+     * queue them for the workers under a single lock.
+     */
+    void
+    sndu_pipeline::dispatch(const sndu_rewrite &rewrite)
+    {
+      packet_desc *desc;
+      uint64_t first = dispatched;
+
+      while (dispatched - retired < depth) {
+        desc = source->next_packet();
+        if (desc == NULL) {
+          break;
+        }
+        slot &s = slots[dispatched % depth];
+        s.desc = desc;
+        s.rewrite = rewrite;
+        s.state.store(SLOT_QUEUED);
+        dispatched++;
+      }
+      if (dispatched != first) {
+        boost::mutex::scoped_lock lock(mutex);
+        queued = dispatched;
+        if (!running) {
+          /* no workers, build in line */
+          while (next_job != queued) {
+            build(next_job++);
+          }
+        }
+        else if (dispatched - first == 1) {
+          job_ready.notify_one();
+        }
+        else {
+          job_ready.notify_all();
+        }
+      }
+    }
+
+    packet_desc *
+    sndu_pipeline::next_sndu(const sndu_rewrite &rewrite)
+    {
+      packet_desc *desc;
+
+      dispatch(rewrite);
+      while (retired != dispatched) {
+        slot &s = slots[retired % depth];
+        if (s.state.load() != SLOT_DONE) {
+          boost::mutex::scoped_lock lock(mutex);
+          waiting.store(true);
+          while (s.state.load() != SLOT_DONE) {
+            job_done.wait(lock);
+          }
+          waiting.store(false);
+        }
+        desc = s.desc;
+        s.desc = NULL;
+        s.state.store(SLOT_FREE);
+        retired++;
+        if (desc) {
+          return desc;
+        }
+      }
+      return NULL;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_PIPELINE_H
+#define INCLUDED_ULE_SNDU_PIPELINE_H
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "sndu_builder.h"
+
+/* frames taken from the source ahead of the packer, per worker */
+#define PIPELINE_AHEAD 2
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Parallel SNDU encapsulation. The packetizer thread takes frames
+     * from the packet source, numbers them and parks their descriptors
+     * in a ring of slots. A pool of workers builds each SNDU (rewrites,
+     * header and CRC) in place in its buffer, and the packetizer thread
+     * hands finished SNDUs back out in sequence order. Capture, frame
+     * dispatch and cell packing stay serial, so this offloads the per
+     * SNDU work rather than scaling the whole path. Jobs are always
+     * the slots from next_job up to queued, so handing them out is a
+     * counter.
+     *
+     * Only PIPELINE_AHEAD frames per worker are taken ahead of the
+     * packer. Anything more would wait in the ring in plain FIFO
+     * order, out of reach of the source's own queue management.
+     */
+    class sndu_pipeline : public sndu_source
+    {
+     private:
+      enum { SLOT_FREE = 0, SLOT_QUEUED, SLOT_DONE };
+      struct slot {
+        boost::atomic<int> state;
+        packet_desc *desc;
+        sndu_rewrite rewrite;
+      };
+      packet_source *source;
+      int num_workers;
+      unsigned int depth;
+      slot *slots;
+      uint64_t dispatched;
+      uint64_t retired;
+      uint64_t queued;
+      uint64_t next_job;
+      boost::mutex mutex;
+      boost::condition_variable job_ready;
+      boost::condition_variable job_done;
+      boost::atomic<bool> waiting;
+      boost::thread_group workers;
+      bool running;
+      void dispatch(const sndu_rewrite &rewrite);
+      void build(uint64_t seq);
+      void worker(void);
+
+     public:
+      sndu_pipeline(packet_source *source, int num_workers);
+      ~sndu_pipeline();
+
+      void start(void);
+      void stop(void);
+      unsigned int in_flight(void) const { return dispatched - retired; }
+      unsigned int get_depth(void) const { return depth; }
+      packet_desc *next_sndu(const sndu_rewrite &rewrite);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_PIPELINE_H */
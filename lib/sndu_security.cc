@@ -0,0 +1,252 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+#include <netinet/if_ether.h>
+#include "sndu_builder.h"
+#include "sndu_security.h"
+
+namespace gr {
+  namespace ule {
+
+    static void
+    free_context(EVP_CIPHER_CTX *ctx)
+    {
+      EVP_CIPHER_CTX_free(ctx);
+    }
+
+    /*
+     * The key string is the hexadecimal AES key followed by the 4 byte
+     * salt, 40 digits for AES-128 and 72 for AES-256 (RFC 4106).
+     */
+    sndu_security::sndu_security(ule_security_t mode, const std::string &key, uint32_t spi)
+      : sequence(0),
+        encrypt_context(free_context)
+    {
+      unsigned int key_size, byte;
+
+      switch (mode) {
+        case SECURITY_AES128_GCM:
+          cipher = EVP_aes_128_gcm();
+          key_size = 16;
+          break;
+        case SECURITY_AES256_GCM:
+          cipher = EVP_aes_256_gcm();
+          key_size = 32;
+          break;
+        default:
+          throw std::runtime_error("Unknown ULE security mode\n");
+      }
+      if (key.size() != (key_size + SEC_SALT_SIZE) * 2) {
+        throw std::runtime_error("ULE security key must be the AES key and a 4 byte salt in hexadecimal\n");
+      }
+      for (unsigned int i = 0; i < key_size + SEC_SALT_SIZE; i++) {
+        if (sscanf(key.c_str() + i * 2, "%2x", &byte) != 1) {
+          throw std::runtime_error("ULE security key must be the AES key and a 4 byte salt in hexadecimal\n");
+        }
+        if (i < key_size) {
+          this->key[i] = byte;
+        }
+        else {
+          salt[i - key_size] = byte;
+        }
+      }
+      this->spi = spi;
+      /*
+       * Start the sequence at the time in seconds times 2^32, so a
+       * restart with the same key never repeats a nonce and stays
+       * ahead of the receiver's replay window.
+       */
+      sequence = (uint64_t)time(NULL) << 32;
+      replay_top = 0;
+      replay_bitmap = 0;
+      auth_failures = 0;
+      replays = 0;
+      decrypt_context = EVP_CIPHER_CTX_new();
+      if (decrypt_context == NULL ||
+          EVP_DecryptInit_ex(decrypt_context, cipher, NULL, this->key, NULL) != 1) {
+        EVP_CIPHER_CTX_free(decrypt_context);
+        throw std::runtime_error("Error setting up the ULE security cipher\n");
+      }
+    }
+
+    sndu_security::~sndu_security()
+    {
+      EVP_CIPHER_CTX_free(decrypt_context);
+      memset(key, 0, sizeof(key));
+    }
+
+    /* key schedule once per thread, only the nonce changes per SNDU */
+    EVP_CIPHER_CTX *
+    sndu_security::context(void)
+    {
+      EVP_CIPHER_CTX *ctx = encrypt_context.get();
+
+      if (ctx == NULL) {
+        ctx = EVP_CIPHER_CTX_new();
+        if (ctx == NULL || EVP_EncryptInit_ex(ctx, cipher, NULL, key, NULL) != 1) {
+          EVP_CIPHER_CTX_free(ctx);
+          throw std::runtime_error("Error setting up the ULE security cipher\n");
+        }
+        encrypt_context.reset(ctx);
+      }
+      return ctx;
+    }
+
+    unsigned int
+    sndu_security::seal(const unsigned char *frame, unsigned int len, unsigned char *out)
+    {
+      EVP_CIPHER_CTX *ctx = context();
+      unsigned char nonce[SEC_NONCE_SIZE];
+      unsigned int plain_length, length, crc32;
+      unsigned char *ptr = out;
+      uint64_t seq;
+      int outl;
+
+      /* the type and PDU are encrypted together */
+      plain_length = len - 2 * ETHER_ADDR_LEN;
+      length = ETHER_ADDR_LEN + SEC_SPI_SIZE + SEC_SEQUENCE_SIZE + plain_length + SEC_TAG_SIZE + SNDU_CRC_SIZE;
+      seq = ++sequence;
+      *ptr++ = (length >> 8) & 0x7f;    /* D bit clear, NPA address present */
+      *ptr++ = length & 0xff;
+      *ptr++ = (ULE_TYPE_SECURITY >> 8) & 0xff;
+      *ptr++ = ULE_TYPE_SECURITY & 0xff;
+      memcpy(ptr, frame, ETHER_ADDR_LEN);
+      ptr += ETHER_ADDR_LEN;
+      for (int i = SEC_SPI_SIZE - 1; i >= 0; i--) {
+        *ptr++ = (spi >> (i * 8)) & 0xff;
+      }
+      for (int i = SEC_SEQUENCE_SIZE - 1; i >= 0; i--) {
+        *ptr++ = (seq >> (i * 8)) & 0xff;
+      }
+      memcpy(nonce, salt, SEC_SALT_SIZE);
+      memcpy(nonce + SEC_SALT_SIZE, ptr - SEC_SEQUENCE_SIZE, SEC_SEQUENCE_SIZE);
+
+      if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, nonce) != 1 ||
+          EVP_EncryptUpdate(ctx, NULL, &outl, out, ptr - out) != 1 ||
+          EVP_EncryptUpdate(ctx, ptr, &outl, frame + 2 * ETHER_ADDR_LEN, plain_length) != 1 ||
+          EVP_EncryptFinal_ex(ctx, ptr + outl, &outl) != 1) {
+        throw std::runtime_error("ULE security encryption failed\n");
+      }
+      ptr += plain_length;
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, SEC_TAG_SIZE, ptr);
+      ptr += SEC_TAG_SIZE;
+
+      crc32 = sndu_crc32(out, ptr - out);
+      *ptr++ = (crc32 >> 24) & 0xff;
+      *ptr++ = (crc32 >> 16) & 0xff;
+      *ptr++ = (crc32 >> 8) & 0xff;
+      *ptr++ = crc32 & 0xff;
+      return ptr - out;
+    }
+
+    /* sliding window of RFC 4303 section 3.4.3 */
+    bool
+    sndu_security::replay_check(uint64_t seq) const
+    {
+      if (seq == 0) {
+        return false;
+      }
+      if (seq > replay_top) {
+        return true;
+      }
+      if (replay_top - seq >= SEC_REPLAY_WINDOW) {
+        return false;
+      }
+      return !(replay_bitmap & ((uint64_t)1 << (replay_top - seq)));
+    }
+
+    void
+    sndu_security::replay_update(uint64_t seq)
+    {
+      if (seq > replay_top) {
+        if (seq - replay_top >= SEC_REPLAY_WINDOW) {
+          replay_bitmap = 1;
+        }
+        else {
+          replay_bitmap = (replay_bitmap << (seq - replay_top)) | 1;
+        }
+        replay_top = seq;
+      }
+      else {
+        replay_bitmap |= (uint64_t)1 << (replay_top - seq);
+      }
+    }
+
+    unsigned int
+    sndu_security::open(const unsigned char *sndu, unsigned int length, unsigned char *frame)
+    {
+      const unsigned char *ptr = sndu + SNDU_BASE_HEADER_SIZE;
+      unsigned char nonce[SEC_NONCE_SIZE];
+      unsigned char tag[SEC_TAG_SIZE];
+      unsigned int crc32, header_length, plain_length;
+      uint32_t key_id = 0;
+      uint64_t seq = 0;
+      int outl;
+
+      header_length = SNDU_BASE_HEADER_SIZE + ETHER_ADDR_LEN + SEC_SPI_SIZE + SEC_SEQUENCE_SIZE;
+      if (length < header_length + SEC_NEXT_TYPE_SIZE + SEC_TAG_SIZE + SNDU_CRC_SIZE ||
+          (sndu[0] & 0x80) || (unsigned int)((sndu[0] << 8) | sndu[1]) != length - SNDU_BASE_HEADER_SIZE ||
+          ((sndu[2] << 8) | sndu[3]) != ULE_TYPE_SECURITY) {
+        return 0;
+      }
+      crc32 = sndu_crc32(sndu, length - SNDU_CRC_SIZE);
+      if (sndu[length - 4] != ((crc32 >> 24) & 0xff) || sndu[length - 3] != ((crc32 >> 16) & 0xff) ||
+          sndu[length - 2] != ((crc32 >> 8) & 0xff) || sndu[length - 1] != (crc32 & 0xff)) {
+        return 0;
+      }
+      ptr += ETHER_ADDR_LEN;
+      for (int i = 0; i < SEC_SPI_SIZE; i++) {
+        key_id = (key_id << 8) | *ptr++;
+      }
+      for (int i = 0; i < SEC_SEQUENCE_SIZE; i++) {
+        seq = (seq << 8) | *ptr++;
+      }
+      if (key_id != spi) {
+        return 0;
+      }
+      if (!replay_check(seq)) {
+        replays++;
+        return 0;
+      }
+
+      plain_length = length - header_length - SEC_TAG_SIZE - SNDU_CRC_SIZE;
+      memcpy(nonce, salt, SEC_SALT_SIZE);
+      memcpy(nonce + SEC_SALT_SIZE, ptr - SEC_SEQUENCE_SIZE, SEC_SEQUENCE_SIZE);
+      memcpy(tag, ptr + plain_length, SEC_TAG_SIZE);
+      memcpy(frame, sndu + SNDU_BASE_HEADER_SIZE, ETHER_ADDR_LEN);
+      memset(frame + ETHER_ADDR_LEN, 0, ETHER_ADDR_LEN);
+      if (EVP_DecryptInit_ex(decrypt_context, NULL, NULL, NULL, nonce) != 1 ||
+          EVP_DecryptUpdate(decrypt_context, NULL, &outl, sndu, header_length) != 1 ||
+          EVP_DecryptUpdate(decrypt_context, frame + 2 * ETHER_ADDR_LEN, &outl, ptr, plain_length) != 1 ||
+          EVP_CIPHER_CTX_ctrl(decrypt_context, EVP_CTRL_GCM_SET_TAG, SEC_TAG_SIZE, tag) != 1 ||
+          EVP_DecryptFinal_ex(decrypt_context, frame + 2 * ETHER_ADDR_LEN + outl, &outl) != 1) {
+        auth_failures++;
+        return 0;
+      }
+      replay_update(seq);
+      return 2 * ETHER_ADDR_LEN + plain_length;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
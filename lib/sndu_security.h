@@ -0,0 +1,107 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_SNDU_SECURITY_H
+#define INCLUDED_ULE_SNDU_SECURITY_H
+
+#include <ule/ule_config.h>
+#include <stdint.h>
+#include <string>
+#include <openssl/evp.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
+/*
+ * Mandatory extension header (H-LEN 0) carrying an AES-GCM protected
+ * PDU. The value is not IANA assigned, both ends must agree on it.
+ */
+#define ULE_TYPE_SECURITY 0x0080
+#define SEC_SPI_SIZE 4
+#define SEC_SEQUENCE_SIZE 8
+#define SEC_SALT_SIZE 4
+#define SEC_NONCE_SIZE (SEC_SALT_SIZE + SEC_SEQUENCE_SIZE)
+#define SEC_TAG_SIZE 16
+#define SEC_NEXT_TYPE_SIZE 2
+#define SEC_MAX_KEY_SIZE 32
+#define SEC_REPLAY_WINDOW 64
+/* out = frame - SEC_SEAL_OFFSET lines the ciphertext up with the plaintext */
+#define SEC_SEAL_OFFSET (SNDU_BASE_HEADER_SIZE + ETHER_ADDR_LEN + SEC_SPI_SIZE + SEC_SEQUENCE_SIZE - 2 * ETHER_ADDR_LEN)
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * AES-128/256-GCM protection for the SNDUs of one PID, following
+     * the ESP conventions of RFC 4106 and RFC 4303. A secured SNDU is
+     *
+     *   length | 0x0080 | NPA | SPI | sequence | E(type | PDU) | tag | CRC32
+     *
+     * The nonce is the 4 byte key salt followed by the 64 bit sequence
+     * number. Everything in front of the ciphertext is authenticated.
+     * OpenSSL selects the AES-NI/VAES and carry-less multiply GHASH
+     * code at run time. Sealing may be called from several threads at
+     * once, each keeps its own cipher context. Opening is for a single
+     * receive thread.
+     */
+    class sndu_security
+    {
+     private:
+      const EVP_CIPHER *cipher;
+      unsigned char key[SEC_MAX_KEY_SIZE];
+      unsigned char salt[SEC_SALT_SIZE];
+      uint32_t spi;
+      boost::atomic<uint64_t> sequence;
+      boost::thread_specific_ptr<EVP_CIPHER_CTX> encrypt_context;
+      EVP_CIPHER_CTX *decrypt_context;
+      uint64_t replay_top;
+      uint64_t replay_bitmap;
+      uint64_t auth_failures;
+      uint64_t replays;
+      EVP_CIPHER_CTX *context(void);
+      bool replay_check(uint64_t seq) const;
+      void replay_update(uint64_t seq);
+
+     public:
+      sndu_security(ule_security_t mode, const std::string &key, uint32_t spi);
+      ~sndu_security();
+
+      /*
+       * Write a secured SNDU for frame (an Ethernet frame) to out and
+       * return its length. out may be frame - SEC_SEAL_OFFSET, which
+       * encrypts the frame in place.
+       */
+      unsigned int seal(const unsigned char *frame, unsigned int len, unsigned char *out);
+
+      /*
+       * Check, decrypt and authenticate a secured SNDU, rebuilding the
+       * Ethernet frame (NPA destination, zero source) in frame. Returns
+       * the frame length, or 0 if the SNDU is malformed, fails
+       * authentication or is a replay.
+       */
+      unsigned int open(const unsigned char *sndu, unsigned int length, unsigned char *frame);
+
+      uint64_t get_auth_failures() const { return auth_failures; }
+      uint64_t get_replays() const { return replays; }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_SNDU_SECURITY_H */
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+#ifdef ULE_PROFILING
+    static const char *const stage_names[PROFILE_STAGES] = {
+      "capture", "rewrite", "crc", "packetize", "psi", "stuffing"
+    };
+
+    profile_counter profile_counters[PROFILE_STAGES];
+
+    std::vector<profile_sample>
+    get_profile(void)
+    {
+      std::vector<profile_sample> samples(PROFILE_STAGES);
+
+      for (int i = 0; i < PROFILE_STAGES; i++) {
+        samples[i].stage = stage_names[i];
+        samples[i].calls = profile_counters[i].calls.load(boost::memory_order_relaxed);
+        samples[i].cycles = profile_counters[i].cycles.load(boost::memory_order_relaxed);
+      }
+      return samples;
+    }
+
+    void
+    reset_profile(void)
+    {
+      for (int i = 0; i < PROFILE_STAGES; i++) {
+        profile_counters[i].calls.store(0, boost::memory_order_relaxed);
+        profile_counters[i].cycles.store(0, boost::memory_order_relaxed);
+      }
+    }
+#else
+    std::vector<profile_sample>
+    get_profile(void)
+    {
+      return std::vector<profile_sample>();
+    }
+
+    void
+    reset_profile(void)
+    {
+    }
+#endif
+
+    std::string
+    profile_summary(void)
+    {
+      std::vector<profile_sample> samples = get_profile();
+      std::string summary;
+      uint64_t total = 0;
+      char line[128];
+
+      if (samples.empty()) {
+        return "ULE was built without profiling\n";
+      }
+      for (unsigned int i = 0; i < samples.size(); i++) {
+        total += samples[i].cycles;
+      }
+      snprintf(line, sizeof(line), "%-10s %14s %18s %12s %7s\n", "stage", "calls", "cycles", "cycles/call", "share");
+      summary += line;
+      for (unsigned int i = 0; i < samples.size(); i++) {
+        snprintf(line, sizeof(line), "%-10s %14llu %18llu %12.1f %6.1f%%\n", samples[i].stage,
+                 (unsigned long long)samples[i].calls, (unsigned long long)samples[i].cycles,
+                 samples[i].calls ? (double)samples[i].cycles / samples[i].calls : 0.0,
+                 total ? 100.0 * samples[i].cycles / total : 0.0);
+        summary += line;
+      }
+      return summary;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
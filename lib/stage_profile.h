@@ -0,0 +1,163 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_STAGE_PROFILE_H
+#define INCLUDED_ULE_STAGE_PROFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#ifdef ULE_PROFILING
+#include <boost/atomic.hpp>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#endif
+#endif
+
+#define PROFILE_CACHE_LINE 64
+
+/*
+ * USDT probes for perf, bpftrace and SystemTap, in provider ule:
+ *
+ *   sndu_start(desc, frame length)  a frame goes into an SNDU builder
+ *   sndu_end(desc, SNDU length)     its last byte is packed into a cell
+ *   ts_cell(cell, kind)             a cell is emitted, kind is TS_CELL_*
+ *
+ * desc is the same packet_desc at both ends of an SNDU. They compile
+ * to nothing unless built with ENABLE_PROFILING and sys/sdt.h.
+ */
+#if defined(ULE_PROFILING) && defined(HAVE_SYS_SDT_H)
+#define ULE_PROBE_SNDU_START(desc, length) DTRACE_PROBE2(ule, sndu_start, desc, length)
+#define ULE_PROBE_SNDU_END(desc, length) DTRACE_PROBE2(ule, sndu_end, desc, length)
+#define ULE_PROBE_TS_CELL(cell, kind) DTRACE_PROBE2(ule, ts_cell, cell, kind)
+#else
+#define ULE_PROBE_SNDU_START(desc, length) do { } while (0)
+#define ULE_PROBE_SNDU_END(desc, length) do { } while (0)
+#define ULE_PROBE_TS_CELL(cell, kind) do { } while (0)
+#endif
+
+#define TS_CELL_ULE 0
+#define TS_CELL_PSI 1
+#define TS_CELL_NULL 2
+
+namespace gr {
+  namespace ule {
+
+    enum profile_stage {
+      PROFILE_CAPTURE = 0,
+      PROFILE_REWRITE,
+      PROFILE_CRC,
+      PROFILE_PACKETIZE,
+      PROFILE_PSI,
+      PROFILE_STUFFING,
+      PROFILE_STAGES
+    };
+
+    struct profile_sample {
+      const char *stage;
+      uint64_t calls;
+      uint64_t cycles;
+    };
+
+    /*
+     * Counters of every stage since startup or the last reset, summed
+     * over all threads. Empty without ULE_PROFILING.
+     */
+    std::vector<profile_sample> get_profile(void);
+    void reset_profile(void);
+
+    //! One line per stage with calls, cycles, cycles per call and share.
+    std::string profile_summary(void);
+
+#ifdef ULE_PROFILING
+    /* one cache line per stage, the capture and encapsulation threads all add */
+    struct profile_counter {
+      boost::atomic<uint64_t> cycles;
+      boost::atomic<uint64_t> calls;
+      char pad[PROFILE_CACHE_LINE - 2 * sizeof(boost::atomic<uint64_t>)];
+    };
+
+    extern profile_counter profile_counters[PROFILE_STAGES];
+
+    /* the TSC, or nanoseconds where there is none */
+    static inline uint64_t
+    profile_cycles(void)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    class profile_timer
+    {
+     private:
+      uint64_t begin;
+
+      void add(profile_stage stage, unsigned int calls)
+      {
+        profile_counters[stage].cycles.fetch_add(profile_cycles() - begin, boost::memory_order_relaxed);
+        profile_counters[stage].calls.fetch_add(calls, boost::memory_order_relaxed);
+      }
+
+     public:
+      void start(void) { begin = profile_cycles(); }
+
+      //! Charge the cycles since start() to stage as one call.
+      void stop(profile_stage stage) { add(stage, 1); }
+
+      //! Charge them without a call, when another stage interrupts.
+      void pause(profile_stage stage) { add(stage, 0); }
+    };
+#else
+    class profile_timer
+    {
+     public:
+      void start(void) { }
+      void stop(profile_stage) { }
+      void pause(profile_stage) { }
+    };
+#endif
+
+    /* times the enclosing block as one call of a stage */
+    class profile_scope
+    {
+     private:
+      profile_timer timer;
+      profile_stage stage;
+
+     public:
+      explicit profile_scope(profile_stage stage) : stage(stage) { timer.start(); }
+      ~profile_scope() { timer.stop(stage); }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_STAGE_PROFILE_H */
@@ -0,0 +1,277 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+#include <netinet/in.h>
+#include "traffic_generator.h"
+
+#define GEN_SRC_ADDR 0xc0000201    /* 192.0.2.1 */
+#define GEN_DST_ADDR 0xc6336401    /* 198.51.100.1 */
+#define GEN_SRC_PORT 10000
+#define GEN_DST_PORT 5004
+#define GEN_CBR_FRAME (14 + 20 + 8 + 12 + 7 * 188)
+#define GEN_ACK_FRAME (14 + 20 + 32)
+#define GEN_MSS 1448
+
+namespace gr {
+  namespace ule {
+
+    static const unsigned char src_mac[ETHER_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+    static double
+    monotonic(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    static void
+    put16(unsigned char *p, unsigned int v)
+    {
+      p[0] = (v >> 8) & 0xff;
+      p[1] = v & 0xff;
+    }
+
+    static void
+    put32(unsigned char *p, uint32_t v)
+    {
+      p[0] = v >> 24;
+      p[1] = (v >> 16) & 0xff;
+      p[2] = (v >> 8) & 0xff;
+      p[3] = v & 0xff;
+    }
+
+    static void
+    ip_header(unsigned char *ip, unsigned int length, int protocol, int id)
+    {
+      unsigned int sum = 0;
+
+      memset(ip, 0, 20);
+      ip[0] = 0x45;
+      put16(ip + 2, length);
+      ip[6] = 0x40;    /* DF */
+      ip[8] = 64;
+      ip[9] = protocol;
+      put32(ip + 12, GEN_SRC_ADDR);
+      put32(ip + 16, GEN_DST_ADDR + (id >> 16));
+      for (int i = 0; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+      }
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum += sum >> 16;
+      put16(ip + 10, ~sum & 0xffff);
+    }
+
+    traffic_generator::traffic_generator(ule_traffic_t model, int rate, int flows, int size, unsigned int seed, const unsigned char *dst_mac)
+    {
+      if (rate <= 0) {
+        throw std::runtime_error("Traffic rate must be positive\n");
+      }
+      if (flows < 1 || flows > GEN_MAX_FLOWS) {
+        throw std::runtime_error("Traffic flows must be 1 to 65536\n");
+      }
+      if (size < GEN_MIN_FRAME || size > GEN_MAX_FRAME) {
+        throw std::runtime_error("Traffic frame size must be 60 to 1514 bytes\n");
+      }
+      this->model = model;
+      this->rate = rate;
+      this->flows = flows;
+      this->size = size;
+      random_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+      memcpy(this->dst_mac, dst_mac, ETHER_ADDR_LEN);
+      flow.resize(flows);
+      for (int i = 0; i < flows; i++) {
+        flow[i].sequence = random();
+        flow[i].ack = random();
+      }
+      next_flow = 0;
+      departure = 0.0;
+      burst_end = 0.0;
+      generated = 0;
+    }
+
+    /* xorshift64*, repeatable for a given seed */
+    uint64_t
+    traffic_generator::random(void)
+    {
+      random_state ^= random_state >> 12;
+      random_state ^= random_state << 25;
+      random_state ^= random_state >> 27;
+      return random_state * 0x2545f4914f6cdd1dULL;
+    }
+
+    double
+    traffic_generator::uniform(void)
+    {
+      return ((random() >> 11) + 1) * (1.0 / 9007199254740993.0);
+    }
+
+    double
+    traffic_generator::pareto(double minimum)
+    {
+      double period = minimum / pow(uniform(), 1.0 / GEN_PARETO_SHAPE);
+
+      return period < GEN_PARETO_MAX ? period : GEN_PARETO_MAX;
+    }
+
+    unsigned int
+    traffic_generator::build_udp(unsigned char *frame, int id, unsigned int length, bool rtp)
+    {
+      unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned char *udp = ip + 20;
+      flow_state &f = flow[id];
+
+      memcpy(frame, dst_mac, ETHER_ADDR_LEN);
+      memcpy(frame + ETHER_ADDR_LEN, src_mac, ETHER_ADDR_LEN);
+      put16(frame + 12, ETHERTYPE_IP);
+      ip_header(ip, length - sizeof(struct ether_header), IPPROTO_UDP, id);
+      put16(udp, GEN_SRC_PORT + (id & 0xffff));
+      put16(udp + 2, GEN_DST_PORT);
+      put16(udp + 4, length - sizeof(struct ether_header) - 20);
+      put16(udp + 6, 0);
+      memset(udp + 8, 0, length - sizeof(struct ether_header) - 28);
+      if (rtp) {
+        udp[8] = 0x80;
+        udp[9] = 33;
+        put16(udp + 10, f.sequence);
+        put32(udp + 16, id);
+        udp += 12;
+      }
+      if (length >= (unsigned int)(udp + 8 + 4 - frame)) {
+        put32(udp + 8, f.sequence);
+      }
+      f.sequence++;
+      return length;
+    }
+
+    unsigned int
+    traffic_generator::build_tcp(unsigned char *frame, int id, unsigned int payload)
+    {
+      unsigned char *ip = frame + sizeof(struct ether_header);
+      unsigned char *tcp = ip + 20;
+      unsigned int length = GEN_ACK_FRAME + payload;
+      flow_state &f = flow[id];
+
+      memcpy(frame, dst_mac, ETHER_ADDR_LEN);
+      memcpy(frame + ETHER_ADDR_LEN, src_mac, ETHER_ADDR_LEN);
+      put16(frame + 12, ETHERTYPE_IP);
+      ip_header(ip, length - sizeof(struct ether_header), IPPROTO_TCP, id);
+      put16(tcp, GEN_SRC_PORT + (id & 0xffff));
+      put16(tcp + 2, 80);
+      put32(tcp + 4, f.sequence);
+      put32(tcp + 8, f.ack);
+      tcp[12] = 8 << 4;    /* 32 byte header with the timestamp option */
+      tcp[13] = payload ? 0x18 : 0x10;    /* ACK, PSH with data */
+      put16(tcp + 14, 65535);
+      put16(tcp + 16, 0);
+      put16(tcp + 18, 0);
+      tcp[20] = 1;    /* NOP, NOP, timestamps */
+      tcp[21] = 1;
+      tcp[22] = 8;
+      tcp[23] = 10;
+      memset(tcp + 24, 0, 8 + payload);
+      f.sequence += payload;
+      /* the peer's data keeps arriving, so every ACK moves forward */
+      f.ack += 2 * GEN_MSS;
+      return length;
+    }
+
+    unsigned int
+    traffic_generator::next_frame(unsigned char *frame, double *due)
+    {
+      unsigned int length;
+      double now, send_rate = rate;
+      uint64_t r;
+      int id;
+
+      now = monotonic();
+      if (departure == 0.0 || now - departure > 0.1) {
+        departure = now;    /* start, or fell behind by more than 100 ms */
+        burst_end = now + pareto(GEN_PARETO_MIN);
+      }
+
+      if (model == TRAFFIC_CBR) {
+        id = next_flow;
+        next_flow = (next_flow + 1) % flows;
+      }
+      else {
+        id = random() % flows;
+      }
+      switch (model) {
+        case TRAFFIC_IMIX:
+          r = random() % 12;
+          length = build_udp(frame, id, r < 7 ? 60 : (r < 11 ? 590 : 1514), false);
+          break;
+        case TRAFFIC_CBR:
+          length = build_udp(frame, id, GEN_CBR_FRAME, true);
+          break;
+        case TRAFFIC_ACK:
+          length = build_tcp(frame, id, random() % GEN_ACK_DATA_RATIO == 0 ? GEN_MSS : 0);
+          break;
+        case TRAFFIC_PARETO:
+          send_rate = 2.0 * rate;
+          if (departure >= burst_end) {
+            /* off period, then the next burst */
+            departure += pareto(GEN_PARETO_MIN);
+            burst_end = departure + pareto(GEN_PARETO_MIN);
+          }
+          length = build_udp(frame, id, size, false);
+          break;
+        default:
+          length = build_udp(frame, id, size, false);
+          break;
+      }
+      *due = departure;
+      departure += length * 8.0 / send_rate;
+      generated++;
+      return length;
+    }
+
+    void
+    traffic_generator::stamp(unsigned char *frame, unsigned int length)
+    {
+      struct timespec ts;
+      uint64_t ns;
+      unsigned int offset;
+
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      if (frame[sizeof(struct ether_header) + 9] == IPPROTO_TCP) {
+        put32(frame + sizeof(struct ether_header) + 20 + 24, (uint32_t)(ns / 1000));
+        return;
+      }
+      offset = sizeof(struct ether_header) + 20 + 8 + 4;
+      if (model == TRAFFIC_CBR) {
+        offset += 12;
+        put32(frame + offset - 4 - 8, (uint32_t)(ns / 1000 * 9 / 100));    /* RTP 90 kHz */
+      }
+      if (offset + 8 <= length) {
+        put32(frame + offset, ns >> 32);
+        put32(frame + offset + 4, ns & 0xffffffff);
+      }
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
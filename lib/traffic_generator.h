@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TRAFFIC_GENERATOR_H
+#define INCLUDED_ULE_TRAFFIC_GENERATOR_H
+
+#include <ule/ule_config.h>
+#include <stdint.h>
+#include <vector>
+#include <netinet/if_ether.h>
+
+#define GEN_MIN_FRAME 60
+#define GEN_MAX_FRAME 1514
+#define GEN_MAX_FLOWS 65536
+#define GEN_PARETO_SHAPE 1.5
+#define GEN_PARETO_MIN 0.01
+#define GEN_PARETO_MAX 1.0
+#define GEN_ACK_DATA_RATIO 8
+#define GEN_DEFAULT_RATE 10000000
+#define GEN_DEFAULT_FLOWS 16
+#define GEN_DEFAULT_SEED 1
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Synthetic IPv4 traffic for load and soak tests, from TEST-NET
+     * addresses with one UDP or TCP port per flow:
+     *
+     *   fixed   every frame the configured size
+     *   imix    60, 590 and 1514 byte frames in the ratio 7:4:1
+     *   pareto  on/off bursts with Pareto distributed periods at twice
+     *           the mean rate while on
+     *   cbr     evenly spaced RTP streams of 7 TS cells per datagram
+     *   ack     pure TCP ACKs with a data segment every 8th frame
+     *
+     * next_frame() returns frames in departure order with the
+     * CLOCK_MONOTONIC time each is due. stamp() writes the generation
+     * time into the payload when the frame is actually sent: 8 bytes
+     * of CLOCK_REALTIME ns after a 4 byte flow sequence number in UDP
+     * frames (after the RTP header for cbr), or the TCP timestamp
+     * option value in microseconds for ACKs.
+     */
+    class traffic_generator
+    {
+     private:
+      struct flow_state {
+        uint32_t sequence;
+        uint32_t ack;
+      };
+      int model;
+      double rate;
+      int flows;
+      unsigned int size;
+      uint64_t random_state;
+      unsigned char dst_mac[ETHER_ADDR_LEN];
+      std::vector<flow_state> flow;
+      int next_flow;
+      double departure;
+      double burst_end;
+      uint64_t generated;
+      uint64_t random(void);
+      double uniform(void);
+      double pareto(double minimum);
+      unsigned int build_udp(unsigned char *frame, int id, unsigned int length, bool rtp);
+      unsigned int build_tcp(unsigned char *frame, int id, unsigned int payload);
+
+     public:
+      traffic_generator(ule_traffic_t model, int rate, int flows, int size, unsigned int seed, const unsigned char *dst_mac);
+
+      unsigned int next_frame(unsigned char *frame, double *due);
+      void stamp(unsigned char *frame, unsigned int length);
+      uint64_t get_generated() const { return generated; }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TRAFFIC_GENERATOR_H */
@@ -0,0 +1,243 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <algorithm>
+#include <cstring>
+#include "ts_analyzer_impl.h"
+
+namespace gr {
+  namespace ule {
+
+    ts_analyzer::sptr
+    ts_analyzer::make(int ts_rate, ule_item_t item_size)
+    {
+      return gnuradio::get_initial_sptr
+        (new ts_analyzer_impl(ts_rate, item_size));
+    }
+
+    /*
+     * The private constructor
+     */
+    ts_analyzer_impl::ts_analyzer_impl(int ts_rate, ule_item_t item_size)
+      : gr::sync_block("ts_analyzer",
+              gr::io_signature::make(1, 1, input_item_size(item_size)),
+              gr::io_signature::make(0, 0, 0))
+    {
+      conformance = new ts_conformance(ts_rate);
+      this->item_size = item_size;
+      ring_size = (uint64_t)(ts_rate * ANALYZER_RING_SECONDS / 8.0) / MPEG2_PACKET_SIZE * MPEG2_PACKET_SIZE;
+      if (ring_size < ANALYZER_MIN_RING) {
+        ring_size = ANALYZER_MIN_RING;
+      }
+      ring = new unsigned char[ring_size];
+      write_pos.store(0);
+      read_pos.store(0);
+      dropped.store(0);
+      gap_open.store(false);
+      gap_pos = 0;
+      dropped_seen = 0;
+      waiting.store(false);
+      analyzer = NULL;
+      running = false;
+
+      message_port_register_out(pmt::mp("report"));
+      if (item_size == ITEM_BYTE) {
+        set_output_multiple(MPEG2_PACKET_SIZE);
+      }
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ts_analyzer_impl::~ts_analyzer_impl()
+    {
+      stop();
+      delete[] ring;
+      delete conformance;
+    }
+
+    int
+    ts_analyzer_impl::input_item_size(ule_item_t item_size)
+    {
+      switch (item_size) {
+        case ITEM_TS188:
+          return MPEG2_PACKET_SIZE;
+        case ITEM_TS204:
+          return MPEG2_RS_PACKET_SIZE;
+        default:
+          return sizeof(unsigned char);
+      }
+    }
+
+    bool
+    ts_analyzer_impl::start()
+    {
+      running = true;
+      analyzer = new boost::thread(boost::bind(&ts_analyzer_impl::analyze_loop, this));
+      return true;
+    }
+
+    bool
+    ts_analyzer_impl::stop()
+    {
+      if (analyzer) {
+        {
+          boost::mutex::scoped_lock lock(wake_mutex);
+          running = false;
+          data_ready.notify_one();
+        }
+        analyzer->join();
+        delete analyzer;
+        analyzer = NULL;
+      }
+      return true;
+    }
+
+    /*
+     * The analyzer owns read_pos, work() owns write_pos and opens a
+     * gap when the ring is full. Nothing more is written until the
+     * analyzer has caught up to the gap and closed it, so the stream
+     * it sees is always whole up to the point input went missing.
+     */
+    void
+    ts_analyzer_impl::analyze_loop(void)
+    {
+      uint64_t read, limit, length, offset, windows = 0, total;
+
+      while (1) {
+        read = read_pos.load(boost::memory_order_relaxed);
+        if (gap_open.load(boost::memory_order_acquire)) {
+          limit = gap_pos;
+        }
+        else {
+          limit = write_pos.load(boost::memory_order_acquire);
+        }
+        if (read == limit) {
+          if (gap_open.load(boost::memory_order_acquire) && read == gap_pos) {
+            total = dropped.load();
+            conformance->gap(total - dropped_seen);
+            dropped_seen = total;
+            gap_open.store(false, boost::memory_order_release);
+            continue;
+          }
+          boost::mutex::scoped_lock lock(wake_mutex);
+          if (!running) {
+            return;
+          }
+          waiting.store(true);
+          if (write_pos.load() == read && !gap_open.load()) {
+            data_ready.timed_wait(lock, boost::posix_time::milliseconds(ANALYZER_WAIT));
+          }
+          waiting.store(false);
+          continue;
+        }
+        while (read < limit) {
+          offset = read % ring_size;
+          length = std::min(limit - read, ring_size - offset);
+          conformance->analyze(ring + offset, length);
+          read += length;
+        }
+        read_pos.store(read, boost::memory_order_release);
+        if (conformance->get_windows() != windows) {
+          windows = conformance->get_windows();
+          publish_report();
+        }
+      }
+    }
+
+    void
+    ts_analyzer_impl::publish_report(void)
+    {
+      static const char *names[TS_CHECKS] = {
+        "sync_loss", "sync_byte_errors", "pat_errors", "cc_errors",
+        "pmt_errors", "transport_errors", "crc_errors", "pcr_errors"
+      };
+      pmt::pmt_t report = pmt::make_dict();
+      pmt::pmt_t bitrates = pmt::make_dict();
+      uint64_t rate;
+
+      report = pmt::dict_add(report, pmt::mp("sync"), pmt::from_bool(conformance->get_sync()));
+      for (int i = 0; i < TS_CHECKS; i++) {
+        report = pmt::dict_add(report, pmt::mp(names[i]), pmt::from_uint64(conformance->get_errors((ule_ts_check_t)i)));
+      }
+      report = pmt::dict_add(report, pmt::mp("cells"), pmt::from_uint64(conformance->get_cells()));
+      report = pmt::dict_add(report, pmt::mp("dropped_cells"), pmt::from_uint64(cells_dropped()));
+      for (int pid = 0; pid < TS_PID_COUNT; pid++) {
+        if ((rate = conformance->get_pid_bitrate(pid)) != 0) {
+          bitrates = pmt::dict_add(bitrates, pmt::from_long(pid), pmt::from_uint64(rate));
+        }
+      }
+      report = pmt::dict_add(report, pmt::mp("bitrate"), bitrates);
+      message_port_pub(pmt::mp("report"), report);
+    }
+
+    int
+    ts_analyzer_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const unsigned char *in = (const unsigned char *) input_items[0];
+      uint64_t write = write_pos.load(boost::memory_order_relaxed);
+      uint64_t bytes, offset, length;
+
+      bytes = item_size == ITEM_BYTE ? noutput_items : (uint64_t)noutput_items * MPEG2_PACKET_SIZE;
+      if (gap_open.load(boost::memory_order_acquire) || write + bytes - read_pos.load(boost::memory_order_acquire) > ring_size) {
+        if (!gap_open.load(boost::memory_order_relaxed)) {
+          gap_pos = write;
+          gap_open.store(true, boost::memory_order_release);
+        }
+        dropped.fetch_add(bytes, boost::memory_order_relaxed);
+        return noutput_items;
+      }
+      if (item_size != ITEM_TS204) {
+        while (bytes > 0) {
+          offset = write % ring_size;
+          length = std::min(bytes, ring_size - offset);
+          memcpy(ring + offset, in, length);
+          in += length;
+          write += length;
+          bytes -= length;
+        }
+      }
+      else {
+        /* drop the parity, the ring holds whole cells so none wraps */
+        for (int i = 0; i < noutput_items; i++) {
+          memcpy(ring + write % ring_size, in, MPEG2_PACKET_SIZE);
+          in += MPEG2_RS_PACKET_SIZE;
+          write += MPEG2_PACKET_SIZE;
+        }
+      }
+      write_pos.store(write, boost::memory_order_release);
+      if (waiting.load()) {
+        boost::mutex::scoped_lock lock(wake_mutex);
+        data_ready.notify_one();
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_ANALYZER_IMPL_H
+#define INCLUDED_ULE_TS_ANALYZER_IMPL_H
+
+#include <ule/ts_analyzer.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "ts_conformance.h"
+
+#define MPEG2_RS_PACKET_SIZE 204
+#define ANALYZER_RING_SECONDS 0.5
+#define ANALYZER_MIN_RING (MPEG2_PACKET_SIZE * 4096)
+#define ANALYZER_WAIT 100
+
+namespace gr {
+  namespace ule {
+
+    class ts_analyzer_impl : public ts_analyzer
+    {
+     private:
+      ts_conformance *conformance;
+      ule_item_t item_size;
+      unsigned char *ring;
+      uint64_t ring_size;
+      boost::atomic<uint64_t> write_pos;
+      boost::atomic<uint64_t> read_pos;
+      boost::atomic<uint64_t> dropped;
+      boost::atomic<bool> gap_open;
+      uint64_t gap_pos;
+      uint64_t dropped_seen;
+      boost::atomic<bool> waiting;
+      boost::mutex wake_mutex;
+      boost::condition_variable data_ready;
+      boost::thread *analyzer;
+      bool running;
+      static int input_item_size(ule_item_t item_size);
+      void analyze_loop(void);
+      void publish_report(void);
+
+     public:
+      ts_analyzer_impl(int ts_rate, ule_item_t item_size);
+      ~ts_analyzer_impl();
+
+      uint64_t errors(ule_ts_check_t check) { return conformance->get_errors(check); }
+      uint64_t cells_analyzed() { return conformance->get_cells(); }
+      uint64_t cells_dropped() { return dropped.load() / MPEG2_PACKET_SIZE; }
+      uint64_t pid_bitrate(int pid) { return conformance->get_pid_bitrate(pid); }
+      uint64_t pid_cc_errors(int pid) { return conformance->get_pid_cc_errors(pid); }
+
+      bool start();
+      bool stop();
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_ANALYZER_IMPL_H */
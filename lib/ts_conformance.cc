@@ -0,0 +1,483 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "ts_conformance.h"
+#include "sndu_builder.h"
+
+namespace gr {
+  namespace ule {
+
+    int
+    ts_find_sync(const unsigned char *data, unsigned int length)
+    {
+      const unsigned int span = (CONFORMANCE_SYNC_LOCK - 1) * MPEG2_PACKET_SIZE;
+      unsigned int candidates, i = 0;
+      int k;
+
+      if (length <= span) {
+        return -1;
+      }
+      candidates = length - span;
+#ifdef __SSE2__
+      /* 16 candidates at a time, AND of the compares one cell apart */
+      const __m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+      for (; i + 16 <= candidates; i += 16) {
+        __m128i match = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), sync);
+        for (k = 1; k < CONFORMANCE_SYNC_LOCK; k++) {
+          match = _mm_and_si128(match, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + k * MPEG2_PACKET_SIZE)), sync));
+        }
+        int mask = _mm_movemask_epi8(match);
+        if (mask) {
+          return i + __builtin_ctz(mask);
+        }
+      }
+#endif
+      for (; i < candidates; i++) {
+        for (k = 0; k < CONFORMANCE_SYNC_LOCK; k++) {
+          if (data[i + k * MPEG2_PACKET_SIZE] != TS_SYNC_BYTE) {
+            break;
+          }
+        }
+        if (k == CONFORMANCE_SYNC_LOCK) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    ts_conformance::ts_conformance(int ts_rate)
+    {
+      double cell_time;
+
+      if (ts_rate <= 0) {
+        throw std::runtime_error("TS rate must be positive\n");
+      }
+      this->ts_rate = ts_rate;
+      cell_time = MPEG2_PACKET_SIZE * 8.0 / ts_rate;
+      psi_limit = (uint64_t)(CONFORMANCE_PSI_INTERVAL / cell_time) * MPEG2_PACKET_SIZE;
+      pcr_limit = (uint64_t)(CONFORMANCE_PCR_INTERVAL / cell_time) * MPEG2_PACKET_SIZE;
+      window_limit = (uint64_t)(CONFORMANCE_RATE_WINDOW / cell_time) * MPEG2_PACKET_SIZE;
+      if (window_limit == 0) {
+        window_limit = MPEG2_PACKET_SIZE;
+      }
+      pids = new pid_state[TS_PID_COUNT];
+      for (int i = 0; i < TS_PID_COUNT; i++) {
+        pid_state &state = pids[i];
+        state.cells.store(0);
+        state.cc_errors.store(0);
+        state.bitrate.store(0);
+        state.window_cells = 0;
+        state.last_pcr = 0;
+        state.last_psi = 0;
+        state.cc = 0;
+        state.duplicates = 0;
+        state.cc_valid = false;
+        state.pcr_valid = false;
+        state.psi = false;
+        state.pmt = false;
+      }
+      pids[0].psi = true;    /* PAT */
+      pids[1].psi = true;    /* CAT */
+      pids[TS_PSIP_PID].psi = true;
+      for (int i = 0; i < TS_CHECKS; i++) {
+        errors[i].store(0);
+      }
+      cells.store(0);
+      windows.store(0);
+      in_sync = false;
+      bad_syncs = 0;
+      position = 0;
+      last_pat = 0;
+      window_start = 0;
+    }
+
+    ts_conformance::~ts_conformance()
+    {
+      delete[] pids;
+    }
+
+    /* single writer, so a plain load and store is enough */
+    inline void
+    ts_conformance::count(boost::atomic<uint64_t> &counter, uint64_t n)
+    {
+      counter.store(counter.load(boost::memory_order_relaxed) + n, boost::memory_order_relaxed);
+    }
+
+    /*
+     * Feeds whatever cannot be decided yet (a partial cell, or less
+     * than the lock span while searching) through pending, so the
+     * common case of whole aligned cells is scanned in place.
+     */
+    void
+    ts_conformance::analyze(const unsigned char *data, unsigned int length)
+    {
+      unsigned int used;
+
+      if (!pending.empty()) {
+        used = in_sync ? std::min((unsigned int)(MPEG2_PACKET_SIZE - pending.size()), length) : length;
+        pending.insert(pending.end(), data, data + used);
+        data += used;
+        length -= used;
+        used = scan(&pending[0], pending.size());
+        pending.erase(pending.begin(), pending.begin() + used);
+        if (!pending.empty()) {
+          /* still short, or sync was lost in the completed cell */
+          if (length > 0) {
+            pending.insert(pending.end(), data, data + length);
+            used = scan(&pending[0], pending.size());
+            pending.erase(pending.begin(), pending.begin() + used);
+          }
+          return;
+        }
+      }
+      used = scan(data, length);
+      pending.assign(data + used, data + length);
+    }
+
+    /* bytes were lost upstream, nothing before them can be trusted */
+    void
+    ts_conformance::gap(uint64_t bytes)
+    {
+      position += pending.size() + bytes;
+      pending.clear();
+      in_sync = false;
+      bad_syncs = 0;
+      reset_continuity();
+    }
+
+    unsigned int
+    ts_conformance::scan(const unsigned char *data, unsigned int length)
+    {
+      const unsigned int span = (CONFORMANCE_SYNC_LOCK - 1) * MPEG2_PACKET_SIZE;
+      unsigned int offset = 0;
+      int found;
+
+      for (;;) {
+        if (!in_sync) {
+          found = ts_find_sync(data + offset, length - offset);
+          if (found < 0) {
+            if (length - offset > span) {
+              position += length - offset - span;
+              offset = length - span;
+            }
+            return offset;
+          }
+          position += found;
+          offset += found;
+          in_sync = true;
+          bad_syncs = 0;
+        }
+        while (offset + MPEG2_PACKET_SIZE <= length) {
+          if (data[offset] != TS_SYNC_BYTE) {
+            count(errors[CHECK_SYNC_BYTE]);
+            if (++bad_syncs >= CONFORMANCE_SYNC_LOSS) {
+              count(errors[CHECK_SYNC_LOSS]);
+              in_sync = false;
+              reset_continuity();
+              position++;
+              offset++;
+              break;
+            }
+          }
+          else {
+            bad_syncs = 0;
+            cell(data + offset);
+          }
+          position += MPEG2_PACKET_SIZE;
+          offset += MPEG2_PACKET_SIZE;
+          count(cells);
+          check_timeouts();
+          if (position - window_start >= window_limit) {
+            close_window();
+          }
+        }
+        if (in_sync) {
+          return offset;
+        }
+      }
+    }
+
+    void
+    ts_conformance::cell(const unsigned char *cell)
+    {
+      int pid = ((cell[1] & 0x1f) << 8) | cell[2];
+      int control = (cell[3] >> 4) & 0x3;
+      unsigned int offset = 4;
+      bool discontinuity = false;
+      uint64_t now = position;
+      pid_state &state = pids[pid];
+
+      count(state.cells);
+      state.window_cells++;
+      if (cell[1] & 0x80) {
+        count(errors[CHECK_TRANSPORT]);
+        return;
+      }
+      if (pid == TS_NULL_PID) {
+        return;
+      }
+      if (control & 0x2) {
+        unsigned int af_length = cell[4];
+        if (af_length > MPEG2_PACKET_SIZE - 5) {
+          return;
+        }
+        if (af_length > 0) {
+          discontinuity = (cell[5] & 0x80) != 0;
+          if ((cell[5] & 0x10) && af_length >= 7) {
+            if (state.pcr_valid && !discontinuity && now - state.last_pcr > pcr_limit) {
+              count(errors[CHECK_PCR]);
+            }
+            state.last_pcr = now;
+            state.pcr_valid = true;
+          }
+        }
+        offset += 1 + af_length;
+      }
+      continuity(state, cell, discontinuity);
+      if (pid == 0 && (cell[3] & 0xc0)) {
+        count(errors[CHECK_PAT]);    /* scrambled PAT */
+        return;
+      }
+      if (state.psi && (control & 0x1) && offset < MPEG2_PACKET_SIZE) {
+        reassemble(pid, cell + offset, MPEG2_PACKET_SIZE - offset, (cell[1] & 0x40) != 0);
+      }
+    }
+
+    /*
+     * A payload cell must carry the next counter, one duplicate is
+     * allowed. Cells without payload repeat the last counter.
+     */
+    void
+    ts_conformance::continuity(pid_state &state, const unsigned char *cell, bool discontinuity)
+    {
+      unsigned char cc = cell[3] & 0xf;
+      bool payload = (cell[3] & 0x10) != 0;
+      bool error = false;
+
+      if (state.cc_valid && !discontinuity) {
+        if (!payload) {
+          error = cc != state.cc;
+        }
+        else if (cc == state.cc) {
+          error = ++state.duplicates > 1;
+        }
+        else {
+          error = cc != ((state.cc + 1) & 0xf);
+          state.duplicates = 0;
+        }
+      }
+      else {
+        state.duplicates = 0;
+      }
+      if (error) {
+        count(state.cc_errors);
+        count(errors[CHECK_CC]);
+      }
+      state.cc = cc;
+      state.cc_valid = true;
+    }
+
+    void
+    ts_conformance::reset_continuity(void)
+    {
+      for (int i = 0; i < TS_PID_COUNT; i++) {
+        pids[i].cc_valid = false;
+        pids[i].pcr_valid = false;
+        pids[i].last_psi = position;
+      }
+      last_pat = position;
+      for (std::map<int, psi_section>::iterator it = sections.begin(); it != sections.end(); ++it) {
+        it->second.active = false;
+        it->second.data.clear();
+      }
+    }
+
+    /* sections may span cells, and several may share one cell */
+    void
+    ts_conformance::reassemble(int pid, const unsigned char *payload, unsigned int length, bool start)
+    {
+      psi_section &psi = sections[pid];
+      unsigned int pointer;
+
+      if (start) {
+        pointer = payload[0];
+        if (pointer + 1 > length) {
+          psi.active = false;
+          psi.data.clear();
+          return;
+        }
+        if (psi.active) {
+          psi.data.insert(psi.data.end(), payload + 1, payload + 1 + pointer);
+          drain(pid, psi);
+        }
+        psi.data.clear();
+        psi.active = true;
+        payload += 1 + pointer;
+        length -= 1 + pointer;
+      }
+      else if (!psi.active) {
+        return;
+      }
+      psi.data.insert(psi.data.end(), payload, payload + length);
+      drain(pid, psi);
+    }
+
+    void
+    ts_conformance::drain(int pid, psi_section &psi)
+    {
+      unsigned int total;
+
+      while (psi.active && !psi.data.empty()) {
+        if (psi.data[0] == 0xff || psi.data.size() < 3) {
+          break;
+        }
+        total = 3 + (((psi.data[1] & 0x0f) << 8) | psi.data[2]);
+        if (total > CONFORMANCE_MAX_SECTION) {
+          psi.data.clear();
+          break;
+        }
+        if (psi.data.size() < total) {
+          return;
+        }
+        section(pid, &psi.data[0], total);
+        psi.data.erase(psi.data.begin(), psi.data.begin() + total);
+      }
+      /* the next section starts in a cell with a pointer field */
+      psi.active = false;
+      psi.data.clear();
+    }
+
+    void
+    ts_conformance::section(int pid, const unsigned char *data, unsigned int length)
+    {
+      int table_id = data[0];
+      unsigned int program, program_pid;
+
+      if (table_id == 0xff) {
+        return;
+      }
+      if ((data[1] & 0x80) && sndu_crc32(data, length) != 0) {
+        count(errors[CHECK_CRC]);
+        return;
+      }
+      if (pid == 0) {
+        if (table_id != 0x00) {
+          count(errors[CHECK_PAT]);
+          return;
+        }
+        last_pat = position;
+        /* program loop between the 8 byte header and the CRC */
+        for (unsigned int i = 8; i + 4 <= length - 4; i += 4) {
+          program = (data[i] << 8) | data[i + 1];
+          program_pid = ((data[i + 2] & 0x1f) << 8) | data[i + 3];
+          if (program != 0 && !pids[program_pid].pmt) {
+            pmt_pids.push_back(program_pid);
+            pids[program_pid].pmt = true;
+            pids[program_pid].psi = true;
+            pids[program_pid].last_psi = position;
+          }
+        }
+      }
+      else if (pids[pid].pmt && table_id == 0x02) {
+        pids[pid].last_psi = position;
+      }
+    }
+
+    /* once per missed interval, as a receiver would report it */
+    void
+    ts_conformance::check_timeouts(void)
+    {
+      if (position - last_pat > psi_limit) {
+        count(errors[CHECK_PAT]);
+        last_pat = position;
+      }
+      for (unsigned int i = 0; i < pmt_pids.size(); i++) {
+        pid_state &state = pids[pmt_pids[i]];
+        if (position - state.last_psi > psi_limit) {
+          count(errors[CHECK_PMT]);
+          state.last_psi = position;
+        }
+      }
+    }
+
+    void
+    ts_conformance::close_window(void)
+    {
+      double seconds = (position - window_start) * 8.0 / ts_rate;
+
+      for (int i = 0; i < TS_PID_COUNT; i++) {
+        pid_state &state = pids[i];
+        state.bitrate.store((uint64_t)(state.window_cells * MPEG2_PACKET_SIZE * 8 / seconds), boost::memory_order_relaxed);
+        state.window_cells = 0;
+      }
+      window_start = position;
+      windows.fetch_add(1, boost::memory_order_release);
+    }
+
+    uint64_t
+    ts_conformance::get_errors(ule_ts_check_t check)
+    {
+      return errors[check].load(boost::memory_order_relaxed);
+    }
+
+    uint64_t
+    ts_conformance::get_cells(void)
+    {
+      return cells.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t
+    ts_conformance::get_windows(void)
+    {
+      return windows.load(boost::memory_order_acquire);
+    }
+
+    uint64_t
+    ts_conformance::get_pid_cells(int pid)
+    {
+      return pids[pid & 0x1fff].cells.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t
+    ts_conformance::get_pid_cc_errors(int pid)
+    {
+      return pids[pid & 0x1fff].cc_errors.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t
+    ts_conformance::get_pid_bitrate(int pid)
+    {
+      return pids[pid & 0x1fff].bitrate.load(boost::memory_order_relaxed);
+    }
+
+    bool
+    ts_conformance::get_sync(void)
+    {
+      return in_sync;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_CONFORMANCE_H
+#define INCLUDED_ULE_TS_CONFORMANCE_H
+
+#include <ule/ule_config.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <boost/atomic.hpp>
+
+#define MPEG2_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_COUNT 8192
+#define TS_NULL_PID 0x1fff
+#define TS_PSIP_PID 0x1ffb
+#define TS_CHECKS 8
+#define CONFORMANCE_SYNC_LOCK 5
+#define CONFORMANCE_SYNC_LOSS 2
+#define CONFORMANCE_PSI_INTERVAL 0.5
+#define CONFORMANCE_PCR_INTERVAL 0.04
+#define CONFORMANCE_RATE_WINDOW 1.0
+#define CONFORMANCE_MAX_SECTION 4096
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * ETSI TR 101 290 priority 1 and 2 checks on a Transport Stream:
+     *
+     *   1.1 sync loss      5 sync bytes to lock, 2 bad ones to lose it
+     *   1.2 sync byte      a bad sync byte while locked
+     *   1.3 PAT            missing for 0.5 s, wrong table_id, scrambled
+     *   1.4 CC             continuity counter errors per PID
+     *   1.5 PMT            a PMT of the PAT missing for 0.5 s
+     *   2.1 transport      transport_error_indicator set
+     *   2.2 CRC            bad CRC_32 in PAT, CAT, PMT or PSIP sections
+     *   2.3 PCR            PCRs of a PID more than 40 ms apart
+     *
+     * All intervals are measured in stream time, the position in the
+     * stream at ts_rate, which is what a receiver sees regardless of
+     * how the stream arrives here. The input need not be aligned to
+     * cells; sync is found with SSE2 where available. One thread calls
+     * analyze(), any thread may read the counters, which are relaxed
+     * atomics so neither side ever waits.
+     */
+    class ts_conformance
+    {
+     private:
+      struct pid_state {
+        boost::atomic<uint64_t> cells;
+        boost::atomic<uint64_t> cc_errors;
+        boost::atomic<uint64_t> bitrate;
+        uint64_t window_cells;
+        uint64_t last_pcr;
+        uint64_t last_psi;
+        unsigned char cc;
+        unsigned char duplicates;
+        bool cc_valid;
+        bool pcr_valid;
+        bool psi;
+        bool pmt;
+      };
+      struct psi_section {
+        std::vector<unsigned char> data;
+        bool active;
+      };
+      double ts_rate;
+      uint64_t psi_limit;
+      uint64_t pcr_limit;
+      uint64_t window_limit;
+      pid_state *pids;
+      std::map<int, psi_section> sections;
+      std::vector<int> pmt_pids;
+      std::vector<unsigned char> pending;
+      bool in_sync;
+      int bad_syncs;
+      uint64_t position;
+      uint64_t last_pat;
+      uint64_t window_start;
+      boost::atomic<uint64_t> errors[TS_CHECKS];
+      boost::atomic<uint64_t> cells;
+      boost::atomic<uint64_t> windows;
+      void count(boost::atomic<uint64_t> &counter, uint64_t n = 1);
+      unsigned int scan(const unsigned char *data, unsigned int length);
+      void cell(const unsigned char *cell);
+      void continuity(pid_state &state, const unsigned char *cell, bool discontinuity);
+      void reassemble(int pid, const unsigned char *payload, unsigned int length, bool start);
+      void drain(int pid, psi_section &psi);
+      void section(int pid, const unsigned char *data, unsigned int length);
+      void check_timeouts(void);
+      void close_window(void);
+      void reset_continuity(void);
+
+     public:
+      ts_conformance(int ts_rate);
+      ~ts_conformance();
+      void analyze(const unsigned char *data, unsigned int length);
+      void gap(uint64_t bytes);
+      uint64_t get_errors(ule_ts_check_t check);
+      uint64_t get_cells(void);
+      uint64_t get_windows(void);
+      uint64_t get_pid_cells(int pid);
+      uint64_t get_pid_cc_errors(int pid);
+      uint64_t get_pid_bitrate(int pid);
+      bool get_sync(void);
+    };
+
+    /* offset of the first of CONFORMANCE_SYNC_LOCK sync bytes 188 apart */
+    int ts_find_sync(const unsigned char *data, unsigned int length);
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_CONFORMANCE_H */
@@ -0,0 +1,814 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "ts_packetizer.h"
+#include "crc32.h"
+#include "stage_profile.h"
+
+namespace gr {
+  namespace ule {
+
+    ts_packetizer::ts_packetizer(int pid, const char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, const char *src_address, const char *dst_address, ule_npd_t npd, ule_dbit_t dbit, ule_packing_t packing)
+    {
+      ts_packetizer_config initial;
+
+      pat_count = 0;
+      pmt_count = 0;
+      mgt_count = 0;
+      tvct_count = 0;
+      ule_continuity_counter = 0;
+      npd_mode = npd;
+      psi_version = 0;
+      config_pending = false;
+      sndu = NULL;
+      rewrite.dbit = dbit;
+      rewrite.security = NULL;
+      rewrite.compress = NULL;
+      if (packing == PACKING_ON) {
+        packer = &ts_packetizer::pack_sndus<true>;
+      }
+      else {
+        packer = &ts_packetizer::pack_sndus<false>;
+      }
+      sndu_offset = 0;
+      null_cells = 0;
+      data_cells = 0;
+      memset(pat, 0, sizeof(pat));
+      memset(pmt, 0, sizeof(pmt));
+      memset(mgt, 0, sizeof(mgt));
+      memset(tvct, 0, sizeof(tvct));
+
+      initial.pid = pid;
+      initial.call_sign = call_sign;
+      initial.ping_reply = ping_reply;
+      initial.ipaddr_spoof = ipaddr_spoof;
+      initial.src_address = src_address;
+      initial.dst_address = dst_address;
+      check_config(initial);
+      pidULE = -1;
+      apply_config(initial);
+    }
+
+    void
+    ts_packetizer::check_config(const ts_packetizer_config &cfg)
+    {
+      unsigned char addr[sizeof(in_addr)];
+
+      if (cfg.pid < 0x20 || cfg.pid > 0x1ffa || cfg.pid == 0x30 || cfg.pid == 0x31 || cfg.pid == 0x34) {
+        throw std::runtime_error("ULE PID must be 0x20 to 0x1ffa and not used by the PSI\n");
+      }
+      if (inet_pton(AF_INET, cfg.src_address.c_str(), addr) != 1) {
+        throw std::runtime_error("Invalid source IP address\n");
+      }
+      if (inet_pton(AF_INET, cfg.dst_address.c_str(), addr) != 1) {
+        throw std::runtime_error("Invalid destination IP address\n");
+      }
+    }
+
+    /*
+     * Called at an SNDU boundary, so a PID change never splits an
+     * SNDU. The PSI is rebuilt with a new version number and sent
+     * again at once when the PID or call sign changes.
+     */
+    void
+    ts_packetizer::apply_config(const ts_packetizer_config &cfg)
+    {
+      bool rebuild = cfg.pid != pidULE || cfg.call_sign != config.call_sign;
+
+      if (rebuild && pidULE != -1) {
+        psi_version = (psi_version + 1) & 0x1f;
+        pat_count = pmt_count = mgt_count = tvct_count = 500;
+      }
+      config = cfg;
+      pidULE = cfg.pid;
+      rewrite.ping_reply = cfg.ping_reply;
+      rewrite.ipaddr_spoof = cfg.ipaddr_spoof;
+      inet_pton(AF_INET, cfg.src_address.c_str(), rewrite.src_addr);
+      inet_pton(AF_INET, cfg.dst_address.c_str(), rewrite.dst_addr);
+      rewrite.build = select_sndu_builder(rewrite);
+      if (rebuild) {
+        build_psi();
+      }
+    }
+
+    void
+    ts_packetizer::set_config(const ts_packetizer_config &cfg)
+    {
+      check_config(cfg);
+      boost::mutex::scoped_lock lock(config_mutex);
+      pending_config = cfg;
+      config_pending = true;
+    }
+
+    ts_packetizer_config
+    ts_packetizer::get_config(void)
+    {
+      boost::mutex::scoped_lock lock(config_mutex);
+      return config_pending ? pending_config : config;
+    }
+
+    /*
+     * Build the PAT, PMT, MGT, TVCT and stuffing packets for the
+     * current configuration and psi_version. The continuity counters
+     * are carried over from the previous tables.
+     */
+    void
+    ts_packetizer::build_psi(void)
+    {
+      TS_HEADER tsHeader;
+      PAT_HEADER patHeader;
+      PAT_ELEMENT patElement;
+      PMT_HEADER pmtHeader;
+      PMT_ELEMENT pmtElement;
+      PMT_STREAM_DESCRIPTOR streamDesc;
+      PMT_REGISTRATION_DESCRIPTOR registrationDesc;
+      MGT_HEADER mgtHeader;
+      MGT_ELEMENT mgtElement;
+      MGT_TRAILER mgtTrailer;
+      TVCT_HEADER tvctHeader;
+      TVCT_ELEMENT tvctElement;
+      TVCT_SLD_DESCRIPTOR tvctDesc;
+      TVCT_SLD_DESCRIPTOR_ELEMENT tvctDescElement;
+      TVCT_TRAILER tvctTrailer;
+      unsigned char tempBuffer[MPEG2_PACKET_SIZE];
+      int offset, temp_offset;
+      int pidPAT = 0;
+      int pidPMT = 0x30;
+      int pidVID = 0x31;
+      int pidPCR = 0x31;
+      int pidAUD = 0x34;
+      int pidMGT = 0x1ffb;
+      int pidTVCT = 0x1ffb;
+      int pidNULL = 0x1fff;
+      int programNum = 1;
+      const char *call_sign = config.call_sign.c_str();
+      unsigned char pat_cc = pat[3] & 0xf;
+      unsigned char pmt_cc = pmt[3] & 0xf;
+      unsigned char psip_cc = mgt[3] & 0xf;
+      int totalStreams = 2;
+      int crc32;
+      unsigned int id_length;
+
+      /* null packet */
+      offset = 0;
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = 0x0;
+      tsHeader.transport_priority = 0x0;
+      tsHeader.pid_12to8 = ((pidNULL) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidNULL) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = 0;
+      memcpy(&stuffing[offset], (unsigned char *) &tsHeader, TS_HEADER_SIZE);
+      offset += TS_HEADER_SIZE;
+
+      memset(&stuffing[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+
+      /* PAT packet */
+      offset = 0;
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = 0x1;
+      tsHeader.transport_priority = 0x1;
+      tsHeader.pid_12to8 = ((pidPAT) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidPAT) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = 0;
+      memcpy(&pat[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
+      offset += TS_HEADER_SIZE;
+
+      pat[offset] = 0x0;
+      offset += 1;
+
+      temp_offset = PAT_HEADER_SIZE;
+      patElement.program_number_h = (programNum >> 8) & 0xff;
+      patElement.program_number_l = programNum & 0xff;
+      patElement.reserved2 = 0x7;
+      patElement.program_map_PID_h = (pidPMT >> 8) & 0x1f;
+      patElement.program_map_PID_l = pidPMT & 0xff;
+      memcpy(&tempBuffer[temp_offset], (unsigned char *) &patElement, PAT_ELEMENT_SIZE);
+      temp_offset += PAT_ELEMENT_SIZE;
+
+      patHeader.table_id = 0x00;
+      patHeader.section_syntax_indicator = 0x1;
+      patHeader.b0 = 0x0;
+      patHeader.reserved0 = 0x3;
+      patHeader.section_length_h = ((temp_offset - 3 + sizeof(crc32)) >> 8) & 0xf;
+      patHeader.section_length_l = (temp_offset - 3 + sizeof(crc32)) & 0xff;
+
+      patHeader.transport_stream_id_h = 0x00;
+      patHeader.transport_stream_id_l = 0x00;
+      patHeader.reserved1 = 0x3;
+      patHeader.version_number = psi_version;
+      patHeader.current_next_indicator = 1;
+      patHeader.section_number = 0x0;
+      patHeader.last_section_number = 0x0;
+      memcpy(&tempBuffer[0], (char *) &patHeader, PAT_HEADER_SIZE);
+
+      memcpy(&pat[offset], &tempBuffer, temp_offset);
+      offset += temp_offset;
+
+      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
+      memcpy(&pat[offset], (unsigned char *) &crc32, sizeof(crc32));
+      offset += sizeof(crc32);
+
+      memset(&pat[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+
+      /* PMT packet */
+      offset = 0;
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = 0x1;
+      tsHeader.transport_priority = 0x1;
+      tsHeader.pid_12to8 = ((pidPMT) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidPMT) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = 0;
+      memcpy(&pmt[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
+      offset += TS_HEADER_SIZE;
+
+      pmt[offset] = 0x0;
+      offset += 1;
+
+      /* audio stream */
+      temp_offset = PMT_HEADER_SIZE;
+      pmtElement.stream_type = 0x81;
+      pmtElement.reserved0 = 0x7;
+      pmtElement.elementary_PID_h = (pidAUD >> 8) & 0x1f;
+      pmtElement.elementary_PID_l = pidAUD & 0xff;
+      pmtElement.reserved1 = 0xf;
+      pmtElement.ES_info_length_h = 0x00;
+      pmtElement.ES_info_length_l = PMT_STREAM_DESCRIPTOR_SIZE;
+
+      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
+      temp_offset += PMT_ELEMENT_SIZE;
+
+      streamDesc.descriptor_tag = 0x52;
+      streamDesc.descriptor_length = 0x01;
+      streamDesc.component_tag = 0x10;
+      memcpy(&tempBuffer[temp_offset], (unsigned char *)&streamDesc, PMT_STREAM_DESCRIPTOR_SIZE);
+      temp_offset += PMT_STREAM_DESCRIPTOR_SIZE;
+
+      /* video stream */
+      pmtElement.stream_type = 0x2;
+      pmtElement.reserved0 = 0x7;
+      pmtElement.elementary_PID_h = (pidVID >> 8) & 0x1f;
+      pmtElement.elementary_PID_l = pidVID & 0xff;
+      pmtElement.reserved1 = 0xf;
+      pmtElement.ES_info_length_h = 0x00;
+      pmtElement.ES_info_length_l = PMT_STREAM_DESCRIPTOR_SIZE;
+
+      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
+      temp_offset += PMT_ELEMENT_SIZE;
+
+      streamDesc.descriptor_tag = 0x52;
+      streamDesc.descriptor_length = 0x01;
+      streamDesc.component_tag = 0x0;
+      memcpy(&tempBuffer[temp_offset], (unsigned char *)&streamDesc, PMT_STREAM_DESCRIPTOR_SIZE);
+      temp_offset += PMT_STREAM_DESCRIPTOR_SIZE;
+
+      /* ULE stream */
+      pmtElement.stream_type = 0x91;
+      pmtElement.reserved0 = 0x7;
+      pmtElement.elementary_PID_h = (pidULE >> 8) & 0x1f;
+      pmtElement.elementary_PID_l = pidULE & 0xff;
+      pmtElement.reserved1 = 0xf;
+      pmtElement.ES_info_length_h = 0x00;
+      pmtElement.ES_info_length_l = PMT_REGISTRATION_DESCRIPTOR_SIZE;
+
+      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
+      temp_offset += PMT_ELEMENT_SIZE;
+
+      registrationDesc.descriptor_tag = 0x05;
+      registrationDesc.descriptor_length = 0x04;
+      registrationDesc.format_identifier_31to24 = 'U';
+      registrationDesc.format_identifier_23to16 = 'L';
+      registrationDesc.format_identifier_15to8 = 'E';
+      registrationDesc.format_identifier_7to0 = '1';
+      memcpy(&tempBuffer[temp_offset], (unsigned char *)&registrationDesc, PMT_REGISTRATION_DESCRIPTOR_SIZE);
+      temp_offset += PMT_REGISTRATION_DESCRIPTOR_SIZE;
+
+      pmtHeader.table_id = 0x02;
+      pmtHeader.section_syntax_indicator = 1;
+      pmtHeader.b0  = 0;
+      pmtHeader.reserved0 = 0x3;
+      pmtHeader.section_length_h = ((temp_offset - 3 + sizeof(crc32)) >> 8) & 0xf;
+      pmtHeader.section_length_l = (temp_offset - 3 + sizeof(crc32)) & 0xff;
+      pmtHeader.program_number_h = (programNum >> 8) & 0xff;
+      pmtHeader.program_number_l = programNum & 0xff;
+      pmtHeader.reserved1 = 0x3;
+      pmtHeader.version_number = psi_version;
+      pmtHeader.current_next_indicator = 1;
+      pmtHeader.section_number = 0x0;
+      pmtHeader.last_section_number = 0x0;
+      pmtHeader.reserved2 = 0x7;
+      pmtHeader.PCR_PID_h = (pidVID >> 8) & 0x1f;
+      pmtHeader.PCR_PID_l = pidVID & 0xff;
+      pmtHeader.reserved3 = 0xF;
+      pmtHeader.program_info_length_h = 0;
+      pmtHeader.program_info_length_l = 0;
+      memcpy(&tempBuffer[0], (char *) &pmtHeader, PMT_HEADER_SIZE);
+
+      memcpy(&pmt[offset], tempBuffer, temp_offset);
+      offset += temp_offset;
+
+      crc32 = crc32_calc(tempBuffer, temp_offset);
+      memcpy(&pmt[offset], (char *)&crc32, sizeof(crc32));
+      offset += sizeof(crc32);
+
+      memset(&pmt[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+
+      /* MGT packet */
+      offset = 0;
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = 0x1;
+      tsHeader.transport_priority = 0x0;
+      tsHeader.pid_12to8 = ((pidMGT) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidMGT) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = 0;
+      memcpy(&mgt[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
+      offset += TS_HEADER_SIZE;
+
+      mgt[offset] = 0x0;
+      offset += 1;
+
+      temp_offset = MGT_HEADER_SIZE;
+
+      mgtElement.table_type_h = 0;
+      mgtElement.table_type_l = 0;
+      mgtElement.reserved0 = 0x7;
+      mgtElement.table_type_PID_h = (pidTVCT >> 8) & 0x1f;
+      mgtElement.table_type_PID_l = pidTVCT & 0xff;
+      mgtElement.reserved1 = 0x7;
+      mgtElement.table_type_version_number = psi_version;
+      mgtElement.number_bytes_h = 0x00;
+      mgtElement.number_bytes_mh = 0x00;
+      mgtElement.number_bytes_ml = 0x00;
+      mgtElement.number_bytes_l = 0x41;
+      mgtElement.reserved2 = 0xF;
+      mgtElement.table_type_descriptors_length_h = 0x00;
+      mgtElement.table_type_descriptors_length_l = 0x00;
+
+      memcpy(&tempBuffer[temp_offset], (char *) &mgtElement, MGT_ELEMENT_SIZE);
+      temp_offset += MGT_ELEMENT_SIZE;
+
+      mgtHeader.table_id = 0xC7;
+      mgtHeader.section_syntax_indicator = 1;
+      mgtHeader.private_indicator = 1;
+      mgtHeader.reserved0 = 0x3;
+      mgtHeader.section_length_h = ((temp_offset - 1 + sizeof(crc32)) >> 8) & 0xf;
+      mgtHeader.section_length_l = (temp_offset - 1 + sizeof(crc32)) & 0xff;
+
+      mgtHeader.table_id_extension_h = 0;
+      mgtHeader.table_id_extension_l = 0;
+      mgtHeader.reserved1 = 0x3;
+      mgtHeader.version_number = psi_version;
+      mgtHeader.current_next_indicator = 1;
+      mgtHeader.section_number = 0x0;
+      mgtHeader.last_section_number = 0x0;
+      mgtHeader.protocol_version = 0x0;
+      mgtHeader.tables_defined_h = 0;
+      mgtHeader.tables_defined_l = 1;
+      memcpy(&tempBuffer[0], (char *) &mgtHeader, MGT_HEADER_SIZE);
+
+      mgtTrailer.reserved = 0xF;
+      mgtTrailer.descriptors_length_h = 0x00;
+      mgtTrailer.descriptors_length_l = 0x00;
+      memcpy(&tempBuffer[temp_offset], (char *) &mgtTrailer, MGT_TRAILER_SIZE);
+      temp_offset += MGT_TRAILER_SIZE;
+
+      memcpy(&mgt[offset], &tempBuffer, temp_offset);
+      offset += temp_offset;
+
+      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
+      memcpy(&mgt[offset], (unsigned char *) &crc32, sizeof(crc32));
+      offset += sizeof(crc32);
+
+      memset(&mgt[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+
+      /* TVCT packet */
+      offset = 0;
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = 0x1;
+      tsHeader.transport_priority = 0x0;
+      tsHeader.pid_12to8 = ((pidTVCT) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidTVCT) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = 0;
+      memcpy(&tvct[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
+      offset += TS_HEADER_SIZE;
+
+      tvct[offset] = 0x0;
+      offset += 1;
+
+      temp_offset = TVCT_HEADER_SIZE;
+
+      id_length = strlen(call_sign);
+      tvctElement.short_name_1h = 0x0;
+      if (id_length > 0) {
+        tvctElement.short_name_1l = call_sign[0];
+      }
+      else {
+        tvctElement.short_name_1l = 0x0;
+      }
+      tvctElement.short_name_2h = 0x0;
+      if (id_length > 1) {
+        tvctElement.short_name_2l = call_sign[1];
+      }
+      else {
+        tvctElement.short_name_2l = 0x0;
+      }
+      tvctElement.short_name_3h = 0x0;
+      if (id_length > 2) {
+        tvctElement.short_name_3l = call_sign[2];
+      }
+      else {
+        tvctElement.short_name_3l = 0x0;
+      }
+      tvctElement.short_name_4h = 0x0;
+      if (id_length > 3) {
+        tvctElement.short_name_4l = call_sign[3];
+      }
+      else {
+        tvctElement.short_name_4l = 0x0;
+      }
+      tvctElement.short_name_5h = 0x0;
+      if (id_length > 4) {
+        tvctElement.short_name_5l = call_sign[4];
+      }
+      else {
+        tvctElement.short_name_5l = 0x0;
+      }
+      tvctElement.short_name_6h = 0x0;
+      if (id_length > 5) {
+        tvctElement.short_name_6l = call_sign[5];
+      }
+      else {
+        tvctElement.short_name_6l = 0x0;
+      }
+      tvctElement.short_name_7h = 0x0;
+      if (id_length > 6) {
+        tvctElement.short_name_7l = call_sign[6];
+      }
+      else {
+        tvctElement.short_name_7l = 0x0;
+      }
+      tvctElement.reserved0 = 0xF;
+      tvctElement.major_channel_number_h = (37 >> 6) & 0xf;
+      tvctElement.major_channel_number_l = (37) & 0x3f;
+      tvctElement.minor_channel_number_h = ((programNum) >> 8) & 0x3;
+      tvctElement.minor_channel_number_l = (programNum) & 0xff;
+      tvctElement.modulation_mode = 0x4;
+      tvctElement.carrier_frequency_h = 0x0;
+      tvctElement.carrier_frequency_mh = 0x0;
+      tvctElement.carrier_frequency_ml = 0x0;
+      tvctElement.carrier_frequency_l = 0x0;
+      tvctElement.channel_TSID_h = (0x8086 >> 8) & 0xff;
+      tvctElement.channel_TSID_l = 0x8086 & 0xff;
+      tvctElement.program_number_h = (programNum >> 8) & 0xff;
+      tvctElement.program_number_l = programNum & 0xff;
+      tvctElement.ETM_location = 0x1;
+      tvctElement.access_controlled = 0x0;
+      tvctElement.hidden = 0x0;
+      tvctElement.reserved1 = 0x3;
+      tvctElement.hide_guide = 0x1;
+      tvctElement.reserved2 = 0x1;
+      tvctElement.reserved3 = 0x3;
+      tvctElement.service_type = 0x2;
+      tvctElement.source_id_h = (0x1 >> 8) & 0xff;
+      tvctElement.source_id_l = (0x1) & 0xff;
+      tvctElement.reserved4 = 0x3f;
+      tvctElement.descriptors_length_h = (((totalStreams * 6) + 5) >> 8) & 0xff;
+      tvctElement.descriptors_length_l = ((totalStreams * 6) + 5) & 0xff;
+
+      memcpy(&tempBuffer[temp_offset], (char *) &tvctElement, TVCT_ELEMENT_SIZE);
+      temp_offset += TVCT_ELEMENT_SIZE;
+
+      tvctDesc.descriptor_tag = 0xA1;
+      tvctDesc.descriptor_length = (totalStreams * 6) + 3;
+      tvctDesc.reserved = 0x7;
+      tvctDesc.PCR_PID_h = (pidPCR >> 8) & 0x1f;
+      tvctDesc.PCR_PID_l = pidPCR & 0xff;
+      tvctDesc.number_elements = totalStreams;
+
+      memcpy(&tempBuffer[temp_offset], (char *) &tvctDesc, TVCT_DESCRIPTOR_SIZE);
+      temp_offset += TVCT_DESCRIPTOR_SIZE;
+
+      tvctDescElement.stream_type = 0x81;
+      tvctDescElement.reserved = 0x7;
+      tvctDescElement.elementary_PID_h = (pidAUD >> 8) & 0x1f;
+      tvctDescElement.elementary_PID_l = pidAUD & 0xff;
+      tvctDescElement.ISO_639_language_code_1 = 'e';
+      tvctDescElement.ISO_639_language_code_2 = 'n';
+      tvctDescElement.ISO_639_language_code_3 = 'g';
+
+      memcpy(&tempBuffer[temp_offset], (char *) &tvctDescElement, TVCT_DESCRIPTOR_ELEMENT_SIZE);
+      temp_offset += TVCT_DESCRIPTOR_ELEMENT_SIZE;
+
+      tvctDescElement.stream_type = 0x2;
+      tvctDescElement.reserved = 0x7;
+      tvctDescElement.elementary_PID_h = (pidVID >> 8) & 0x1f;
+      tvctDescElement.elementary_PID_l = pidVID & 0xff;
+      tvctDescElement.ISO_639_language_code_1 = 0x0;
+      tvctDescElement.ISO_639_language_code_2 = 0x0;
+      tvctDescElement.ISO_639_language_code_3 = 0x0;
+
+      memcpy(&tempBuffer[temp_offset], (char *) &tvctDescElement, TVCT_DESCRIPTOR_ELEMENT_SIZE);
+      temp_offset += TVCT_DESCRIPTOR_ELEMENT_SIZE;
+
+      tvctHeader.table_id = 0xC8;
+      tvctHeader.section_syntax_indicator = 1;
+      tvctHeader.private_indicator = 1;
+      tvctHeader.reserved0 = 0x3;
+      tvctHeader.section_length_h = ((temp_offset - 1 + sizeof(crc32)) >> 8) & 0xf;
+      tvctHeader.section_length_l = (temp_offset - 1 + sizeof(crc32)) & 0xff;
+
+      tvctHeader.transport_stream_id_h = (0x8086 >> 8) & 0xff;
+      tvctHeader.transport_stream_id_l = 0x8086 & 0xff;
+      tvctHeader.reserved1 = 0x3;
+      tvctHeader.version_number = psi_version;
+      tvctHeader.current_next_indicator = 1;
+      tvctHeader.section_number = 0x0;
+      tvctHeader.last_section_number = 0x0;
+      tvctHeader.protocol_version = 0x0;
+      tvctHeader.num_channels_in_section = 1;
+      memcpy(&tempBuffer[0], (char *) &tvctHeader, TVCT_HEADER_SIZE);
+
+      tvctTrailer.reserved = 0x3F;
+      tvctTrailer.additional_descriptors_length_h = 0x00;
+      tvctTrailer.additional_descriptors_length_l = 0x00;
+
+      memcpy(&tempBuffer[temp_offset], (char *) &tvctTrailer, TVCT_TRAILER_SIZE);
+      temp_offset += TVCT_TRAILER_SIZE;
+
+      memcpy(&tvct[offset], &tempBuffer, temp_offset);
+      offset += temp_offset;
+
+      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
+      memcpy(&tvct[offset], (unsigned char *) &crc32, sizeof(crc32));
+      offset += sizeof(crc32);
+
+      memset(&tvct[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+
+      pat[3] = (pat[3] & 0xf0) | pat_cc;
+      pmt[3] = (pmt[3] & 0xf0) | pmt_cc;
+      mgt[3] = (mgt[3] & 0xf0) | psip_cc;
+      tvct[3] = (tvct[3] & 0xf0) | psip_cc;
+    }
+
+    ts_packetizer::~ts_packetizer()
+    {
+      if (sndu) {
+        sndu->release();
+      }
+    }
+
+    int
+    ts_packetizer::crc32_calc(unsigned char *buf, int size)
+    {
+      unsigned int crc = crc32_mpeg2(buf, size);
+      int reverse;
+
+      reverse = (crc & 0xff) << 24;
+      reverse |= (crc & 0xff00) << 8;
+      reverse |= (crc & 0xff0000) >> 8;
+      reverse |= (crc & 0xff000000) >> 24;
+      return (reverse);
+    }
+
+    inline void
+    ts_packetizer::null_packet(int offset)
+    {
+      if (null_runs.empty() || null_runs.back().second == NPD_MAX_DNP ||
+          null_runs.back().first + (null_runs.back().second * MPEG2_PACKET_SIZE) != offset) {
+        null_runs.push_back(std::make_pair(offset, 0));
+      }
+      null_runs.back().second++;
+      null_cells++;
+    }
+
+    /*
+     * Each PSI table is due every 500 cells. Copies at most one due
+     * table into cell and returns true if it did.
+     */
+    inline bool
+    ts_packetizer::insert_psi(unsigned char *cell)
+    {
+      unsigned char temp, continuity_counter;
+
+      pat_count++;
+      pmt_count++;
+      mgt_count++;
+      tvct_count++;
+      if (pat_count >= 500) {
+        pat_count = 0;
+        memcpy(cell, &pat[0], MPEG2_PACKET_SIZE);
+        temp = pat[3];
+        continuity_counter = temp & 0xf;
+        continuity_counter = (continuity_counter + 1) & 0xf;
+        temp = (temp & 0xf0) | continuity_counter;
+        pat[3] = temp;
+        return true;
+      }
+      else if (pmt_count >= 500) {
+        pmt_count = 0;
+        memcpy(cell, &pmt[0], MPEG2_PACKET_SIZE);
+        temp = pmt[3];
+        continuity_counter = temp & 0xf;
+        continuity_counter = (continuity_counter + 1) & 0xf;
+        temp = (temp & 0xf0) | continuity_counter;
+        pmt[3] = temp;
+        return true;
+      }
+      else if (mgt_count >= 500) {
+        mgt_count = 0;
+        memcpy(cell, &mgt[0], MPEG2_PACKET_SIZE);
+        temp = mgt[3];
+        continuity_counter = temp & 0xf;
+        continuity_counter = (continuity_counter + 1) & 0xf;
+        temp = (temp & 0xf0) | continuity_counter;
+        mgt[3] = temp;
+        tvct[3] = temp;
+        return true;
+      }
+      else if (tvct_count >= 500) {
+        tvct_count = 0;
+        memcpy(cell, &tvct[0], MPEG2_PACKET_SIZE);
+        temp = tvct[3];
+        continuity_counter = temp & 0xf;
+        continuity_counter = (continuity_counter + 1) & 0xf;
+        temp = (temp & 0xf0) | continuity_counter;
+        tvct[3] = temp;
+        mgt[3] = temp;
+        return true;
+      }
+      return false;
+    }
+
+    inline void
+    ts_packetizer::ule_header(unsigned char *cell, int payload_unit_start)
+    {
+      TS_HEADER tsHeader;
+
+      tsHeader.sync_byte = 0x47;
+      tsHeader.transport_error_indicator = 0x0;
+      tsHeader.payload_unit_start_indicator = payload_unit_start;
+      tsHeader.transport_priority = 0x1;
+      tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
+      tsHeader.pid_7to0 = (pidULE) & 0xff;
+      tsHeader.transport_scrambling_control = 0x0;
+      tsHeader.adaptation_field_control = 0x1;
+      tsHeader.continuity_counter = ule_continuity_counter & 0xf;
+      ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
+      memcpy(cell, (unsigned char *)&tsHeader, TS_HEADER_SIZE);
+    }
+
+    /*
+     * Frames are built into SNDUs in their pool buffers as they are
+     * taken, then packed like any other SNDUs.
+     */
+    int
+    ts_packetizer::packetize(unsigned char *out, int size, packet_source *source)
+    {
+      serial_sndu_source frames(source);
+
+      return packetize_sndus(out, size, &frames);
+    }
+
+    int
+    ts_packetizer::packetize_sndus(unsigned char *out, int size, sndu_source *source)
+    {
+      return (this->*packer)(out, size, source);
+    }
+
+    /*
+     * Pack complete SNDUs into cells. With Packing, a cell that
+     * finishes one SNDU starts the next in its remaining payload, as
+     * long as at least the two byte length field fits (RFC 4326
+     * section 7.2). Without, every SNDU starts a cell and the rest of
+     * its last cell is padding. Fetching SNDUs is not charged to
+     * the packetize stage, their builders profile themselves.
+     */
+    template <bool Packing>
+    int
+    ts_packetizer::pack_sndus(unsigned char *out, int size, sndu_source *source)
+    {
+      int produced = 0;
+      unsigned char *cell;
+      unsigned int offset, count;
+      bool pointer, started;
+      uint64_t null_cells_start = null_cells;
+      profile_timer timer;
+
+      null_runs.clear();
+
+      while (produced + MPEG2_PACKET_SIZE <= size) {
+        cell = &out[produced];
+        timer.start();
+        if (config_pending && sndu == NULL) {
+          boost::mutex::scoped_lock lock(config_mutex);
+          apply_config(pending_config);
+          config_pending = false;
+        }
+        if (insert_psi(cell)) {
+          timer.stop(PROFILE_PSI);
+          ULE_PROBE_TS_CELL(cell, TS_CELL_PSI);
+          produced += MPEG2_PACKET_SIZE;
+          continue;
+        }
+        if (sndu == NULL) {
+          timer.pause(PROFILE_PACKETIZE);
+          sndu = source->next_sndu(rewrite);
+          sndu_offset = 0;
+          timer.start();
+        }
+        if (sndu == NULL) {
+          memcpy(cell, &stuffing[0], MPEG2_PACKET_SIZE);
+          if (npd_mode) {
+            null_packet(produced);
+          }
+          timer.stop(PROFILE_STUFFING);
+          ULE_PROBE_TS_CELL(cell, TS_CELL_NULL);
+          produced += MPEG2_PACKET_SIZE;
+          continue;
+        }
+
+        started = sndu_offset == 0;
+        pointer = started || (Packing && sndu->length - sndu_offset + 2 <= SNDU_PAYLOAD_PP_SIZE);
+        ule_header(cell, pointer);
+        offset = TS_HEADER_SIZE;
+        if (pointer) {
+          cell[offset++] = started ? 0 : sndu->length - sndu_offset;    /* Payload Pointer */
+        }
+        while (1) {
+          count = sndu->length - sndu_offset;
+          if (count > MPEG2_PACKET_SIZE - offset) {
+            count = MPEG2_PACKET_SIZE - offset;
+          }
+          memcpy(&cell[offset], &sndu->data[sndu_offset], count);
+          offset += count;
+          sndu_offset += count;
+          if (sndu_offset < sndu->length) {
+            break;
+          }
+          ULE_PROBE_SNDU_END(sndu, sndu->length);
+          sndu->release();
+          sndu = NULL;
+          if (!Packing || !pointer || MPEG2_PACKET_SIZE - offset < 2 || config_pending) {
+            break;
+          }
+          timer.pause(PROFILE_PACKETIZE);
+          sndu = source->next_sndu(rewrite);
+          sndu_offset = 0;
+          timer.start();
+          if (sndu == NULL) {
+            break;
+          }
+          started = true;
+        }
+        if (pointer && !started) {
+          /* nothing followed the end of the SNDU, drop the pointer */
+          memmove(&cell[TS_HEADER_SIZE], &cell[SNDU_PAYLOAD_PP_OFFSET], offset - SNDU_PAYLOAD_PP_OFFSET);
+          offset--;
+          cell[1] &= ~0x40;
+        }
+        memset(&cell[offset], 0xff, MPEG2_PACKET_SIZE - offset);
+        timer.stop(PROFILE_PACKETIZE);
+        ULE_PROBE_TS_CELL(cell, TS_CELL_ULE);
+        produced += MPEG2_PACKET_SIZE;
+      }
+
+      data_cells += (produced / MPEG2_PACKET_SIZE) - (null_cells - null_cells_start);
+      return produced;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
+
@@ -0,0 +1,395 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016,2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_ULE_TS_PACKETIZER_H
+#define INCLUDED_ULE_TS_PACKETIZER_H
+
+#include <ule/ule_config.h>
+#include <pcap.h>
+#include <arpa/inet.h>
+#include <netinet/if_ether.h>
+#include <netinet/ip.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include "sndu_builder.h"
+#include "sndu_encap.h"
+
+#define TRUE 1
+#define FALSE 0
+
+#define MPEG2_PACKET_SIZE 188
+#define PAYLOAD_POINTER_SIZE 1
+#define NPD_MAX_DNP 255
+#define ULE_PID 0x35
+
+typedef struct {
+    unsigned char sync_byte                   :8; /* Synchronization byte. */
+    unsigned char pid_12to8                   :5; /* Program ID, bits 12:8. */
+    unsigned char transport_priority          :1; /* Transport stream priority. */
+    unsigned char payload_unit_start_indicator:1; /* Payload unit start indicator. */
+    unsigned char transport_error_indicator   :1; /* Transport stream error indicator. */
+    unsigned char pid_7to0                    :8; /* Program ID, bits 7:0. */
+    unsigned char continuity_counter          :4; /* Countinuity counter. */
+    unsigned char adaptation_field_control    :2; /* Transport stream Adaptation field control. */
+    unsigned char transport_scrambling_control:2; /* Transport stream scrambling control. */
+} TS_HEADER;
+
+#define TS_HEADER_SIZE 4
+
+typedef struct {
+    unsigned int table_id:8;
+    unsigned int section_length_h:4;
+    unsigned int reserved0:2;
+    unsigned int b0:1;
+    unsigned int section_syntax_indicator:1;
+    unsigned int section_length_l:8;
+    unsigned int transport_stream_id_h:8;
+    unsigned int transport_stream_id_l:8;
+    unsigned int current_next_indicator:1;
+    unsigned int version_number:5;
+    unsigned int reserved1:2;
+    unsigned int section_number:8;
+    unsigned int last_section_number:8;
+} PAT_HEADER;
+
+#define PAT_HEADER_SIZE 8
+
+typedef struct {
+    unsigned int program_number_h:8;
+    unsigned int program_number_l:8;
+    unsigned int program_map_PID_h:5;
+    unsigned int reserved2:3;
+    unsigned int program_map_PID_l:8;
+} PAT_ELEMENT;
+
+#define PAT_ELEMENT_SIZE 4
+
+typedef struct {
+    unsigned int table_id:8;
+    unsigned int section_length_h:4;
+    unsigned int reserved0:2;
+    unsigned int b0:1;
+    unsigned int section_syntax_indicator:1;
+    unsigned int section_length_l:8;
+    unsigned int program_number_h:8;
+    unsigned int program_number_l:8;
+    unsigned int current_next_indicator:1;
+    unsigned int version_number:5;
+    unsigned int reserved1:2;
+    unsigned int section_number:8;
+    unsigned int last_section_number:8;
+    unsigned int PCR_PID_h:5;
+    unsigned int reserved2:3;
+    unsigned int PCR_PID_l:8;
+    unsigned int program_info_length_h:4;
+    unsigned int reserved3:4;
+    unsigned int program_info_length_l:8;
+} PMT_HEADER;
+
+#define PMT_HEADER_SIZE 12
+
+typedef struct {
+    unsigned int stream_type:8;
+    unsigned int elementary_PID_h:5;
+    unsigned int reserved0:3;
+    unsigned int elementary_PID_l:8;
+    unsigned int ES_info_length_h:4;
+    unsigned int reserved1:4;
+    unsigned int ES_info_length_l:8;
+} PMT_ELEMENT;
+
+#define PMT_ELEMENT_SIZE 5
+
+typedef struct {
+    unsigned int descriptor_tag:8;
+    unsigned int descriptor_length:8;
+    unsigned int component_tag:8;
+} PMT_STREAM_DESCRIPTOR;
+
+#define PMT_STREAM_DESCRIPTOR_SIZE 3
+
+typedef struct {
+    unsigned int descriptor_tag:8;
+    unsigned int descriptor_length:8;
+    unsigned int format_identifier_31to24:8;
+    unsigned int format_identifier_23to16:8;
+    unsigned int format_identifier_15to8:8;
+    unsigned int format_identifier_7to0:8;
+} PMT_REGISTRATION_DESCRIPTOR;
+
+#define PMT_REGISTRATION_DESCRIPTOR_SIZE 6
+
+typedef struct {
+    unsigned int table_id:8;
+    unsigned int section_length_h:4;
+    unsigned int reserved0:2;
+    unsigned int private_indicator:1;
+    unsigned int section_syntax_indicator:1;
+    unsigned int section_length_l:8;
+    unsigned int table_id_extension_h:8;
+    unsigned int table_id_extension_l:8;
+    unsigned int current_next_indicator:1;
+    unsigned int version_number:5;
+    unsigned int reserved1:2;
+    unsigned int section_number:8;
+    unsigned int last_section_number:8;
+    unsigned int protocol_version:8;
+    unsigned int tables_defined_h:8;
+    unsigned int tables_defined_l:8;
+} MGT_HEADER;
+
+#define MGT_HEADER_SIZE 11
+
+typedef struct {
+    unsigned int table_type_h:8;
+    unsigned int table_type_l:8;
+    unsigned int table_type_PID_h:5;
+    unsigned int reserved0:3;
+    unsigned int table_type_PID_l:8;
+    unsigned int table_type_version_number:5;
+    unsigned int reserved1:3;
+    unsigned int number_bytes_h:8;
+    unsigned int number_bytes_mh:8;
+    unsigned int number_bytes_ml:8;
+    unsigned int number_bytes_l:8;
+    unsigned int table_type_descriptors_length_h:4;
+    unsigned int reserved2:4;
+    unsigned int table_type_descriptors_length_l:8;
+} MGT_ELEMENT;
+
+#define MGT_ELEMENT_SIZE 11
+
+typedef struct {
+    unsigned int descriptors_length_h:4;
+    unsigned int reserved:4;
+    unsigned int descriptors_length_l:8;
+} MGT_TRAILER;
+
+#define MGT_TRAILER_SIZE 2
+
+typedef struct {
+    unsigned int table_id:8;
+    unsigned int section_length_h:4;
+    unsigned int reserved0:2;
+    unsigned int private_indicator:1;
+    unsigned int section_syntax_indicator:1;
+    unsigned int section_length_l:8;
+    unsigned int transport_stream_id_h:8;
+    unsigned int transport_stream_id_l:8;
+    unsigned int current_next_indicator:1;
+    unsigned int version_number:5;
+    unsigned int reserved1:2;
+    unsigned int section_number:8;
+    unsigned int last_section_number:8;
+    unsigned int protocol_version:8;
+    unsigned int num_channels_in_section:8;
+} TVCT_HEADER;
+
+#define TVCT_HEADER_SIZE 10
+
+typedef struct {
+    unsigned int short_name_1h:8;
+    unsigned int short_name_1l:8;
+    unsigned int short_name_2h:8;
+    unsigned int short_name_2l:8;
+    unsigned int short_name_3h:8;
+    unsigned int short_name_3l:8;
+    unsigned int short_name_4h:8;
+    unsigned int short_name_4l:8;
+    unsigned int short_name_5h:8;
+    unsigned int short_name_5l:8;
+    unsigned int short_name_6h:8;
+    unsigned int short_name_6l:8;
+    unsigned int short_name_7h:8;
+    unsigned int short_name_7l:8;
+    unsigned int major_channel_number_h:4;
+    unsigned int reserved0:4;
+    unsigned int minor_channel_number_h:2;
+    unsigned int major_channel_number_l:6;
+    unsigned int minor_channel_number_l:8;
+    unsigned int modulation_mode:8;
+    unsigned int carrier_frequency_h:8;
+    unsigned int carrier_frequency_mh:8;
+    unsigned int carrier_frequency_ml:8;
+    unsigned int carrier_frequency_l:8;
+    unsigned int channel_TSID_h:8;
+    unsigned int channel_TSID_l:8;
+    unsigned int program_number_h:8;
+    unsigned int program_number_l:8;
+    unsigned int reserved2:1;
+    unsigned int hide_guide:1;
+    unsigned int reserved1:2;
+    unsigned int hidden:1;
+    unsigned int access_controlled:1;
+    unsigned int ETM_location:2;
+    unsigned int service_type:6;
+    unsigned int reserved3:2;
+    unsigned int source_id_h:8;
+    unsigned int source_id_l:8;
+    unsigned int descriptors_length_h:2;
+    unsigned int reserved4:6;
+    unsigned int descriptors_length_l:8;
+} TVCT_ELEMENT;
+
+#define TVCT_ELEMENT_SIZE 32
+
+typedef struct {
+    unsigned int additional_descriptors_length_h:2;
+    unsigned int reserved:6;
+    unsigned int additional_descriptors_length_l:8;
+} TVCT_TRAILER;
+
+#define TVCT_TRAILER_SIZE 2
+
+typedef struct {
+    unsigned int descriptor_tag:8;
+    unsigned int descriptor_length:8;
+    unsigned int PCR_PID_h:5;
+    unsigned int reserved:3;
+    unsigned int PCR_PID_l:8;
+    unsigned int number_elements:8;
+} TVCT_SLD_DESCRIPTOR;
+
+#define TVCT_DESCRIPTOR_SIZE 5
+
+typedef struct {
+    unsigned int stream_type:8;
+    unsigned int elementary_PID_h:5;
+    unsigned int reserved:3;
+    unsigned int elementary_PID_l:8;
+    unsigned int ISO_639_language_code_1:8;
+    unsigned int ISO_639_language_code_2:8;
+    unsigned int ISO_639_language_code_3:8;
+} TVCT_SLD_DESCRIPTOR_ELEMENT;
+
+#define TVCT_DESCRIPTOR_ELEMENT_SIZE       (6)
+
+#define SNDU_PAYLOAD_SIZE (MPEG2_PACKET_SIZE - TS_HEADER_SIZE)
+#define SNDU_PAYLOAD_PP_SIZE (MPEG2_PACKET_SIZE - TS_HEADER_SIZE - PAYLOAD_POINTER_SIZE)
+#define SNDU_PAYLOAD_PP_OFFSET (TS_HEADER_SIZE + PAYLOAD_POINTER_SIZE)
+
+namespace gr {
+  namespace ule {
+
+    /*
+     * Settings that can be changed while the stream is running.
+     */
+    struct ts_packetizer_config {
+      int pid;
+      std::string call_sign;
+      int ping_reply;
+      int ipaddr_spoof;
+      std::string src_address;
+      std::string dst_address;
+    };
+
+    /*
+     * ULE encapsulator for one Transport Stream. Owns the PSI tables,
+     * the continuity counters and the SNDU state machine. The SNDU
+     * builder and the cell packer are picked once for the options in
+     * use, so the per frame paths do not test them.
+     */
+    class ts_packetizer
+    {
+     private:
+      unsigned int pat_count;
+      unsigned int pmt_count;
+      unsigned int mgt_count;
+      unsigned int tvct_count;
+      int npd_mode;
+      int pidULE;
+      int psi_version;
+      ts_packetizer_config config;
+      ts_packetizer_config pending_config;
+      boost::atomic<bool> config_pending;
+      boost::mutex config_mutex;
+      unsigned char pat[MPEG2_PACKET_SIZE];
+      unsigned char pmt[MPEG2_PACKET_SIZE];
+      unsigned char mgt[MPEG2_PACKET_SIZE];
+      unsigned char tvct[MPEG2_PACKET_SIZE];
+      unsigned char stuffing[MPEG2_PACKET_SIZE];
+      unsigned char ule_continuity_counter;
+      sndu_rewrite rewrite;
+      int (ts_packetizer::*packer)(unsigned char *, int, sndu_source *);
+      packet_desc *sndu;
+      unsigned int sndu_offset;
+      std::vector<std::pair<int, int> > null_runs;
+      uint64_t null_cells;
+      uint64_t data_cells;
+      int crc32_calc(unsigned char *, int);
+      inline bool insert_psi(unsigned char *);
+      inline void ule_header(unsigned char *, int);
+      inline void null_packet(int);
+      void check_config(const ts_packetizer_config &);
+      void apply_config(const ts_packetizer_config &);
+      void build_psi(void);
+      template <bool Packing> int pack_sndus(unsigned char *, int, sndu_source *);
+
+     public:
+      ts_packetizer(int pid, const char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, const char *src_address, const char *dst_address, ule_npd_t npd, ule_dbit_t dbit, ule_packing_t packing);
+      ~ts_packetizer();
+
+      int packetize(unsigned char *out, int size, packet_source *source);
+      int packetize_sndus(unsigned char *out, int size, sndu_source *source);
+
+      /*
+       * Stage a new configuration from any thread. It takes effect at
+       * the next SNDU boundary. Throws std::runtime_error if invalid.
+       */
+      void set_config(const ts_packetizer_config &cfg);
+      ts_packetizer_config get_config(void);
+
+      /*
+       * Seal every SNDU this packetizer builds with security, or send
+       * them in clear with NULL. Set before the first call.
+       */
+      void set_security(sndu_security *security)
+      {
+        rewrite.security = security;
+        rewrite.build = select_sndu_builder(rewrite);
+      }
+
+      /*
+       * Compress the SNDUs this packetizer builds with compress, or
+       * not with NULL. Set before the first call.
+       */
+      void set_compress(sndu_compress *compress)
+      {
+        rewrite.compress = compress;
+        rewrite.build = select_sndu_builder(rewrite);
+      }
+      const std::vector<std::pair<int, int> > &get_null_runs(void) const { return null_runs; }
+      uint64_t get_null_cells(void) const { return null_cells; }
+      uint64_t get_data_cells(void) const { return data_cells; }
+      unsigned int get_pending_cells(void) const
+      {
+        return sndu ? (sndu->length - sndu_offset + SNDU_PAYLOAD_SIZE - 1) / SNDU_PAYLOAD_SIZE : 0;
+      }
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_PACKETIZER_H */
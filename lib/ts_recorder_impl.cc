@@ -0,0 +1,299 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "ts_recorder_impl.h"
+
+namespace gr {
+  namespace ule {
+
+    ts_recorder::sptr
+    ts_recorder::make(const std::string &filename, float window, int ts_rate, int pid)
+    {
+      return gnuradio::get_initial_sptr
+        (new ts_recorder_impl(filename, window, ts_rate, pid));
+    }
+
+    /*
+     * The private constructor
+     */
+    ts_recorder_impl::ts_recorder_impl(const std::string &filename, float window, int ts_rate, int pid)
+      : gr::sync_block("ts_recorder",
+              gr::io_signature::make(1, 1, sizeof(unsigned char)),
+              gr::io_signature::make(0, 0, 0))
+    {
+      struct timespec ts;
+      uint64_t bytes;
+
+      if (window <= 0.0 || ts_rate <= 0) {
+        throw std::runtime_error("ts_recorder: window and TS rate must be positive\n");
+      }
+      if (pid < 0 || pid > 0x1fff) {
+        throw std::runtime_error("ts_recorder: PID must be 0 to 0x1fff\n");
+      }
+      this->pid = pid;
+      bytes = (uint64_t)((double)window * ts_rate / 8.0);
+      data_size = (bytes + RECORDER_RING_UNIT - 1) / RECORDER_RING_UNIT * RECORDER_RING_UNIT;
+      if (data_size == 0) {
+        data_size = RECORDER_RING_UNIT;
+      }
+      segments = data_size / RECORDER_SEGMENT_SIZE;
+      /* enough entries to cover the whole ring even when every cell is packed full */
+      entry_capacity = data_size / MPEG2_PACKET_SIZE * RECORDER_CELL_STARTS;
+      cells = 0;
+      sequence = 0;
+      write_offset = 0;
+      flusher = NULL;
+      running = false;
+
+      data = (unsigned char *)map_file(filename, data_size, &data_fd);
+      try {
+        index_map = (unsigned char *)map_file(filename + ".idx", TS_INDEX_HEADER_SIZE + entry_capacity * sizeof(ts_index_entry), &index_fd);
+      }
+      catch (...) {
+        munmap(data, data_size);
+        close(data_fd);
+        throw;
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(data, data_size, MADV_HUGEPAGE);
+#endif
+      header = (ts_index_header *)index_map;
+      entries = (ts_index_entry *)(index_map + TS_INDEX_HEADER_SIZE);
+      memset(header, 0, sizeof(ts_index_header));
+      memcpy(header->magic, TS_INDEX_MAGIC, sizeof(header->magic));
+      header->version = TS_INDEX_VERSION;
+      header->entry_size = sizeof(ts_index_entry);
+      header->data_size = data_size;
+      header->entry_capacity = entry_capacity;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      header->start_time = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+      set_output_multiple(MPEG2_PACKET_SIZE);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ts_recorder_impl::~ts_recorder_impl()
+    {
+      stop();
+      munmap(index_map, TS_INDEX_HEADER_SIZE + entry_capacity * sizeof(ts_index_entry));
+      munmap(data, data_size);
+      close(index_fd);
+      close(data_fd);
+    }
+
+    /* allocate the blocks up front, a full disk must not SIGBUS work() */
+    void *
+    ts_recorder_impl::map_file(const std::string &filename, uint64_t size, int *fd)
+    {
+      void *map;
+      int rc;
+
+      *fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+      if (*fd < 0) {
+        throw std::runtime_error("ts_recorder: can't open " + filename + "\n");
+      }
+      rc = ftruncate(*fd, size);
+      if (rc == 0) {
+        rc = posix_fallocate(*fd, 0, size);
+        if (rc == EOPNOTSUPP || rc == EINVAL) {
+          rc = 0;
+        }
+      }
+      if (rc != 0) {
+        close(*fd);
+        throw std::runtime_error("ts_recorder: can't allocate " + filename + "\n");
+      }
+      map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+      if (map == MAP_FAILED) {
+        close(*fd);
+        throw std::runtime_error("ts_recorder: can't map " + filename + "\n");
+      }
+      return map;
+    }
+
+    bool
+    ts_recorder_impl::start()
+    {
+      running = true;
+      flusher = new boost::thread(boost::bind(&ts_recorder_impl::flush_loop, this));
+      return true;
+    }
+
+    bool
+    ts_recorder_impl::stop()
+    {
+      if (flusher) {
+        {
+          boost::mutex::scoped_lock lock(flush_mutex);
+          running = false;
+          flush_ready.notify_one();
+        }
+        flusher->join();
+        delete flusher;
+        flusher = NULL;
+        msync(index_map, TS_INDEX_HEADER_SIZE + entry_capacity * sizeof(ts_index_entry), MS_ASYNC);
+        msync(data, data_size, MS_ASYNC);
+      }
+      return true;
+    }
+
+    /*
+     * Start writeback of each finished segment, so dirty pages never
+     * pile up until the kernel throttles work(), and read the segment
+     * after next into the page cache before it is overwritten.
+     */
+    void
+    ts_recorder_impl::flush_loop(void)
+    {
+      uint64_t segment, ahead;
+
+      while (1) {
+        {
+          boost::mutex::scoped_lock lock(flush_mutex);
+          while (running && finished.empty()) {
+            flush_ready.wait(lock);
+          }
+          if (!running) {
+            return;
+          }
+          segment = finished.front();
+          finished.pop_front();
+        }
+        sync_file_range(data_fd, segment * RECORDER_SEGMENT_SIZE, RECORDER_SEGMENT_SIZE, SYNC_FILE_RANGE_WRITE);
+        ahead = (segment + RECORDER_PREFETCH) % segments;
+        madvise(data + ahead * RECORDER_SEGMENT_SIZE, RECORDER_SEGMENT_SIZE, MADV_WILLNEED);
+        msync(index_map, TS_INDEX_HEADER_SIZE + entry_capacity * sizeof(ts_index_entry), MS_ASYNC);
+      }
+    }
+
+    /*
+     * Every SNDU starts in a cell with the payload unit start bit set,
+     * at the payload pointer or straight after an SNDU that ended in
+     * the same cell, so only those cells need to be looked at.
+     */
+    void
+    ts_recorder_impl::index_cell(const unsigned char *cell, uint64_t number, int64_t now)
+    {
+      unsigned int pos = TS_HEADER_SIZE, length;
+      ts_index_entry *entry;
+
+      if (cell[0] != 0x47 || !(cell[1] & 0x40) || (((cell[1] & 0x1f) << 8) | cell[2]) != pid) {
+        return;
+      }
+      if (!(cell[3] & 0x10)) {
+        return;
+      }
+      if (cell[3] & 0x20) {
+        pos += 1 + cell[pos];
+      }
+      if (pos >= MPEG2_PACKET_SIZE) {
+        return;
+      }
+      pos += 1 + cell[pos];
+      while (pos + 2 <= MPEG2_PACKET_SIZE) {
+        if (cell[pos] == 0xff && cell[pos + 1] == 0xff) {
+          break;    /* end of SNDU padding */
+        }
+        length = (((cell[pos] & 0x7f) << 8) | cell[pos + 1]) + SNDU_HEADER_SIZE;
+        entry = &entries[sequence % entry_capacity];
+        entry->sequence = sequence;
+        entry->cell = number;
+        entry->time = now;
+        entry->offset = pos;
+        entry->pid = pid;
+        entry->length = length;
+        sequence++;
+        pos += length;
+      }
+    }
+
+    void
+    ts_recorder_impl::write_data(const unsigned char *in, uint64_t length)
+    {
+      uint64_t first, last, count;
+
+      first = write_offset / RECORDER_SEGMENT_SIZE;
+      while (length > 0) {
+        count = data_size - write_offset;
+        if (count > length) {
+          count = length;
+        }
+        memcpy(data + write_offset, in, count);
+        in += count;
+        length -= count;
+        write_offset += count;
+        last = write_offset / RECORDER_SEGMENT_SIZE;
+        if (last != first) {
+          boost::mutex::scoped_lock lock(flush_mutex);
+          for (uint64_t s = first; s != last; s++) {
+            finished.push_back(s);
+          }
+          flush_ready.notify_one();
+          first = last;
+        }
+        if (write_offset == data_size) {
+          write_offset = 0;
+          first = 0;
+        }
+      }
+    }
+
+    int
+    ts_recorder_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const unsigned char *in = (const unsigned char *) input_items[0];
+      int count = noutput_items / MPEG2_PACKET_SIZE;
+      struct timespec ts;
+      int64_t now;
+
+      clock_gettime(CLOCK_REALTIME, &ts);
+      now = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+      for (int i = 0; i < count; i++) {
+        index_cell(&in[i * MPEG2_PACKET_SIZE], cells + i, now);
+      }
+      write_data(in, (uint64_t)count * MPEG2_PACKET_SIZE);
+      cells += count;
+
+      /* publish the counters after the data they describe */
+      __atomic_store_n(&header->entries, sequence, __ATOMIC_RELEASE);
+      __atomic_store_n(&header->cells, cells, __ATOMIC_RELEASE);
+
+      // Tell runtime system how many output items we produced.
+      return count * MPEG2_PACKET_SIZE;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
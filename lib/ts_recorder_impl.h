@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_RECORDER_IMPL_H
+#define INCLUDED_ULE_TS_RECORDER_IMPL_H
+
+#include <ule/ts_recorder.h>
+#include <deque>
+#include <boost/thread.hpp>
+
+#define MPEG2_PACKET_SIZE 188
+#define TS_HEADER_SIZE 4
+#define SNDU_HEADER_SIZE 4
+#define RECORDER_SEGMENT_SIZE (2 * 1024 * 1024)
+/* whole cells and whole segments, so no cell straddles the wrap */
+#define RECORDER_RING_UNIT ((uint64_t)MPEG2_PACKET_SIZE / 4 * RECORDER_SEGMENT_SIZE)
+#define RECORDER_PREFETCH 2
+/*
+ * Packed SNDU starts a cell can hold: the payload after the pointer
+ * field cut into the shortest useful SNDU, a bare IPv4 header
+ * between the SNDU header and CRC.
+ */
+#define RECORDER_MIN_SNDU (SNDU_HEADER_SIZE + 20 + 4)
+#define RECORDER_CELL_STARTS ((MPEG2_PACKET_SIZE - TS_HEADER_SIZE - 1) / RECORDER_MIN_SNDU + 1)
+
+namespace gr {
+  namespace ule {
+
+    class ts_recorder_impl : public ts_recorder
+    {
+     private:
+      int pid;
+      int data_fd;
+      int index_fd;
+      unsigned char *data;
+      unsigned char *index_map;
+      ts_index_header *header;
+      ts_index_entry *entries;
+      uint64_t data_size;
+      uint64_t segments;
+      uint64_t entry_capacity;
+      uint64_t cells;
+      uint64_t sequence;
+      uint64_t write_offset;
+      std::deque<uint64_t> finished;
+      boost::mutex flush_mutex;
+      boost::condition_variable flush_ready;
+      boost::thread *flusher;
+      bool running;
+      void *map_file(const std::string &filename, uint64_t size, int *fd);
+      void flush_loop(void);
+      void index_cell(const unsigned char *cell, uint64_t number, int64_t now);
+      void write_data(const unsigned char *in, uint64_t length);
+
+     public:
+      ts_recorder_impl(const std::string &filename, float window, int ts_rate, int pid);
+      ~ts_recorder_impl();
+
+      uint64_t cells_recorded() { return cells; }
+      uint64_t sndus_indexed() { return sequence; }
+
+      bool start();
+      bool stop();
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_RECORDER_IMPL_H */
@@ -0,0 +1,306 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <time.h>
+#include <unistd.h>
+#include "ts_udp_sink_impl.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace gr {
+  namespace ule {
+
+    ts_udp_sink::sptr
+    ts_udp_sink::make(const std::string &address, int port, ule_udp_encap_t encapsulation, int cells_per_datagram, int ts_rate, int ttl)
+    {
+      return gnuradio::get_initial_sptr
+        (new ts_udp_sink_impl(address, port, encapsulation, cells_per_datagram, ts_rate, ttl));
+    }
+
+    /*
+     * The private constructor
+     */
+    ts_udp_sink_impl::ts_udp_sink_impl(const std::string &address, int port, ule_udp_encap_t encapsulation, int cells_per_datagram, int ts_rate, int ttl)
+      : gr::sync_block("ts_udp_sink",
+              gr::io_signature::make(1, 1, sizeof(unsigned char)),
+              gr::io_signature::make(0, 0, 0))
+    {
+      if (cells_per_datagram < 1 || cells_per_datagram > UDP_MAX_CELLS) {
+        throw std::runtime_error("ts_udp_sink: cells per datagram must be 1 to 7\n");
+      }
+      if (ts_rate < 0) {
+        throw std::runtime_error("ts_udp_sink: TS rate must not be negative\n");
+      }
+      this->encapsulation = encapsulation;
+      datagram_size = cells_per_datagram * MPEG2_PACKET_SIZE;
+      this->ts_rate = ts_rate;
+      max_batch = UDP_BATCH;
+      datagram_time = 0.0;
+      if (ts_rate > 0) {
+        /* keep each burst within PACING_BURST of TS */
+        datagram_time = datagram_size * 8.0 / ts_rate;
+        max_batch = (int)(PACING_BURST / datagram_time);
+        if (max_batch < 1) {
+          max_batch = 1;
+        }
+        if (max_batch > UDP_BATCH) {
+          max_batch = UDP_BATCH;
+        }
+      }
+      next_time = 0.0;
+      rtp_sequence = rand() & 0xffff;
+      rtp_ssrc = ((uint32_t)rand() << 16) ^ (uint32_t)rand() ^ getpid();
+      bytes_sent = 0;
+      sent = 0;
+      errors = 0;
+
+      open_socket(address, port, ttl);
+      set_output_multiple(datagram_size);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ts_udp_sink_impl::~ts_udp_sink_impl()
+    {
+      close(sock);
+    }
+
+    void
+    ts_udp_sink_impl::open_socket(const std::string &address, int port, int ttl)
+    {
+      struct addrinfo hints, *res;
+      std::stringstream service;
+      bool multicast;
+      int segment, rc;
+
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_DGRAM;
+      hints.ai_flags = AI_NUMERICSERV;
+      service << port;
+      rc = getaddrinfo(address.c_str(), service.str().c_str(), &hints, &res);
+      if (rc != 0) {
+        std::stringstream s;
+        s << "ts_udp_sink: can't resolve " << address << ": " << gai_strerror(rc) << std::endl;
+        throw std::runtime_error(s.str());
+      }
+      sock = socket(res->ai_family, SOCK_DGRAM, 0);
+      if (sock < 0) {
+        freeaddrinfo(res);
+        throw std::runtime_error("ts_udp_sink: error calling socket()\n");
+      }
+      if (res->ai_family == AF_INET6) {
+        multicast = IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)res->ai_addr)->sin6_addr);
+        rc = setsockopt(sock, IPPROTO_IPV6, multicast ? IPV6_MULTICAST_HOPS : IPV6_UNICAST_HOPS, &ttl, sizeof(ttl));
+      }
+      else {
+        multicast = IN_MULTICAST(ntohl(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr));
+        if (multicast) {
+          unsigned char mttl = ttl;
+          rc = setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl));
+        }
+        else {
+          rc = setsockopt(sock, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+        }
+      }
+      if (rc < 0 || connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        freeaddrinfo(res);
+        close(sock);
+        throw std::runtime_error("ts_udp_sink: error setting up the socket\n");
+      }
+      freeaddrinfo(res);
+
+      /* every send larger than one segment is split by the kernel */
+      segment = datagram_size + (encapsulation == UDP_RTP ? RTP_HEADER_SIZE : 0);
+      gso = setsockopt(sock, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0;
+    }
+
+    bool
+    ts_udp_sink_impl::start()
+    {
+      next_time = 0.0;
+      return true;
+    }
+
+    double
+    ts_udp_sink_impl::now(void)
+    {
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    void
+    ts_udp_sink_impl::pace(int datagrams)
+    {
+      struct timespec ts;
+      double t = now();
+
+      if (next_time == 0.0 || t - next_time > PACING_RESYNC) {
+        next_time = t;
+      }
+      if (next_time > t) {
+        ts.tv_sec = (time_t)next_time;
+        ts.tv_nsec = (long)((next_time - ts.tv_sec) * 1e9);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+      }
+      next_time += datagrams * datagram_time;
+    }
+
+    /*
+     * One iovec per datagram, or an RTP header and payload pair. The
+     * payload is sent straight from the input buffer.
+     */
+    int
+    ts_udp_sink_impl::build_iov(const unsigned char *in, int datagrams)
+    {
+      unsigned char *rtp;
+      uint32_t timestamp;
+      int n = 0;
+
+      for (int i = 0; i < datagrams; i++) {
+        if (encapsulation == UDP_RTP) {
+          if (ts_rate > 0) {
+            timestamp = (uint32_t)((bytes_sent + (uint64_t)i * datagram_size) * 8 * 90000 / (uint64_t)ts_rate);
+          }
+          else {
+            timestamp = (uint32_t)(uint64_t)(now() * 90000);
+          }
+          rtp = rtp_headers[i];
+          rtp[0] = 0x80;    /* version 2 */
+          rtp[1] = RTP_PAYLOAD_MP2T;
+          rtp[2] = rtp_sequence >> 8;
+          rtp[3] = rtp_sequence & 0xff;
+          rtp[4] = timestamp >> 24;
+          rtp[5] = (timestamp >> 16) & 0xff;
+          rtp[6] = (timestamp >> 8) & 0xff;
+          rtp[7] = timestamp & 0xff;
+          rtp[8] = rtp_ssrc >> 24;
+          rtp[9] = (rtp_ssrc >> 16) & 0xff;
+          rtp[10] = (rtp_ssrc >> 8) & 0xff;
+          rtp[11] = rtp_ssrc & 0xff;
+          rtp_sequence++;
+          iov[n].iov_base = rtp;
+          iov[n].iov_len = RTP_HEADER_SIZE;
+          n++;
+        }
+        iov[n].iov_base = (void *)(in + i * datagram_size);
+        iov[n].iov_len = datagram_size;
+        n++;
+      }
+      return n;
+    }
+
+    void
+    ts_udp_sink_impl::send_batch(const unsigned char *in, int datagrams)
+    {
+      int per_datagram = encapsulation == UDP_RTP ? 2 : 1;
+      int n = build_iov(in, datagrams);
+      int rc, done;
+
+      if (gso && datagrams > 1) {
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        if (sendmsg(sock, &msg, 0) >= 0) {
+          sent += datagrams;
+          bytes_sent += (uint64_t)datagrams * datagram_size;
+          return;
+        }
+        if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP) {
+          /* no segmentation offload on this route, stay with sendmmsg */
+          int segment = 0;
+          setsockopt(sock, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment));
+          gso = false;
+        }
+        else {
+          errors += datagrams;
+          bytes_sent += (uint64_t)datagrams * datagram_size;
+          return;
+        }
+      }
+
+      memset(msgs, 0, sizeof(struct mmsghdr) * datagrams);
+      for (int i = 0; i < datagrams; i++) {
+        msgs[i].msg_hdr.msg_iov = &iov[i * per_datagram];
+        msgs[i].msg_hdr.msg_iovlen = per_datagram;
+      }
+      done = 0;
+      while (done < datagrams) {
+        rc = sendmmsg(sock, &msgs[done], datagrams - done, 0);
+        if (rc <= 0) {
+          /* skip the datagram that failed, for example ECONNREFUSED */
+          errors++;
+          rc = 1;
+        }
+        else {
+          sent += rc;
+        }
+        done += rc;
+      }
+      bytes_sent += (uint64_t)datagrams * datagram_size;
+    }
+
+    int
+    ts_udp_sink_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const unsigned char *in = (const unsigned char *) input_items[0];
+      int datagrams = noutput_items / datagram_size;
+      int batch;
+
+      for (int i = 0; i < datagrams; i += batch) {
+        batch = datagrams - i;
+        if (batch > max_batch) {
+          batch = max_batch;
+        }
+        if (ts_rate > 0) {
+          pace(batch);
+        }
+        send_batch(in + i * datagram_size, batch);
+      }
+
+      // Tell runtime system how many output items we produced.
+      return datagrams * datagram_size;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
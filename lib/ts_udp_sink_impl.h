@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_TS_UDP_SINK_IMPL_H
+#define INCLUDED_ULE_TS_UDP_SINK_IMPL_H
+
+#include <ule/ts_udp_sink.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define MPEG2_PACKET_SIZE 188
+#define UDP_MAX_CELLS 7
+#define UDP_BATCH 32
+#define RTP_HEADER_SIZE 12
+#define RTP_PAYLOAD_MP2T 33
+#define PACING_BURST 0.001
+#define PACING_RESYNC 0.1
+
+namespace gr {
+  namespace ule {
+
+    class ts_udp_sink_impl : public ts_udp_sink
+    {
+     private:
+      int sock;
+      int encapsulation;
+      int datagram_size;
+      int max_batch;
+      double ts_rate;
+      double datagram_time;
+      double next_time;
+      bool gso;
+      uint16_t rtp_sequence;
+      uint32_t rtp_ssrc;
+      uint64_t bytes_sent;
+      uint64_t sent;
+      uint64_t errors;
+      unsigned char rtp_headers[UDP_BATCH][RTP_HEADER_SIZE];
+      struct iovec iov[UDP_BATCH * 2];
+      struct mmsghdr msgs[UDP_BATCH];
+      void open_socket(const std::string &address, int port, int ttl);
+      void pace(int datagrams);
+      int build_iov(const unsigned char *in, int datagrams);
+      void send_batch(const unsigned char *in, int datagrams);
+      static double now(void);
+
+     public:
+      ts_udp_sink_impl(const std::string &address, int port, ule_udp_encap_t encapsulation, int cells_per_datagram, int ts_rate, int ttl);
+      ~ts_udp_sink_impl();
+
+      uint64_t datagrams_sent() { return sent; }
+      uint64_t send_errors() { return errors; }
+
+      bool start();
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_TS_UDP_SINK_IMPL_H */
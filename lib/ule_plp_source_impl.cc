@@ -0,0 +1,174 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "ule_plp_source_impl.h"
+
+namespace gr {
+  namespace ule {
+
+    ule_plp_source::sptr
+    ule_plp_source::make(char *mac_address, char *interface, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, int plp, int num_plps, const std::vector<int> &class_map)
+    {
+      return gnuradio::get_initial_sptr
+        (new ule_plp_source_impl(mac_address, interface, filename, frequency, call_sign, ping_reply, ipaddr_spoof, src_address, dst_address, npd, plp, num_plps, class_map));
+    }
+
+    /*
+     * The private constructor
+     */
+    ule_plp_source_impl::ule_plp_source_impl(char *mac_address, char *interface, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, int plp, int num_plps, const std::vector<int> &class_map)
+      : gr::sync_block("ule_plp_source",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(1, 1, sizeof(unsigned char))),
+        plp(plp)
+    {
+      if (plp < 0 || plp >= num_plps) {
+        throw std::runtime_error("ule_plp_source: PLP must be 0 to the number of PLPs - 1\n");
+      }
+      npd_mode = npd;
+      npd_stats_count = 0;
+      classifier = plp_classifier::attach(interface && *interface ? interface : DEFAULT_IF, mac_address, num_plps, class_map);
+      packetizer = new ts_packetizer(ULE_PID, call_sign, ping_reply, ipaddr_spoof, src_address, dst_address, npd, DBIT_OFF, PACKING_ON);
+
+      /* one receiver for the whole stream */
+      frontend = NULL;
+      if (plp == 0) {
+        frontend = new dvb_frontend(filename, frequency, boost::bind(&ule_plp_source_impl::publish_frontend_status, this, _1));
+      }
+
+      message_port_register_out(pmt::mp("npd"));
+      message_port_register_out(pmt::mp("frontend"));
+      message_port_register_in(pmt::mp("retune"));
+      set_msg_handler(pmt::mp("retune"), boost::bind(&ule_plp_source_impl::handle_retune, this, _1));
+      set_output_multiple(MPEG2_PACKET_SIZE * 200);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ule_plp_source_impl::~ule_plp_source_impl()
+    {
+      delete frontend;
+      delete packetizer;
+    }
+
+    bool
+    ule_plp_source_impl::start()
+    {
+      if (frontend) {
+        frontend->start();
+      }
+      classifier->start();
+      return true;
+    }
+
+    bool
+    ule_plp_source_impl::stop()
+    {
+      classifier->stop();
+      if (frontend) {
+        frontend->stop();
+      }
+      return true;
+    }
+
+    void
+    ule_plp_source_impl::handle_retune(pmt::pmt_t msg)
+    {
+      if (frontend == NULL) {
+        return;
+      }
+      if (pmt::is_dict(msg)) {
+        msg = pmt::dict_ref(msg, pmt::mp("frequency"), pmt::PMT_NIL);
+      }
+      if (pmt::is_integer(msg)) {
+        frontend->retune(pmt::to_long(msg));
+      }
+      else if (pmt::is_real(msg)) {
+        frontend->retune((unsigned int)pmt::to_double(msg));
+      }
+    }
+
+    void
+    ule_plp_source_impl::publish_frontend_status(const frontend_status &status)
+    {
+      static const char *states[] = {"opening", "tuning", "tuned", "error"};
+      pmt::pmt_t msg = pmt::make_dict();
+
+      msg = pmt::dict_add(msg, pmt::mp("state"), pmt::mp(states[status.state]));
+      msg = pmt::dict_add(msg, pmt::mp("frequency"), pmt::from_long(status.frequency));
+      msg = pmt::dict_add(msg, pmt::mp("locked"), pmt::from_bool(status.locked));
+      msg = pmt::dict_add(msg, pmt::mp("snr"), pmt::from_double(status.snr));
+      msg = pmt::dict_add(msg, pmt::mp("ber"), pmt::from_double(status.ber));
+      if (!status.error.empty()) {
+        msg = pmt::dict_add(msg, pmt::mp("error"), pmt::mp(status.error));
+      }
+      message_port_pub(pmt::mp("frontend"), msg);
+    }
+
+    void
+    ule_plp_source_impl::publish_npd_stats(void)
+    {
+      pmt::pmt_t stats = pmt::make_dict();
+      uint64_t null_cells = packetizer->get_null_cells();
+      uint64_t data_cells = packetizer->get_data_cells();
+      double total = (double)(null_cells + data_cells);
+
+      stats = pmt::dict_add(stats, pmt::mp("plp"), pmt::from_long(plp));
+      stats = pmt::dict_add(stats, pmt::mp("deleted_cells"), pmt::from_uint64(null_cells));
+      stats = pmt::dict_add(stats, pmt::mp("transmitted_cells"), pmt::from_uint64(data_cells));
+      stats = pmt::dict_add(stats, pmt::mp("reclaimed"), pmt::from_double(total > 0 ? null_cells / total : 0.0));
+      message_port_pub(pmt::mp("npd"), stats);
+    }
+
+    int
+    ule_plp_source_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      unsigned char *out = (unsigned char *) output_items[0];
+      int produced;
+
+      /* only this PLP's queue, the others drain at their own pace */
+      produced = packetizer->packetize(out, noutput_items, classifier->get_source(plp));
+      if (npd_mode) {
+        const std::vector<std::pair<int, int> > &runs = packetizer->get_null_runs();
+        for (unsigned int i = 0; i < runs.size(); i++) {
+          add_item_tag(0, nitems_written(0) + runs[i].first, pmt::intern("dnp"), pmt::from_long(runs[i].second));
+        }
+        npd_stats_count += produced / MPEG2_PACKET_SIZE;
+        if (npd_stats_count >= NPD_STATS_INTERVAL) {
+          npd_stats_count = 0;
+          publish_npd_stats();
+        }
+      }
+
+      // Tell runtime system how many output items we produced.
+      return produced;
+    }
+
+  } /* namespace ule */
+} /* namespace gr */
+
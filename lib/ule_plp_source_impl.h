@@ -0,0 +1,63 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2017 Ron Economos.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_ULE_ULE_PLP_SOURCE_IMPL_H
+#define INCLUDED_ULE_ULE_PLP_SOURCE_IMPL_H
+
+#include <ule/ule_plp_source.h>
+#include "ts_packetizer.h"
+#include "plp_classifier.h"
+#include "dvb_frontend.h"
+
+#define NPD_STATS_INTERVAL 5000
+
+namespace gr {
+  namespace ule {
+
+    class ule_plp_source_impl : public ule_plp_source
+    {
+     private:
+      int plp;
+      int npd_mode;
+      ts_packetizer *packetizer;
+      boost::shared_ptr<plp_classifier> classifier;
+      unsigned int npd_stats_count;
+      dvb_frontend *frontend;
+      void handle_retune(pmt::pmt_t msg);
+      void publish_frontend_status(const frontend_status &status);
+      void publish_npd_stats(void);
+
+     public:
+      ule_plp_source_impl(char *mac_address, char *interface, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, int plp, int num_plps, const std::vector<int> &class_map);
+      ~ule_plp_source_impl();
+
+      bool start();
+      bool stop();
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace ule
+} // namespace gr
+
+#endif /* INCLUDED_ULE_ULE_PLP_SOURCE_IMPL_H */
+
@@ -23,750 +23,1071 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <unistd.h>
+#include <algorithm>
 #include "ule_source_impl.h"
 
-#define DEFAULT_IF "dvb0_0"
-#define FILTER "ether src "
-#define ULE_PID 0x35
-#undef DEBUG
-
 namespace gr {
   namespace ule {
 
     ule_source::sptr
-    ule_source::make(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address)
+    ule_source::make(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, ule_aqm_t aqm, float codel_target, float codel_interval, ule_output_t output_mode, int ts_rate, float max_latency, ule_ingress_t ingress_mode, char *interfaces, int capture_threads, ule_fanout_t fanout, int encap_threads, ule_item_t item_size, ule_security_t security, char *security_key, int spi, int fec_k, int fec_r, ule_dbit_t dbit, ule_packing_t packing, ule_mcast_t mcast_filter, char *static_groups, char *snoop_interface, ule_arp_t arp, char *arp_table, ule_ack_filter_t ack_filter, ule_compress_t compress, char *compress_classes, int bbframe_size, float bbframe_rate)
     {
       return gnuradio::get_initial_sptr
-        (new ule_source_impl(mac_address, filename, frequency, call_sign, ping_reply, ipaddr_spoof, src_address, dst_address));
+        (new ule_source_impl(mac_address, filename, frequency, call_sign, ping_reply, ipaddr_spoof, src_address, dst_address, npd, aqm, codel_target, codel_interval, output_mode, ts_rate, max_latency, ingress_mode, interfaces, capture_threads, fanout, encap_threads, item_size, security, security_key, spi, fec_k, fec_r, dbit, packing, mcast_filter, static_groups, snoop_interface, arp, arp_table, ack_filter, compress, compress_classes, bbframe_size, bbframe_rate));
     }
 
     /*
      * The private constructor
      */
-    ule_source_impl::ule_source_impl(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address)
+    ule_source_impl::ule_source_impl(char *mac_address, char *filename, char *frequency, char *call_sign, ule_ping_reply_t ping_reply, ule_ipaddr_spoof_t ipaddr_spoof, char *src_address, char *dst_address, ule_npd_t npd, ule_aqm_t aqm, float codel_target, float codel_interval, ule_output_t output_mode, int ts_rate, float max_latency, ule_ingress_t ingress_mode, char *interfaces, int capture_threads, ule_fanout_t fanout, int encap_threads, ule_item_t item_size, ule_security_t security, char *security_key, int spi, int fec_k, int fec_r, ule_dbit_t dbit, ule_packing_t packing, ule_mcast_t mcast_filter, char *static_groups, char *snoop_interface, ule_arp_t arp, char *arp_table, ule_ack_filter_t ack_filter, ule_compress_t compress, char *compress_classes, int bbframe_size, float bbframe_rate)
       : gr::sync_block("ule_source",
               gr::io_signature::make(0, 0, 0),
-              gr::io_signature::make(1, 1, sizeof(unsigned char)))
+              gr::io_signature::make(1, 1, output_item_size(item_size)))
     {
-      TS_HEADER tsHeader;
-      PAT_HEADER patHeader;
-      PAT_ELEMENT patElement;
-      PMT_HEADER pmtHeader;
-      PMT_ELEMENT pmtElement;
-      PMT_STREAM_DESCRIPTOR streamDesc;
-      PMT_REGISTRATION_DESCRIPTOR registrationDesc;
-      MGT_HEADER mgtHeader;
-      MGT_ELEMENT mgtElement;
-      MGT_TRAILER mgtTrailer;
-      TVCT_HEADER tvctHeader;
-      TVCT_ELEMENT tvctElement;
-      TVCT_SLD_DESCRIPTOR tvctDesc;
-      TVCT_SLD_DESCRIPTOR_ELEMENT tvctDescElement;
-      TVCT_TRAILER tvctTrailer;
-      unsigned char tempBuffer[MPEG2_PACKET_SIZE];
-      int offset, temp_offset;
-      int pidPAT = 0;
-      int pidPMT = 0x30;
-      int pidVID = 0x31;
-      int pidPCR = 0x31;
-      int pidAUD = 0x34;
-      int pidULE = ULE_PID;
-      int pidMGT = 0x1ffb;
-      int pidTVCT = 0x1ffb;
-      int pidNULL = 0x1fff;
-      int programNum = 1;
-      int totalStreams = 2;
-      int crc32;
-      char errbuf[PCAP_ERRBUF_SIZE];
-      char dev[IFNAMSIZ];
-      struct bpf_program fp;
-      bpf_u_int32 netp = 0;
-      char filter[50];
-      struct dvb_file *dvb_file;
-      struct dvb_entry *entry = NULL;
-      int rc;
-      unsigned int sys, freq, f, data, id_length;
-
-      pat_count = 0;
-      pmt_count = 0;
-      mgt_count = 0;
-      tvct_count = 0;
-      packet_count = 0;
-      ule_continuity_counter = 0;
-      next_packet_valid = FALSE;
-      parms = NULL;
-      ping_reply_mode = ping_reply;
-      ipaddr_spoof_mode = ipaddr_spoof;
-      inet_pton(AF_INET, src_address, &src_addr);
-      inet_pton(AF_INET, dst_address, &dst_addr);
-      crc32_init();
-
-      /* null packet */
-      offset = 0;
-      tsHeader.sync_byte = 0x47;
-      tsHeader.transport_error_indicator = 0x0;
-      tsHeader.payload_unit_start_indicator = 0x0;
-      tsHeader.transport_priority = 0x0;
-      tsHeader.pid_12to8 = ((pidNULL) >> 8) & 0x1f;
-      tsHeader.pid_7to0 = (pidNULL) & 0xff;
-      tsHeader.transport_scrambling_control = 0x0;
-      tsHeader.adaptation_field_control = 0x1;
-      tsHeader.continuity_counter = 0;
-      memcpy(&stuffing[offset], (unsigned char *) &tsHeader, TS_HEADER_SIZE);
-      offset += TS_HEADER_SIZE;
-
-      memset(&stuffing[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-
-      /* PAT packet */
-      offset = 0;
-      tsHeader.sync_byte = 0x47;
-      tsHeader.transport_error_indicator = 0x0;
-      tsHeader.payload_unit_start_indicator = 0x1;
-      tsHeader.transport_priority = 0x1;
-      tsHeader.pid_12to8 = ((pidPAT) >> 8) & 0x1f;
-      tsHeader.pid_7to0 = (pidPAT) & 0xff;
-      tsHeader.transport_scrambling_control = 0x0;
-      tsHeader.adaptation_field_control = 0x1;
-      tsHeader.continuity_counter = 0;
-      memcpy(&pat[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-      offset += TS_HEADER_SIZE;
-
-      pat[offset] = 0x0;
-      offset += 1;
-
-      temp_offset = PAT_HEADER_SIZE;
-      patElement.program_number_h = (programNum >> 8) & 0xff;
-      patElement.program_number_l = programNum & 0xff;
-      patElement.reserved2 = 0x7;
-      patElement.program_map_PID_h = (pidPMT >> 8) & 0x1f;
-      patElement.program_map_PID_l = pidPMT & 0xff;
-      memcpy(&tempBuffer[temp_offset], (unsigned char *) &patElement, PAT_ELEMENT_SIZE);
-      temp_offset += PAT_ELEMENT_SIZE;
-
-      patHeader.table_id = 0x00;
-      patHeader.section_syntax_indicator = 0x1;
-      patHeader.b0 = 0x0;
-      patHeader.reserved0 = 0x3;
-      patHeader.section_length_h = ((temp_offset - 3 + sizeof(crc32)) >> 8) & 0xf;
-      patHeader.section_length_l = (temp_offset - 3 + sizeof(crc32)) & 0xff;
-
-      patHeader.transport_stream_id_h = 0x00;
-      patHeader.transport_stream_id_l = 0x00;
-      patHeader.reserved1 = 0x3;
-      patHeader.version_number = 0;
-      patHeader.current_next_indicator = 1;
-      patHeader.section_number = 0x0;
-      patHeader.last_section_number = 0x0;
-      memcpy(&tempBuffer[0], (char *) &patHeader, PAT_HEADER_SIZE);
-
-      memcpy(&pat[offset], &tempBuffer, temp_offset);
-      offset += temp_offset;
-
-      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
-      memcpy(&pat[offset], (unsigned char *) &crc32, sizeof(crc32));
-      offset += sizeof(crc32);
-
-      memset(&pat[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-
-      /* PMT packet */
-      offset = 0;
-      tsHeader.sync_byte = 0x47;
-      tsHeader.transport_error_indicator = 0x0;
-      tsHeader.payload_unit_start_indicator = 0x1;
-      tsHeader.transport_priority = 0x1;
-      tsHeader.pid_12to8 = ((pidPMT) >> 8) & 0x1f;
-      tsHeader.pid_7to0 = (pidPMT) & 0xff;
-      tsHeader.transport_scrambling_control = 0x0;
-      tsHeader.adaptation_field_control = 0x1;
-      tsHeader.continuity_counter = 0;
-      memcpy(&pmt[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-      offset += TS_HEADER_SIZE;
-
-      pmt[offset] = 0x0;
-      offset += 1;
-
-      /* audio stream */
-      temp_offset = PMT_HEADER_SIZE;
-      pmtElement.stream_type = 0x81;
-      pmtElement.reserved0 = 0x7;
-      pmtElement.elementary_PID_h = (pidAUD >> 8) & 0x1f;
-      pmtElement.elementary_PID_l = pidAUD & 0xff;
-      pmtElement.reserved1 = 0xf;
-      pmtElement.ES_info_length_h = 0x00;
-      pmtElement.ES_info_length_l = PMT_STREAM_DESCRIPTOR_SIZE;
-
-      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
-      temp_offset += PMT_ELEMENT_SIZE;
-
-      streamDesc.descriptor_tag = 0x52;
-      streamDesc.descriptor_length = 0x01;
-      streamDesc.component_tag = 0x10;
-      memcpy(&tempBuffer[temp_offset], (unsigned char *)&streamDesc, PMT_STREAM_DESCRIPTOR_SIZE);
-      temp_offset += PMT_STREAM_DESCRIPTOR_SIZE;
-
-      /* video stream */
-      pmtElement.stream_type = 0x2;
-      pmtElement.reserved0 = 0x7;
-      pmtElement.elementary_PID_h = (pidVID >> 8) & 0x1f;
-      pmtElement.elementary_PID_l = pidVID & 0xff;
-      pmtElement.reserved1 = 0xf;
-      pmtElement.ES_info_length_h = 0x00;
-      pmtElement.ES_info_length_l = PMT_STREAM_DESCRIPTOR_SIZE;
-
-      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
-      temp_offset += PMT_ELEMENT_SIZE;
-
-      streamDesc.descriptor_tag = 0x52;
-      streamDesc.descriptor_length = 0x01;
-      streamDesc.component_tag = 0x0;
-      memcpy(&tempBuffer[temp_offset], (unsigned char *)&streamDesc, PMT_STREAM_DESCRIPTOR_SIZE);
-      temp_offset += PMT_STREAM_DESCRIPTOR_SIZE;
-
-      /* ULE stream */
-      pmtElement.stream_type = 0x91;
-      pmtElement.reserved0 = 0x7;
-      pmtElement.elementary_PID_h = (pidULE >> 8) & 0x1f;
-      pmtElement.elementary_PID_l = pidULE & 0xff;
-      pmtElement.reserved1 = 0xf;
-      pmtElement.ES_info_length_h = 0x00;
-      pmtElement.ES_info_length_l = PMT_REGISTRATION_DESCRIPTOR_SIZE;
-
-      memcpy(&tempBuffer[temp_offset], (unsigned char *) &pmtElement, PMT_ELEMENT_SIZE);
-      temp_offset += PMT_ELEMENT_SIZE;
-
-      registrationDesc.descriptor_tag = 0x05;
-      registrationDesc.descriptor_length = 0x04;
-      registrationDesc.format_identifier_31to24 = 'U';
-      registrationDesc.format_identifier_23to16 = 'L';
-      registrationDesc.format_identifier_15to8 = 'E';
-      registrationDesc.format_identifier_7to0 = '1';
-      memcpy(&tempBuffer[temp_offset], (unsigned char *)&registrationDesc, PMT_REGISTRATION_DESCRIPTOR_SIZE);
-      temp_offset += PMT_REGISTRATION_DESCRIPTOR_SIZE;
-
-      pmtHeader.table_id = 0x02;
-      pmtHeader.section_syntax_indicator = 1;
-      pmtHeader.b0  = 0;
-      pmtHeader.reserved0 = 0x3;
-      pmtHeader.section_length_h = ((temp_offset - 3 + sizeof(crc32)) >> 8) & 0xf;
-      pmtHeader.section_length_l = (temp_offset - 3 + sizeof(crc32)) & 0xff;
-      pmtHeader.program_number_h = (programNum >> 8) & 0xff;
-      pmtHeader.program_number_l = programNum & 0xff;
-      pmtHeader.reserved1 = 0x3;
-      pmtHeader.version_number = 0;
-      pmtHeader.current_next_indicator = 1;
-      pmtHeader.section_number = 0x0;
-      pmtHeader.last_section_number = 0x0;
-      pmtHeader.reserved2 = 0x7;
-      pmtHeader.PCR_PID_h = (pidVID >> 8) & 0x1f;
-      pmtHeader.PCR_PID_l = pidVID & 0xff;
-      pmtHeader.reserved3 = 0xF;
-      pmtHeader.program_info_length_h = 0;
-      pmtHeader.program_info_length_l = 0;
-      memcpy(&tempBuffer[0], (char *) &pmtHeader, PMT_HEADER_SIZE);
-
-      memcpy(&pmt[offset], tempBuffer, temp_offset);
-      offset += temp_offset;
-
-      crc32 = crc32_calc(tempBuffer, temp_offset);
-      memcpy(&pmt[offset], (char *)&crc32, sizeof(crc32));
-      offset += sizeof(crc32);
-
-      memset(&pmt[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-
-      /* MGT packet */
-      offset = 0;
-      tsHeader.sync_byte = 0x47;
-      tsHeader.transport_error_indicator = 0x0;
-      tsHeader.payload_unit_start_indicator = 0x1;
-      tsHeader.transport_priority = 0x0;
-      tsHeader.pid_12to8 = ((pidMGT) >> 8) & 0x1f;
-      tsHeader.pid_7to0 = (pidMGT) & 0xff;
-      tsHeader.transport_scrambling_control = 0x0;
-      tsHeader.adaptation_field_control = 0x1;
-      tsHeader.continuity_counter = 0;
-      memcpy(&mgt[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-      offset += TS_HEADER_SIZE;
-
-      mgt[offset] = 0x0;
-      offset += 1;
-
-      temp_offset = MGT_HEADER_SIZE;
-
-      mgtElement.table_type_h = 0;
-      mgtElement.table_type_l = 0;
-      mgtElement.reserved0 = 0x7;
-      mgtElement.table_type_PID_h = (pidTVCT >> 8) & 0x1f;
-      mgtElement.table_type_PID_l = pidTVCT & 0xff;
-      mgtElement.reserved1 = 0x7;
-      mgtElement.table_type_version_number = 0x01;
-      mgtElement.number_bytes_h = 0x00;
-      mgtElement.number_bytes_mh = 0x00;
-      mgtElement.number_bytes_ml = 0x00;
-      mgtElement.number_bytes_l = 0x41;
-      mgtElement.reserved2 = 0xF;
-      mgtElement.table_type_descriptors_length_h = 0x00;
-      mgtElement.table_type_descriptors_length_l = 0x00;
-
-      memcpy(&tempBuffer[temp_offset], (char *) &mgtElement, MGT_ELEMENT_SIZE);
-      temp_offset += MGT_ELEMENT_SIZE;
-
-      mgtHeader.table_id = 0xC7;
-      mgtHeader.section_syntax_indicator = 1;
-      mgtHeader.private_indicator = 1;
-      mgtHeader.reserved0 = 0x3;
-      mgtHeader.section_length_h = ((temp_offset - 1 + sizeof(crc32)) >> 8) & 0xf;
-      mgtHeader.section_length_l = (temp_offset - 1 + sizeof(crc32)) & 0xff;
-
-      mgtHeader.table_id_extension_h = 0;
-      mgtHeader.table_id_extension_l = 0;
-      mgtHeader.reserved1 = 0x3;
-      mgtHeader.version_number = 0;
-      mgtHeader.current_next_indicator = 1;
-      mgtHeader.section_number = 0x0;
-      mgtHeader.last_section_number = 0x0;
-      mgtHeader.protocol_version = 0x0;
-      mgtHeader.tables_defined_h = 0;
-      mgtHeader.tables_defined_l = 1;
-      memcpy(&tempBuffer[0], (char *) &mgtHeader, MGT_HEADER_SIZE);
-
-      mgtTrailer.reserved = 0xF;
-      mgtTrailer.descriptors_length_h = 0x00;
-      mgtTrailer.descriptors_length_l = 0x00;
-      memcpy(&tempBuffer[temp_offset], (char *) &mgtTrailer, MGT_TRAILER_SIZE);
-      temp_offset += MGT_TRAILER_SIZE;
-
-      memcpy(&mgt[offset], &tempBuffer, temp_offset);
-      offset += temp_offset;
-
-      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
-      memcpy(&mgt[offset], (unsigned char *) &crc32, sizeof(crc32));
-      offset += sizeof(crc32);
-
-      memset(&mgt[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-
-      /* TVCT packet */
-      offset = 0;
-      tsHeader.sync_byte = 0x47;
-      tsHeader.transport_error_indicator = 0x0;
-      tsHeader.payload_unit_start_indicator = 0x1;
-      tsHeader.transport_priority = 0x0;
-      tsHeader.pid_12to8 = ((pidTVCT) >> 8) & 0x1f;
-      tsHeader.pid_7to0 = (pidTVCT) & 0xff;
-      tsHeader.transport_scrambling_control = 0x0;
-      tsHeader.adaptation_field_control = 0x1;
-      tsHeader.continuity_counter = 0;
-      memcpy(&tvct[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-      offset += TS_HEADER_SIZE;
-
-      mgt[offset] = 0x0;
-      offset += 1;
-
-      temp_offset = TVCT_HEADER_SIZE;
-
-      id_length = strlen(call_sign);
-      tvctElement.short_name_1h = 0x0;
-      if (id_length > 0) {
-        tvctElement.short_name_1l = call_sign[0];
+      if (output_mode == OUTPUT_BBFRAME) {
+        if (bbframe_size < MPEG2_PACKET_SIZE * 8 || bbframe_size % 8 != 0) {
+          throw std::runtime_error("BBFRAME data field must be whole bytes and hold a TS packet\n");
+        }
+        if (bbframe_rate <= 0.0) {
+          throw std::runtime_error("BBFRAME rate must be positive\n");
+        }
+        if (npd == NPD_ON) {
+          throw std::runtime_error("BBFRAME output needs null packet deletion off\n");
+        }
       }
-      else {
-        tvctElement.short_name_1l = 0x0;
+      npd_mode = npd;
+      npd_stats_count = 0;
+      packetizer = NULL;
+      pool = NULL;
+      frontend = NULL;
+      rs = NULL;
+      filter_stats_count = 0;
+      ingress = NULL;
+      generator = NULL;
+      pipeline = NULL;
+      serial = NULL;
+      fec = NULL;
+      sndus = NULL;
+      this->security = NULL;
+      this->compress = NULL;
+      mcast = NULL;
+      snoop_descr = NULL;
+      proxy = NULL;
+      inject_descr = NULL;
+      capture_running = false;
+      this->ingress_mode = ingress_mode;
+      pdu_turn = false;
+      pdu_drops = 0;
+      filter_generation = 0;
+      direct_generation = 0;
+      custom_filter = false;
+      default_filter = std::string(FILTER) + mac_address;
+      pending_filter = default_filter;
+      if (sscanf(mac_address, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &npa_address[0], &npa_address[1],
+                 &npa_address[2], &npa_address[3], &npa_address[4], &npa_address[5]) != ETHER_ADDR_LEN) {
+        memset(npa_address, 0xff, ETHER_ADDR_LEN);
       }
-      tvctElement.short_name_2h = 0x0;
-      if (id_length > 1) {
-        tvctElement.short_name_2l = call_sign[1];
+      try {
+        packetizer = new ts_packetizer(ULE_PID, call_sign, ping_reply, ipaddr_spoof, src_address, dst_address, npd, dbit, packing);
+
+        /*
+         * In BBFRAME mode every frame waits for the next BBFRAME, which
+         * CoDel must not take for a standing queue.
+         */
+        frame_time = output_mode == OUTPUT_BBFRAME ? 1000.0 / bbframe_rate : 0.0;
+        bbframe_bytes = bbframe_size / 8;
+        bbframes = 0;
+        float target = std::max(codel_target, frame_time);
+        float interval = std::max(codel_interval, frame_time * BBFRAME_CODEL_INTERVALS);
+
+        /*
+         * Fair queueing, without CoDel when it is off, merges the
+         * capture threads and lets sparse flows lead the next BBFRAME.
+         * Generated frames always go through it.
+         */
+        bool fair_queue = ingress_mode == INGRESS_GENERATOR;
+        if (ingress_mode != INGRESS_GENERATOR && ingress_mode != INGRESS_PDU) {
+          open_captures(interfaces, mac_address, capture_threads, fanout, aqm != AQM_OFF || ack_filter == ACK_FILTER_ON || output_mode == OUTPUT_BBFRAME);
+          fair_queue = aqm != AQM_OFF || descrs.size() > 1 || ack_filter == ACK_FILTER_ON || output_mode == OUTPUT_BBFRAME;
+        }
+
+        /*
+         * Room for every frame that can be held at once: a full fair
+         * queue and a frame in hand per thread feeding it, or else the
+         * one frame read on demand, plus a full encapsulation pipeline.
+         * PDUs wait in their own queue until a buffer is free.
+         */
+        unsigned int pool_size = SOURCE_POOL_SPARE;
+        if (fair_queue) {
+          pool_size += FQ_CODEL_LIMIT + std::max((unsigned int)descrs.size(), 1u);
+        }
+        else {
+          pool_size += 1;
+        }
+        if (encap_threads > 0) {
+          pool_size += encap_threads * PIPELINE_AHEAD;
+        }
+        pool = new packet_pool(pool_size);
+
+        if (ingress_mode == INGRESS_GENERATOR) {
+          generator = new traffic_generator(TRAFFIC_FIXED, GEN_DEFAULT_RATE, GEN_DEFAULT_FLOWS, GEN_MAX_FRAME, GEN_DEFAULT_SEED, npa_address);
+        }
+        if (fair_queue) {
+          ingress = new fq_codel_queue(pool, aqm != AQM_OFF ? target : 0.0, interval, aqm == AQM_FQ_CODEL_ECN);
+        }
+        if (ingress) {
+          ingress->set_ack_filter(ack_filter == ACK_FILTER_ON);
+        }
+        if (encap_threads > 0) {
+          pipeline = new sndu_pipeline(this, encap_threads);
+          sndus = pipeline;
+        }
+        if (security != SECURITY_OFF) {
+          this->security = new sndu_security(security, security_key, spi);
+          packetizer->set_security(this->security);
+        }
+        if (compress != COMPRESS_OFF) {
+          this->compress = new sndu_compress(compress, compress_classes ? compress_classes : "");
+          packetizer->set_compress(this->compress);
+        }
+        if ((security != SECURITY_OFF || fec_r > 0) && !pipeline) {
+          /* only complete SNDUs can be sealed or protected */
+          serial = new serial_sndu_source(this);
+          sndus = serial;
+        }
+        if (fec_r > 0) {
+          fec = new fec_sndu_source(sndus, pool, fec_k, fec_r);
+          sndus = fec;
+        }
+        if (mcast_filter == MCAST_SNOOP) {
+          mcast = new multicast_filter(static_groups);
+        }
+        if (arp == ARP_PROXY_ON) {
+          proxy = new arp_proxy(arp_table);
+        }
+        if (mcast || proxy) {
+          std::string device(interfaces ? interfaces : "");
+          device = device.substr(0, device.find(','));
+          device.erase(0, device.find_first_not_of(" \t"));
+          device.erase(device.find_last_not_of(" \t") + 1);
+          if (device.empty()) {
+            device = DEFAULT_IF;
+          }
+          /* answers go back out of the first capture interface */
+          if (proxy && !descrs.empty()) {
+            inject_descr = open_capture(device.c_str(), mac_address, CAPTURE_TIMEOUT);
+            set_capture_filter(inject_descr, ARP_INJECT_FILTER);
+          }
+          if (snoop_interface && *snoop_interface) {
+            device = snoop_interface;
+          }
+          snoop_descr = open_capture(device.c_str(), mac_address, CAPTURE_TIMEOUT);
+          set_capture_filter(snoop_descr, mcast && proxy ? MCAST_SNOOP_FILTER " or arp" : mcast ? MCAST_SNOOP_FILTER : ARP_LEARN_FILTER);
+        }
+        frontend = new dvb_frontend(filename, frequency, boost::bind(&ule_source_impl::publish_frontend_status, this, _1));
+
+        message_port_register_out(pmt::mp("npd"));
+        message_port_register_out(pmt::mp("frontend"));
+        message_port_register_out(pmt::mp("multicast"));
+        message_port_register_out(pmt::mp("arp"));
+        message_port_register_out(pmt::mp("compression"));
+        message_port_register_out(pmt::mp("profile"));
+        message_port_register_in(pmt::mp("retune"));
+        set_msg_handler(pmt::mp("retune"), boost::bind(&ule_source_impl::handle_retune, this, _1));
+        message_port_register_in(pmt::mp("pdus"));
+        set_msg_handler(pmt::mp("pdus"), boost::bind(&ule_source_impl::handle_pdu, this, _1));
+        message_port_register_in(pmt::mp("control"));
+        set_msg_handler(pmt::mp("control"), boost::bind(&ule_source_impl::handle_control, this, _1));
+
+        this->item_size = item_size;
+        if (item_size == ITEM_TS204) {
+          rs = new reed_solomon(MPEG2_RS_PACKET_SIZE - MPEG2_PACKET_SIZE);
+        }
       }
-      else {
-        tvctElement.short_name_2l = 0x0;
+      catch (...) {
+        /* the destructor does not run when a constructor throws */
+        release();
+        throw;
+      }
+
+      /* output items per TS cell */
+      cell_items = item_size == ITEM_BYTE ? MPEG2_PACKET_SIZE : 1;
+
+      this->output_mode = output_mode;
+      this->ts_rate = ts_rate;
+      this->max_latency = max_latency;
+      this->codel_target = codel_target;
+      this->codel_interval = codel_interval;
+      if (output_mode == OUTPUT_LATENCY) {
+        set_latency_cells();
+        set_output_multiple(cell_items);
+        set_max_noutput_items(cell_items * max_cells);
       }
-      tvctElement.short_name_3h = 0x0;
-      if (id_length > 2) {
-        tvctElement.short_name_3l = call_sign[2];
+      else if (output_mode == OUTPUT_BBFRAME) {
+        /* a frame straddles at most this many cells, only a couple are built ahead */
+        max_cells = (bbframe_bytes + MPEG2_PACKET_SIZE - 1) / MPEG2_PACKET_SIZE;
+        set_output_multiple(cell_items);
+        set_min_noutput_items(cell_items * max_cells);
+        set_max_noutput_items(cell_items * max_cells);
+        set_max_output_buffer(cell_items * max_cells * BBFRAME_LEAD_FRAMES);
       }
       else {
-        tvctElement.short_name_3l = 0x0;
+        min_cells = max_cells = 200;
+        set_output_multiple(cell_items * 200);
       }
-      tvctElement.short_name_4h = 0x0;
-      if (id_length > 3) {
-        tvctElement.short_name_4l = call_sign[3];
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ule_source_impl::~ule_source_impl()
+    {
+      release();
+    }
+
+    /* frees whatever the constructor got as far as allocating */
+    void
+    ule_source_impl::release(void)
+    {
+      delete frontend;
+      for (unsigned int i = 0; i < descrs.size(); i++) {
+        pcap_close(descrs[i]);
       }
-      else {
-        tvctElement.short_name_4l = 0x0;
+      if (snoop_descr) {
+        pcap_close(snoop_descr);
       }
-      tvctElement.short_name_5h = 0x0;
-      if (id_length > 4) {
-        tvctElement.short_name_5l = call_sign[4];
+      if (inject_descr) {
+        pcap_close(inject_descr);
       }
-      else {
-        tvctElement.short_name_5l = 0x0;
+      delete mcast;
+      delete proxy;
+      delete fec;
+      delete pipeline;
+      delete serial;
+      delete security;
+      delete compress;
+      delete ingress;
+      delete generator;
+      delete packetizer;
+      delete pool;
+      delete rs;
+    }
+
+    int
+    ule_source_impl::output_item_size(ule_item_t item_size)
+    {
+      switch (item_size) {
+        case ITEM_TS188:
+          return MPEG2_PACKET_SIZE;
+        case ITEM_TS204:
+          return MPEG2_RS_PACKET_SIZE;
+        default:
+          return sizeof(unsigned char);
       }
-      tvctElement.short_name_6h = 0x0;
-      if (id_length > 5) {
-        tvctElement.short_name_6l = call_sign[5];
+    }
+
+    bool
+    ule_source_impl::start()
+    {
+      frontend->start();
+      if (pipeline) {
+        pipeline->start();
       }
-      else {
-        tvctElement.short_name_6l = 0x0;
+      if (ingress && (!descrs.empty() || generator)) {
+        capture_running = true;
+        for (unsigned int i = 0; i < descrs.size(); i++) {
+          capture_threads.create_thread(boost::bind(&ule_source_impl::capture_loop, this, descrs[i]));
+        }
+        if (generator) {
+          capture_threads.create_thread(boost::bind(&ule_source_impl::generator_loop, this));
+        }
       }
-      tvctElement.short_name_7h = 0x0;
-      if (id_length > 6) {
-        tvctElement.short_name_7l = call_sign[6];
+      if (snoop_descr) {
+        capture_running = true;
+        capture_threads.create_thread(boost::bind(&ule_source_impl::snoop_loop, this));
       }
-      else {
-        tvctElement.short_name_7l = 0x0;
-      }
-      tvctElement.reserved0 = 0xF;
-      tvctElement.major_channel_number_h = (37 >> 6) & 0xf;
-      tvctElement.major_channel_number_l = (37) & 0x3f;
-      tvctElement.minor_channel_number_h = ((programNum) >> 8) & 0x3;
-      tvctElement.minor_channel_number_l = (programNum) & 0xff;
-      tvctElement.modulation_mode = 0x4;
-      tvctElement.carrier_frequency_h = 0x0;
-      tvctElement.carrier_frequency_mh = 0x0;
-      tvctElement.carrier_frequency_ml = 0x0;
-      tvctElement.carrier_frequency_l = 0x0;
-      tvctElement.channel_TSID_h = (0x8086 >> 8) & 0xff;
-      tvctElement.channel_TSID_l = 0x8086 & 0xff;
-      tvctElement.program_number_h = (programNum >> 8) & 0xff;
-      tvctElement.program_number_l = programNum & 0xff;
-      tvctElement.ETM_location = 0x1;
-      tvctElement.access_controlled = 0x0;
-      tvctElement.hidden = 0x0;
-      tvctElement.reserved1 = 0x3;
-      tvctElement.hide_guide = 0x1;
-      tvctElement.reserved2 = 0x1;
-      tvctElement.reserved3 = 0x3;
-      tvctElement.service_type = 0x2;
-      tvctElement.source_id_h = (0x1 >> 8) & 0xff;
-      tvctElement.source_id_l = (0x1) & 0xff;
-      tvctElement.reserved4 = 0x3f;
-      tvctElement.descriptors_length_h = (((totalStreams * 6) + 5) >> 8) & 0xff;
-      tvctElement.descriptors_length_l = ((totalStreams * 6) + 5) & 0xff;
-
-      memcpy(&tempBuffer[temp_offset], (char *) &tvctElement, TVCT_ELEMENT_SIZE);
-      temp_offset += TVCT_ELEMENT_SIZE;
-
-      tvctDesc.descriptor_tag = 0xA1;
-      tvctDesc.descriptor_length = (totalStreams * 6) + 3;
-      tvctDesc.reserved = 0x7;
-      tvctDesc.PCR_PID_h = (pidPCR >> 8) & 0x1f;
-      tvctDesc.PCR_PID_l = pidPCR & 0xff;
-      tvctDesc.number_elements = totalStreams;
-
-      memcpy(&tempBuffer[temp_offset], (char *) &tvctDesc, TVCT_DESCRIPTOR_SIZE);
-      temp_offset += TVCT_DESCRIPTOR_SIZE;
-
-      tvctDescElement.stream_type = 0x81;
-      tvctDescElement.reserved = 0x7;
-      tvctDescElement.elementary_PID_h = (pidAUD >> 8) & 0x1f;
-      tvctDescElement.elementary_PID_l = pidAUD & 0xff;
-      tvctDescElement.ISO_639_language_code_1 = 'e';
-      tvctDescElement.ISO_639_language_code_2 = 'n';
-      tvctDescElement.ISO_639_language_code_3 = 'g';
-
-      memcpy(&tempBuffer[temp_offset], (char *) &tvctDescElement, TVCT_DESCRIPTOR_ELEMENT_SIZE);
-      temp_offset += TVCT_DESCRIPTOR_ELEMENT_SIZE;
-
-      tvctDescElement.stream_type = 0x2;
-      tvctDescElement.reserved = 0x7;
-      tvctDescElement.elementary_PID_h = (pidVID >> 8) & 0x1f;
-      tvctDescElement.elementary_PID_l = pidVID & 0xff;
-      tvctDescElement.ISO_639_language_code_1 = 0x0;
-      tvctDescElement.ISO_639_language_code_2 = 0x0;
-      tvctDescElement.ISO_639_language_code_3 = 0x0;
-
-      memcpy(&tempBuffer[temp_offset], (char *) &tvctDescElement, TVCT_DESCRIPTOR_ELEMENT_SIZE);
-      temp_offset += TVCT_DESCRIPTOR_ELEMENT_SIZE;
-
-      tvctHeader.table_id = 0xC8;
-      tvctHeader.section_syntax_indicator = 1;
-      tvctHeader.private_indicator = 1;
-      tvctHeader.reserved0 = 0x3;
-      tvctHeader.section_length_h = ((temp_offset - 1 + sizeof(crc32)) >> 8) & 0xf;
-      tvctHeader.section_length_l = (temp_offset - 1 + sizeof(crc32)) & 0xff;
-
-      tvctHeader.transport_stream_id_h = (0x8086 >> 8) & 0xff;
-      tvctHeader.transport_stream_id_l = 0x8086 & 0xff;
-      tvctHeader.reserved1 = 0x3;
-      tvctHeader.version_number = 0;
-      tvctHeader.current_next_indicator = 1;
-      tvctHeader.section_number = 0x0;
-      tvctHeader.last_section_number = 0x0;
-      tvctHeader.protocol_version = 0x0;
-      tvctHeader.num_channels_in_section = 1;
-      memcpy(&tempBuffer[0], (char *) &tvctHeader, TVCT_HEADER_SIZE);
-
-      tvctTrailer.reserved = 0x3F;
-      tvctTrailer.additional_descriptors_length_h = 0x00;
-      tvctTrailer.additional_descriptors_length_l = 0x00;
-
-      memcpy(&tempBuffer[temp_offset], (char *) &tvctTrailer, TVCT_TRAILER_SIZE);
-      temp_offset += TVCT_TRAILER_SIZE;
-
-      memcpy(&tvct[offset], &tempBuffer, temp_offset);
-      offset += temp_offset;
-
-      crc32 = crc32_calc(&tempBuffer[0], temp_offset);
-      memcpy(&tvct[offset], (unsigned char *) &crc32, sizeof(crc32));
-      offset += sizeof(crc32);
-
-      memset(&tvct[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-
-      strcpy(dev, DEFAULT_IF);
-      descr = pcap_create(dev, errbuf);
-      if (descr == NULL) {
-        std::stringstream s;
-        s << "Error calling pcap_create(): " << errbuf << std::endl;
-        throw std::runtime_error(s.str());
-      }
-      if (pcap_set_promisc(descr, 0) != 0) {
-        pcap_close(descr);
-        throw std::runtime_error("Error calling pcap_set_promisc()\n");
-      }
-      if (pcap_set_timeout(descr, -1) != 0) {
-        pcap_close(descr);
-        throw std::runtime_error("Error calling pcap_set_timeout()\n");
-      }
-      if (pcap_set_snaplen(descr, 65536) != 0) {
-        pcap_close(descr);
-        throw std::runtime_error("Error calling pcap_set_snaplen()\n");
-      }
-      if (pcap_set_buffer_size(descr, 1024 * 1024 * 16) != 0) {
-        pcap_close(descr);
-        throw std::runtime_error("Error calling pcap_set_buffer_size()\n");
-      }
-      if (pcap_activate(descr) != 0) {
-        pcap_close(descr);
-        throw std::runtime_error("Error calling pcap_activate()\n");
-      }
-      strcpy(filter, FILTER);
-      strcat(filter, mac_address);
-      if (pcap_compile(descr, &fp, filter, 0, netp) == -1) {
-        throw std::runtime_error("Error calling pcap_compile()\n");
-      }
-      if (pcap_setfilter(descr, &fp) == -1) {
-        throw std::runtime_error("Error calling pcap_setfilter()\n");
-      }
-
-      parms = dvb_fe_open(0, 0, 0, 0);
-      if (!parms) {
-        throw std::runtime_error("Error calling dvb_fe_open()\n");
-      }
-      sys = SYS_UNDEFINED;
-      dvb_file = dvb_read_file_format(filename, sys, FILE_DVBV5);
-      if (!dvb_file) {
-        throw std::runtime_error("Error calling dvb_file()\n");
-      }
-      freq = atoi(frequency);
-      if (freq) {
-        for (entry = dvb_file->first_entry; entry != NULL; entry = entry->next) {
-          dvb_retrieve_entry_prop(entry, DTV_FREQUENCY, &f);
-          if (f == freq) {
-            break;
+      return true;
+    }
+
+    bool
+    ule_source_impl::stop()
+    {
+      if (capture_running) {
+        capture_running = false;
+        capture_threads.join_all();
+      }
+      if (pipeline) {
+        pipeline->stop();
+      }
+      frontend->stop();
+      return true;
+    }
+
+    /* cells of TS in MIN_CHUNK_LATENCY and max_latency milliseconds */
+    void
+    ule_source_impl::set_latency_cells(void)
+    {
+      max_cells = (int)((double)ts_rate * max_latency / 1000.0 / (MPEG2_PACKET_SIZE * 8));
+      if (max_cells < 1) {
+        max_cells = 1;
+      }
+      min_cells = (int)((double)ts_rate * MIN_CHUNK_LATENCY / 1000.0 / (MPEG2_PACKET_SIZE * 8));
+      if (min_cells < 1) {
+        min_cells = 1;
+      }
+      if (min_cells > max_cells) {
+        min_cells = max_cells;
+      }
+    }
+
+    /*
+     * One capture handle per interface and thread. A single handle
+     * without AQM keeps the original non-blocking capture polled from
+     * work(), everything else is read by capture threads.
+     */
+    void
+    ule_source_impl::open_captures(const char *interfaces, const char *mac_address, int threads, ule_fanout_t fanout, bool queued)
+    {
+      static unsigned int fanout_groups = 0;
+      std::vector<std::string> devices;
+      std::string list(interfaces ? interfaces : "");
+      size_t start = 0, end;
+      int timeout, group;
+
+      while (start <= list.size()) {
+        end = list.find(',', start);
+        if (end == std::string::npos) {
+          end = list.size();
+        }
+        std::string device = list.substr(start, end - start);
+        device.erase(0, device.find_first_not_of(" \t"));
+        device.erase(device.find_last_not_of(" \t") + 1);
+        if (!device.empty()) {
+          devices.push_back(device);
+        }
+        start = end + 1;
+      }
+      if (devices.empty()) {
+        devices.push_back(DEFAULT_IF);
+      }
+      if (threads < 1 || threads > MAX_CAPTURE_THREADS) {
+        throw std::runtime_error("Capture threads must be 1 to 64\n");
+      }
+
+      timeout = (queued || devices.size() > 1 || threads > 1) ? CAPTURE_TIMEOUT : -1;
+      for (unsigned int i = 0; i < devices.size(); i++) {
+        group = (getpid() + (fanout_groups++ << 8)) & 0xffff;
+        for (int j = 0; j < threads; j++) {
+          descrs.push_back(open_capture(devices[i].c_str(), mac_address, timeout));
+          if (threads > 1) {
+            join_fanout(descrs.back(), group, fanout);
           }
         }
       }
-      if (!entry) {
-        dvb_file_free(dvb_file);
-        throw std::runtime_error("Can't find channel\n");
+    }
+
+    /*
+     * The filter is swapped by whichever thread reads each capture
+     * handle, between two reads.
+     */
+    void
+    ule_source_impl::apply_filter(pcap_t *descr, unsigned int &generation)
+    {
+      std::string filter;
+
+      {
+        boost::mutex::scoped_lock lock(control_mutex);
+        filter = pending_filter;
+        generation = filter_generation;
       }
-      dvb_retrieve_entry_prop(entry, DTV_DELIVERY_SYSTEM, &sys);
-      dvb_set_compat_delivery_system(parms, sys);
-      for (unsigned int i = 0; i < entry->n_props; i++) {
-        data = entry->props[i].u.data;
-        if (entry->props[i].cmd == DTV_DELIVERY_SYSTEM) {
-          continue;
+      try {
+        set_capture_filter(descr, filter.c_str());
+      }
+      catch (std::exception &e) {
+        GR_LOG_WARN(d_logger, e.what());
+      }
+    }
+
+    void
+    ule_source_impl::capture_loop(pcap_t *descr)
+    {
+      struct pcap_pkthdr *hdr;
+      const unsigned char *packet;
+      unsigned int generation = 0;
+      int rc;
+
+      while (capture_running) {
+        if (generation != filter_generation) {
+          apply_filter(descr, generation);
+        }
+        rc = pcap_next_ex(descr, &hdr, &packet);
+        if (rc == 1) {
+          ingress->enqueue(hdr, packet);
+        }
+        else if (rc < 0) {
+          break;
         }
-        dvb_fe_store_parm(parms, entry->props[i].cmd, data);
       }
-      dvb_file_free(dvb_file);
-      rc = dvb_fe_set_parms(parms);
-      if (rc < 0) {
-        throw std::runtime_error("Error calling dvb_fe_set_parms()\n");
+    }
+
+    /*
+     * Membership reports and address resolution from the receivers,
+     * never encapsulated. Frames from the captured host may show up
+     * here too and are left to the ingress side.
+     */
+    void
+    ule_source_impl::snoop_loop(void)
+    {
+      struct pcap_pkthdr *hdr;
+      const unsigned char *packet;
+      bool local;
+      int rc;
+
+      while (capture_running) {
+        rc = pcap_next_ex(snoop_descr, &hdr, &packet);
+        if (rc == 1) {
+          if (mcast) {
+            mcast->snoop(packet, hdr->caplen);
+          }
+          if (proxy && hdr->caplen >= sizeof(struct ether_header)) {
+            {
+              boost::mutex::scoped_lock lock(control_mutex);
+              local = memcmp(packet + ETHER_ADDR_LEN, npa_address, ETHER_ADDR_LEN) == 0;
+            }
+            if (!local) {
+              proxy->learn(packet, hdr->caplen);
+            }
+          }
+        }
+        else if (rc < 0) {
+          break;
+        }
       }
+    }
 
-      set_output_multiple(MPEG2_PACKET_SIZE * 200);
+    /*
+     * Generated frames are queued at their departure time, exactly as
+     * a capture thread would queue them.
+     */
+    void
+    ule_source_impl::generator_loop(void)
+    {
+      unsigned char frame[GEN_MAX_FRAME];
+      struct pcap_pkthdr hdr;
+      struct timespec ts;
+      double due, wake;
+
+      while (capture_running) {
+        hdr.len = hdr.caplen = generator->next_frame(frame, &due);
+        while (capture_running) {
+          clock_gettime(CLOCK_MONOTONIC, &ts);
+          if (ts.tv_sec + ts.tv_nsec / 1e9 >= due) {
+            break;
+          }
+          /* wake at least every CAPTURE_TIMEOUT ms to notice stop() */
+          wake = ts.tv_sec + ts.tv_nsec / 1e9 + CAPTURE_TIMEOUT / 1000.0;
+          if (wake > due) {
+            wake = due;
+          }
+          ts.tv_sec = (time_t)wake;
+          ts.tv_nsec = (long)((wake - ts.tv_sec) * 1e9);
+          clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        generator->stamp(frame, hdr.len);
+        gettimeofday(&hdr.ts, NULL);
+        ingress->enqueue(&hdr, frame);
+      }
     }
 
     /*
-     * Our virtual destructor.
+     * Message handlers run on the block thread between calls to
+     * work(), so the PDU queue needs no locking. Only references to
+     * the PDU payloads are queued.
      */
-    ule_source_impl::~ule_source_impl()
+    void
+    ule_source_impl::handle_pdu(pmt::pmt_t msg)
     {
-      if (parms) {
-        dvb_fe_close(parms);
+      pmt::pmt_t data;
+
+      if ((ingress_mode != INGRESS_PDU && ingress_mode != INGRESS_PCAP_PDU) || !pmt::is_pair(msg)) {
+        return;
+      }
+      data = pmt::cdr(msg);
+      if (!pmt::is_u8vector(data) && !pmt::is_blob(data)) {
+        return;
       }
-      if (descr) {
-        pcap_close(descr);
+      if (pdu_queue.size() >= PDU_QUEUE_LIMIT || pmt::length(data) > ULE_MAX_FRAME_SIZE - sizeof(struct ether_header)) {
+        pdu_drops++;
+        return;
       }
+      pdu_queue.push_back(data);
     }
 
-    int
-    ule_source_impl::crc32_calc(unsigned char *buf, int size)
+    /*
+     * A PDU stays queued until a pool buffer is free to copy it into.
+     */
+    packet_desc *
+    ule_source_impl::next_pdu(void)
     {
-      int crc = 0xffffffffL;
-      int reverse;
+      pmt::pmt_t pdu;
+      const unsigned char *data;
+      struct ether_header *eptr;
+      packet_desc *desc;
+      size_t length;
+      bool raw_ip = false;
 
-      for (int i = 0; i < size; i++) {
-        crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ buf[i]) & 0xff];
+      if (pdu_queue.empty()) {
+        return NULL;
+      }
+      desc = pool->alloc();
+      if (desc == NULL) {
+        return NULL;
+      }
+      pdu = pdu_queue.front();
+      pdu_queue.pop_front();
+      if (pmt::is_blob(pdu)) {
+        data = (const unsigned char *)pmt::blob_data(pdu);
+        length = pmt::blob_length(pdu);
+      }
+      else {
+        data = pmt::u8vector_elements(pdu, length);
+      }
+
+      /* a raw IP datagram has a version nibble and length field that agree */
+      if (length >= 20 && (data[0] >> 4) == 4 && (size_t)((data[2] << 8) | data[3]) == length) {
+        raw_ip = true;
+      }
+      else if (length >= 40 && (data[0] >> 4) == 6 && (size_t)((data[4] << 8) | data[5]) + 40 == length) {
+        raw_ip = true;
       }
-      reverse = (crc & 0xff) << 24;
-      reverse |= (crc & 0xff00) << 8;
-      reverse |= (crc & 0xff0000) >> 8;
-      reverse |= (crc & 0xff000000) >> 24;
-      return (reverse);
+
+      if (raw_ip) {
+        eptr = (struct ether_header *)desc->data;
+        {
+          boost::mutex::scoped_lock lock(control_mutex);
+          memcpy(eptr->ether_dhost, npa_address, ETHER_ADDR_LEN);
+        }
+        memset(eptr->ether_shost, 0, ETHER_ADDR_LEN);
+        eptr->ether_type = htons((data[0] >> 4) == 4 ? ETHERTYPE_IP : ETHERTYPE_IPV6);
+        memcpy(&desc->data[sizeof(struct ether_header)], data, length);
+        desc->length = length + sizeof(struct ether_header);
+        return desc;
+      }
+      if (length < sizeof(struct ether_header)) {
+        pdu_drops++;
+        desc->release();
+        return NULL;
+      }
+      memcpy(desc->data, data, length);
+      desc->length = length;
+      return desc;
     }
 
-    int
-    ule_source_impl::crc32_calc_partial(unsigned char *buf, int size, int crc)
+    packet_desc *
+    ule_source_impl::next_capture(void)
     {
-      for (int i = 0; i < size; i++) {
-        crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ buf[i]) & 0xff];
+      struct pcap_pkthdr hdr;
+      const unsigned char *packet;
+      packet_desc *desc;
+
+      if (ingress) {
+        return ingress->next_packet();
+      }
+      if (descrs.empty()) {
+        return NULL;
+      }
+      if (direct_generation != filter_generation) {
+        apply_filter(descrs[0], direct_generation);
+      }
+      desc = pool->alloc();
+      if (desc == NULL) {
+        return NULL;
+      }
+      while ((packet = pcap_next(descrs[0], &hdr)) != NULL) {
+        if (hdr.len <= ULE_MAX_FRAME_SIZE) {
+          profile_scope profile(PROFILE_CAPTURE);
+          memcpy(desc->data, packet, hdr.len);
+          desc->length = hdr.len;
+          return desc;
+        }
       }
-      return (crc);
+      desc->release();
+      return NULL;
     }
 
-    int
-    ule_source_impl::crc32_calc_final(unsigned char *buf, int size, int crc)
+    packet_desc *
+    ule_source_impl::next_frame(void)
     {
-      int reverse;
+      packet_desc *desc = NULL;
 
-      for (int i = 0; i < size; i++) {
-        crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ buf[i]) & 0xff];
+      /* alternate between PDUs and captured frames when both are ready */
+      pdu_turn = !pdu_turn;
+      if (pdu_turn) {
+        desc = next_pdu();
+      }
+      if (desc == NULL) {
+        desc = next_capture();
       }
-      reverse = (crc & 0xff) << 24;
-      reverse |= (crc & 0xff00) << 8;
-      reverse |= (crc & 0xff0000) >> 8;
-      reverse |= (crc & 0xff000000) >> 24;
-      return (reverse);
+      if (desc == NULL && !pdu_turn) {
+        desc = next_pdu();
+      }
+      return desc;
+    }
+
+    /*
+     * Multicast without a receiver and address resolution answered
+     * or dropped by the proxy go back to the pool unencapsulated.
+     */
+    packet_desc *
+    ule_source_impl::next_packet(void)
+    {
+      unsigned char reply[ARP_REPLY_SIZE];
+      unsigned int reply_len;
+      packet_desc *desc;
+      arp_verdict verdict;
+
+      while ((desc = next_frame()) != NULL) {
+        if (mcast && !mcast->admit(desc->data, desc->length)) {
+          desc->release();
+          continue;
+        }
+        if (proxy) {
+          verdict = proxy->handle(desc->data, desc->length, inject_descr ? reply : NULL, &reply_len);
+          if (verdict == ARP_REPLY && pcap_inject(inject_descr, reply, reply_len) < 0) {
+            GR_LOG_WARN(d_logger, pcap_geterr(inject_descr));
+          }
+          if (verdict != ARP_PASS) {
+            desc->release();
+            continue;
+          }
+        }
+        return desc;
+      }
+      return NULL;
+    }
+
+    uint64_t
+    ule_source_impl::aqm_drops()
+    {
+      return ingress ? ingress->get_drops() : 0;
+    }
+
+    uint64_t
+    ule_source_impl::aqm_marks()
+    {
+      return ingress ? ingress->get_marks() : 0;
     }
 
+    uint64_t
+    ule_source_impl::aqm_overlimit_drops()
+    {
+      return ingress ? ingress->get_overlimit_drops() : 0;
+    }
+
+    uint64_t
+    ule_source_impl::ack_filter_drops()
+    {
+      return ingress ? ingress->get_ack_drops() : 0;
+    }
+
+    /* the generator thread reads generator without a lock */
     void
-    ule_source_impl::crc32_init(void)
+    ule_source_impl::set_traffic(ule_traffic_t traffic, int traffic_rate, int traffic_flows, int traffic_size, int traffic_seed)
     {
-      unsigned int i, j, k;
+      boost::mutex::scoped_lock lock(control_mutex);
+      traffic_generator *next = new traffic_generator(traffic, traffic_rate, traffic_flows, traffic_size, traffic_seed, npa_address);
 
-      for (i = 0; i < 256; i++) {
-        k = 0;
-        for (j = (i << 24) | 0x800000; j != 0x80000000; j <<= 1) {
-          k = (k << 1) ^ (((k ^ j) & 0x80000000) ? 0x04c11db7 : 0);
-        }
-        crc32_table[i] = k;
+      if (ingress_mode != INGRESS_GENERATOR) {
+        delete next;
+        return;
+      }
+      if (capture_running) {
+        delete next;
+        throw std::runtime_error("Traffic can only be set while the flowgraph is stopped\n");
       }
+      delete generator;
+      generator = next;
     }
 
-    int
-    ule_source_impl::checksum(unsigned short *addr, int count, int sum)
+    void
+    ule_source_impl::handle_retune(pmt::pmt_t msg)
+    {
+      if (pmt::is_dict(msg)) {
+        msg = pmt::dict_ref(msg, pmt::mp("frequency"), pmt::PMT_NIL);
+      }
+      if (pmt::is_integer(msg)) {
+        frontend->retune(pmt::to_long(msg));
+      }
+      else if (pmt::is_real(msg)) {
+        frontend->retune((unsigned int)pmt::to_double(msg));
+      }
+    }
+
+    void
+    ule_source_impl::publish_frontend_status(const frontend_status &status)
+    {
+      static const char *states[] = {"opening", "tuning", "tuned", "error"};
+      pmt::pmt_t msg = pmt::make_dict();
+
+      msg = pmt::dict_add(msg, pmt::mp("state"), pmt::mp(states[status.state]));
+      msg = pmt::dict_add(msg, pmt::mp("frequency"), pmt::from_long(status.frequency));
+      msg = pmt::dict_add(msg, pmt::mp("locked"), pmt::from_bool(status.locked));
+      msg = pmt::dict_add(msg, pmt::mp("snr"), pmt::from_double(status.snr));
+      msg = pmt::dict_add(msg, pmt::mp("ber"), pmt::from_double(status.ber));
+      if (!status.error.empty()) {
+        msg = pmt::dict_add(msg, pmt::mp("error"), pmt::mp(status.error));
+      }
+      message_port_pub(pmt::mp("frontend"), msg);
+    }
+
+    /*
+     * A new MAC address rebuilds the capture filter only while it is
+     * still the default one built from the MAC, never a filter set
+     * with set_filter().
+     */
+    void
+    ule_source_impl::set_mac_address(const std::string &mac_address)
     {
-      while (count > 1) {
-        sum += *addr++;
-        count -= 2;
+      unsigned char addr[ETHER_ADDR_LEN];
+      std::string filter = std::string(FILTER) + mac_address;
+
+      if (sscanf(mac_address.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &addr[0], &addr[1],
+                 &addr[2], &addr[3], &addr[4], &addr[5]) != ETHER_ADDR_LEN) {
+        throw std::runtime_error("Invalid MAC address\n");
       }
-      if (count > 0) {
-        sum += *(unsigned char *)addr;
+      check_capture_filter(filter.c_str());
+      boost::mutex::scoped_lock lock(control_mutex);
+      memcpy(npa_address, addr, ETHER_ADDR_LEN);
+      default_filter = filter;
+      if (!custom_filter) {
+        pending_filter = filter;
+        filter_generation++;
       }
-      sum = (sum & 0xffff) + (sum >> 16);
-      sum += (sum >> 16);
-      return (~sum);
     }
 
-    inline void
-    ule_source_impl::ping_reply(void)
+    /* an empty filter goes back to the default one for the MAC */
+    void
+    ule_source_impl::set_filter(const std::string &filter)
     {
-      unsigned short *csum_ptr;
-      unsigned short header_length, total_length, type_code, fragment_offset;
-      int csum;
-      struct ip *ip_ptr;
-      unsigned char *saddr_ptr, *daddr_ptr;
-      unsigned char addr[sizeof(in_addr)];
-
-      /* jam ping reply and calculate new checksum */
-      ip_ptr = (struct ip*)(packet_save + sizeof(struct ether_header));
-      csum_ptr = (unsigned short *)ip_ptr;
-      header_length = (*csum_ptr & 0xf) * 4;
-      csum_ptr = &ip_ptr->ip_len;
-      total_length = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
-      csum_ptr = &ip_ptr->ip_off;
-      fragment_offset = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
-
-      csum_ptr = (unsigned short *)(packet_save + sizeof(struct ether_header) + sizeof(struct ip));
-      type_code = *csum_ptr;
-      type_code = (type_code & 0xff00) | 0x0;
-      if ((fragment_offset & 0x1fff) == 0) {
-        *csum_ptr++ = type_code;
-        *csum_ptr = 0x0000;
-        csum_ptr = (unsigned short *)(packet_save + sizeof(struct ether_header) + sizeof(struct ip));
-        csum = checksum(csum_ptr, total_length - header_length, 0);
-        csum_ptr++;
-        *csum_ptr = csum;
-      }
-
-      /* swap IP adresses */
-      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
-      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
-      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
-        addr[i] = *daddr_ptr++;
-      }
-      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
-      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
-        *daddr_ptr++ = *saddr_ptr++;
-      }
-      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
-      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
-        *saddr_ptr++ = addr[i];
+      if (!filter.empty()) {
+        check_capture_filter(filter.c_str());
       }
+      boost::mutex::scoped_lock lock(control_mutex);
+      custom_filter = !filter.empty();
+      pending_filter = custom_filter ? filter : default_filter;
+      filter_generation++;
+    }
+
+    /*
+     * Packetizer settings are read, changed and staged as a whole under
+     * control_mutex so that concurrent setters do not lose each other's
+     * changes.
+     */
+    void
+    ule_source_impl::set_pid(int pid)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.pid = pid;
+      packetizer->set_config(cfg);
+    }
+
+    void
+    ule_source_impl::set_call_sign(const std::string &call_sign)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.call_sign = call_sign;
+      packetizer->set_config(cfg);
+    }
+
+    void
+    ule_source_impl::set_ping_reply(ule_ping_reply_t ping_reply)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.ping_reply = ping_reply;
+      packetizer->set_config(cfg);
+    }
+
+    void
+    ule_source_impl::set_ipaddr_spoof(ule_ipaddr_spoof_t ipaddr_spoof)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.ipaddr_spoof = ipaddr_spoof;
+      packetizer->set_config(cfg);
     }
 
-    inline void
-    ule_source_impl::ipaddr_spoof(void)
+    void
+    ule_source_impl::set_src_address(const std::string &src_address)
     {
-      unsigned short *csum_ptr;
-      unsigned short header_length, fragment_offset;
-      int csum;
-      struct ip *ip_ptr;
-      unsigned char *saddr_ptr, *daddr_ptr;
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.src_address = src_address;
+      packetizer->set_config(cfg);
+    }
 
-      ip_ptr = (struct ip*)(packet_save + sizeof(struct ether_header));
+    void
+    ule_source_impl::set_dst_address(const std::string &dst_address)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      ts_packetizer_config cfg = packetizer->get_config();
+      cfg.dst_address = dst_address;
+      packetizer->set_config(cfg);
+    }
 
-      saddr_ptr = (unsigned char *)&ip_ptr->ip_src;
-      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
-        *saddr_ptr++ = src_addr[i];
+    void
+    ule_source_impl::set_codel(float codel_target, float codel_interval)
+    {
+      if (codel_target <= 0.0 || codel_interval <= 0.0) {
+        throw std::runtime_error("CoDel target and interval must be positive\n");
+      }
+      boost::mutex::scoped_lock lock(control_mutex);
+      this->codel_target = codel_target;
+      this->codel_interval = codel_interval;
+      if (ingress) {
+        ingress->set_params(std::max(codel_target, frame_time), std::max(codel_interval, frame_time * BBFRAME_CODEL_INTERVALS));
+      }
+    }
+
+    void
+    ule_source_impl::set_ts_rate(int ts_rate)
+    {
+      if (ts_rate <= 0) {
+        throw std::runtime_error("TS rate must be positive\n");
+      }
+      boost::mutex::scoped_lock lock(control_mutex);
+      this->ts_rate = ts_rate;
+      if (output_mode == OUTPUT_LATENCY) {
+        set_latency_cells();
+        set_max_noutput_items(cell_items * max_cells);
+      }
+    }
+
+    void
+    ule_source_impl::set_max_latency(float max_latency)
+    {
+      if (max_latency <= 0.0) {
+        throw std::runtime_error("Max latency must be positive\n");
       }
+      boost::mutex::scoped_lock lock(control_mutex);
+      this->max_latency = max_latency;
+      if (output_mode == OUTPUT_LATENCY) {
+        set_latency_cells();
+        set_max_noutput_items(cell_items * max_cells);
+      }
+    }
 
-      daddr_ptr = (unsigned char *)&ip_ptr->ip_dst;
-      for (unsigned int i = 0; i < sizeof(in_addr); i++) {
-        *daddr_ptr++ = dst_addr[i];
+    /*
+     * A dictionary on the control port applies every packetizer key
+     * it carries as a single change.
+     */
+    void
+    ule_source_impl::handle_control(pmt::pmt_t msg)
+    {
+      pmt::pmt_t nil = pmt::PMT_NIL;
+      pmt::pmt_t value;
+
+      if (!pmt::is_dict(msg)) {
+        return;
+      }
+      try {
+        {
+          boost::mutex::scoped_lock lock(control_mutex);
+          ts_packetizer_config cfg = packetizer->get_config();
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("pid"), nil))) {
+            cfg.pid = pmt::to_long(value);
+          }
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("call_sign"), nil))) {
+            cfg.call_sign = pmt::symbol_to_string(value);
+          }
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("ping_reply"), nil))) {
+            cfg.ping_reply = pmt::is_bool(value) ? pmt::to_bool(value) : pmt::to_long(value);
+          }
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("ipaddr_spoof"), nil))) {
+            cfg.ipaddr_spoof = pmt::is_bool(value) ? pmt::to_bool(value) : pmt::to_long(value);
+          }
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("src_address"), nil))) {
+            cfg.src_address = pmt::symbol_to_string(value);
+          }
+          if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("dst_address"), nil))) {
+            cfg.dst_address = pmt::symbol_to_string(value);
+          }
+          packetizer->set_config(cfg);
+        }
+        if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("mac_address"), nil))) {
+          set_mac_address(pmt::symbol_to_string(value));
+        }
+        if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("filter"), nil))) {
+          set_filter(pmt::symbol_to_string(value));
+        }
+        if (pmt::dict_has_key(msg, pmt::mp("codel_target")) || pmt::dict_has_key(msg, pmt::mp("codel_interval"))) {
+          float target, interval;
+          {
+            boost::mutex::scoped_lock lock(control_mutex);
+            target = codel_target;
+            interval = codel_interval;
+          }
+          set_codel(pmt::to_double(pmt::dict_ref(msg, pmt::mp("codel_target"), pmt::from_double(target))),
+                    pmt::to_double(pmt::dict_ref(msg, pmt::mp("codel_interval"), pmt::from_double(interval))));
+        }
+        if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("ts_rate"), nil))) {
+          set_ts_rate(pmt::to_long(value));
+        }
+        if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("max_latency"), nil))) {
+          set_max_latency(pmt::to_double(value));
+        }
+        if (!pmt::is_null(value = pmt::dict_ref(msg, pmt::mp("profile"), nil))) {
+          publish_profile(pmt::eq(value, pmt::mp("reset")));
+        }
+      }
+      catch (std::exception &e) {
+        GR_LOG_WARN(d_logger, e.what());
       }
+    }
 
-      csum_ptr = (unsigned short *)ip_ptr;
-      header_length = (*csum_ptr & 0xf) * 4;
-      csum_ptr = &ip_ptr->ip_off;
-      fragment_offset = ((*csum_ptr & 0xff) << 8) | ((*csum_ptr & 0xff00) >> 8);
+    void
+    ule_source_impl::publish_npd_stats(void)
+    {
+      pmt::pmt_t stats = pmt::make_dict();
+      uint64_t null_cells = packetizer->get_null_cells();
+      uint64_t data_cells = packetizer->get_data_cells();
+      double total = (double)(null_cells + data_cells);
+
+      stats = pmt::dict_add(stats, pmt::mp("deleted_cells"), pmt::from_uint64(null_cells));
+      stats = pmt::dict_add(stats, pmt::mp("transmitted_cells"), pmt::from_uint64(data_cells));
+      stats = pmt::dict_add(stats, pmt::mp("reclaimed"), pmt::from_double(total > 0 ? null_cells / total : 0.0));
+      message_port_pub(pmt::mp("npd"), stats);
+    }
 
-      if ((fragment_offset & 0x1fff) == 0) {
-        csum_ptr = &ip_ptr->ip_sum;
-        *csum_ptr = 0x0000;
-        csum_ptr = (unsigned short *)ip_ptr;
-        csum = checksum(csum_ptr, header_length, 0);
-        csum_ptr = &ip_ptr->ip_sum;
-        *csum_ptr = csum;
+    void
+    ule_source_impl::publish_multicast_stats(void)
+    {
+      pmt::pmt_t stats = pmt::make_dict();
+      pmt::pmt_t groups = pmt::make_dict();
+      std::vector<multicast_group> table = mcast->get_groups();
 
-        csum_ptr = (unsigned short *)(packet_save + sizeof(struct ether_header) + sizeof(struct ip) + 6);
-        *csum_ptr = 0x0000;
+      for (unsigned int i = 0; i < table.size(); i++) {
+        if (table[i].active) {
+          groups = pmt::dict_add(groups, pmt::mp(table[i].address), pmt::from_uint64(table[i].bytes));
+        }
       }
+      stats = pmt::dict_add(stats, pmt::mp("groups"), groups);
+      stats = pmt::dict_add(stats, pmt::mp("suppressed_frames"), pmt::from_uint64(mcast->get_suppressed_frames()));
+      stats = pmt::dict_add(stats, pmt::mp("suppressed_bytes"), pmt::from_uint64(mcast->get_suppressed_bytes()));
+      message_port_pub(pmt::mp("multicast"), stats);
     }
 
-    inline void
-    ule_source_impl::dump_packet(void)
+    void
+    ule_source_impl::publish_arp_stats(void)
     {
-#ifdef DEBUG
-      printf("\n");
-      for (int i = 0; i < MPEG2_PACKET_SIZE; i++) {
-        if (i % 16 == 0) {
-          printf("\n");
+      pmt::pmt_t stats = pmt::make_dict();
+      pmt::pmt_t neighbours = pmt::make_dict();
+      std::vector<arp_neighbour> table = proxy->get_neighbours();
+
+      for (unsigned int i = 0; i < table.size(); i++) {
+        if (table[i].remote) {
+          neighbours = pmt::dict_add(neighbours, pmt::mp(table[i].address), pmt::mp(table[i].mac_address));
         }
-        printf("0x%02x:", ule[i]);
       }
-      printf("\n");
-#endif
+      stats = pmt::dict_add(stats, pmt::mp("neighbours"), neighbours);
+      stats = pmt::dict_add(stats, pmt::mp("answered"), pmt::from_uint64(proxy->get_answered()));
+      stats = pmt::dict_add(stats, pmt::mp("dropped"), pmt::from_uint64(proxy->get_dropped()));
+      stats = pmt::dict_add(stats, pmt::mp("limited"), pmt::from_uint64(proxy->get_limited()));
+      message_port_pub(pmt::mp("arp"), stats);
+    }
+
+    /*
+     * Stage cycle counters, on request only. The summary also goes to
+     * the log for a quick look from the console.
+     */
+    void
+    ule_source_impl::publish_profile(bool reset)
+    {
+      pmt::pmt_t stats = pmt::make_dict();
+      pmt::pmt_t stage;
+      std::vector<profile_sample> samples = get_profile();
+
+      for (unsigned int i = 0; i < samples.size(); i++) {
+        stage = pmt::make_dict();
+        stage = pmt::dict_add(stage, pmt::mp("calls"), pmt::from_uint64(samples[i].calls));
+        stage = pmt::dict_add(stage, pmt::mp("cycles"), pmt::from_uint64(samples[i].cycles));
+        stats = pmt::dict_add(stats, pmt::mp(samples[i].stage), stage);
+      }
+      GR_LOG_INFO(d_logger, profile_summary());
+      message_port_pub(pmt::mp("profile"), stats);
+      if (reset) {
+        reset_profile();
+      }
+    }
+
+    void
+    ule_source_impl::publish_compress_stats(void)
+    {
+      pmt::pmt_t stats = pmt::make_dict();
+      uint64_t bytes_in = compress->get_bytes_in();
+
+      stats = pmt::dict_add(stats, pmt::mp("compressed"), pmt::from_uint64(compress->get_compressed()));
+      stats = pmt::dict_add(stats, pmt::mp("skipped"), pmt::from_uint64(compress->get_skipped()));
+      stats = pmt::dict_add(stats, pmt::mp("ratio"), pmt::from_double(bytes_in > 0 ? (double)compress->get_bytes_out() / bytes_in : 1.0));
+      stats = pmt::dict_add(stats, pmt::mp("ns_per_byte"), pmt::from_double(bytes_in > 0 ? (double)compress->get_cpu_ns() / bytes_in : 0.0));
+      message_port_pub(pmt::mp("compression"), stats);
+    }
+
+    /*
+     * The data fields of the BBFRAMEs are a continuous stream of TS
+     * packets, so a packet can straddle two of them. Frame n needs
+     * every cell up to byte (n + 1) * bbframe_bytes of the stream.
+     */
+    int
+    ule_source_impl::bbframe_cells(void)
+    {
+      uint64_t start = (bbframes * bbframe_bytes + MPEG2_PACKET_SIZE - 1) / MPEG2_PACKET_SIZE;
+      uint64_t end = ((bbframes + 1) * bbframe_bytes + MPEG2_PACKET_SIZE - 1) / MPEG2_PACKET_SIZE;
+
+      return (int)(end - start);
+    }
+
+    int
+    ule_source_impl::chunk_size(int noutput_items)
+    {
+      boost::mutex::scoped_lock lock(control_mutex);
+      int cells;
+
+      /* room for the SNDU in flight and everything queued behind it */
+      cells = packetizer->get_pending_cells() + 1;
+      if (ingress) {
+        cells += (ingress->backlog() + SNDU_PAYLOAD_SIZE - 1) / SNDU_PAYLOAD_SIZE;
+      }
+      if (cells < min_cells) {
+        cells = min_cells;
+      }
+      if (cells > max_cells) {
+        cells = max_cells;
+      }
+      if (cells * MPEG2_PACKET_SIZE > noutput_items) {
+        cells = noutput_items / MPEG2_PACKET_SIZE;
+      }
+      return cells * MPEG2_PACKET_SIZE;
+    }
+
+    /*
+     * Spread the packed 188 byte cells out to 204 bytes, last cell
+     * first so that no cell is overwritten before it is moved, and
+     * append the RS(204,188) parity.
+     */
+    void
+    ule_source_impl::add_parity(unsigned char *out, int cells)
+    {
+      unsigned char *cell;
+
+      for (int i = cells - 1; i >= 0; i--) {
+        cell = &out[i * MPEG2_RS_PACKET_SIZE];
+        memmove(cell, &out[i * MPEG2_PACKET_SIZE], MPEG2_PACKET_SIZE);
+        rs->encode(cell, MPEG2_PACKET_SIZE, cell + MPEG2_PACKET_SIZE);
+      }
     }
 
     int
@@ -775,440 +1096,61 @@ namespace gr {
         gr_vector_void_star &output_items)
     {
       unsigned char *out = (unsigned char *) output_items[0];
-      int size = noutput_items;
-      int produced = 0;
-      unsigned char temp, continuity_counter;
-      struct ether_header *eptr;
-      unsigned char *ptr;
-      int crc32;
-      TS_HEADER tsHeader;
-      int pidULE = ULE_PID;
-      unsigned int remainder, offset, temp_offset, length;
-
-      while (produced + MPEG2_PACKET_SIZE <= size) {
-        pat_count++;
-        pmt_count++;
-        mgt_count++;
-        tvct_count++;
-        if (pat_count >= 500) {
-          pat_count = 0;
-          memcpy(&out[produced], &pat[0], MPEG2_PACKET_SIZE);
-          temp = pat[3];
-          continuity_counter = temp & 0xf;
-          continuity_counter = (continuity_counter + 1) & 0xf;
-          temp = (temp & 0xf0) | continuity_counter;
-          pat[3] = temp;
-          produced += MPEG2_PACKET_SIZE;
-          if (produced == size) {
-            break;
-          }
-        }
-        else if (pmt_count >= 500) {
-          pmt_count = 0;
-          memcpy(&out[produced], &pmt[0], MPEG2_PACKET_SIZE);
-          temp = pmt[3];
-          continuity_counter = temp & 0xf;
-          continuity_counter = (continuity_counter + 1) & 0xf;
-          temp = (temp & 0xf0) | continuity_counter;
-          pmt[3] = temp;
-          produced += MPEG2_PACKET_SIZE;
-          if (produced == size) {
-            break;
-          }
-        }
-        else if (mgt_count >= 500) {
-          mgt_count = 0;
-          memcpy(&out[produced], &mgt[0], MPEG2_PACKET_SIZE);
-          temp = mgt[3];
-          continuity_counter = temp & 0xf;
-          continuity_counter = (continuity_counter + 1) & 0xf;
-          temp = (temp & 0xf0) | continuity_counter;
-          mgt[3] = temp;
-          tvct[3] = temp;
-          produced += MPEG2_PACKET_SIZE;
-          if (produced == size) {
-            break;
-          }
+      int size = noutput_items / cell_items * MPEG2_PACKET_SIZE;
+      int produced, cells;
+
+      if (output_mode == OUTPUT_LATENCY) {
+        size = chunk_size(size);
+      }
+      else if (output_mode == OUTPUT_BBFRAME) {
+        if (bbframe_cells() * MPEG2_PACKET_SIZE > size) {
+          return 0;
         }
-        else if (tvct_count >= 500) {
-          tvct_count = 0;
-          memcpy(&out[produced], &tvct[0], MPEG2_PACKET_SIZE);
-          temp = tvct[3];
-          continuity_counter = temp & 0xf;
-          continuity_counter = (continuity_counter + 1) & 0xf;
-          temp = (temp & 0xf0) | continuity_counter;
-          tvct[3] = temp;
-          mgt[3] = temp;
-          produced += MPEG2_PACKET_SIZE;
-          if (produced == size) {
-            break;
-          }
+        size = bbframe_cells() * MPEG2_PACKET_SIZE;
+        bbframes++;
+      }
+      if (sndus) {
+        produced = packetizer->packetize_sndus(out, size, sndus);
+      }
+      else {
+        produced = packetizer->packetize(out, size, this);
+      }
+      cells = produced / MPEG2_PACKET_SIZE;
+      if (rs) {
+        add_parity(out, cells);
+      }
+
+      if (npd_mode) {
+        /* tag the first null packet of every run with its DNP count */
+        const std::vector<std::pair<int, int> > &runs = packetizer->get_null_runs();
+        for (unsigned int i = 0; i < runs.size(); i++) {
+          add_item_tag(0, nitems_written(0) + runs[i].first / MPEG2_PACKET_SIZE * cell_items, pmt::intern("dnp"), pmt::from_long(runs[i].second));
         }
-        if (packet_count == 0) {
-          if (next_packet_valid == FALSE) {
-            packet = pcap_next(descr, &hdr);
-          }
-          if (packet != NULL) {
-            next_packet_valid = FALSE;
-            memcpy(packet_save, packet, hdr.len);
-            if (hdr.len <= SNDU_PAYLOAD_PP_SIZE) {
-              offset = 0;
-              tsHeader.sync_byte = 0x47;
-              tsHeader.transport_error_indicator = 0x0;
-              tsHeader.payload_unit_start_indicator = 0x1;
-              tsHeader.transport_priority = 0x1;
-              tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-              tsHeader.pid_7to0 = (pidULE) & 0xff;
-              tsHeader.transport_scrambling_control = 0x0;
-              tsHeader.adaptation_field_control = 0x1;
-              tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-              ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-              memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-              offset += TS_HEADER_SIZE;
-
-              ule[offset++] = 0x0;    /* Payload Pointer */
-              length = hdr.len - sizeof(struct ether_header) + ETHER_ADDR_LEN + sizeof(crc32);
-              ule[offset++] = ((length >> 8) & 0x7f) | 0x0;
-              ule[offset++] = length & 0xff;
-              eptr = (struct ether_header *)packet_save;
-              ule[offset++] = eptr->ether_type & 0xff;
-              ule[offset++] = (eptr->ether_type >> 8) & 0xff;
-
-              if (ping_reply_mode) {
-                ping_reply();
-              }
-              if (ipaddr_spoof_mode) {
-                ipaddr_spoof();
-              }
-
-              ptr = eptr->ether_dhost;
-              for (int i = 0; i < ETHER_ADDR_LEN; i++) {
-                ule[offset++] = *ptr++;
-              }
-              ptr = (unsigned char *)(packet_save + sizeof(struct ether_header));
-              for (unsigned int i = 0; i < hdr.len - sizeof(struct ether_header); i++) {
-                ule[offset++] = *ptr++;
-              }
-              crc32 = crc32_calc(&ule[SNDU_PAYLOAD_PP_OFFSET], offset - SNDU_PAYLOAD_PP_OFFSET);
-              memcpy(&ule[offset], (unsigned char *) &crc32, sizeof(crc32));
-              offset += sizeof(crc32);
-
-              memset(&ule[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-              dump_packet();
-
-              memcpy(&out[produced], &ule[0], MPEG2_PACKET_SIZE);
-              produced += MPEG2_PACKET_SIZE;
-              if (produced == size) {
-                break;
-              }
-            }
-            else {
-              offset = 0;
-              tsHeader.sync_byte = 0x47;
-              tsHeader.transport_error_indicator = 0x0;
-              tsHeader.payload_unit_start_indicator = 0x1;
-              tsHeader.transport_priority = 0x1;
-              tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-              tsHeader.pid_7to0 = (pidULE) & 0xff;
-              tsHeader.transport_scrambling_control = 0x0;
-              tsHeader.adaptation_field_control = 0x1;
-              tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-              ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-              memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-              offset += TS_HEADER_SIZE;
-
-              ule[offset++] = 0x0;    /* Payload Pointer */
-              length = hdr.len - sizeof(struct ether_header) + ETHER_ADDR_LEN + sizeof(crc32);
-              ule[offset++] = ((length >> 8) & 0x7f) | 0x0;
-              ule[offset++] = length & 0xff;
-              eptr = (struct ether_header *)packet_save;
-              ule[offset++] = eptr->ether_type & 0xff;
-              ule[offset++] = (eptr->ether_type >> 8) & 0xff;
-
-              if (ping_reply_mode) {
-                ping_reply();
-              }
-              if (ipaddr_spoof_mode) {
-                ipaddr_spoof();
-              }
-
-              ptr = eptr->ether_dhost;
-              for (int i = 0; i < ETHER_ADDR_LEN; i++) {
-                ule[offset++] = *ptr++;
-              }
-              ptr = (unsigned char *)(packet_save + sizeof(struct ether_header));
-              if ((hdr.len - sizeof(struct ether_header)) < (SNDU_PAYLOAD_PP_SIZE - SNDU_BASE_HEADER_SIZE - ETHER_ADDR_LEN)) {
-                for (unsigned int i = 0; i < hdr.len - sizeof(struct ether_header); i++) {
-                  ule[offset++] = *ptr++;
-                }
-              }
-              else {
-                for (int i = 0; i < SNDU_PAYLOAD_PP_SIZE - SNDU_BASE_HEADER_SIZE - ETHER_ADDR_LEN; i++) {
-                  ule[offset++] = *ptr++;
-                }
-              }
-              crc32_partial = crc32_calc_partial(&ule[SNDU_PAYLOAD_PP_OFFSET], offset - SNDU_PAYLOAD_PP_OFFSET, 0xffffffff);
-              packet_ptr = ptr;
-              packet_length = hdr.len - sizeof(struct ether_header) + ETHER_ADDR_LEN + sizeof(crc32) - SNDU_PAYLOAD_PP_SIZE;
-              shift = 3;
-              if (packet_length < 0) {
-                while (packet_length < 0) {
-                  ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                  packet_length++;
-                  shift--;
-                }
-              }
-              dump_packet();
-              memcpy(&out[produced], &ule[0], MPEG2_PACKET_SIZE);
-              produced += MPEG2_PACKET_SIZE;
-              if (hdr.len > (SNDU_PAYLOAD_PP_SIZE + SNDU_PAYLOAD_SIZE)) {
-                packet_count = ((hdr.len - (SNDU_PAYLOAD_PP_SIZE + SNDU_PAYLOAD_SIZE)) / SNDU_PAYLOAD_SIZE) + 2;
-              }
-              else {
-                packet_count = 1;
-              }
-              if (produced == size) {
-                break;
-              }
-            }
-          }
+        npd_stats_count += cells;
+        if (npd_stats_count >= NPD_STATS_INTERVAL) {
+          npd_stats_count = 0;
+          publish_npd_stats();
         }
-        if (packet_count != 0) {
-          packet_count--;
-          if (packet_count == 0) {
-            packet = pcap_next(descr, &hdr);
-            if (packet == NULL) {
-              offset = 0;
-              tsHeader.sync_byte = 0x47;
-              tsHeader.transport_error_indicator = 0x0;
-              tsHeader.payload_unit_start_indicator = 0x0;
-              tsHeader.transport_priority = 0x1;
-              tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-              tsHeader.pid_7to0 = (pidULE) & 0xff;
-              tsHeader.transport_scrambling_control = 0x0;
-              tsHeader.adaptation_field_control = 0x1;
-              tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-              ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-              memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-              offset += TS_HEADER_SIZE;
-
-              if (shift < 3) {
-                while (shift >= 0) {
-                  ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                  shift--;
-                }
-              }
-              else {
-                ptr = packet_ptr;
-                for (int i = 0; i < packet_length; i++) {
-                  ule[offset++] = *ptr++;
-                }
-
-                crc32 = crc32_calc_final(packet_ptr, packet_length, crc32_partial);
-                memcpy(&ule[offset], (unsigned char *) &crc32, sizeof(crc32));
-                offset += sizeof(crc32);
-              }
-            }
-            else {
-              if ((packet_length + sizeof(crc32)) > (SNDU_PAYLOAD_PP_SIZE - SNDU_BASE_HEADER_SIZE - ETHER_ADDR_LEN)) {
-                next_packet_valid = TRUE;
-                offset = 0;
-                tsHeader.sync_byte = 0x47;
-                tsHeader.transport_error_indicator = 0x0;
-                tsHeader.payload_unit_start_indicator = 0x0;
-                tsHeader.transport_priority = 0x1;
-                tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-                tsHeader.pid_7to0 = (pidULE) & 0xff;
-                tsHeader.transport_scrambling_control = 0x0;
-                tsHeader.adaptation_field_control = 0x1;
-                tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-                ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-                memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-                offset += TS_HEADER_SIZE;
-
-                if (shift < 3) {
-                  while (shift >= 0) {
-                    ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                    shift--;
-                  }
-                }
-                else {
-                  ptr = packet_ptr;
-                  for (int i = 0; i < packet_length; i++) {
-                    ule[offset++] = *ptr++;
-                  }
-
-                  crc32 = crc32_calc_final(packet_ptr, packet_length, crc32_partial);
-                  memcpy(&ule[offset], (unsigned char *) &crc32, sizeof(crc32));
-                  offset += sizeof(crc32);
-                }
-              }
-              else {
-                offset = 0;
-                tsHeader.sync_byte = 0x47;
-                tsHeader.transport_error_indicator = 0x0;
-                tsHeader.payload_unit_start_indicator = 0x1;
-                tsHeader.transport_priority = 0x1;
-                tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-                tsHeader.pid_7to0 = (pidULE) & 0xff;
-                tsHeader.transport_scrambling_control = 0x0;
-                tsHeader.adaptation_field_control = 0x1;
-                tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-                ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-                memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-                offset += TS_HEADER_SIZE;
-
-                if (shift < 3) {
-                  ule[offset++] = shift + 1;    /* Payload Pointer */
-                  while (shift >= 0) {
-                    ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                    shift--;
-                  }
-                }
-                else {
-                  ule[offset++] = packet_length + sizeof(crc32);    /* Payload Pointer */
-                  ptr = packet_ptr;
-                  for (int i = 0; i < packet_length; i++) {
-                    ule[offset++] = *ptr++;
-                  }
-
-                  crc32 = crc32_calc_final(packet_ptr, packet_length, crc32_partial);
-                  memcpy(&ule[offset], (unsigned char *) &crc32, sizeof(crc32));
-                  offset += sizeof(crc32);
-                }
-                memcpy(packet_save, packet, hdr.len);
-                temp_offset = offset;
-                length = hdr.len - sizeof(struct ether_header) + ETHER_ADDR_LEN + sizeof(crc32);
-                ule[offset++] = ((length >> 8) & 0x7f) | 0x0;
-                ule[offset++] = length & 0xff;
-                eptr = (struct ether_header *)packet_save;
-                ule[offset++] = eptr->ether_type & 0xff;
-                ule[offset++] = (eptr->ether_type >> 8) & 0xff;
-
-                if (ping_reply_mode) {
-                  ping_reply();
-                }
-                if (ipaddr_spoof_mode) {
-                  ipaddr_spoof();
-                }
-
-                ptr = eptr->ether_dhost;
-                for (int i = 0; i < ETHER_ADDR_LEN; i++) {
-                  ule[offset++] = *ptr++;
-                }
-                remainder = MPEG2_PACKET_SIZE - offset;
-                ptr = (unsigned char *)(packet_save + sizeof(struct ether_header));
-                if ((hdr.len - sizeof(struct ether_header)) < remainder) {
-                  for (unsigned int i = 0; i < hdr.len - sizeof(struct ether_header); i++) {
-                    ule[offset++] = *ptr++;
-                  }
-                }
-                else {
-                  for (unsigned int i = 0; i < remainder; i++) {
-                    ule[offset++] = *ptr++;
-                  }
-                }
-                crc32_partial = crc32_calc_partial(&ule[temp_offset], offset - temp_offset, 0xffffffff);
-                packet_ptr = ptr;
-                packet_length = hdr.len - sizeof(struct ether_header) + ETHER_ADDR_LEN + sizeof(crc32) - (offset - temp_offset);
-                shift = 3;
-                remainder = MPEG2_PACKET_SIZE - offset;
-                if (remainder != 0) {
-                  if (remainder >= 4) {
-                    remainder = 4;
-                    packet_count = 0;
-                  }
-                  else {
-                    packet_count = 1;
-                  }
-                  for (unsigned int i = 0; i < remainder; i++) {
-                    ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                    shift--;
-                  }
-                }
-                else {
-                  if (hdr.len > ((offset - temp_offset) + SNDU_PAYLOAD_SIZE)) {
-                    packet_count = ((hdr.len - ((offset - temp_offset) + SNDU_PAYLOAD_SIZE)) / SNDU_PAYLOAD_SIZE) + 2;
-                  }
-                  else {
-                    packet_count = 1;
-                  }
-                }
-              }
-            }
-
-            memset(&ule[offset], 0xff, MPEG2_PACKET_SIZE - offset);
-            dump_packet();
-            memcpy(&out[produced], &ule[0], MPEG2_PACKET_SIZE);
-            produced += MPEG2_PACKET_SIZE;
-            if (produced == size) {
-              break;
-            }
+      }
+      if (mcast || proxy || compress) {
+        filter_stats_count += cells;
+        if (filter_stats_count >= NPD_STATS_INTERVAL) {
+          filter_stats_count = 0;
+          if (mcast) {
+            publish_multicast_stats();
           }
-          else {
-            offset = 0;
-            tsHeader.sync_byte = 0x47;
-            tsHeader.transport_error_indicator = 0x0;
-            tsHeader.payload_unit_start_indicator = 0x0;
-            tsHeader.transport_priority = 0x1;
-            tsHeader.pid_12to8 = ((pidULE) >> 8) & 0x1f;
-            tsHeader.pid_7to0 = (pidULE) & 0xff;
-            tsHeader.transport_scrambling_control = 0x0;
-            tsHeader.adaptation_field_control = 0x1;
-            tsHeader.continuity_counter = ule_continuity_counter & 0xf;
-            ule_continuity_counter = (ule_continuity_counter + 1) & 0xf;
-            memcpy(&ule[offset], (unsigned char *)&tsHeader, TS_HEADER_SIZE);
-            offset += TS_HEADER_SIZE;
-
-            ptr = packet_ptr;
-            if (packet_length < SNDU_PAYLOAD_SIZE) {
-              for (int i = 0; i < packet_length; i++) {
-                ule[offset++] = *ptr++;
-              }
-              crc32_partial = crc32_calc_partial(packet_ptr, packet_length, crc32_partial);
-              shift = 3;
-              while (SNDU_PAYLOAD_SIZE - packet_length) {
-                ule[offset++] = (crc32_partial >> (shift * 8)) & 0xff;
-                packet_length++;
-                shift--;
-              }
-              if (shift == -1) {
-                packet_count = 0;
-              }
-              else {
-                packet_length = 0;
-              }
-            }
-            else {
-              for (int i = 0; i < SNDU_PAYLOAD_SIZE; i++) {
-                ule[offset++] = *ptr++;
-              }
-              crc32_partial = crc32_calc_partial(packet_ptr, SNDU_PAYLOAD_SIZE, crc32_partial);
-              packet_ptr += SNDU_PAYLOAD_SIZE;
-              packet_length -= SNDU_PAYLOAD_SIZE;
-            }
-            dump_packet();
-
-            memcpy(&out[produced], &ule[0], MPEG2_PACKET_SIZE);
-            produced += MPEG2_PACKET_SIZE;
-            if (produced == size) {
-              break;
-            }
+          if (proxy) {
+            publish_arp_stats();
           }
-        }
-        else {
-          memcpy(&out[produced], &stuffing[0], MPEG2_PACKET_SIZE);
-          produced += MPEG2_PACKET_SIZE;
-          if (produced == size) {
-            break;
+          if (compress) {
+            publish_compress_stats();
           }
         }
       }
 
       // Tell runtime system how many output items we produced.
-      return produced;
+      return cells * cell_items;
     }
 
   } /* namespace ule */
 } /* namespace gr */
-
@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Ron Economos.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import ule_swig as ule
+
+class qa_ts_analyzer (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+
+    def tearDown (self):
+        self.tb = None
+
+    def test_001_t (self):
+        # 200 cells on PID 0x35 with the counter skipping once
+        data = []
+        for i in range(200):
+            cc = i if i < 100 else i + 1
+            data += [0x47, 0x00, 0x35, 0x10 | (cc & 0xf)] + [0xff] * 184
+        src = blocks.vector_source_b(data)
+        ana = ule.ts_analyzer(1000000, ule.ITEM_BYTE)
+        self.tb.connect(src, ana)
+        self.tb.run ()
+        self.assertEqual(ana.cells_analyzed(), 200)
+        self.assertEqual(ana.cells_dropped(), 0)
+        self.assertEqual(ana.errors(ule.CHECK_SYNC_LOSS), 0)
+        self.assertEqual(ana.errors(ule.CHECK_CC), 1)
+        self.assertEqual(ana.pid_cc_errors(0x35), 1)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_ts_analyzer, "qa_ts_analyzer.xml")
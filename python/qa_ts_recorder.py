@@ -0,0 +1,70 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Ron Economos.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import os
+import struct
+import tempfile
+import ule_swig as ule
+
+class qa_ts_recorder (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+        self.dir = tempfile.mkdtemp()
+        self.filename = os.path.join(self.dir, 'rec.ts')
+
+    def tearDown (self):
+        self.tb = None
+        for name in (self.filename, self.filename + '.idx'):
+            if os.path.exists(name):
+                os.remove(name)
+        os.rmdir(self.dir)
+
+    def test_001_t (self):
+        # one cell holding two SNDUs, a 20 byte one and a 30 byte one
+        cell = [0x47, 0x40, 0x35, 0x10, 0x00]
+        cell += [0x00, 0x10] + [0x11] * 18
+        cell += [0x00, 0x1a] + [0x22] * 28
+        cell += [0xff] * (188 - len(cell))
+        null = [0x47, 0x1f, 0xff, 0x10] + [0x00] * 184
+        data = null + cell + null
+        src = blocks.vector_source_b(data)
+        rec = ule.ts_recorder(self.filename, 1.0, 1000000, 0x35)
+        self.tb.connect(src, rec)
+        self.tb.run ()
+        self.assertEqual(rec.cells_recorded(), 3)
+        self.assertEqual(rec.sndus_indexed(), 2)
+        with open(self.filename, 'rb') as f:
+            self.assertEqual([ord(c) for c in f.read(len(data))], data)
+        with open(self.filename + '.idx', 'rb') as f:
+            header = f.read(56)
+            self.assertEqual(header[0:8], 'ULETSIDX')
+            cells, entries = struct.unpack('<QQ', header[32:48])
+            self.assertEqual((cells, entries), (3, 2))
+            f.seek(4096 + 32)
+            seq, cell_number, t, offset, pid, length = struct.unpack('<QQqHHI', f.read(32))
+            self.assertEqual((seq, cell_number, offset, pid, length), (1, 1, 25, 0x35, 30))
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_ts_recorder, "qa_ts_recorder.xml")
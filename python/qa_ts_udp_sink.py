@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Ron Economos.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import socket
+import ule_swig as ule
+
+class qa_ts_udp_sink (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+        self.rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.rx.bind(('127.0.0.1', 0))
+        self.rx.settimeout(1.0)
+        self.port = self.rx.getsockname()[1]
+
+    def tearDown (self):
+        self.rx.close()
+        self.tb = None
+
+    def ts_cells (self, count):
+        data = []
+        for i in range(count):
+            data += [0x47, 0x1f, 0xff, 0x10] + [i & 0xff] * 184
+        return data
+
+    def test_001_raw (self):
+        data = self.ts_cells(14)
+        src = blocks.vector_source_b(data)
+        sink = ule.ts_udp_sink('127.0.0.1', self.port, ule.UDP_RAW, 7, 0, 1)
+        self.tb.connect(src, sink)
+        self.tb.run ()
+        received = []
+        for i in range(2):
+            received += [ord(c) for c in self.rx.recv(2048)]
+        self.assertEqual(received, data)
+        self.assertEqual(sink.datagrams_sent(), 2)
+
+    def test_002_rtp (self):
+        data = self.ts_cells(7)
+        src = blocks.vector_source_b(data)
+        sink = ule.ts_udp_sink('127.0.0.1', self.port, ule.UDP_RTP, 7, 0, 1)
+        self.tb.connect(src, sink)
+        self.tb.run ()
+        received = [ord(c) for c in self.rx.recv(2048)]
+        self.assertEqual(len(received), 12 + 7 * 188)
+        self.assertEqual(received[0], 0x80)
+        self.assertEqual(received[1], 33)
+        self.assertEqual(received[12:], data)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_ts_udp_sink, "qa_ts_udp_sink.xml")
@@ -0,0 +1,53 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Ron Economos.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+from gnuradio import gr, gr_unittest
+import ule_swig as ule
+
+class qa_ule_plp_source (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+
+    def tearDown (self):
+        self.tb = None
+
+    def make (self, plp, num_plps, class_map):
+        return ule.ule_plp_source("02:00:48:55:4c:45", "dvb0_0", "", "", "TEST",
+            ule.PING_REPLY_OFF, ule.IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0",
+            ule.NPD_OFF, plp, num_plps, class_map)
+
+    # the layout is checked before the capture is opened, so these
+    # need no interface and no privileges
+
+    def test_001_plp_out_of_range (self):
+        class_map = [1, 1, 1, 1, 1, 0, 0, 0]
+        self.assertRaises(RuntimeError, self.make, 2, 2, class_map)
+        self.assertRaises(RuntimeError, self.make, -1, 2, class_map)
+        self.assertRaises(RuntimeError, self.make, 0, 0, class_map)
+
+    def test_002_class_map_out_of_range (self):
+        self.assertRaises(RuntimeError, self.make, 0, 2, [1, 1, 1, 1, 1, 0, 0, 2])
+        self.assertRaises(RuntimeError, self.make, 0, 2, [1, 1, 1, 1, 1, 0, 0, -1])
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_ule_plp_source, "qa_ule_plp_source.xml")
@@ -21,8 +21,29 @@
 
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
+import pmt
 import ule_swig as ule
 
+MAC = "02:00:48:55:4c:45"
+CELL = 188
+ULE_PID = 0x35
+MARKER = [0x55, 0x4c, 0x45, 0x51, 0x41, 0x21]
+
+def pids (data):
+    return [((data[i + 1] & 0x1f) << 8) | data[i + 2] for i in range(0, len(data), CELL)]
+
+def find (data, pattern):
+    for i in range(len(data) - len(pattern) + 1):
+        if list(data[i:i + len(pattern)]) == pattern:
+            return i
+    return -1
+
+def ipv4_udp (payload):
+    length = 28 + len(payload)
+    return [0x45, 0, length >> 8, length & 0xff, 0, 0, 0, 0, 64, 17, 0, 0,
+            192, 0, 2, 1, 198, 51, 100, 1,
+            0x30, 0x39, 0x30, 0x39, (length - 20) >> 8, (length - 20) & 0xff, 0, 0] + payload
+
 class qa_ule_source (gr_unittest.TestCase):
 
     def setUp (self):
@@ -31,10 +52,82 @@ class qa_ule_source (gr_unittest.TestCase):
     def tearDown (self):
         self.tb = None
 
-    def test_001_t (self):
-        # set up fg
-        self.tb.run ()
-        # check data
+    # PDU ingress needs no capture interface and no privileges
+    def make (self, npd=ule.NPD_OFF, output_mode=ule.OUTPUT_THROUGHPUT,
+              ingress_mode=ule.INGRESS_PDU, item_size=ule.ITEM_BYTE,
+              bbframe_size=0, bbframe_rate=0.0):
+        return ule.ule_source(MAC, "", "", "TEST",
+            ule.PING_REPLY_OFF, ule.IPADDR_SPOOF_OFF, "0.0.0.0", "0.0.0.0",
+            npd, ule.AQM_OFF, 5.0, 100.0, output_mode, 1000000, 10.0,
+            ingress_mode, "", 1, ule.FANOUT_HASH, 0, item_size,
+            ule.SECURITY_OFF, "", 0, 32, 0, ule.DBIT_OFF, ule.PACKING_ON,
+            ule.MCAST_OFF, "", "", ule.ARP_PROXY_OFF, "", ule.ACK_FILTER_OFF,
+            ule.COMPRESS_OFF, "", bbframe_size, bbframe_rate)
+
+    def run_cells (self, src, cells):
+        head = blocks.head(gr.sizeof_char, cells * CELL)
+        snk = blocks.vector_sink_b()
+        self.tb.connect(src, head, snk)
+        self.tb.run()
+        return snk
+
+    def test_001_pdu_encapsulation (self):
+        # a raw IPv4 PDU comes out as a ULE SNDU on PID 0x35
+        src = self.make()
+        pdu = ipv4_udp(MARKER)
+        src.to_basic_block()._post(pmt.intern("pdus"),
+            pmt.cons(pmt.PMT_NIL, pmt.init_u8vector(len(pdu), pdu)))
+        # the first PSI is due after 500 cells
+        data = self.run_cells(src, 1000).data()
+        self.assertEqual(len(data), 1000 * CELL)
+        self.assertEqual(set(data[::CELL]), set([0x47]))
+        cell_pids = pids(data)
+        self.assertTrue(0 in cell_pids)
+        ule_cells = [i for i, p in enumerate(cell_pids) if p == ULE_PID]
+        self.assertEqual(len(ule_cells), 1)
+        cell = data[ule_cells[0] * CELL:(ule_cells[0] + 1) * CELL]
+        # SNDU type 0x0800, the NPA address, then the datagram
+        start = 5 + cell[4]
+        self.assertEqual(list(cell[start + 2:start + 4]), [0x08, 0x00])
+        self.assertEqual(list(cell[start + 4:start + 10]), [0x02, 0x00, 0x48, 0x55, 0x4c, 0x45])
+        self.assertEqual(find(cell, pdu), start + 10)
+
+    def test_002_ts188_items (self):
+        # one item per TS packet
+        src = self.make(item_size=ule.ITEM_TS188)
+        head = blocks.head(CELL, 400)
+        snk = blocks.vector_sink_b(CELL)
+        self.tb.connect(src, head, snk)
+        self.tb.run()
+        data = snk.data()
+        self.assertEqual(len(data), 400 * CELL)
+        self.assertEqual(set(data[::CELL]), set([0x47]))
+
+    def test_003_npd_tags (self):
+        # with nothing to send every run of null packets is tagged
+        src = self.make(npd=ule.NPD_ON)
+        snk = self.run_cells(src, 400)
+        tags = [t for t in snk.tags() if pmt.symbol_to_string(t.key) == "dnp"]
+        self.assertTrue(len(tags) > 0)
+        data = snk.data()
+        for t in tags:
+            self.assertEqual(t.offset % CELL, 0)
+            self.assertEqual(pids(data[t.offset:t.offset + CELL]), [0x1fff])
+
+    def test_004_invalid_settings (self):
+        self.assertRaises(RuntimeError, self.make, npd=ule.NPD_ON,
+            output_mode=ule.OUTPUT_BBFRAME, bbframe_size=7032 * 8, bbframe_rate=100.0)
+        self.assertRaises(RuntimeError, self.make,
+            output_mode=ule.OUTPUT_BBFRAME, bbframe_size=100, bbframe_rate=100.0)
+        src = self.make()
+        self.assertRaises(RuntimeError, src.set_mac_address, "02:00:48")
+        self.assertRaises(RuntimeError, src.set_filter, "ether src nonsense (")
+        self.assertRaises(RuntimeError, src.set_codel, 0.0, 100.0)
+        self.assertRaises(RuntimeError, src.set_ts_rate, 0)
+        # checked in every ingress mode, used only by the generator
+        self.assertRaises(RuntimeError, src.set_traffic, ule.TRAFFIC_FIXED, 1000000, 0, 1514, 1)
+        self.assertRaises(RuntimeError, src.set_traffic, ule.TRAFFIC_FIXED, 1000000, 16, 20, 1)
+        src.set_traffic(ule.TRAFFIC_IMIX, 1000000, 16, 1514, 1)
 
 
 if __name__ == '__main__':
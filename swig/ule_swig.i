@@ -10,9 +10,21 @@
 %{
 #include "ule/ule_config.h"
 #include "ule/ule_source.h"
+#include "ule/ule_plp_source.h"
+#include "ule/ts_udp_sink.h"
+#include "ule/ts_recorder.h"
+#include "ule/ts_analyzer.h"
 %}
 
 
 %include "ule/ule_config.h"
 %include "ule/ule_source.h"
 GR_SWIG_BLOCK_MAGIC2(ule, ule_source);
+%include "ule/ule_plp_source.h"
+GR_SWIG_BLOCK_MAGIC2(ule, ule_plp_source);
+%include "ule/ts_udp_sink.h"
+GR_SWIG_BLOCK_MAGIC2(ule, ts_udp_sink);
+%include "ule/ts_recorder.h"
+GR_SWIG_BLOCK_MAGIC2(ule, ts_recorder);
+%include "ule/ts_analyzer.h"
+GR_SWIG_BLOCK_MAGIC2(ule, ts_analyzer);